@@ -0,0 +1,368 @@
+/*
+  yagears                  Yet Another Gears OpenGL / Vulkan demo
+  Copyright (C) 2013-2024  Nicolas Caramelli
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "options.h"
+
+/* HDR-style histogram of the frame times in ns: each value below 2^HIST_BITS
+   has its own bucket, each power of 2 above is split into HIST_HALF buckets */
+
+#define HIST_BITS     8
+#define HIST_HALF     (1 << (HIST_BITS - 1))
+#define HIST_MAX_BITS 40
+#define HIST_SIZE     ((HIST_MAX_BITS - HIST_BITS + 2) * HIST_HALF)
+
+struct bench {
+  char *program;
+  char *engine;
+  char *backend;
+  int width;
+  int height;
+  int gears;
+  char *driver;
+  int warmup;
+  int started;
+  int done;
+  uint64_t t_start;
+  uint64_t t_last;
+  int nb;
+  uint64_t min;
+  uint64_t max;
+  double sum;
+  double sum2;
+  unsigned int hist[HIST_SIZE];
+  int threads;
+  int nb_record;
+  uint64_t record_max;
+  double record_sum;
+  int nb_gpu;
+  uint64_t gpu_max;
+  double gpu_sum;
+  double vertex_sum;
+  double fragment_sum;
+};
+
+/******************************************************************************/
+
+static int hist_index(uint64_t value)
+{
+  int shift = 0;
+
+  if (value >> HIST_MAX_BITS) {
+    value = (1ULL << HIST_MAX_BITS) - 1;
+  }
+
+  while (value >> shift >= 2 * HIST_HALF) {
+    shift++;
+  }
+
+  return shift * HIST_HALF + (value >> shift);
+}
+
+/* middle of the range of values counted in a bucket */
+static uint64_t hist_value(int index)
+{
+  int shift = index < 2 * HIST_HALF ? 0 : index / HIST_HALF - 1;
+
+  return ((uint64_t)(index - shift * HIST_HALF) << shift) + ((1ULL << shift) >> 1);
+}
+
+/* nearest-rank percentile, clamped to the exact min and max */
+static double percentile(bench_t *bench, double p)
+{
+  int rank = ceil(bench->nb * p / 100), count = 0, i;
+  uint64_t value = bench->max;
+
+  for (i = 0; i < HIST_SIZE; i++) {
+    count += bench->hist[i];
+    if (count >= rank) {
+      value = hist_value(i);
+      break;
+    }
+  }
+
+  if (value < bench->min) {
+    value = bench->min;
+  }
+  else if (value > bench->max) {
+    value = bench->max;
+  }
+
+  return value / 1000000.0;
+}
+
+static void print_string(FILE *file, const char *s, int csv)
+{
+  fputc('"', file);
+  for (; s && *s; s++) {
+    if (*s == '"') {
+      fputs(csv ? "\"\"" : "\\\"", file);
+    }
+    else if (*s == '\\' && !csv) {
+      fputs("\\\\", file);
+    }
+    else if ((unsigned char)*s >= ' ') {
+      fputc(*s, file);
+    }
+  }
+  fputc('"', file);
+}
+
+/******************************************************************************/
+
+int bench_enabled()
+{
+  return options.bench_frames > 0 || options.bench_duration > 0;
+}
+
+bench_t *bench_new(const char *program, const char *engine, const char *backend, int width, int height, int gears, const char *driver)
+{
+  bench_t *bench = NULL;
+
+  if (options.bench_format && strcmp(options.bench_format, "json") && strcmp(options.bench_format, "csv")) {
+    printf("%s: Format unknown\n", options.bench_format);
+    return NULL;
+  }
+
+  bench = calloc(1, sizeof(bench_t));
+  if (!bench) {
+    printf("calloc bench failed\n");
+    return NULL;
+  }
+
+  bench->program = strdup(program ? program : "");
+  bench->engine = strdup(engine ? engine : "");
+  bench->backend = strdup(backend ? backend : "");
+  bench->driver = strdup(driver ? driver : "");
+  if (!bench->program || !bench->engine || !bench->backend || !bench->driver) {
+    printf("strdup failed\n");
+    bench_free(bench);
+    return NULL;
+  }
+
+  bench->width = width;
+  bench->height = height;
+  bench->gears = gears;
+  bench->warmup = options.bench_warmup > 0;
+
+  return bench;
+}
+
+/* called once per drawn frame, returns 1 when the benchmark is complete */
+int bench_frame(bench_t *bench, uint64_t t)
+{
+  uint64_t frame_time;
+
+  if (!bench || bench->done) {
+    return 1;
+  }
+
+  if (!bench->started) {
+    bench->started = 1;
+    bench->t_start = bench->t_last = t;
+    return 0;
+  }
+
+  if (bench->warmup) {
+    if (t - bench->t_start >= options.bench_warmup * 1000000000ULL) {
+      bench->warmup = 0;
+      bench->t_start = t;
+    }
+    bench->t_last = t;
+    return 0;
+  }
+
+  frame_time = t - bench->t_last;
+  bench->t_last = t;
+
+  if (!bench->nb || frame_time < bench->min) {
+    bench->min = frame_time;
+  }
+  if (frame_time > bench->max) {
+    bench->max = frame_time;
+  }
+  bench->sum += frame_time;
+  bench->sum2 += (double)frame_time * frame_time;
+  bench->hist[hist_index(frame_time)]++;
+  bench->nb++;
+
+  if ((options.bench_frames > 0 && bench->nb >= options.bench_frames) || (options.bench_duration > 0 && t - bench->t_start >= options.bench_duration * 1000000000ULL)) {
+    bench->done = 1;
+  }
+
+  return bench->done;
+}
+
+void bench_record(bench_t *bench, int threads, uint64_t record_time)
+{
+  if (!bench || !bench->started || bench->warmup || bench->done) {
+    return;
+  }
+
+  bench->threads = threads;
+  if (record_time > bench->record_max) {
+    bench->record_max = record_time;
+  }
+  bench->record_sum += record_time;
+  bench->nb_record++;
+}
+
+void bench_gpu(bench_t *bench, uint64_t gpu_time, const uint64_t *statistics)
+{
+  if (!bench || !bench->started || bench->warmup || bench->done) {
+    return;
+  }
+
+  if (gpu_time > bench->gpu_max) {
+    bench->gpu_max = gpu_time;
+  }
+  bench->gpu_sum += gpu_time;
+  if (statistics) {
+    bench->vertex_sum += statistics[0];
+    bench->fragment_sum += statistics[1];
+  }
+  bench->nb_gpu++;
+}
+
+int bench_done(bench_t *bench)
+{
+  return bench ? bench->done : 0;
+}
+
+int bench_report(bench_t *bench)
+{
+  FILE *file = stdout;
+  int csv, i, first = 1;
+  double avg, stddev;
+
+  if (!bench || !bench->nb) {
+    printf("no frame measured\n");
+    return -1;
+  }
+
+  csv = options.bench_format && !strcmp(options.bench_format, "csv");
+
+  if (options.bench_output) {
+    file = fopen(options.bench_output, "a");
+    if (!file) {
+      printf("fopen %s failed: %m\n", options.bench_output);
+      return -1;
+    }
+  }
+
+  avg = bench->sum / bench->nb;
+  stddev = sqrt(fmax(bench->sum2 / bench->nb - avg * avg, 0));
+
+  if (csv) {
+    /* header only at the beginning of the file, so that runs can be appended */
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) <= 0) {
+      fprintf(file, "program,engine,backend,width,height,gears,driver,frames,fps,min,avg,stddev,p50,p95,p99,p99.9,max,record_threads,record_avg,record_max,gpu_avg,gpu_max,vertex_invocations,fragment_invocations,texture\n");
+    }
+    print_string(file, bench->program, 1);
+    fputc(',', file);
+    print_string(file, bench->engine, 1);
+    fputc(',', file);
+    print_string(file, bench->backend, 1);
+    fprintf(file, ",%d,%d,%d,", bench->width, bench->height, bench->gears);
+    print_string(file, bench->driver, 1);
+    fprintf(file, ",%d,%.2f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f", bench->nb, 1000000000.0 / avg,
+            bench->min / 1000000.0, avg / 1000000.0, stddev / 1000000.0, percentile(bench, 50), percentile(bench, 95), percentile(bench, 99), percentile(bench, 99.9), bench->max / 1000000.0);
+    if (bench->nb_record) {
+      fprintf(file, ",%d,%.6f,%.6f", bench->threads, bench->record_sum / bench->nb_record / 1000000.0, bench->record_max / 1000000.0);
+    }
+    else {
+      fprintf(file, ",,,");
+    }
+    if (bench->gpu_max) {
+      fprintf(file, ",%.6f,%.6f", bench->gpu_sum / bench->nb_gpu / 1000000.0, bench->gpu_max / 1000000.0);
+    }
+    else {
+      fprintf(file, ",,");
+    }
+    if (bench->vertex_sum || bench->fragment_sum) {
+      fprintf(file, ",%.0f,%.0f", bench->vertex_sum / bench->nb_gpu, bench->fragment_sum / bench->nb_gpu);
+    }
+    else {
+      fprintf(file, ",,");
+    }
+    fprintf(file, ",%d\n", !options.no_texture);
+  }
+  else {
+    /* one object per line (JSON Lines), with the non-empty histogram buckets as [ns, count] pairs */
+    fprintf(file, "{\"program\": ");
+    print_string(file, bench->program, 0);
+    fprintf(file, ", \"engine\": ");
+    print_string(file, bench->engine, 0);
+    fprintf(file, ", \"backend\": ");
+    print_string(file, bench->backend, 0);
+    fprintf(file, ", \"width\": %d, \"height\": %d, \"gears\": %d, \"driver\": ", bench->width, bench->height, bench->gears);
+    print_string(file, bench->driver, 0);
+    fprintf(file, ", \"frames\": %d, \"fps\": %.2f, \"frame_time_ms\": {\"min\": %.6f, \"avg\": %.6f, \"stddev\": %.6f, \"p50\": %.6f, \"p95\": %.6f, \"p99\": %.6f, \"p99.9\": %.6f, \"max\": %.6f}", bench->nb, 1000000000.0 / avg,
+            bench->min / 1000000.0, avg / 1000000.0, stddev / 1000000.0, percentile(bench, 50), percentile(bench, 95), percentile(bench, 99), percentile(bench, 99.9), bench->max / 1000000.0);
+    if (bench->nb_record) {
+      fprintf(file, ", \"record_threads\": %d, \"record_time_ms\": {\"avg\": %.6f, \"max\": %.6f}", bench->threads, bench->record_sum / bench->nb_record / 1000000.0, bench->record_max / 1000000.0);
+    }
+    if (bench->gpu_max) {
+      fprintf(file, ", \"gpu_time_ms\": {\"avg\": %.6f, \"max\": %.6f}", bench->gpu_sum / bench->nb_gpu / 1000000.0, bench->gpu_max / 1000000.0);
+    }
+    if (bench->vertex_sum || bench->fragment_sum) {
+      fprintf(file, ", \"vertex_invocations\": %.0f, \"fragment_invocations\": %.0f", bench->vertex_sum / bench->nb_gpu, bench->fragment_sum / bench->nb_gpu);
+    }
+    fprintf(file, ", \"texture\": %s", options.no_texture ? "false" : "true");
+    fprintf(file, ", \"histogram_ns\": [");
+    for (i = 0; i < HIST_SIZE; i++) {
+      if (bench->hist[i]) {
+        fprintf(file, "%s[%llu, %u]", first ? "" : ", ", (unsigned long long)hist_value(i), bench->hist[i]);
+        first = 0;
+      }
+    }
+    fprintf(file, "]}\n");
+  }
+
+  if (file != stdout) {
+    fclose(file);
+  }
+  else {
+    fflush(file);
+  }
+
+  return 0;
+}
+
+void bench_free(bench_t *bench)
+{
+  if (!bench) {
+    return;
+  }
+
+  free(bench->driver);
+  free(bench->backend);
+  free(bench->engine);
+  free(bench->program);
+  free(bench);
+}
@@ -0,0 +1,66 @@
+/*
+  yagears                  Yet Another Gears OpenGL / Vulkan demo
+  Copyright (C) 2013-2024  Nicolas Caramelli
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* benchmark mode, enabled by the BENCH_FRAMES or BENCH_DURATION options:
+   frames drawn during the first BENCH_WARMUP seconds are not measured, the
+   run is complete after BENCH_FRAMES frames or BENCH_DURATION seconds, and
+   the frame times are appended to BENCH_OUTPUT (stdout by default) in the
+   BENCH_FORMAT format (json or csv) */
+
+/* bench_frame() is given the CLOCK_MONOTONIC time of each frame in ns, frame
+   times are recorded in a fixed-size histogram and reported as the middle of
+   their bucket, each bucket above 256 ns spans 1/128 of a power of 2 so the
+   relative error is < 0.4% (1/256) */
+
+/* bench_record() is optionally given the time spent recording the draws of
+   each frame in ns and the number of threads recording them, reported to
+   compare runs with different thread counts */
+
+/* bench_gpu() is optionally given the GPU time of a frame in ns and its
+   vertex and fragment shader invocations, 0 when not measured */
+
+typedef struct bench bench_t;
+
+int bench_enabled(void);
+bench_t *bench_new(const char *program, const char *engine, const char *backend, int width, int height, int gears, const char *driver);
+int bench_frame(bench_t *bench, uint64_t t);
+void bench_record(bench_t *bench, int threads, uint64_t record_time);
+void bench_gpu(bench_t *bench, uint64_t gpu_time, const uint64_t *statistics);
+int bench_done(bench_t *bench);
+int bench_report(bench_t *bench);
+void bench_free(bench_t *bench);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -13,6 +13,9 @@
 /* Support for EGL with Raspberry Pi Dispmanx platform */
 #cmakedefine EGL_RPI
 
+/* Support for EGL with Surfaceless platform */
+#cmakedefine EGL_SURFACELESS
+
 /* Support for EGL with Wayland platform */
 #cmakedefine EGL_WAYLAND
 
@@ -49,6 +52,21 @@
 /* Have function wl_shell_surface_set_position */
 #cmakedefine HAVE_WL_SHELL_SURFACE_SET_POSITION
 
+/* Support for PortableGL rendering into DRM dumb buffers */
+#cmakedefine PGL_DRM
+
+/* Support for PortableGL rendering into Linux FBDev memory */
+#cmakedefine PGL_FBDEV
+
+/* Support for PortableGL rendering into Wayland wl_shm buffers */
+#cmakedefine PGL_WAYLAND
+
+/* Support for PortableGL rendering into Xlib MIT-SHM images */
+#cmakedefine PGL_X11
+
+/* Support for PortableGL rendering into XCB MIT-SHM segments */
+#cmakedefine PGL_XCB
+
 /* Support for Qt graphical user interface */
 #cmakedefine QT
 
@@ -67,6 +85,9 @@
 /* Support for FBDev WSI */
 #cmakedefine VK_FBDEV
 
+/* Support for Vulkan offscreen rendering */
+#cmakedefine VK_OFFSCREEN
+
 /* Support for Wayland WSI */
 #cmakedefine VK_WAYLAND
 
@@ -22,14 +22,17 @@
 */
 
 #include "list.h"
+#include "scene.h"
 
 typedef struct gears gears_t;
 
 typedef struct {
   char *name;
   int version;
-  gears_t *(*init)(int, int);
+  gears_t *(*init)(int, int, const scene_t *);
   void (*draw)(gears_t *, float, float, float, float);
   void (*term)(gears_t *);
+  const char *(*driver)(gears_t *);
+  int (*target)(gears_t *, void *, int);
   struct list entry;
 } engine_t;
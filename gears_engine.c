@@ -85,13 +85,13 @@ gears_engine_t *gears_engine_new(char *name)
   return NULL;
 }
 
-int gears_engine_init(gears_engine_t *gears_engine, int width, int height)
+int gears_engine_init(gears_engine_t *gears_engine, int width, int height, const scene_t *scene)
 {
   if (!gears_engine) {
     return -1;
   }
 
-  gears_engine->gears = gears_engine->engine->init(width, height);
+  gears_engine->gears = gears_engine->engine->init(width, height, scene);
   if (!gears_engine->gears) {
     return -1;
   }
@@ -127,6 +127,24 @@ void gears_engine_term(gears_engine_t *gears_engine)
   gears_engine->gears = NULL;
 }
 
+const char *gears_engine_driver(gears_engine_t *gears_engine)
+{
+  if (!gears_engine || !gears_engine->gears) {
+    return NULL;
+  }
+
+  return gears_engine->engine->driver(gears_engine->gears);
+}
+
+int gears_engine_target(gears_engine_t *gears_engine, void *buffer, int pitch)
+{
+  if (!gears_engine || !gears_engine->gears || !gears_engine->engine->target) {
+    return -1;
+  }
+
+  return gears_engine->engine->target(gears_engine->gears, buffer, pitch);
+}
+
 void gears_engine_free(gears_engine_t *gears_engine)
 {
   if (!gears_engine) {
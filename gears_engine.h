@@ -21,6 +21,8 @@
   THE SOFTWARE.
 */
 
+#include "scene.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,9 +33,11 @@ int gears_engine_nb(void);
 char *gears_engine_name(int opt);
 gears_engine_t *gears_engine_new(char *name);
 int gears_engine_version(gears_engine_t *gears_engine);
-int gears_engine_init(gears_engine_t *gears_engine, int width, int height);
+int gears_engine_init(gears_engine_t *gears_engine, int width, int height, const scene_t *scene);
 void gears_engine_draw(gears_engine_t *gears_engine, float view_tz, float view_rx, float view_ry, float model_rz);
 void gears_engine_term(gears_engine_t *gears_engine);
+const char *gears_engine_driver(gears_engine_t *gears_engine);
+int gears_engine_target(gears_engine_t *gears_engine, void *buffer, int pitch);
 void gears_engine_free(gears_engine_t *gears_engine);
 
 #ifdef __cplusplus
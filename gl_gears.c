@@ -26,6 +26,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "engine.h"
+#include "mesh.h"
+#include "options.h"
 
 #include "image_loader.h"
 
@@ -33,16 +35,13 @@ extern struct list engine_list;
 
 /******************************************************************************/
 
-#define GEAR0 0
-#define GEAR1 1
-#define GEAR2 2
-
 struct gear {
   GLuint list;
 };
 
 struct gears {
-  struct gear *gear[3];
+  const scene_t *scene;
+  struct gear **gear;
 };
 
 static void delete_gear(gears_t *gears, int id)
@@ -65,8 +64,9 @@ static void delete_gear(gears_t *gears, int id)
 static int create_gear(gears_t *gears, int id, float inner, float outer, float width, int teeth, float tooth_depth)
 {
   struct gear *gear;
-  float r0, r1, r2, da, a1, ai, s[5], c[5];
-  int i, j;
+  const mesh_t *mesh;
+  const float *v;
+  int i, k;
   GLenum err = GL_NO_ERROR;
 
   gear = calloc(1, sizeof(struct gear));
@@ -77,6 +77,11 @@ static int create_gear(gears_t *gears, int id, float inner, float outer, float w
 
   gears->gear[id] = gear;
 
+  mesh = mesh_get(inner, outer, width, teeth, tooth_depth, MESH_NORMAL | MESH_TEXCOORD);
+  if (!mesh) {
+    goto out;
+  }
+
   gear->list = glGenLists(1);
   if (!gear->list) {
     printf("glGenLists failed\n");
@@ -90,114 +95,14 @@ static int create_gear(gears_t *gears, int id, float inner, float outer, float w
     goto out;
   }
 
-  r0 = inner;
-  r1 = outer - tooth_depth / 2;
-  r2 = outer + tooth_depth / 2;
-  a1 = 2 * M_PI / teeth;
-  da = a1 / 4;
-
-  for (i = 0; i < teeth; i++) {
-    ai = i * a1;
-    for (j = 0; j < 5; j++) {
-      sincosf(ai + j * da, &s[j], &c[j]);
-    }
-
-    /* front face begin */
-    glBegin(GL_TRIANGLE_STRIP);
-    /* front face normal */
-    glNormal3f(0, 0, 1);
-    /* front face vertices */
-    glTexCoord2f(0.36 * r2 * s[1] / r1 + 0.5, 0.36 * r2 * c[1] / r1 + 0.5);
-    glVertex3f(r2 * c[1], r2 * s[1], width / 2);
-    glTexCoord2f(0.36 * r2 * s[2] / r1 + 0.5, 0.36 * r2 * c[2] / r1 + 0.5);
-    glVertex3f(r2 * c[2], r2 * s[2], width / 2);
-    glTexCoord2f(0.36 * r1 * s[0] / r1 + 0.5, 0.36 * r1 * c[0] / r1 + 0.5);
-    glVertex3f(r1 * c[0], r1 * s[0], width / 2);
-    glTexCoord2f(0.36 * r1 * s[3] / r1 + 0.5, 0.36 * r1 * c[3] / r1 + 0.5);
-    glVertex3f(r1 * c[3], r1 * s[3], width / 2);
-    glTexCoord2f(0.36 * r0 * s[0] / r1 + 0.5, 0.36 * r0 * c[0] / r1 + 0.5);
-    glVertex3f(r0 * c[0], r0 * s[0], width / 2);
-    glTexCoord2f(0.36 * r1 * s[4] / r1 + 0.5, 0.36 * r1 * c[4] / r1 + 0.5);
-    glVertex3f(r1 * c[4], r1 * s[4], width / 2);
-    glTexCoord2f(0.36 * r0 * s[4] / r1 + 0.5, 0.36 * r0 * c[4] / r1 + 0.5);
-    glVertex3f(r0 * c[4], r0 * s[4], width / 2);
-    glTexCoord2f(0, 0);
-    /* front face end */
-    glEnd();
-
-    /* back face begin */
-    glBegin(GL_TRIANGLE_STRIP);
-    /* back face normal */
-    glNormal3f(0, 0, -1);
-    /* back face vertices */
-    glVertex3f(r2 * c[1], r2 * s[1], -width / 2);
-    glVertex3f(r2 * c[2], r2 * s[2], -width / 2);
-    glVertex3f(r1 * c[0], r1 * s[0], -width / 2);
-    glVertex3f(r1 * c[3], r1 * s[3], -width / 2);
-    glVertex3f(r0 * c[0], r0 * s[0], -width / 2);
-    glVertex3f(r1 * c[4], r1 * s[4], -width / 2);
-    glVertex3f(r0 * c[4], r0 * s[4], -width / 2);
-    /* back face end */
-    glEnd();
-
-    /* first outward face begin */
-    glBegin(GL_TRIANGLE_STRIP);
-    /* first outward face normal */
-    glNormal3f(r2 * s[1] - r1 * s[0], r1 * c[0] - r2 * c[1], 0);
-    /* first outward face vertices */
-    glVertex3f(r1 * c[0], r1 * s[0],  width / 2);
-    glVertex3f(r1 * c[0], r1 * s[0], -width / 2);
-    glVertex3f(r2 * c[1], r2 * s[1],  width / 2);
-    glVertex3f(r2 * c[1], r2 * s[1], -width / 2);
-    /* first outward face end */
-    glEnd();
-
-    /* second outward face begin */
-    glBegin(GL_TRIANGLE_STRIP);
-    /* second outward face normal */
-    glNormal3f(s[2] - s[1], c[1] - c[2], 0);
-    /* second outward face vertices */
-    glVertex3f(r2 * c[1], r2 * s[1],  width / 2);
-    glVertex3f(r2 * c[1], r2 * s[1], -width / 2);
-    glVertex3f(r2 * c[2], r2 * s[2],  width / 2);
-    glVertex3f(r2 * c[2], r2 * s[2], -width / 2);
-    /* second outward face end */
-    glEnd();
-
-    /* third outward face begin */
-    glBegin(GL_TRIANGLE_STRIP);
-    /* third outward face normal */
-    glNormal3f(r1 * s[3] - r2 * s[2], r2 * c[2] - r1 * c[3], 0);
-    /* third outward face vertices */
-    glVertex3f(r2 * c[2], r2 * s[2],  width / 2);
-    glVertex3f(r2 * c[2], r2 * s[2], -width / 2);
-    glVertex3f(r1 * c[3], r1 * s[3],  width / 2);
-    glVertex3f(r1 * c[3], r1 * s[3], -width / 2);
-    /* third outward face end */
-    glEnd();
-
-    /* fourth outward face begin */
+  for (k = 0; k < mesh->nstrips; k++) {
     glBegin(GL_TRIANGLE_STRIP);
-    /* fourth outward face normal */
-    glNormal3f(s[4] - s[3], c[3] - c[4], 0);
-    /* fourth outward face vertices */
-    glVertex3f(r1 * c[3], r1 * s[3],  width / 2);
-    glVertex3f(r1 * c[3], r1 * s[3], -width / 2);
-    glVertex3f(r1 * c[4], r1 * s[4],  width / 2);
-    glVertex3f(r1 * c[4], r1 * s[4], -width / 2);
-    /* fourth outward face end */
-    glEnd();
-
-    /* inside face begin */
-    glBegin(GL_TRIANGLE_STRIP);
-    /* inside face normal */
-    glNormal3f(s[0] - s[4], c[4] - c[0], 0);
-    /* inside face vertices */
-    glVertex3f(r0 * c[0], r0 * s[0],  width / 2);
-    glVertex3f(r0 * c[0], r0 * s[0], -width / 2);
-    glVertex3f(r0 * c[4], r0 * s[4],  width / 2);
-    glVertex3f(r0 * c[4], r0 * s[4], -width / 2);
-    /* inside face end */
+    for (i = mesh->strips[k].begin; i < mesh->strips[k].begin + mesh->strips[k].count; i++) {
+      v = (const float *)((const char *)mesh->vertices + i * mesh->stride);
+      glNormal3fv(v + 3);
+      glTexCoord2fv(v + 6);
+      glVertex3fv(v);
+    }
     glEnd();
   }
 
@@ -236,7 +141,7 @@ static void draw_gear(gears_t *gears, int id, float model_tx, float model_ty, fl
 
   glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, color);
 
-  if (getenv("NO_TEXTURE"))
+  if (options.no_texture)
     glDisable(GL_TEXTURE_2D);
   else
     glEnable(GL_TEXTURE_2D);
@@ -250,18 +155,19 @@ static void draw_gear(gears_t *gears, int id, float model_tx, float model_ty, fl
 
 static void gl_gears_term(gears_t *gears)
 {
+  int i;
+
   if (!gears) {
     return;
   }
 
-  if (gears->gear[GEAR2]) {
-    delete_gear(gears, GEAR2);
-  }
-  if (gears->gear[GEAR1]) {
-    delete_gear(gears, GEAR1);
-  }
-  if (gears->gear[GEAR0]) {
-    delete_gear(gears, GEAR0);
+  if (gears->gear) {
+    for (i = gears->scene->nb - 1; i >= 0; i--) {
+      if (gears->gear[i]) {
+        delete_gear(gears, i);
+      }
+    }
+    free(gears->gear);
   }
 
   printf("%s\n", glGetString(GL_VERSION));
@@ -269,9 +175,10 @@ static void gl_gears_term(gears_t *gears)
   free(gears);
 }
 
-static gears_t *gl_gears_init(int win_width, int win_height)
+static gears_t *gl_gears_init(int win_width, int win_height, const scene_t *scene)
 {
   gears_t *gears = NULL;
+  int i;
   int texture_width, texture_height;
   void *texture_data = NULL;
   const GLdouble zNear = 5, zFar = 60;
@@ -282,6 +189,14 @@ static gears_t *gl_gears_init(int win_width, int win_height)
     return NULL;
   }
 
+  gears->scene = scene;
+
+  gears->gear = calloc(scene->nb, sizeof(struct gear *));
+  if (!gears->gear) {
+    printf("calloc gear failed\n");
+    goto out;
+  }
+
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_NORMALIZE);
   glEnable(GL_LIGHTING);
@@ -289,7 +204,7 @@ static gears_t *gl_gears_init(int win_width, int win_height)
 
   /* load texture */
 
-  image_load(getenv("TEXTURE"), NULL, &texture_width, &texture_height);
+  image_load(options.texture, NULL, &texture_width, &texture_height);
 
   texture_data = malloc(texture_width * texture_height * 4);
   if (!texture_data) {
@@ -297,7 +212,7 @@ static gears_t *gl_gears_init(int win_width, int win_height)
     goto out;
   }
 
-  image_load(getenv("TEXTURE"), texture_data, &texture_width, &texture_height);
+  image_load(options.texture, texture_data, &texture_width, &texture_height);
 
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture_width, texture_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data);
 
@@ -315,16 +230,10 @@ static gears_t *gl_gears_init(int win_width, int win_height)
 
   /* create gears */
 
-  if (create_gear(gears, GEAR0, 1.0, 4.0, 1.0, 20, 0.7)) {
-    goto out;
-  }
-
-  if (create_gear(gears, GEAR1, 0.5, 2.0, 2.0, 10, 0.7)) {
-    goto out;
-  }
-
-  if (create_gear(gears, GEAR2, 1.3, 2.0, 0.5, 10, 0.7)) {
-    goto out;
+  for (i = 0; i < scene->nb; i++) {
+    if (create_gear(gears, i, scene->gear[i].inner, scene->gear[i].outer, scene->gear[i].width, scene->gear[i].teeth, scene->gear[i].tooth_depth)) {
+      goto out;
+    }
   }
 
   glMatrixMode(GL_PROJECTION);
@@ -342,9 +251,8 @@ out:
 
 static void gl_gears_draw(gears_t *gears, float view_tz, float view_rx, float view_ry, float model_rz)
 {
-  const float red[4] = { 0.8, 0.1, 0.0, 1.0 };
-  const float green[4] = { 0.0, 0.8, 0.2, 1.0 };
-  const float blue[4] = { 0.2, 0.2, 1.0, 1.0 };
+  const gear_desc_t *gear_desc;
+  int i;
 
   if (!gears) {
     return;
@@ -357,9 +265,15 @@ static void gl_gears_draw(gears_t *gears, float view_tz, float view_rx, float vi
   glRotatef(view_rx, 1, 0, 0);
   glRotatef(view_ry, 0, 1, 0);
 
-  draw_gear(gears, GEAR0, -3.0, -2.0,      model_rz     , red);
-  draw_gear(gears, GEAR1,  3.1, -2.0, -2 * model_rz - 9 , green);
-  draw_gear(gears, GEAR2, -3.1,  4.2, -2 * model_rz - 25, blue);
+  for (i = 0; i < gears->scene->nb; i++) {
+    gear_desc = &gears->scene->gear[i];
+    draw_gear(gears, i, gear_desc->tx, gear_desc->ty, gear_desc->ratio * model_rz + gear_desc->phase, gear_desc->color);
+  }
+}
+
+static const char *gl_gears_driver(gears_t *gears)
+{
+  return (const char *)glGetString(GL_VERSION);
 }
 
 /******************************************************************************/
@@ -369,7 +283,8 @@ static engine_t gl_engine = {
   0,
   gl_gears_init,
   gl_gears_draw,
-  gl_gears_term
+  gl_gears_term,
+  gl_gears_driver
 };
 
 void
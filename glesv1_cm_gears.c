@@ -27,6 +27,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "engine.h"
+#include "mesh.h"
+#include "options.h"
 
 #include "image_loader.h"
 
@@ -34,23 +36,10 @@ extern struct list engine_list;
 
 /******************************************************************************/
 
-#define GEAR0 0
-#define GEAR1 1
-#define GEAR2 2
-
-typedef float Vertex[8];
-
-typedef struct {
-  int begin;
-  int count;
-} Strip;
-
 struct gear {
-  int nvertices;
-  Vertex *vertices;
-  int nstrips;
-  Strip *strips;
+  const mesh_t *mesh;
   GLuint vbo;
+  GLuint ibo;
 };
 
 struct gears {
@@ -63,6 +52,7 @@ struct gears {
   void           (*glDisable)(GLenum);
   void           (*glDisableClientState)(GLenum);
   void           (*glDrawArrays)(GLenum, GLint, GLsizei);
+  void           (*glDrawElements)(GLenum, GLsizei, GLenum, const GLvoid *);
   void           (*glEnable)(GLenum);
   void           (*glEnableClientState)(GLenum);
   void           (*glFrustumf)(GLfloat, GLfloat, GLfloat, GLfloat, GLfloat, GLfloat);
@@ -84,7 +74,8 @@ struct gears {
   void           (*glTranslatef)(GLfloat, GLfloat, GLfloat);
   void           (*glVertexPointer)(GLint, GLenum, GLsizei, const GLvoid *);
   void           (*glViewport)(GLint, GLint, GLsizei, GLsizei);
-  struct gear *gear[3];
+  const scene_t *scene;
+  struct gear **gear;
 };
 
 static void delete_gear(gears_t *gears, int id)
@@ -95,15 +86,12 @@ static void delete_gear(gears_t *gears, int id)
     return;
   }
 
+  if (gear->ibo) {
+    gears->glDeleteBuffers(1, &gear->ibo);
+  }
   if (gear->vbo) {
     gears->glDeleteBuffers(1, &gear->vbo);
   }
-  if (gear->strips) {
-    free(gear->strips);
-  }
-  if (gear->vertices) {
-    free(gear->vertices);
-  }
 
   free(gear);
 
@@ -113,10 +101,6 @@ static void delete_gear(gears_t *gears, int id)
 static int create_gear(gears_t *gears, int id, float inner, float outer, float width, int teeth, float tooth_depth)
 {
   struct gear *gear;
-  float r0, r1, r2, da, a1, ai, s[5], c[5];
-  int i, j;
-  float n[3], t[2];
-  int k = 0;
   GLenum err = GL_NO_ERROR;
 
   gear = calloc(1, sizeof(struct gear));
@@ -127,158 +111,11 @@ static int create_gear(gears_t *gears, int id, float inner, float outer, float w
 
   gears->gear[id] = gear;
 
-  gear->nvertices = 0;
-  gear->vertices = calloc(34 * teeth, sizeof(Vertex));
-  if (!gear->vertices) {
-    printf("calloc vertices failed\n");
+  gear->mesh = mesh_get(inner, outer, width, teeth, tooth_depth, MESH_NORMAL | MESH_TEXCOORD | (options.indexed ? MESH_INDEXED : 0));
+  if (!gear->mesh) {
     goto out;
   }
 
-  gear->nstrips = 7 * teeth;
-  gear->strips = calloc(gear->nstrips, sizeof(Strip));
-  if (!gear->strips) {
-    printf("calloc strips failed\n");
-    goto out;
-  }
-
-  r0 = inner;
-  r1 = outer - tooth_depth / 2;
-  r2 = outer + tooth_depth / 2;
-  a1 = 2 * M_PI / teeth;
-  da = a1 / 4;
-
-  #define normal(nx, ny, nz) \
-    n[0] = nx; \
-    n[1] = ny; \
-    n[2] = nz;
-
-  #define texcoord(tx, ty) \
-    t[0] = tx; \
-    t[1] = ty;
-
-  #define vertex(x, y, z) \
-    gear->vertices[gear->nvertices][0] = x; \
-    gear->vertices[gear->nvertices][1] = y; \
-    gear->vertices[gear->nvertices][2] = z; \
-    gear->vertices[gear->nvertices][3] = n[0]; \
-    gear->vertices[gear->nvertices][4] = n[1]; \
-    gear->vertices[gear->nvertices][5] = n[2]; \
-    gear->vertices[gear->nvertices][6] = t[0]; \
-    gear->vertices[gear->nvertices][7] = t[1]; \
-    gear->nvertices++;
-
-  for (i = 0; i < teeth; i++) {
-    ai = i * a1;
-    for (j = 0; j < 5; j++) {
-      sincosf(ai + j * da, &s[j], &c[j]);
-    }
-
-    /* front face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* front face normal */
-    normal(0, 0, 1);
-    /* front face vertices */
-    texcoord(0.36 * r2 * s[1] / r1 + 0.5, 0.36 * r2 * c[1] / r1 + 0.5);
-    vertex(r2 * c[1], r2 * s[1], width / 2);
-    texcoord(0.36 * r2 * s[2] / r1 + 0.5, 0.36 * r2 * c[2] / r1 + 0.5);
-    vertex(r2 * c[2], r2 * s[2], width / 2);
-    texcoord(0.36 * r1 * s[0] / r1 + 0.5, 0.36 * r1 * c[0] / r1 + 0.5);
-    vertex(r1 * c[0], r1 * s[0], width / 2);
-    texcoord(0.36 * r1 * s[3] / r1 + 0.5, 0.36 * r1 * c[3] / r1 + 0.5);
-    vertex(r1 * c[3], r1 * s[3], width / 2);
-    texcoord(0.36 * r0 * s[0] / r1 + 0.5, 0.36 * r0 * c[0] / r1 + 0.5);
-    vertex(r0 * c[0], r0 * s[0], width / 2);
-    texcoord(0.36 * r1 * s[4] / r1 + 0.5, 0.36 * r1 * c[4] / r1 + 0.5);
-    vertex(r1 * c[4], r1 * s[4], width / 2);
-    texcoord(0.36 * r0 * s[4] / r1 + 0.5, 0.36 * r0 * c[4] / r1 + 0.5);
-    vertex(r0 * c[4], r0 * s[4], width / 2);
-    texcoord(0, 0);
-    /* front face end */
-    gear->strips[k].count = 7;
-    k++;
-
-    /* back face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* back face normal */
-    normal(0, 0, -1);
-    /* back face vertices */
-    vertex(r2 * c[1], r2 * s[1], -width / 2);
-    vertex(r2 * c[2], r2 * s[2], -width / 2);
-    vertex(r1 * c[0], r1 * s[0], -width / 2);
-    vertex(r1 * c[3], r1 * s[3], -width / 2);
-    vertex(r0 * c[0], r0 * s[0], -width / 2);
-    vertex(r1 * c[4], r1 * s[4], -width / 2);
-    vertex(r0 * c[4], r0 * s[4], -width / 2);
-    /* back face end */
-    gear->strips[k].count = 7;
-    k++;
-
-    /* first outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* first outward face normal */
-    normal(r2 * s[1] - r1 * s[0], r1 * c[0] - r2 * c[1], 0);
-    /* first outward face vertices */
-    vertex(r1 * c[0], r1 * s[0],  width / 2);
-    vertex(r1 * c[0], r1 * s[0], -width / 2);
-    vertex(r2 * c[1], r2 * s[1],  width / 2);
-    vertex(r2 * c[1], r2 * s[1], -width / 2);
-    /* first outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* second outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* second outward face normal */
-    normal(s[2] - s[1], c[1] - c[2], 0);
-    /* second outward face vertices */
-    vertex(r2 * c[1], r2 * s[1],  width / 2);
-    vertex(r2 * c[1], r2 * s[1], -width / 2);
-    vertex(r2 * c[2], r2 * s[2],  width / 2);
-    vertex(r2 * c[2], r2 * s[2], -width / 2);
-    /* second outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* third outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* third outward face normal */
-    normal(r1 * s[3] - r2 * s[2], r2 * c[2] - r1 * c[3], 0);
-    /* third outward face vertices */
-    vertex(r2 * c[2], r2 * s[2],  width / 2);
-    vertex(r2 * c[2], r2 * s[2], -width / 2);
-    vertex(r1 * c[3], r1 * s[3],  width / 2);
-    vertex(r1 * c[3], r1 * s[3], -width / 2);
-    /* third outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* fourth outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* fourth outward face normal */
-    normal(s[4] - s[3], c[3] - c[4], 0);
-    /* fourth outward face vertices */
-    vertex(r1 * c[3], r1 * s[3],  width / 2);
-    vertex(r1 * c[3], r1 * s[3], -width / 2);
-    vertex(r1 * c[4], r1 * s[4],  width / 2);
-    vertex(r1 * c[4], r1 * s[4], -width / 2);
-    /* fourth outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* inside face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* inside face normal */
-    normal(s[0] - s[4], c[4] - c[0], 0);
-    /* inside face vertices */
-    vertex(r0 * c[0], r0 * s[0],  width / 2);
-    vertex(r0 * c[0], r0 * s[0], -width / 2);
-    vertex(r0 * c[4], r0 * s[4],  width / 2);
-    vertex(r0 * c[4], r0 * s[4], -width / 2);
-    /* inside face end */
-    gear->strips[k].count = 4;
-    k++;
-  }
-
   /* vertex buffer object */
 
   gears->glGenBuffers(1, &gear->vbo);
@@ -294,13 +131,37 @@ static int create_gear(gears_t *gears, int id, float inner, float outer, float w
     goto out;
   }
 
-  gears->glBufferData(GL_ARRAY_BUFFER, gear->nvertices * sizeof(Vertex), gear->vertices, GL_STATIC_DRAW);
+  gears->glBufferData(GL_ARRAY_BUFFER, gear->mesh->nvertices * gear->mesh->stride, gear->mesh->vertices, GL_STATIC_DRAW);
   err = gears->glGetError();
   if (err) {
     printf("glBufferData failed: 0x%x\n", (unsigned int)err);
     goto out;
   }
 
+  /* index buffer object */
+
+  if (gear->mesh->nindices) {
+    gears->glGenBuffers(1, &gear->ibo);
+    if (!gear->ibo) {
+      printf("glGenBuffers failed\n");
+      goto out;
+    }
+
+    gears->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gear->ibo);
+    err = gears->glGetError();
+    if (err) {
+      printf("glBindBuffer failed: 0x%x\n", (unsigned int)err);
+      goto out;
+    }
+
+    gears->glBufferData(GL_ELEMENT_ARRAY_BUFFER, gear->mesh->nindices * sizeof(GLushort), gear->mesh->indices, GL_STATIC_DRAW);
+    err = gears->glGetError();
+    if (err) {
+      printf("glBufferData failed: 0x%x\n", (unsigned int)err);
+      goto out;
+    }
+  }
+
   return 0;
 
 out:
@@ -330,23 +191,29 @@ static void draw_gear(gears_t *gears, int id, float model_tx, float model_ty, fl
 
   gears->glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, color);
 
-  if (getenv("NO_TEXTURE"))
+  if (options.no_texture)
     gears->glDisable(GL_TEXTURE_2D);
   else
     gears->glEnable(GL_TEXTURE_2D);
 
   gears->glBindBuffer(GL_ARRAY_BUFFER, gear->vbo);
 
-  gears->glVertexPointer(3, GL_FLOAT, sizeof(Vertex), NULL);
-  gears->glNormalPointer(GL_FLOAT, sizeof(Vertex), (const float *)NULL + 3);
-  gears->glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), (const float *)NULL + 6);
+  gears->glVertexPointer(3, GL_FLOAT, gear->mesh->stride, NULL);
+  gears->glNormalPointer(GL_FLOAT, gear->mesh->stride, (const float *)NULL + 3);
+  gears->glTexCoordPointer(2, GL_FLOAT, gear->mesh->stride, (const float *)NULL + 6);
 
   gears->glEnableClientState(GL_VERTEX_ARRAY);
   gears->glEnableClientState(GL_NORMAL_ARRAY);
   gears->glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
-  for (k = 0; k < gear->nstrips; k++) {
-    gears->glDrawArrays(GL_TRIANGLE_STRIP, gear->strips[k].begin, gear->strips[k].count);
+  if (gear->ibo) {
+    gears->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gear->ibo);
+    gears->glDrawElements(GL_TRIANGLES, gear->mesh->nindices, GL_UNSIGNED_SHORT, NULL);
+  }
+  else {
+    for (k = 0; k < gear->mesh->nstrips; k++) {
+      gears->glDrawArrays(GL_TRIANGLE_STRIP, gear->mesh->strips[k].begin, gear->mesh->strips[k].count);
+    }
   }
 
   gears->glDisableClientState(GL_TEXTURE_COORD_ARRAY);
@@ -360,18 +227,19 @@ static void draw_gear(gears_t *gears, int id, float model_tx, float model_ty, fl
 
 static void glesv1_cm_gears_term(gears_t *gears)
 {
+  int i;
+
   if (!gears) {
     return;
   }
 
-  if (gears->gear[GEAR2]) {
-    delete_gear(gears, GEAR2);
-  }
-  if (gears->gear[GEAR1]) {
-    delete_gear(gears, GEAR1);
-  }
-  if (gears->gear[GEAR0]) {
-    delete_gear(gears, GEAR0);
+  if (gears->gear) {
+    for (i = gears->scene->nb - 1; i >= 0; i--) {
+      if (gears->gear[i]) {
+        delete_gear(gears, i);
+      }
+    }
+    free(gears->gear);
   }
 
   printf("%s\n", gears->glGetString(GL_VERSION));
@@ -383,9 +251,10 @@ static void glesv1_cm_gears_term(gears_t *gears)
   free(gears);
 }
 
-static gears_t *glesv1_cm_gears_init(int win_width, int win_height)
+static gears_t *glesv1_cm_gears_init(int win_width, int win_height, const scene_t *scene)
 {
   gears_t *gears = NULL;
+  int i;
   int texture_width, texture_height;
   void *texture_data = NULL;
   const float zNear = 5, zFar = 60;
@@ -396,6 +265,14 @@ static gears_t *glesv1_cm_gears_init(int win_width, int win_height)
     return NULL;
   }
 
+  gears->scene = scene;
+
+  gears->gear = calloc(scene->nb, sizeof(struct gear *));
+  if (!gears->gear) {
+    printf("calloc gear failed\n");
+    goto out;
+  }
+
   gears->lib_handle = dlopen(GLESV1_CM_LIB, RTLD_LAZY);
   if (!gears->lib_handle) {
     printf("%s library not found\n", GLESV1_CM_LIB);
@@ -416,6 +293,7 @@ static gears_t *glesv1_cm_gears_init(int win_width, int win_height)
   DLSYM(glDisableClientState);
   DLSYM(glDeleteBuffers);
   DLSYM(glDrawArrays);
+  DLSYM(glDrawElements);
   DLSYM(glEnable);
   DLSYM(glEnableClientState);
   DLSYM(glFrustumf);
@@ -445,7 +323,7 @@ static gears_t *glesv1_cm_gears_init(int win_width, int win_height)
 
   /* load texture */
 
-  image_load(getenv("TEXTURE"), NULL, &texture_width, &texture_height);
+  image_load(options.texture, NULL, &texture_width, &texture_height);
 
   texture_data = malloc(texture_width * texture_height * 4);
   if (!texture_data) {
@@ -453,7 +331,7 @@ static gears_t *glesv1_cm_gears_init(int win_width, int win_height)
     goto out;
   }
 
-  image_load(getenv("TEXTURE"), texture_data, &texture_width, &texture_height);
+  image_load(options.texture, texture_data, &texture_width, &texture_height);
 
   gears->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture_width, texture_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data);
 
@@ -471,16 +349,10 @@ static gears_t *glesv1_cm_gears_init(int win_width, int win_height)
 
   /* create gears */
 
-  if (create_gear(gears, GEAR0, 1.0, 4.0, 1.0, 20, 0.7)) {
-    goto out;
-  }
-
-  if (create_gear(gears, GEAR1, 0.5, 2.0, 2.0, 10, 0.7)) {
-    goto out;
-  }
-
-  if (create_gear(gears, GEAR2, 1.3, 2.0, 0.5, 10, 0.7)) {
-    goto out;
+  for (i = 0; i < scene->nb; i++) {
+    if (create_gear(gears, i, scene->gear[i].inner, scene->gear[i].outer, scene->gear[i].width, scene->gear[i].teeth, scene->gear[i].tooth_depth)) {
+      goto out;
+    }
   }
 
   gears->glMatrixMode(GL_PROJECTION);
@@ -498,9 +370,8 @@ out:
 
 static void glesv1_cm_gears_draw(gears_t *gears, float view_tz, float view_rx, float view_ry, float model_rz)
 {
-  const float red[4] = { 0.8, 0.1, 0.0, 1.0 };
-  const float green[4] = { 0.0, 0.8, 0.2, 1.0 };
-  const float blue[4] = { 0.2, 0.2, 1.0, 1.0 };
+  const gear_desc_t *gear_desc;
+  int i;
 
   if (!gears) {
     return;
@@ -513,9 +384,15 @@ static void glesv1_cm_gears_draw(gears_t *gears, float view_tz, float view_rx, f
   gears->glRotatef(view_rx, 1, 0, 0);
   gears->glRotatef(view_ry, 0, 1, 0);
 
-  draw_gear(gears, GEAR0, -3.0, -2.0,      model_rz     , red);
-  draw_gear(gears, GEAR1,  3.1, -2.0, -2 * model_rz - 9 , green);
-  draw_gear(gears, GEAR2, -3.1,  4.2, -2 * model_rz - 25, blue);
+  for (i = 0; i < gears->scene->nb; i++) {
+    gear_desc = &gears->scene->gear[i];
+    draw_gear(gears, i, gear_desc->tx, gear_desc->ty, gear_desc->ratio * model_rz + gear_desc->phase, gear_desc->color);
+  }
+}
+
+static const char *glesv1_cm_gears_driver(gears_t *gears)
+{
+  return (const char *)gears->glGetString(GL_VERSION);
 }
 
 /******************************************************************************/
@@ -525,7 +402,8 @@ static engine_t glesv1_cm_engine = {
   1,
   glesv1_cm_gears_init,
   glesv1_cm_gears_draw,
-  glesv1_cm_gears_term
+  glesv1_cm_gears_term,
+  glesv1_cm_gears_driver
 };
 
 void
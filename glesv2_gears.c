@@ -23,118 +23,45 @@
 
 #include GLESV2_H
 #include <dlfcn.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include "engine.h"
+#include "mat4.h"
+#include "mesh.h"
+#include "options.h"
 
 #include "image_loader.h"
 
-extern struct list engine_list;
-
-static void identity(float *a)
-{
-  float m[16] = {
-    1, 0, 0, 0,
-    0, 1, 0, 0,
-    0, 0, 1, 0,
-    0, 0, 0, 1,
-  };
-
-  memcpy(a, m, sizeof(m));
-}
-
-static void multiply(float *a, const float *b)
-{
-  float m[16];
-  int i, j;
-  div_t d;
-
-  for (i = 0; i < 16; i++) {
-    m[i] = 0;
-    d = div(i, 4);
-    for (j = 0; j < 4; j++)
-      m[i] += (a + d.rem)[j * 4] * (b + d.quot * 4)[j];
-  }
-
-  memcpy(a, m, sizeof(m));
-}
-
-static void translate(float *a, float tx, float ty, float tz)
-{
-  float m[16] = {
-     1,  0,  0, 0,
-     0,  1,  0, 0,
-     0,  0,  1, 0,
-    tx, ty, tz, 1
-  };
-
-  multiply(a, m);
-}
-
-static void rotate(float *a, float r, float ux, float uy, float uz)
-{
-  float s, c;
-
-  sincosf(r * M_PI / 180, &s, &c);
-
-  float m[16] = {
-         ux * ux * (1 - c) + c, uy * ux * (1 - c) + uz * s, ux * uz * (1 - c) - uy * s, 0,
-    ux * uy * (1 - c) - uz * s,      uy * uy * (1 - c) + c, uy * uz * (1 - c) + ux * s, 0,
-    ux * uz * (1 - c) + uy * s, uy * uz * (1 - c) - ux * s,      uz * uz * (1 - c) + c, 0,
-                             0,                          0,                          0, 1
-  };
-
-  multiply(a, m);
-}
-
-static void transpose(float *a)
-{
-  float m[16] = {
-    a[0], a[4], a[8],  a[12],
-    a[1], a[5], a[9],  a[13],
-    a[2], a[6], a[10], a[14],
-    a[3], a[7], a[11], a[15]
-  };
-
-  memcpy(a, m, sizeof(m));
-}
-
-static void invert(float *a)
-{
-  float m[16] = {
-         1,      0,      0, 0,
-         0,      1,      0, 0,
-         0,      0,      1, 0,
-    -a[12], -a[13], -a[14], 1,
-  };
-
-  a[12] = a[13] = a[14] = 0;
-  transpose(a);
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
+#ifndef GL_UNSIGNED_INT_2_10_10_10_REV
+#define GL_UNSIGNED_INT_2_10_10_10_REV 0x8368
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
 
-  multiply(a, m);
-}
+extern struct list engine_list;
 
 /******************************************************************************/
 
-#define GEAR0 0
-#define GEAR1 1
-#define GEAR2 2
-
-typedef float Vertex[8];
-
-typedef struct {
-  int begin;
-  int count;
-} Strip;
-
 struct gear {
-  int nvertices;
-  Vertex *vertices;
-  int nstrips;
-  Strip *strips;
+  const mesh_t *mesh;
   GLuint vbo;
+  GLuint ibo;
+  GLuint instance_vbo;
 };
 
 struct gears {
@@ -153,10 +80,15 @@ struct gears {
   void           (*glDeleteShader)(GLuint);
   void           (*glDisableVertexAttribArray)(GLuint);
   void           (*glDrawArrays)(GLenum, GLint, GLsizei);
+  void           (*glDrawArraysInstanced)(GLenum, GLint, GLsizei, GLsizei);
+  void           (*glDrawElements)(GLenum, GLsizei, GLenum, const GLvoid *);
+  void           (*glDrawElementsInstanced)(GLenum, GLsizei, GLenum, const GLvoid *, GLsizei);
   void           (*glEnable)(GLenum);
   void           (*glEnableVertexAttribArray)(GLuint);
   void           (*glGenBuffers)(GLsizei, GLuint *);
   GLenum         (*glGetError)();
+  void           (*glGetIntegerv)(GLenum, GLint *);
+  void           (*glGetProgramBinary)(GLuint, GLsizei, GLsizei *, GLenum *, void *);
   void           (*glGetProgramInfoLog)(GLuint, GLsizei, GLsizei *, GLchar *);
   void           (*glGetProgramiv)(GLuint, GLenum, GLint *);
   void           (*glGetShaderInfoLog)(GLuint, GLsizei, GLsizei *, GLchar *);
@@ -164,6 +96,8 @@ struct gears {
   const GLubyte *(*glGetString)(GLenum);
   int            (*glGetUniformLocation)(GLuint, const GLchar *);
   void           (*glLinkProgram)(GLuint);
+  void           (*glProgramBinary)(GLuint, GLenum, const void *, GLsizei);
+  void           (*glProgramParameteri)(GLuint, GLenum, GLint);
   void           (*glShaderSource)(GLuint, GLsizei, const GLchar **, const GLint *);
   void           (*glUniform1i)(GLint, GLint);
   void           (*glUniform4fv)(GLint, GLsizei, const GLfloat *);
@@ -171,10 +105,13 @@ struct gears {
   void           (*glUseProgram)(GLuint);
   void           (*glTexImage2D)(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const GLvoid *);
   void           (*glTexParameteri)(GLenum, GLenum, GLint);
+  void           (*glVertexAttribDivisor)(GLuint, GLuint);
   void           (*glVertexAttribPointer)(GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid *);
   void           (*glViewport)(GLint, GLint, GLsizei, GLsizei);
   GLuint program;
-  struct gear *gear[3];
+  int layout;
+  const scene_t *scene;
+  struct gear **gear;
   float Projection[16];
   float View[16];
 };
@@ -187,14 +124,14 @@ static void delete_gear(gears_t *gears, int id)
     return;
   }
 
-  if (gear->vbo) {
-    gears->glDeleteBuffers(1, &gear->vbo);
+  if (gear->instance_vbo) {
+    gears->glDeleteBuffers(1, &gear->instance_vbo);
   }
-  if (gear->strips) {
-    free(gear->strips);
+  if (gear->ibo) {
+    gears->glDeleteBuffers(1, &gear->ibo);
   }
-  if (gear->vertices) {
-    free(gear->vertices);
+  if (gear->vbo) {
+    gears->glDeleteBuffers(1, &gear->vbo);
   }
 
   free(gear);
@@ -205,10 +142,6 @@ static void delete_gear(gears_t *gears, int id)
 static int create_gear(gears_t *gears, int id, float inner, float outer, float width, int teeth, float tooth_depth)
 {
   struct gear *gear;
-  float r0, r1, r2, da, a1, ai, s[5], c[5];
-  int i, j;
-  float n[3], t[2];
-  int k = 0;
   GLenum err = GL_NO_ERROR;
 
   gear = calloc(1, sizeof(struct gear));
@@ -219,158 +152,11 @@ static int create_gear(gears_t *gears, int id, float inner, float outer, float w
 
   gears->gear[id] = gear;
 
-  gear->nvertices = 0;
-  gear->vertices = calloc(34 * teeth, sizeof(Vertex));
-  if (!gear->vertices) {
-    printf("calloc vertices failed\n");
-    goto out;
-  }
-
-  gear->nstrips = 7 * teeth;
-  gear->strips = calloc(gear->nstrips, sizeof(Strip));
-  if (!gear->strips) {
-    printf("calloc strips failed\n");
+  gear->mesh = mesh_get(inner, outer, width, teeth, tooth_depth, gears->layout);
+  if (!gear->mesh) {
     goto out;
   }
 
-  r0 = inner;
-  r1 = outer - tooth_depth / 2;
-  r2 = outer + tooth_depth / 2;
-  a1 = 2 * M_PI / teeth;
-  da = a1 / 4;
-
-  #define normal(nx, ny, nz) \
-    n[0] = nx; \
-    n[1] = ny; \
-    n[2] = nz;
-
-  #define texcoord(tx, ty) \
-    t[0] = tx; \
-    t[1] = ty;
-
-  #define vertex(x, y, z) \
-    gear->vertices[gear->nvertices][0] = x; \
-    gear->vertices[gear->nvertices][1] = y; \
-    gear->vertices[gear->nvertices][2] = z; \
-    gear->vertices[gear->nvertices][3] = n[0]; \
-    gear->vertices[gear->nvertices][4] = n[1]; \
-    gear->vertices[gear->nvertices][5] = n[2]; \
-    gear->vertices[gear->nvertices][6] = t[0]; \
-    gear->vertices[gear->nvertices][7] = t[1]; \
-    gear->nvertices++;
-
-  for (i = 0; i < teeth; i++) {
-    ai = i * a1;
-    for (j = 0; j < 5; j++) {
-      sincosf(ai + j * da, &s[j], &c[j]);
-    }
-
-    /* front face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* front face normal */
-    normal(0, 0, 1);
-    /* front face vertices */
-    texcoord(0.36 * r2 * s[1] / r1 + 0.5, 0.36 * r2 * c[1] / r1 + 0.5);
-    vertex(r2 * c[1], r2 * s[1], width / 2);
-    texcoord(0.36 * r2 * s[2] / r1 + 0.5, 0.36 * r2 * c[2] / r1 + 0.5);
-    vertex(r2 * c[2], r2 * s[2], width / 2);
-    texcoord(0.36 * r1 * s[0] / r1 + 0.5, 0.36 * r1 * c[0] / r1 + 0.5);
-    vertex(r1 * c[0], r1 * s[0], width / 2);
-    texcoord(0.36 * r1 * s[3] / r1 + 0.5, 0.36 * r1 * c[3] / r1 + 0.5);
-    vertex(r1 * c[3], r1 * s[3], width / 2);
-    texcoord(0.36 * r0 * s[0] / r1 + 0.5, 0.36 * r0 * c[0] / r1 + 0.5);
-    vertex(r0 * c[0], r0 * s[0], width / 2);
-    texcoord(0.36 * r1 * s[4] / r1 + 0.5, 0.36 * r1 * c[4] / r1 + 0.5);
-    vertex(r1 * c[4], r1 * s[4], width / 2);
-    texcoord(0.36 * r0 * s[4] / r1 + 0.5, 0.36 * r0 * c[4] / r1 + 0.5);
-    vertex(r0 * c[4], r0 * s[4], width / 2);
-    texcoord(0, 0);
-    /* front face end */
-    gear->strips[k].count = 7;
-    k++;
-
-    /* back face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* back face normal */
-    normal(0, 0, -1);
-    /* back face vertices */
-    vertex(r2 * c[1], r2 * s[1], -width / 2);
-    vertex(r2 * c[2], r2 * s[2], -width / 2);
-    vertex(r1 * c[0], r1 * s[0], -width / 2);
-    vertex(r1 * c[3], r1 * s[3], -width / 2);
-    vertex(r0 * c[0], r0 * s[0], -width / 2);
-    vertex(r1 * c[4], r1 * s[4], -width / 2);
-    vertex(r0 * c[4], r0 * s[4], -width / 2);
-    /* back face end */
-    gear->strips[k].count = 7;
-    k++;
-
-    /* first outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* first outward face normal */
-    normal(r2 * s[1] - r1 * s[0], r1 * c[0] - r2 * c[1], 0);
-    /* first outward face vertices */
-    vertex(r1 * c[0], r1 * s[0],  width / 2);
-    vertex(r1 * c[0], r1 * s[0], -width / 2);
-    vertex(r2 * c[1], r2 * s[1],  width / 2);
-    vertex(r2 * c[1], r2 * s[1], -width / 2);
-    /* first outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* second outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* second outward face normal */
-    normal(s[2] - s[1], c[1] - c[2], 0);
-    /* second outward face vertices */
-    vertex(r2 * c[1], r2 * s[1],  width / 2);
-    vertex(r2 * c[1], r2 * s[1], -width / 2);
-    vertex(r2 * c[2], r2 * s[2],  width / 2);
-    vertex(r2 * c[2], r2 * s[2], -width / 2);
-    /* second outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* third outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* third outward face normal */
-    normal(r1 * s[3] - r2 * s[2], r2 * c[2] - r1 * c[3], 0);
-    /* third outward face vertices */
-    vertex(r2 * c[2], r2 * s[2],  width / 2);
-    vertex(r2 * c[2], r2 * s[2], -width / 2);
-    vertex(r1 * c[3], r1 * s[3],  width / 2);
-    vertex(r1 * c[3], r1 * s[3], -width / 2);
-    /* third outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* fourth outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* fourth outward face normal */
-    normal(s[4] - s[3], c[3] - c[4], 0);
-    /* fourth outward face vertices */
-    vertex(r1 * c[3], r1 * s[3],  width / 2);
-    vertex(r1 * c[3], r1 * s[3], -width / 2);
-    vertex(r1 * c[4], r1 * s[4],  width / 2);
-    vertex(r1 * c[4], r1 * s[4], -width / 2);
-    /* fourth outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* inside face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* inside face normal */
-    normal(s[0] - s[4], c[4] - c[0], 0);
-    /* inside face vertices */
-    vertex(r0 * c[0], r0 * s[0],  width / 2);
-    vertex(r0 * c[0], r0 * s[0], -width / 2);
-    vertex(r0 * c[4], r0 * s[4],  width / 2);
-    vertex(r0 * c[4], r0 * s[4], -width / 2);
-    /* inside face end */
-    gear->strips[k].count = 4;
-    k++;
-  }
-
   /* vertex buffer object */
 
   gears->glGenBuffers(1, &gear->vbo);
@@ -386,13 +172,61 @@ static int create_gear(gears_t *gears, int id, float inner, float outer, float w
     goto out;
   }
 
-  gears->glBufferData(GL_ARRAY_BUFFER, gear->nvertices * sizeof(Vertex), gear->vertices, GL_STATIC_DRAW);
+  gears->glBufferData(GL_ARRAY_BUFFER, gear->mesh->nvertices * gear->mesh->stride, gear->mesh->vertices, GL_STATIC_DRAW);
   err = gears->glGetError();
   if (err) {
     printf("glBufferData failed: 0x%x\n", (unsigned int)err);
     goto out;
   }
 
+  /* index buffer object */
+
+  if (gear->mesh->nindices) {
+    gears->glGenBuffers(1, &gear->ibo);
+    if (!gear->ibo) {
+      printf("glGenBuffers failed\n");
+      goto out;
+    }
+
+    gears->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gear->ibo);
+    err = gears->glGetError();
+    if (err) {
+      printf("glBindBuffer failed: 0x%x\n", (unsigned int)err);
+      goto out;
+    }
+
+    gears->glBufferData(GL_ELEMENT_ARRAY_BUFFER, gear->mesh->nindices * sizeof(GLushort), gear->mesh->indices, GL_STATIC_DRAW);
+    err = gears->glGetError();
+    if (err) {
+      printf("glBufferData failed: 0x%x\n", (unsigned int)err);
+      goto out;
+    }
+  }
+
+  /* instance buffer object */
+
+  if (gears->layout & MESH_INSTANCED) {
+    gears->glGenBuffers(1, &gear->instance_vbo);
+    if (!gear->instance_vbo) {
+      printf("glGenBuffers failed\n");
+      goto out;
+    }
+
+    gears->glBindBuffer(GL_ARRAY_BUFFER, gear->instance_vbo);
+    err = gears->glGetError();
+    if (err) {
+      printf("glBindBuffer failed: 0x%x\n", (unsigned int)err);
+      goto out;
+    }
+
+    gears->glBufferData(GL_ARRAY_BUFFER, gear->mesh->ninstances * 2 * sizeof(GLfloat), gear->mesh->instances, GL_STATIC_DRAW);
+    err = gears->glGetError();
+    if (err) {
+      printf("glBufferData failed: 0x%x\n", (unsigned int)err);
+      goto out;
+    }
+  }
+
   return 0;
 
 out:
@@ -417,16 +251,16 @@ static void draw_gear(gears_t *gears, int id, float model_tx, float model_ty, fl
 
   memcpy(ModelView, gears->View, sizeof(ModelView));
 
-  translate(ModelView, model_tx, model_ty, 0);
-  rotate(ModelView, model_rz, 0, 0, 1);
+  mat4_translate(ModelView, model_tx, model_ty, 0);
+  mat4_rotate_z(ModelView, model_rz);
 
   memcpy(ModelViewProjection, gears->Projection, sizeof(ModelViewProjection));
-  multiply(ModelViewProjection, ModelView);
+  mat4_multiply(ModelViewProjection, ModelView);
   ModelViewProjection_loc = gears->glGetUniformLocation(gears->program, "u_ModelViewProjectionMatrix");
   gears->glUniformMatrix4fv(ModelViewProjection_loc, 1, GL_FALSE, ModelViewProjection);
 
-  invert(ModelView);
-  transpose(ModelView);
+  mat4_rigid_invert(ModelView);
+  mat4_transpose(ModelView);
   Normal_loc = gears->glGetUniformLocation(gears->program, "u_NormalMatrix");
   gears->glUniformMatrix4fv(Normal_loc, 1, GL_FALSE, ModelView);
 
@@ -434,46 +268,329 @@ static void draw_gear(gears_t *gears, int id, float model_tx, float model_ty, fl
   gears->glUniform4fv(Color_loc, 1, color);
 
   TextureEnable_loc = gears->glGetUniformLocation(gears->program, "u_TextureEnable");
-  if (getenv("NO_TEXTURE"))
+  if (options.no_texture)
     gears->glUniform1i(TextureEnable_loc, 0);
   else
     gears->glUniform1i(TextureEnable_loc, 1);
 
+  if (gears->layout & MESH_INSTANCED) {
+    gears->glBindBuffer(GL_ARRAY_BUFFER, gear->instance_vbo);
+    gears->glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+    gears->glVertexAttribDivisor(3, 1);
+    gears->glEnableVertexAttribArray(3);
+  }
+
   gears->glBindBuffer(GL_ARRAY_BUFFER, gear->vbo);
 
-  gears->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), NULL);
-  gears->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const float *)NULL + 3);
-  gears->glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const float *)NULL + 6);
+  if (gears->layout & MESH_COMPACT) {
+    gears->glVertexAttribPointer(0, 4, GL_HALF_FLOAT, GL_FALSE, gear->mesh->stride, NULL);
+    gears->glVertexAttribPointer(1, 4, GL_UNSIGNED_INT_2_10_10_10_REV, GL_TRUE, gear->mesh->stride, (const unsigned short *)NULL + 4);
+  }
+  else {
+    gears->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, gear->mesh->stride, NULL);
+    gears->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, gear->mesh->stride, (const float *)NULL + 3);
+    gears->glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, gear->mesh->stride, (const float *)NULL + 6);
+    gears->glEnableVertexAttribArray(2);
+  }
 
   gears->glEnableVertexAttribArray(0);
   gears->glEnableVertexAttribArray(1);
-  gears->glEnableVertexAttribArray(2);
 
-  for (k = 0; k < gear->nstrips; k++) {
-    gears->glDrawArrays(GL_TRIANGLE_STRIP, gear->strips[k].begin, gear->strips[k].count);
+  if (gear->ibo) {
+    gears->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gear->ibo);
+    if (gears->layout & MESH_INSTANCED)
+      gears->glDrawElementsInstanced(GL_TRIANGLES, gear->mesh->nindices, GL_UNSIGNED_SHORT, NULL, gear->mesh->ninstances);
+    else
+      gears->glDrawElements(GL_TRIANGLES, gear->mesh->nindices, GL_UNSIGNED_SHORT, NULL);
+  }
+  else {
+    for (k = 0; k < gear->mesh->nstrips; k++) {
+      if (gears->layout & MESH_INSTANCED)
+        gears->glDrawArraysInstanced(GL_TRIANGLE_STRIP, gear->mesh->strips[k].begin, gear->mesh->strips[k].count, gear->mesh->ninstances);
+      else
+        gears->glDrawArrays(GL_TRIANGLE_STRIP, gear->mesh->strips[k].begin, gear->mesh->strips[k].count);
+    }
   }
 
-  gears->glDisableVertexAttribArray(2);
+  if (gears->layout & MESH_INSTANCED) {
+    gears->glDisableVertexAttribArray(3);
+  }
+  if (!(gears->layout & MESH_COMPACT)) {
+    gears->glDisableVertexAttribArray(2);
+  }
   gears->glDisableVertexAttribArray(1);
   gears->glDisableVertexAttribArray(0);
 }
 
+/* program binaries are cached in PROGRAM_CACHE directory, in a file named after
+   a hash of the renderer, the version and the shader sources */
+
+static uint64_t hash_string(uint64_t hash, const char *s)
+{
+  do {
+    hash ^= (unsigned char)*s;
+    hash *= 0x100000001b3ULL;
+  } while (*s++);
+
+  return hash;
+}
+
+static char *program_cache_filename(gears_t *gears, const GLchar **vertCode, const GLchar **fragCode)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  char *filename = NULL;
+  int i;
+
+  hash = hash_string(hash, (char *)gears->glGetString(GL_RENDERER));
+  hash = hash_string(hash, (char *)gears->glGetString(GL_VERSION));
+  for (i = 0; i < 3; i++) {
+    hash = hash_string(hash, vertCode[i]);
+  }
+  for (i = 0; i < 3; i++) {
+    hash = hash_string(hash, fragCode[i]);
+  }
+
+  if (asprintf(&filename, "%s/yagears2-glesv2-%016llx.bin", options.program_cache, (unsigned long long)hash) == -1) {
+    printf("asprintf failed\n");
+    return NULL;
+  }
+
+  return filename;
+}
+
+/* binary format followed by the program binary */
+static int program_cache_load(gears_t *gears, const char *filename)
+{
+  FILE *file;
+  long size;
+  GLsizei length;
+  GLenum format;
+  void *data = NULL;
+  GLint params = 0;
+  int ret = -1;
+
+  file = fopen(filename, "rb");
+  if (!file) {
+    return -1;
+  }
+
+  fseek(file, 0, SEEK_END);
+  size = ftell(file) - (long)sizeof(GLenum);
+  fseek(file, 0, SEEK_SET);
+  if (size <= 0 || size > INT_MAX) {
+    goto out;
+  }
+
+  length = size;
+
+  data = malloc(length);
+  if (!data) {
+    printf("malloc program binary failed\n");
+    goto out;
+  }
+
+  if (fread(&format, sizeof(GLenum), 1, file) != 1 || fread(data, 1, length, file) != (size_t)length) {
+    printf("fread %s failed\n", filename);
+    goto out;
+  }
+
+  /* rejected if the driver changed, the program is then built from the shaders */
+
+  gears->glProgramBinary(gears->program, format, data, length);
+  gears->glGetProgramiv(gears->program, GL_LINK_STATUS, &params);
+  if (!params) {
+    printf("%s: Program binary not valid for this driver\n", filename);
+    goto out;
+  }
+
+  ret = 0;
+
+out:
+  free(data);
+  fclose(file);
+  return ret;
+}
+
+static void program_cache_save(gears_t *gears, const char *filename)
+{
+  GLint length = 0;
+  GLenum format = 0;
+  void *data = NULL;
+  char *tmp_filename = NULL;
+  FILE *file;
+
+  gears->glGetProgramiv(gears->program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    printf("glGetProgramiv GL_PROGRAM_BINARY_LENGTH failed: %d\n", length);
+    return;
+  }
+
+  data = malloc(length);
+  if (!data) {
+    printf("malloc program binary failed\n");
+    return;
+  }
+
+  gears->glGetProgramBinary(gears->program, length, &length, &format, data);
+  if (gears->glGetError() || length <= 0) {
+    printf("glGetProgramBinary failed\n");
+    goto out;
+  }
+
+  /* written next to the cache file then renamed, so that a concurrent launch never reads a partial file */
+
+  if (asprintf(&tmp_filename, "%s.%d", filename, getpid()) == -1) {
+    printf("asprintf failed\n");
+    tmp_filename = NULL;
+    goto out;
+  }
+
+  file = fopen(tmp_filename, "wb");
+  if (!file) {
+    printf("fopen %s failed: %m\n", tmp_filename);
+    goto out;
+  }
+
+  if (fwrite(&format, sizeof(GLenum), 1, file) != 1 || fwrite(data, 1, length, file) != (size_t)length) {
+    printf("fwrite %s failed\n", tmp_filename);
+    fclose(file);
+    unlink(tmp_filename);
+    goto out;
+  }
+
+  fclose(file);
+
+  if (rename(tmp_filename, filename)) {
+    printf("rename %s failed: %m\n", tmp_filename);
+    unlink(tmp_filename);
+  }
+
+out:
+  free(tmp_filename);
+  free(data);
+}
+
+static int build_program(gears_t *gears, const GLchar **vertCode, const GLchar **fragCode)
+{
+  GLint params;
+  GLchar *log;
+  GLuint vertShader = 0;
+  GLuint fragShader = 0;
+
+  /* vertex shader */
+
+  vertShader = gears->glCreateShader(GL_VERTEX_SHADER);
+  if (!vertShader) {
+    printf("glCreateShader vertex failed\n");
+    goto out;
+  }
+
+  gears->glShaderSource(vertShader, 3, vertCode, NULL);
+
+  gears->glCompileShader(vertShader);
+  gears->glGetShaderiv(vertShader, GL_COMPILE_STATUS, &params);
+  if (!params) {
+    gears->glGetShaderiv(vertShader, GL_INFO_LOG_LENGTH, &params);
+    log = calloc(1, params);
+    if (!log) {
+      printf("calloc log failed\n");
+      goto out;
+    }
+    gears->glGetShaderInfoLog(vertShader, params, NULL, log);
+    printf("glCompileShader vertex failed: %s", log);
+    free(log);
+    goto out;
+  }
+
+  gears->glAttachShader(gears->program, vertShader);
+
+  /* fragment shader */
+
+  fragShader = gears->glCreateShader(GL_FRAGMENT_SHADER);
+  if (!fragShader) {
+    printf("glCreateShader fragment failed\n");
+    goto out;
+  }
+
+  gears->glShaderSource(fragShader, 3, fragCode, NULL);
+
+  gears->glCompileShader(fragShader);
+  gears->glGetShaderiv(fragShader, GL_COMPILE_STATUS, &params);
+  if (!params) {
+    gears->glGetShaderiv(fragShader, GL_INFO_LOG_LENGTH, &params);
+    log = calloc(1, params);
+    if (!log) {
+      printf("calloc log failed\n");
+      goto out;
+    }
+    gears->glGetShaderInfoLog(fragShader, params, NULL, log);
+    printf("glCompileShader fragment failed: %s", log);
+    free(log);
+    goto out;
+  }
+
+  gears->glAttachShader(gears->program, fragShader);
+
+  /* link and use program */
+
+  gears->glBindAttribLocation(gears->program, 0, "a_Position");
+  gears->glBindAttribLocation(gears->program, 1, "a_Normal");
+  gears->glBindAttribLocation(gears->program, 2, "a_TexCoord");
+  gears->glBindAttribLocation(gears->program, 3, "a_Rotation");
+
+  if (gears->glProgramParameteri) {
+    gears->glProgramParameteri(gears->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+
+  gears->glLinkProgram(gears->program);
+  gears->glGetProgramiv(gears->program, GL_LINK_STATUS, &params);
+  if (!params) {
+    gears->glGetProgramiv(gears->program, GL_INFO_LOG_LENGTH, &params);
+    log = calloc(1, params);
+    if (!log) {
+      printf("calloc log failed\n");
+      goto out;
+    }
+    gears->glGetProgramInfoLog(gears->program, params, NULL, log);
+    printf("glLinkProgram failed: %s", log);
+    free(log);
+    goto out;
+  }
+
+  /* destroy shaders */
+
+  gears->glDeleteShader(fragShader);
+  gears->glDeleteShader(vertShader);
+
+  return 0;
+
+out:
+  if (fragShader) {
+    gears->glDeleteShader(fragShader);
+  }
+  if (vertShader) {
+    gears->glDeleteShader(vertShader);
+  }
+  return -1;
+}
+
 /******************************************************************************/
 
 static void glesv2_gears_term(gears_t *gears)
 {
+  int i;
+
   if (!gears) {
     return;
   }
 
-  if (gears->gear[GEAR2]) {
-    delete_gear(gears, GEAR2);
-  }
-  if (gears->gear[GEAR1]) {
-    delete_gear(gears, GEAR1);
-  }
-  if (gears->gear[GEAR0]) {
-    delete_gear(gears, GEAR0);
+  if (gears->gear) {
+    for (i = gears->scene->nb - 1; i >= 0; i--) {
+      if (gears->gear[i]) {
+        delete_gear(gears, i);
+      }
+    }
+    free(gears->gear);
   }
   if (gears->program) {
     gears->glDeleteProgram(gears->program);
@@ -489,22 +606,24 @@ static void glesv2_gears_term(gears_t *gears)
   free(gears);
 }
 
-static gears_t *glesv2_gears_init(int win_width, int win_height)
+static gears_t *glesv2_gears_init(int win_width, int win_height, const scene_t *scene)
 {
   gears_t *gears = NULL;
+  int i;
   const char vertShaderSource[] = {
     #include "vert.xxd"
   };
   const char fragShaderSource[] = {
     #include "frag.xxd"
   };
-  const GLchar *code;
+  const GLchar *vertCode[3], *fragCode[3];
   GLint params;
-  GLchar *log;
-  GLuint vertShader = 0;
-  GLuint fragShader = 0;
+  char *program_cache_file = NULL;
+  int program_cached = 0;
+  struct timespec ts_start, ts_end;
   int texture_width, texture_height;
   void *texture_data = NULL;
+  int major_version, minor_version, version_3 = 0;
   const float zNear = 5, zFar = 60;
 
   gears = calloc(1, sizeof(gears_t));
@@ -513,6 +632,14 @@ static gears_t *glesv2_gears_init(int win_width, int win_height)
     return NULL;
   }
 
+  gears->scene = scene;
+
+  gears->gear = calloc(scene->nb, sizeof(struct gear *));
+  if (!gears->gear) {
+    printf("calloc gear failed\n");
+    goto out;
+  }
+
   gears->lib_handle = dlopen(GLESV2_LIB, RTLD_LAZY);
   if (!gears->lib_handle) {
     printf("%s library not found\n", GLESV2_LIB);
@@ -539,10 +666,12 @@ static gears_t *glesv2_gears_init(int win_width, int win_height)
   DLSYM(glDeleteProgram);
   DLSYM(glDisableVertexAttribArray);
   DLSYM(glDrawArrays);
+  DLSYM(glDrawElements);
   DLSYM(glEnable);
   DLSYM(glEnableVertexAttribArray);
   DLSYM(glGenBuffers);
   DLSYM(glGetError);
+  DLSYM(glGetIntegerv);
   DLSYM(glGetProgramInfoLog);
   DLSYM(glGetProgramiv);
   DLSYM(glGetShaderInfoLog);
@@ -562,102 +691,116 @@ static gears_t *glesv2_gears_init(int win_width, int win_height)
 
   gears->glEnable(GL_DEPTH_TEST);
 
-  gears->program = gears->glCreateProgram();
-  if (!gears->program) {
-    printf("glCreateProgram failed\n");
-    goto out;
-  }
+  /* vertex layout */
 
-  /* vertex shader */
+  gears->layout = MESH_NORMAL | MESH_TEXCOORD;
 
-  vertShader = gears->glCreateShader(GL_VERTEX_SHADER);
-  if (!vertShader) {
-    printf("glCreateShader vertex failed\n");
-    goto out;
+  if (options.indexed) {
+    gears->layout |= MESH_INDEXED;
   }
 
-  code = vertShaderSource;
-  gears->glShaderSource(vertShader, 1, &code, NULL);
+  /* half float, 2_10_10_10 and instanced vertex attributes are core in OpenGL ES 3.0 and OpenGL 3.3 */
 
-  gears->glCompileShader(vertShader);
-  gears->glGetShaderiv(vertShader, GL_COMPILE_STATUS, &params);
-  if (!params) {
-    gears->glGetShaderiv(vertShader, GL_INFO_LOG_LENGTH, &params);
-    log = calloc(1, params);
-    if (!log) {
-      printf("calloc log failed\n");
-      goto out;
-    }
-    gears->glGetShaderInfoLog(vertShader, params, NULL, log);
-    printf("glCompileShader vertex failed: %s", log);
-    free(log);
-    goto out;
+  if ((sscanf((char *)gears->glGetString(GL_VERSION), "OpenGL ES %d.%d", &major_version, &minor_version) == 2 && major_version >= 3) ||
+      (sscanf((char *)gears->glGetString(GL_VERSION), "%d.%d", &major_version, &minor_version) == 2 && major_version * 10 + minor_version >= 33)) {
+    version_3 = 1;
   }
 
-  gears->glAttachShader(gears->program, vertShader);
+  if (options.compact) {
+    if (version_3) {
+      gears->layout |= MESH_COMPACT;
+    }
+    else {
+      printf("compact vertex format not supported\n");
+    }
+  }
 
-  /* fragment shader */
+  if (options.instanced) {
+    if (version_3) {
+      gears->glDrawArraysInstanced = dlsym(gears->lib_handle, "glDrawArraysInstanced");
+      gears->glDrawElementsInstanced = dlsym(gears->lib_handle, "glDrawElementsInstanced");
+      gears->glVertexAttribDivisor = dlsym(gears->lib_handle, "glVertexAttribDivisor");
+    }
+    else if (strstr((char *)gears->glGetString(GL_EXTENSIONS), "GL_ANGLE_instanced_arrays")) {
+      gears->glDrawArraysInstanced = dlsym(gears->lib_handle, "glDrawArraysInstancedANGLE");
+      gears->glDrawElementsInstanced = dlsym(gears->lib_handle, "glDrawElementsInstancedANGLE");
+      gears->glVertexAttribDivisor = dlsym(gears->lib_handle, "glVertexAttribDivisorANGLE");
+    }
+    if (gears->glDrawArraysInstanced && gears->glDrawElementsInstanced && gears->glVertexAttribDivisor) {
+      gears->layout |= MESH_INSTANCED;
+    }
+    else {
+      printf("instanced arrays not supported\n");
+    }
+  }
 
-  fragShader = gears->glCreateShader(GL_FRAGMENT_SHADER);
-  if (!fragShader) {
-    printf("glCreateShader fragment failed\n");
+  gears->program = gears->glCreateProgram();
+  if (!gears->program) {
+    printf("glCreateProgram failed\n");
     goto out;
   }
 
-  code = fragShaderSource;
+  vertCode[0] = gears->layout & MESH_COMPACT ? "#define COMPACT\n" : "";
+  vertCode[1] = gears->layout & MESH_INSTANCED ? "#define INSTANCED\n" : "";
+  vertCode[2] = vertShaderSource;
+
+  fragCode[0] = "";
+  fragCode[1] = "";
+  fragCode[2] = fragShaderSource;
   if (strstr((char *)gears->glGetString(GL_SHADING_LANGUAGE_VERSION), "1.20") ||
       strstr((char *)gears->glGetString(GL_SHADING_LANGUAGE_VERSION), "1.30")) {
-    code += strlen("precision mediump float;\n");
+    fragCode[2] += strlen("precision mediump float;\n");
   }
-  gears->glShaderSource(fragShader, 1, &code, NULL);
 
-  gears->glCompileShader(fragShader);
-  gears->glGetShaderiv(fragShader, GL_COMPILE_STATUS, &params);
-  if (!params) {
-    gears->glGetShaderiv(fragShader, GL_INFO_LOG_LENGTH, &params);
-    log = calloc(1, params);
-    if (!log) {
-      printf("calloc log failed\n");
-      goto out;
+  /* program binaries are core in OpenGL ES 3.0 and OpenGL 4.1, and need at least one binary format */
+
+  if (options.program_cache) {
+    if (version_3 || strstr((char *)gears->glGetString(GL_EXTENSIONS), "GL_ARB_get_program_binary")) {
+      gears->glGetProgramBinary = dlsym(gears->lib_handle, "glGetProgramBinary");
+      gears->glProgramBinary = dlsym(gears->lib_handle, "glProgramBinary");
+      gears->glProgramParameteri = dlsym(gears->lib_handle, "glProgramParameteri");
+    }
+    else if (strstr((char *)gears->glGetString(GL_EXTENSIONS), "GL_OES_get_program_binary")) {
+      gears->glGetProgramBinary = dlsym(gears->lib_handle, "glGetProgramBinaryOES");
+      gears->glProgramBinary = dlsym(gears->lib_handle, "glProgramBinaryOES");
+    }
+    params = 0;
+    if (gears->glGetProgramBinary && gears->glProgramBinary) {
+      gears->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &params);
+      gears->glGetError();
+    }
+    if (params > 0) {
+      program_cache_file = program_cache_filename(gears, vertCode, fragCode);
+    }
+    else {
+      printf("program binaries not supported\n");
     }
-    gears->glGetShaderInfoLog(fragShader, params, NULL, log);
-    printf("glCompileShader fragment failed: %s", log);
-    free(log);
-    goto out;
   }
 
-  gears->glAttachShader(gears->program, fragShader);
-
-  /* link and use program */
-
-  gears->glBindAttribLocation(gears->program, 0, "a_Position");
-  gears->glBindAttribLocation(gears->program, 1, "a_Normal");
-  gears->glBindAttribLocation(gears->program, 2, "a_TexCoord");
-
-  gears->glLinkProgram(gears->program);
-  gears->glGetProgramiv(gears->program, GL_LINK_STATUS, &params);
-  if (!params) {
-    gears->glGetProgramiv(gears->program, GL_INFO_LOG_LENGTH, &params);
-    log = calloc(1, params);
-    if (!log) {
-      printf("calloc log failed\n");
+  clock_gettime(CLOCK_MONOTONIC, &ts_start);
+  if (program_cache_file && !program_cache_load(gears, program_cache_file)) {
+    program_cached = 1;
+  }
+  else {
+    if (build_program(gears, vertCode, fragCode)) {
       goto out;
     }
-    gears->glGetProgramInfoLog(gears->program, params, NULL, log);
-    printf("glLinkProgram failed: %s", log);
-    free(log);
-    goto out;
+    if (program_cache_file) {
+      program_cache_save(gears, program_cache_file);
+    }
   }
+  clock_gettime(CLOCK_MONOTONIC, &ts_end);
 
-  /* destroy shaders */
+  if (options.program_cache) {
+    printf("Program built in %.3f ms (%s)\n", (ts_end.tv_sec - ts_start.tv_sec) * 1000.0 + (ts_end.tv_nsec - ts_start.tv_nsec) / 1000000.0, program_cached ? "program binary loaded" : "no program binary");
+  }
 
-  gears->glDeleteShader(fragShader);
-  gears->glDeleteShader(vertShader);
-  vertShader = fragShader = 0;
+  free(program_cache_file);
+  program_cache_file = NULL;
 
   /* load texture */
 
-  image_load(getenv("TEXTURE"), NULL, &texture_width, &texture_height);
+  image_load(options.texture, NULL, &texture_width, &texture_height);
 
   texture_data = malloc(texture_width * texture_height * 4);
   if (!texture_data) {
@@ -665,7 +808,7 @@ static gears_t *glesv2_gears_init(int win_width, int win_height)
     goto out;
   }
 
-  image_load(getenv("TEXTURE"), texture_data, &texture_width, &texture_height);
+  image_load(options.texture, texture_data, &texture_width, &texture_height);
 
   gears->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture_width, texture_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data);
 
@@ -684,16 +827,10 @@ static gears_t *glesv2_gears_init(int win_width, int win_height)
 
   /* create gears */
 
-  if (create_gear(gears, GEAR0, 1.0, 4.0, 1.0, 20, 0.7)) {
-    goto out;
-  }
-
-  if (create_gear(gears, GEAR1, 0.5, 2.0, 2.0, 10, 0.7)) {
-    goto out;
-  }
-
-  if (create_gear(gears, GEAR2, 1.3, 2.0, 0.5, 10, 0.7)) {
-    goto out;
+  for (i = 0; i < scene->nb; i++) {
+    if (create_gear(gears, i, scene->gear[i].inner, scene->gear[i].outer, scene->gear[i].width, scene->gear[i].teeth, scene->gear[i].tooth_depth)) {
+      goto out;
+    }
   }
 
   memset(gears->Projection, 0, sizeof(gears->Projection));
@@ -706,21 +843,15 @@ static gears_t *glesv2_gears_init(int win_width, int win_height)
   return gears;
 
 out:
-  if (fragShader) {
-    gears->glDeleteShader(fragShader);
-  }
-  if (vertShader) {
-    gears->glDeleteShader(vertShader);
-  }
+  free(program_cache_file);
   glesv2_gears_term(gears);
   return NULL;
 }
 
 static void glesv2_gears_draw(gears_t *gears, float view_tz, float view_rx, float view_ry, float model_rz)
 {
-  const float red[4] = { 0.8, 0.1, 0.0, 1.0 };
-  const float green[4] = { 0.0, 0.8, 0.2, 1.0 };
-  const float blue[4] = { 0.2, 0.2, 1.0, 1.0 };
+  const gear_desc_t *gear_desc;
+  int i;
 
   if (!gears) {
     return;
@@ -728,14 +859,20 @@ static void glesv2_gears_draw(gears_t *gears, float view_tz, float view_rx, floa
 
   gears->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  identity(gears->View);
-  translate(gears->View, 0, 0, view_tz);
-  rotate(gears->View, view_rx, 1, 0, 0);
-  rotate(gears->View, view_ry, 0, 1, 0);
+  mat4_identity(gears->View);
+  mat4_translate(gears->View, 0, 0, view_tz);
+  mat4_rotate(gears->View, view_rx, 1, 0, 0);
+  mat4_rotate(gears->View, view_ry, 0, 1, 0);
 
-  draw_gear(gears, GEAR0, -3.0, -2.0,      model_rz     , red);
-  draw_gear(gears, GEAR1,  3.1, -2.0, -2 * model_rz - 9 , green);
-  draw_gear(gears, GEAR2, -3.1,  4.2, -2 * model_rz - 25, blue);
+  for (i = 0; i < gears->scene->nb; i++) {
+    gear_desc = &gears->scene->gear[i];
+    draw_gear(gears, i, gear_desc->tx, gear_desc->ty, gear_desc->ratio * model_rz + gear_desc->phase, gear_desc->color);
+  }
+}
+
+static const char *glesv2_gears_driver(gears_t *gears)
+{
+  return (const char *)gears->glGetString(GL_VERSION);
 }
 
 /******************************************************************************/
@@ -745,7 +882,8 @@ static engine_t glesv2_engine = {
   2,
   glesv2_gears_init,
   glesv2_gears_draw,
-  glesv2_gears_term
+  glesv2_gears_term,
+  glesv2_gears_driver
 };
 
 void
@@ -1,6 +1,14 @@
+#ifdef COMPACT
+attribute vec4 a_Position;
+attribute vec4 a_Normal;
+#else
 attribute vec3 a_Position;
 attribute vec3 a_Normal;
 attribute vec2 a_TexCoord;
+#endif
+#ifdef INSTANCED
+attribute vec2 a_Rotation;
+#endif
 uniform vec4 u_LightPos;
 uniform mat4 u_ModelViewProjectionMatrix;
 uniform mat4 u_NormalMatrix;
@@ -10,7 +18,27 @@ varying vec2 v_TexCoord;
 
 void main(void)
 {
-  gl_Position = u_ModelViewProjectionMatrix * vec4(a_Position, 1);
-  v_Color = u_Color * vec4(0.2, 0.2, 0.2, 1) + u_Color * max(dot(normalize(u_LightPos.xyz), normalize(vec3(u_NormalMatrix * vec4(a_Normal, 1)))), 0.0);
-  v_TexCoord = a_TexCoord;
+#ifdef COMPACT
+  vec3 position = a_Position.xyz;
+  vec3 normal = a_Normal.xyz * 2.0 - 1.0;
+#else
+  vec3 position = a_Position;
+  vec3 normal = a_Normal;
+  vec2 texcoord = a_TexCoord;
+#endif
+#ifdef INSTANCED
+  mat2 rotation = mat2(a_Rotation.x, a_Rotation.y, -a_Rotation.y, a_Rotation.x);
+  position.xy = rotation * position.xy;
+  normal.xy = rotation * normal.xy;
+#ifndef COMPACT
+  texcoord = ((rotation * (texcoord.yx - 0.5)).yx + 0.5) * sign(dot(texcoord, texcoord));
+#endif
+#endif
+#ifdef COMPACT
+  v_TexCoord = (position.yx * a_Position.w + 0.5) * sign(a_Position.w);
+#else
+  v_TexCoord = texcoord;
+#endif
+  gl_Position = u_ModelViewProjectionMatrix * vec4(position, 1);
+  v_Color = u_Color * vec4(0.2, 0.2, 0.2, 1) + u_Color * max(dot(normalize(u_LightPos.xyz), normalize(vec3(u_NormalMatrix * vec4(normal, 1)))), 0.0);
 }
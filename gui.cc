@@ -24,11 +24,12 @@
 #include "config.h"
 
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/time.h>
+#include <time.h>
 
 #if defined(EFL)
 #include <Elementary.h>
@@ -82,7 +83,9 @@ void fl_open_display();
 void fl_close_display();
 #endif
 
+#include "bench.h"
 #include "gears_engine.h"
+#include "options.h"
 
 #if !defined(ENGINE_CTOR) && defined(YAGEARS_ENGINE)
 #define stringify_engine_ctor(name)       name##_engine_ctor()
@@ -104,40 +107,45 @@ engine_ctor_proto(YAGEARS_ENGINE);
 
 static char *toolkit = NULL;
 static gears_engine_t *gears_engine = NULL;
+static scene_t *scene = NULL;
+static bench_t *bench = NULL;
 
-static int loop = 0, animate = 1, t_rate = 0, t_rot = 0, frames = 0, win_width = 0, win_height = 0, win_posx = 0, win_posy = 0;
+static int loop = 0, animate = 1, frames = 0, win_width = 0, win_height = 0, win_posx = 0, win_posy = 0, nb_gears = 3;
+static uint64_t t_rate = 0, t_rot = 0;
 static float fps = 0, view_tz = -40.0, view_rx = 20.0, view_ry = 30.0, model_rz = 210.0;
 
 /******************************************************************************/
 
-static int current_time()
+static uint64_t current_time()
 {
-  struct timeval tv;
+  struct timespec ts;
 
-  gettimeofday(&tv, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &ts);
 
-  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
 /******************************************************************************/
 
 static void rotate()
 {
-  int t;
+  uint64_t t;
 
   t = current_time();
 
-  if (t - t_rate >= 2000) {
+  if (t - t_rate >= 2000000000) {
     loop++;
-    fps += frames * 1000.0 / (t - t_rate);
+    fps += frames * 1000000000.0 / (t - t_rate);
     t_rate = t;
     frames = 0;
   }
 
-  model_rz += 15 * (t - t_rot) / 1000.0;
+  model_rz += 15 * (t - t_rot) / 1000000000.0;
   model_rz = fmod(model_rz, 360);
 
   t_rot = t;
+
+  if (bench) bench_frame(bench, t);
 }
 
 /******************************************************************************/
@@ -152,6 +160,11 @@ static void elm_glview_render(Evas_Object *object)
 
 static Eina_Bool ecore_animator(void *data)
 {
+  if (bench_done(bench)) {
+    elm_exit();
+    return EINA_FALSE;
+  }
+
   if (animate) {
     if (!frames) return EINA_TRUE;
     elm_glview_changed_set((Evas_Object *)data);
@@ -197,12 +210,7 @@ static Eina_Bool ecore_event_key_down(void *widget, int type, void *event)
       view_ry += 5.0;
     }
     else if (!strcmp(((Ecore_Event_Key *)event)->keyname, "t")) {
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
     }
     else {
       return EINA_FALSE;
@@ -239,6 +247,12 @@ void draw()
 public:
 void idle()
 {
+  if (bench_done(bench)) {
+    idle_id = 0;
+    quit = 1;
+    return;
+  }
+
   if (animate) {
     if (!frames) return;
     redraw();
@@ -284,12 +298,7 @@ int handle(int event)
       view_ry += 5.0;
       break;
     case 't':
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return 0;
@@ -316,6 +325,11 @@ static void glfwDisplay(GLFWwindow *window)
 
 static void glfwIdle(GLFWwindow *window)
 {
+  if (bench_done(bench)) {
+    glfwSetWindowShouldClose(window, GL_TRUE);
+    return;
+  }
+
   if (animate) {
     if (!frames) return;
     glfwDisplay(window);
@@ -359,12 +373,7 @@ static void glfwKeyCallback(GLFWwindow *window, int key, int scancode, int actio
       view_ry += 5.0;
       break;
     case GLFW_KEY_T:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -389,6 +398,12 @@ static void glutDisplay()
 
 static void glutIdle()
 {
+  if (bench_done(bench)) {
+    glutIdleFunc(NULL);
+    glutLeaveMainLoop();
+    return;
+  }
+
   if (animate) {
     if (!frames) return;
     glutPostRedisplay();
@@ -412,12 +427,7 @@ static void glutKeyboard(unsigned char key, int x, int y)
       }
       break;
     case 't':
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       break;
@@ -471,6 +481,11 @@ static gboolean gtk_render(GtkWidget *widget)
 
 static gboolean gtk_idle(gpointer data)
 {
+  if (bench_done(bench)) {
+    gtk_main_quit();
+    return FALSE;
+  }
+
   if (animate) {
     if (!frames) return TRUE;
     gtk_widget_queue_draw(GTK_WIDGET(data));
@@ -514,12 +529,7 @@ static gboolean gtk_key_press_event(GtkWidget *widget, GdkEventKey *event, gpoin
       view_ry += 5.0;
       break;
     case GDK_t:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return FALSE;
@@ -551,6 +561,12 @@ void paintGL()
 
 void timerEvent(QTimerEvent *event)
 {
+  if (bench_done(bench)) {
+    killTimer(timer_id);
+    close();
+    return;
+  }
+
   if (animate) {
     if (!frames) return;
     updateGL();
@@ -592,12 +608,7 @@ void keyPressEvent(QKeyEvent *event)
       view_ry += 5.0;
       break;
     case Qt::Key_T:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -634,6 +645,13 @@ static void SDL_Idle(SDL_Window *window)
 static void SDL_Idle()
 #endif
 {
+  if (bench_done(bench)) {
+    SDL_Event sdl_quit;
+    sdl_quit.type = SDL_USEREVENT;
+    SDL_PushEvent(&sdl_quit);
+    return;
+  }
+
   if (animate) {
     if (!frames) return;
     #if SDL_VERSION_ATLEAST(2,0,0)
@@ -692,12 +710,7 @@ static void SDL_KeyDownEvent(SDL_Event *event, void *data)
       view_ry += 5.0;
       break;
     case SDLK_t:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -734,6 +747,11 @@ void draw()
 
 void idle()
 {
+  if (bench_done(bench)) {
+    idle_id = 0;
+    return;
+  }
+
   if (animate) {
     if (!frames) return;
     draw();
@@ -778,12 +796,7 @@ void keyPressedEvent(sf::Event &event)
       view_ry += 5.0;
       break;
     case sf::Keyboard::T:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -829,6 +842,12 @@ void WxPaintEventHandler(wxPaintEvent &event)
 
 void WxTimerEventHandler(wxTimerEvent &event)
 {
+  if (bench_done(bench)) {
+    timer_id.Stop();
+    wxExit();
+    return;
+  }
+
   if (animate) {
     if (!frames) return;
     Refresh();
@@ -870,12 +889,7 @@ void WxKeyEventHandler(wxKeyEvent &event)
       view_ry += 5.0;
       break;
     case 'T':
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -958,7 +972,9 @@ int main(int argc, char *argv[])
   WxFrame *wx_win;
   #endif
 
-  /* process command line */
+  /* process environment and command line */
+
+  options_init();
 
   memset(toolkits, 0, sizeof(toolkits));
   #if defined(EFL)
@@ -989,7 +1005,7 @@ int main(int argc, char *argv[])
   strcat(toolkits, "wx ");
   #endif
 
-  while ((opt = getopt(argc, argv, "t:e:h")) != -1) {
+  while ((opt = getopt(argc, argv, "t:e:o:h")) != -1) {
     switch (opt) {
       case 't':
         toolkit_arg = optarg;
@@ -997,6 +1013,11 @@ int main(int argc, char *argv[])
       case 'e':
         engine_arg = optarg;
         break;
+      case 'o':
+        if (options_set(optarg) == -1) {
+          return EXIT_FAILURE;
+        }
+        break;
       case 'h':
       default:
         break;
@@ -1014,14 +1035,19 @@ int main(int argc, char *argv[])
   }
   else
   #endif
-  if (argc != 5 || !toolkit_arg || !engine_arg) {
-    printf("\n\tUsage: %s -t Toolkit -e Engine\n\n", argv[0]);
+  if (optind != argc || !toolkit_arg || !engine_arg) {
+    printf("\n\tUsage: %s -t Toolkit -e Engine [-o Option[=Value]]...\n\n", argv[0]);
     printf("\t\tToolkits: %s\n\n", toolkits);
     printf("\t\tEngines:  ");
     for (opt = 0; opt < gears_engine_nb(); opt++) {
       printf("%s ", gears_engine_name(opt));
     }
     printf("\n\n");
+    printf("\t\tOptions:  ");
+    for (opt = 0; opt < options_nb(); opt++) {
+      printf("%s ", options_name(opt));
+    }
+    printf("\n\n");
     return EXIT_FAILURE;
   }
 
@@ -1149,20 +1175,24 @@ int main(int argc, char *argv[])
   }
   #endif
 
-  if (getenv("WIDTH")) {
-    win_width = atoi(getenv("WIDTH"));
+  if (options.width) {
+    win_width = options.width;
+  }
+
+  if (options.height) {
+    win_height = options.height;
   }
 
-  if (getenv("HEIGHT")) {
-    win_height = atoi(getenv("HEIGHT"));
+  if (options.posx) {
+    win_posx = options.posx;
   }
 
-  if (getenv("POSX")) {
-    win_posx = atoi(getenv("POSX"));
+  if (options.posy) {
+    win_posy = options.posy;
   }
 
-  if (getenv("POSY")) {
-    win_posy = atoi(getenv("POSY"));
+  if (options.gears) {
+    nb_gears = options.gears;
   }
 
   /* Toolkit window */
@@ -1293,12 +1323,23 @@ int main(int argc, char *argv[])
 
   /* drawing (main event loop) */
 
-  err = gears_engine_init(gears_engine, win_width, win_height);
+  scene = scene_new(nb_gears);
+  if (!scene) {
+    goto out;
+  }
+
+  err = gears_engine_init(gears_engine, win_width, win_height, scene);
   if (err == -1) {
     goto out;
   }
 
-  if (getenv("NO_ANIM")) {
+  if (bench_enabled()) {
+    bench = bench_new("yagears2-gui", engine_arg, toolkit, win_width, win_height, scene->nb, gears_engine_driver(gears_engine));
+    if (!bench) {
+      goto out;
+    }
+  }
+  else if (options.no_anim) {
     animate = 0;
   }
 
@@ -1390,7 +1431,7 @@ int main(int argc, char *argv[])
         if (event.type == sf::Event::Closed)
           break;
       }
-      if (event.type == sf::Event::Closed)
+      if (event.type == sf::Event::Closed || bench_done(bench))
         break;
     }
   }
@@ -1411,6 +1452,13 @@ int main(int argc, char *argv[])
 
   gears_engine_term(gears_engine);
 
+  if (bench) {
+    err = bench_report(bench);
+    if (err == -1) {
+      goto out;
+    }
+  }
+
   ret = EXIT_SUCCESS;
 
 out:
@@ -1484,6 +1532,10 @@ out:
   }
   #endif
 
+  bench_free(bench);
+
+  scene_free(scene);
+
   gears_engine_free(gears_engine);
 
   return ret;
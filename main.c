@@ -25,10 +25,11 @@
 
 #include <math.h>
 #include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 #if defined(GL_X11)
@@ -128,12 +129,46 @@ struct __DRIimageExtensionRec {
 #include <fcntl.h>
 #include <termios.h>
 #endif
-#if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI)
+#if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI) || defined(EGL_SURFACELESS)
 #include <EGL/egl.h>
 #endif
-#if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM)
+#if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_SURFACELESS)
 #include <EGL/eglext.h>
 #endif
+#if defined(PGL_FBDEV)
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <linux/input.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#endif
+#if defined(PGL_DRM)
+#include <dirent.h>
+#include <fcntl.h>
+#include <libevdev/libevdev.h>
+#include <sys/mman.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#endif
+#if defined(PGL_X11)
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#endif
+#if defined(PGL_WAYLAND)
+#include <poll.h>
+#include <sys/mman.h>
+#include <wayland-client.h>
+#include <xkbcommon/xkbcommon.h>
+#endif
+#if defined(PGL_XCB)
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <xcb/xcb.h>
+#include <xcb/shm.h>
+#endif
 #if defined(WAFFLE)
 #include <fcntl.h>
 #include <libinput.h>
@@ -141,7 +176,9 @@ struct __DRIimageExtensionRec {
 #include <waffle.h>
 #endif
 
+#include "bench.h"
 #include "gears_engine.h"
+#include "options.h"
 
 #if !defined(ENGINE_CTOR) && defined(YAGEARS_ENGINE)
 #define stringify_engine_ctor(name)       name##_engine_ctor()
@@ -159,10 +196,18 @@ engine_ctor_proto(YAGEARS_ENGINE);
 
 /******************************************************************************/
 
-static char *backend = NULL;
+typedef struct {
+  const char *name;
+  void (*swap)(void);
+  void (*present)(void);
+  void (*poll_events)(void);
+} backend_t;
+
+static backend_t *backend = NULL;
 static gears_engine_t *gears_engine = NULL;
+static scene_t *scene = NULL;
 
-static int loop = 1, animate = 1, redisplay = 1, win_width = 0, win_height = 0, win_posx = 0, win_posy = 0;
+static int loop = 1, animate = 1, redisplay = 1, win_width = 0, win_height = 0, win_posx = 0, win_posy = 0, nb_gears = 3;
 static float fps = 0, view_tz = -40.0, view_rx = 20.0, view_ry = 30.0, model_rz = 210.0;
 
 /******************************************************************************/
@@ -181,7 +226,7 @@ static void sighandler(int signum)
 
 /******************************************************************************/
 
-#if defined(GL_X11) || defined(EGL_X11)
+#if defined(GL_X11) || defined(EGL_X11) || defined(PGL_X11)
 static void x11_keyboard_handle_key(XEvent *event)
 {
   switch (XLookupKeysym(&event->xkey, 0)) {
@@ -216,12 +261,7 @@ static void x11_keyboard_handle_key(XEvent *event)
       view_ry += 5.0;
       break;
     case XK_t:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -268,12 +308,7 @@ static void dfb_keyboard_handle_key(DFBWindowEvent *event)
       view_ry += 5.0;
       break;
     case DIKS_SMALL_T:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -285,7 +320,7 @@ static void dfb_keyboard_handle_key(DFBWindowEvent *event)
 }
 #endif
 
-#if defined(GL_FBDEV) || defined(EGL_FBDEV)
+#if defined(GL_FBDEV) || defined(EGL_FBDEV) || defined(PGL_FBDEV)
 struct fb_window {
   int width;
   int height;
@@ -327,12 +362,7 @@ static void fb_keyboard_handle_key(struct input_event *event)
       view_ry += 5.0;
       break;
     case KEY_T:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -360,7 +390,9 @@ struct wl_window {
   void (*destroy_window_callback)(void *);
   struct wl_surface *surface;
 };
+#endif
 
+#if defined(EGL_WAYLAND) || defined(PGL_WAYLAND)
 struct wl_data {
   int width;
   int height;
@@ -368,6 +400,7 @@ struct wl_data {
   struct wl_output *wl_output;
   struct wl_compositor *wl_compositor;
   struct wl_shell *wl_shell;
+  struct wl_shm *wl_shm;
   struct wl_seat *wl_seat;
   struct wl_keyboard *wl_keyboard;
   struct xkb_context *xkb_context;
@@ -460,12 +493,7 @@ static void wl_keyboard_handle_key(void *data, struct wl_keyboard *keyboard, uns
       view_ry += 5.0;
       break;
     case XKB_KEY_t:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -510,6 +538,9 @@ static void wl_registry_handle_global(void *data, struct wl_registry *registry,
   else if (!strcmp(interface, "wl_shell")) {
     wl_data->wl_shell = wl_registry_bind(registry, name, &wl_shell_interface, 1);
   }
+  else if (!strcmp(interface, "wl_shm")) {
+    wl_data->wl_shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+  }
   else if (!strcmp(interface, "wl_seat")) {
     wl_data->wl_seat = wl_registry_bind(registry, name, &wl_seat_interface, 1);
     wl_seat_add_listener(wl_data->wl_seat, &wl_seat_listener, wl_data);
@@ -523,7 +554,7 @@ static void wl_registry_handle_global_remove(void *data, struct wl_registry *reg
 static struct wl_registry_listener wl_registry_listener = { wl_registry_handle_global, wl_registry_handle_global_remove };
 #endif
 
-#if defined(EGL_XCB)
+#if defined(EGL_XCB) || defined(PGL_XCB)
 static void xcb_keyboard_handle_key(xcb_generic_event_t *event)
 {
   switch (((xcb_key_press_event_t *)event)->detail) {
@@ -558,12 +589,7 @@ static void xcb_keyboard_handle_key(xcb_generic_event_t *event)
       view_ry += 5.0;
       break;
     case 0x1c:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -699,7 +725,9 @@ static void gbm_destroy_user_data(struct gbm_bo *bo, void *data)
 {
   drmModeRmFB(gbm_device_get_fd(gbm_bo_get_device(bo)), (uintptr_t)data);
 }
+#endif
 
+#if defined(EGL_DRM) || defined(PGL_DRM)
 static void drm_keyboard_handle_key(struct input_event *event)
 {
   switch (event->code) {
@@ -734,12 +762,7 @@ static void drm_keyboard_handle_key(struct input_event *event)
       view_ry += 5.0;
       break;
     case KEY_T:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -794,12 +817,7 @@ static void rpi_keyboard_handle_key(char *event)
       view_ry += 5.0;
     }
     else if (!strcmp(event, "\x74")) {
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
     }
     else {
       return;
@@ -848,50 +866,602 @@ static void waffle_keyboard_handle_key(struct libinput_event_keyboard *event)
       view_ry += 5.0;
       break;
     case KEY_T:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
   }
 
-  if (!animate) {
-    redisplay = 1;
+  if (!animate) {
+    redisplay = 1;
+  }
+}
+
+static int waffle_input_handle_open(const char *path, int flags, void *user_data)
+{
+  return open(path, flags);
+}
+
+static void waffle_input_handle_close(int fd, void *user_data)
+{
+  close(fd);
+}
+
+static struct libinput_interface waffle_input_interface = { waffle_input_handle_open, waffle_input_handle_close };
+#endif
+
+/******************************************************************************/
+
+#if defined(GL_X11) || defined(EGL_X11) || defined(PGL_X11)
+static Display *x11_dpy = NULL;
+static Window x11_win = 0;
+#endif
+#if defined(GL_DIRECTFB) || defined(EGL_DIRECTFB)
+static IDirectFBSurface *dfb_win = NULL;
+static IDirectFBEventBuffer *dfb_event_buffer = NULL;
+#endif
+#if defined(GL_DIRECTFB)
+static IDirectFBGL *dfb_ctx = NULL;
+#endif
+#if defined(GL_FBDEV) || defined(EGL_FBDEV) || defined(PGL_FBDEV)
+static int fb_dpy = -1;
+static struct fb_var_screeninfo fb_vinfo;
+static int fb_keyboard = -1;
+#endif
+#if defined(GL_FBDEV)
+static GLFBDevBufferPtr fb_buffer = NULL;
+#endif
+#if defined(EGL_WAYLAND) || defined(PGL_WAYLAND)
+static struct wl_display *wl_dpy = NULL;
+static struct wl_surface *wl_surface = NULL;
+#endif
+#if defined(EGL_XCB) || defined(PGL_XCB)
+static xcb_connection_t *xcb_dpy = NULL;
+static xcb_window_t xcb_win = -1;
+#endif
+#if defined(EGL_DRM)
+static struct drm_display *drm_dpy = NULL;
+static struct drm_surface *drm_win = NULL;
+#endif
+#if defined(EGL_DRM) || defined(PGL_DRM)
+static int drm_fd = -1;
+static drmModeConnectorPtr drm_connector = NULL;
+static drmModeCrtcPtr drm_crtc = NULL;
+static struct libevdev *drm_evdev = NULL;
+#endif
+#if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI) || defined(EGL_SURFACELESS)
+static EGLDisplay egl_dpy = NULL;
+static EGLSurface egl_win = NULL;
+#endif
+#if defined(PGL_FBDEV) || defined(PGL_DRM) || defined(PGL_X11) || defined(PGL_WAYLAND) || defined(PGL_XCB)
+struct pgl_buffer {
+  void *addr;
+  int pitch;
+  int offset;
+  uint32_t handle;
+  uint32_t fb_id;
+  void *map;
+  uint64_t size;
+  int busy;
+  #if defined(PGL_X11)
+  XShmSegmentInfo x11_shm;
+  XImage *x11_image;
+  #endif
+  #if defined(PGL_WAYLAND)
+  struct wl_buffer *wl_buffer;
+  #endif
+  #if defined(PGL_XCB)
+  int xcb_shmid;
+  xcb_shm_seg_t xcb_shm;
+  #endif
+};
+
+static struct pgl_buffer pgl_buffer[2];
+static int pgl_nb_buffers = 0, pgl_back = 0;
+#endif
+#if defined(PGL_X11)
+static int x11_shm_completion = 0;
+#endif
+#if defined(PGL_XCB)
+static uint8_t xcb_shm_completion = 0;
+static xcb_gcontext_t xcb_gc = 0;
+#endif
+#if defined(WAFFLE)
+static struct waffle_window *waffle_win = NULL;
+static struct libinput *waffle_input = NULL;
+#endif
+
+#if defined(GL_X11)
+static void glx_swap(void)
+{
+  glXSwapBuffers(x11_dpy, x11_win);
+}
+#endif
+
+#if defined(GL_DIRECTFB)
+static void directfbgl_swap(void)
+{
+  if (options.dscaps_gl) {
+    dfb_ctx->SwapBuffers(dfb_ctx);
+  }
+  else {
+    dfb_win->Flip(dfb_win, NULL, DSFLIP_WAITFORSYNC);
+  }
+}
+
+#endif
+
+#if defined(GL_DIRECTFB) || defined(EGL_DIRECTFB)
+static void dfb_present(void)
+{
+  if (options.dscaps_gl) {
+    dfb_win->Flip(dfb_win, NULL, DSFLIP_WAITFORSYNC);
+  }
+}
+#endif
+
+#if defined(GL_FBDEV)
+static void glfbdev_swap(void)
+{
+  glFBDevSwapBuffers(fb_buffer);
+}
+#endif
+
+#if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI) || defined(EGL_SURFACELESS)
+static void egl_swap(void)
+{
+  eglSwapBuffers(egl_dpy, egl_win);
+}
+#endif
+
+#if defined(EGL_SURFACELESS)
+static void surfaceless_swap(void)
+{
+  /* nothing to present with a pbuffer, only wait for the rendering of the frame */
+  eglWaitClient();
+}
+#endif
+
+#if defined(EGL_DRM)
+static void drm_present(void)
+{
+  struct gbm_bo *drm_bo = NULL;
+  uint32_t drm_fb_id = 0;
+  drmEventContext drm_context = { DRM_EVENT_CONTEXT_VERSION, NULL, NULL };
+
+  #ifdef HAVE_DRI
+  if (options.no_gbm) {
+    drm_bo = drm_dpy->surface_lock_front_buffer(drm_win);
+  }
+  else
+  #endif
+  {
+    drm_bo = gbm_surface_lock_front_buffer(drm_win);
+  }
+  if (!drm_bo) {
+    return;
+  }
+
+  #ifdef HAVE_DRI
+  if (options.no_gbm) {
+    drm_fb_id = (uintptr_t)drm_bo->user_data;
+    if (!drm_fb_id) {
+      drmModeAddFB(drm_fd, drm_bo->width, drm_bo->height, 24, 32, drm_bo->stride, drm_bo->handle, &drm_fb_id);
+      drmModeSetCrtc(drm_fd, drm_crtc->crtc_id, drm_fb_id, 0, 0, &drm_connector->connector_id, 1, &drm_connector->modes[0]);
+      drm_bo->user_data = (void *)(uintptr_t)drm_fb_id;
+      drm_bo->destroy_user_data = drm_destroy_user_data;
+    }
+  }
+  else
+  #endif
+  {
+    drm_fb_id = (uintptr_t)gbm_bo_get_user_data(drm_bo);
+    if (!drm_fb_id) {
+      drmModeAddFB(drm_fd, gbm_bo_get_width(drm_bo), gbm_bo_get_height(drm_bo), 24, 32, gbm_bo_get_stride(drm_bo), gbm_bo_get_handle(drm_bo).u32, &drm_fb_id);
+      drmModeSetCrtc(drm_fd, drm_crtc->crtc_id, drm_fb_id, 0, 0, &drm_connector->connector_id, 1, &drm_connector->modes[0]);
+      gbm_bo_set_user_data(drm_bo, (void *)(uintptr_t)drm_fb_id, gbm_destroy_user_data);
+    }
+  }
+  drmModePageFlip(drm_fd, drm_crtc->crtc_id, drm_fb_id, DRM_MODE_PAGE_FLIP_EVENT, NULL);
+  drmHandleEvent(drm_fd, &drm_context);
+  #ifdef HAVE_DRI
+  if (options.no_gbm) {
+    drm_dpy->surface_release_buffer(drm_win, drm_bo);
+  }
+  else
+  #endif
+  {
+    gbm_surface_release_buffer(drm_win, drm_bo);
+  }
+}
+#endif
+
+#if defined(PGL_FBDEV)
+static void pgl_fbdev_swap(void)
+{
+  uint32_t crtc = 0;
+
+  /* without a second buffer, the gears are drawn straight on the screen */
+  if (pgl_nb_buffers == 1) {
+    return;
+  }
+
+  fb_vinfo.yoffset = pgl_buffer[pgl_back].offset;
+  ioctl(fb_dpy, FBIOPAN_DISPLAY, &fb_vinfo);
+  ioctl(fb_dpy, FBIO_WAITFORVSYNC, &crtc);
+
+  pgl_back = !pgl_back;
+  gears_engine_target(gears_engine, pgl_buffer[pgl_back].addr, pgl_buffer[pgl_back].pitch);
+}
+#endif
+
+#if defined(PGL_DRM)
+static void pgl_drm_swap(void)
+{
+  drmEventContext drm_context = { DRM_EVENT_CONTEXT_VERSION, NULL, NULL };
+
+  /* the front buffer is drawn again only once the flip is done */
+  if (!drmModePageFlip(drm_fd, drm_crtc->crtc_id, pgl_buffer[pgl_back].fb_id, DRM_MODE_PAGE_FLIP_EVENT, NULL)) {
+    drmHandleEvent(drm_fd, &drm_context);
+  }
+
+  pgl_back = !pgl_back;
+  gears_engine_target(gears_engine, pgl_buffer[pgl_back].addr, pgl_buffer[pgl_back].pitch);
+}
+#endif
+
+#if defined(PGL_X11)
+static void pgl_x11_handle_event(XEvent *x11_event)
+{
+  int i;
+
+  if (x11_event->type == x11_shm_completion) {
+    for (i = 0; i < pgl_nb_buffers; i++) {
+      if (pgl_buffer[i].x11_shm.shmseg == ((XShmCompletionEvent *)x11_event)->shmseg) {
+        pgl_buffer[i].busy = 0;
+      }
+    }
+  }
+  else if (x11_event->type == Expose && !redisplay) {
+    redisplay = 1;
+  }
+  else if (x11_event->type == KeyPress) {
+    x11_keyboard_handle_key(x11_event);
+  }
+}
+
+static void pgl_x11_swap(void)
+{
+  XEvent x11_event;
+
+  XShmPutImage(x11_dpy, x11_win, DefaultGC(x11_dpy, DefaultScreen(x11_dpy)), pgl_buffer[pgl_back].x11_image, 0, 0, 0, 0, win_width, win_height, True);
+  XFlush(x11_dpy);
+  pgl_buffer[pgl_back].busy = 1;
+
+  /* the other buffer is drawn once the server is done reading it */
+  pgl_back = !pgl_back;
+  while (pgl_buffer[pgl_back].busy) {
+    XNextEvent(x11_dpy, &x11_event);
+    pgl_x11_handle_event(&x11_event);
+  }
+
+  gears_engine_target(gears_engine, pgl_buffer[pgl_back].addr, pgl_buffer[pgl_back].pitch);
+}
+#endif
+
+#if defined(PGL_WAYLAND)
+static void pgl_wl_buffer_handle_release(void *data, struct wl_buffer *buffer)
+{
+  struct pgl_buffer *pgl_buf = data;
+
+  pgl_buf->busy = 0;
+}
+
+static struct wl_buffer_listener pgl_wl_buffer_listener = { pgl_wl_buffer_handle_release };
+
+static void pgl_wl_swap(void)
+{
+  wl_surface_attach(wl_surface, pgl_buffer[pgl_back].wl_buffer, 0, 0);
+  wl_surface_damage(wl_surface, 0, 0, win_width, win_height);
+  wl_surface_commit(wl_surface);
+  pgl_buffer[pgl_back].busy = 1;
+
+  /* the other buffer is drawn once the compositor has released it */
+  pgl_back = !pgl_back;
+  while (pgl_buffer[pgl_back].busy) {
+    if (wl_display_dispatch(wl_dpy) == -1) {
+      break;
+    }
+  }
+
+  gears_engine_target(gears_engine, pgl_buffer[pgl_back].addr, pgl_buffer[pgl_back].pitch);
+}
+#endif
+
+#if defined(PGL_XCB)
+static void pgl_xcb_handle_event(xcb_generic_event_t *xcb_event)
+{
+  int i;
+
+  if ((xcb_event->response_type & 0x7f) == xcb_shm_completion) {
+    for (i = 0; i < pgl_nb_buffers; i++) {
+      if (pgl_buffer[i].xcb_shm == ((xcb_shm_completion_event_t *)xcb_event)->shmseg) {
+        pgl_buffer[i].busy = 0;
+      }
+    }
+  }
+  else if ((xcb_event->response_type & 0x7f) == XCB_KEY_PRESS) {
+    xcb_keyboard_handle_key(xcb_event);
+  }
+}
+
+static void pgl_xcb_swap(void)
+{
+  xcb_generic_event_t *xcb_event = NULL;
+
+  xcb_shm_put_image(xcb_dpy, xcb_win, xcb_gc, pgl_buffer[pgl_back].pitch / 4, win_height, 0, 0, win_width, win_height, 0, 0, xcb_setup_roots_iterator(xcb_get_setup(xcb_dpy)).data->root_depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 1, pgl_buffer[pgl_back].xcb_shm, 0);
+  xcb_flush(xcb_dpy);
+  pgl_buffer[pgl_back].busy = 1;
+
+  /* the other buffer is drawn once the server is done reading it */
+  pgl_back = !pgl_back;
+  while (pgl_buffer[pgl_back].busy) {
+    xcb_event = xcb_wait_for_event(xcb_dpy);
+    if (!xcb_event) {
+      break;
+    }
+    pgl_xcb_handle_event(xcb_event);
+    free(xcb_event);
+  }
+
+  gears_engine_target(gears_engine, pgl_buffer[pgl_back].addr, pgl_buffer[pgl_back].pitch);
+}
+#endif
+
+#if defined(WAFFLE)
+static void waffle_swap(void)
+{
+  waffle_window_swap_buffers(waffle_win);
+}
+#endif
+
+/******************************************************************************/
+
+#if defined(GL_X11) || defined(EGL_X11)
+static void x11_poll_events(void)
+{
+  XEvent x11_event;
+
+  memset(&x11_event, 0, sizeof(XEvent));
+  if (XPending(x11_dpy)) {
+    XNextEvent(x11_dpy, &x11_event);
+    if (x11_event.type == Expose && !redisplay) {
+      redisplay = 1;
+    }
+    else if (x11_event.type == KeyPress) {
+      x11_keyboard_handle_key(&x11_event);
+    }
+  }
+}
+#endif
+
+#if defined(PGL_X11)
+static void pgl_x11_poll_events(void)
+{
+  XEvent x11_event;
+
+  memset(&x11_event, 0, sizeof(XEvent));
+  if (XPending(x11_dpy)) {
+    XNextEvent(x11_dpy, &x11_event);
+    pgl_x11_handle_event(&x11_event);
+  }
+}
+#endif
+
+#if defined(GL_DIRECTFB) || defined(EGL_DIRECTFB)
+static void dfb_poll_events(void)
+{
+  DFBWindowEvent dfb_event;
+
+  memset(&dfb_event, 0, sizeof(DFBWindowEvent));
+  if (!dfb_event_buffer->GetEvent(dfb_event_buffer, (DFBEvent *)&dfb_event)) {
+    if (dfb_event.type == DWET_KEYDOWN) {
+      dfb_keyboard_handle_key(&dfb_event);
+    }
+  }
+}
+#endif
+
+#if defined(GL_FBDEV) || defined(EGL_FBDEV) || defined(PGL_FBDEV)
+static void fb_poll_events(void)
+{
+  struct input_event fb_event;
+
+  memset(&fb_event, 0, sizeof(struct input_event));
+  if (read(fb_keyboard, &fb_event, sizeof(struct input_event)) > 0 && fb_event.type == EV_KEY) {
+    if (fb_event.value) {
+      fb_keyboard_handle_key(&fb_event);
+    }
+  }
+}
+#endif
+
+#if defined(EGL_WAYLAND)
+static void wl_poll_events(void)
+{
+  wl_display_dispatch(wl_dpy);
+}
+#endif
+
+#if defined(PGL_WAYLAND)
+static void pgl_wl_poll_events(void)
+{
+  struct pollfd wl_fd;
+
+  /* buffer releases may be pending while nothing else happens, so do not block */
+  while (wl_display_prepare_read(wl_dpy)) {
+    wl_display_dispatch_pending(wl_dpy);
+  }
+  wl_display_flush(wl_dpy);
+
+  wl_fd.fd = wl_display_get_fd(wl_dpy);
+  wl_fd.events = POLLIN;
+  if (poll(&wl_fd, 1, 0) > 0) {
+    wl_display_read_events(wl_dpy);
+  }
+  else {
+    wl_display_cancel_read(wl_dpy);
+  }
+
+  wl_display_dispatch_pending(wl_dpy);
+}
+#endif
+
+#if defined(EGL_XCB)
+static void xcb_poll_events(void)
+{
+  xcb_generic_event_t *xcb_event = NULL;
+
+  xcb_event = xcb_poll_for_event(xcb_dpy);
+  if (xcb_event) {
+    if ((xcb_event->response_type & 0x7f) == XCB_KEY_PRESS) {
+      xcb_keyboard_handle_key(xcb_event);
+    }
+    free(xcb_event);
+  }
+}
+#endif
+
+#if defined(PGL_XCB)
+static void pgl_xcb_poll_events(void)
+{
+  xcb_generic_event_t *xcb_event = NULL;
+
+  xcb_event = xcb_poll_for_event(xcb_dpy);
+  if (xcb_event) {
+    pgl_xcb_handle_event(xcb_event);
+    free(xcb_event);
   }
 }
+#endif
 
-static int waffle_input_handle_open(const char *path, int flags, void *user_data)
+#if defined(EGL_DRM) || defined(PGL_DRM)
+static void drm_poll_events(void)
 {
-  return open(path, flags);
+  struct input_event drm_event;
+
+  memset(&drm_event, 0, sizeof(struct input_event));
+  if (!libevdev_next_event(drm_evdev, LIBEVDEV_READ_FLAG_NORMAL, &drm_event) && drm_event.type == EV_KEY) {
+    if (drm_event.value) {
+      drm_keyboard_handle_key(&drm_event);
+    }
+  }
 }
+#endif
 
-static void waffle_input_handle_close(int fd, void *user_data)
+#if defined(EGL_RPI)
+static void rpi_poll_events(void)
 {
-  close(fd);
+  char rpi_event[5];
+
+  memset(rpi_event, 0, sizeof(rpi_event));
+  if (read(STDIN_FILENO, rpi_event, 4) > 0) {
+    if (rpi_event[0]) {
+      rpi_keyboard_handle_key(rpi_event);
+    }
+  }
 }
+#endif
 
-static struct libinput_interface waffle_input_interface = { waffle_input_handle_open, waffle_input_handle_close };
+#if defined(WAFFLE)
+static void waffle_poll_events(void)
+{
+  struct libinput_event *waffle_event = NULL;
+
+  libinput_dispatch(waffle_input);
+  waffle_event = libinput_get_event(waffle_input);
+  if (waffle_event && libinput_event_get_type(waffle_event) == LIBINPUT_EVENT_KEYBOARD_KEY) {
+    if (libinput_event_keyboard_get_key_state((struct libinput_event_keyboard *)waffle_event)) {
+      waffle_keyboard_handle_key((struct libinput_event_keyboard *)waffle_event);
+    }
+    libinput_event_destroy(waffle_event);
+  }
+}
 #endif
 
 /******************************************************************************/
 
+static backend_t backend_list[] = {
+  #if defined(GL_X11)
+  { "gl-x11",          glx_swap,         NULL,               x11_poll_events    },
+  #endif
+  #if defined(GL_DIRECTFB)
+  { "gl-directfb",     directfbgl_swap,  dfb_present,        dfb_poll_events    },
+  #endif
+  #if defined(GL_FBDEV)
+  { "gl-fbdev",        glfbdev_swap,     NULL,               fb_poll_events     },
+  #endif
+  #if defined(EGL_X11)
+  { "egl-x11",         egl_swap,         NULL,               x11_poll_events    },
+  #endif
+  #if defined(EGL_DIRECTFB)
+  { "egl-directfb",    egl_swap,         dfb_present,        dfb_poll_events    },
+  #endif
+  #if defined(EGL_FBDEV)
+  { "egl-fbdev",       egl_swap,         NULL,               fb_poll_events     },
+  #endif
+  #if defined(EGL_WAYLAND)
+  { "egl-wayland",     egl_swap,         NULL,               wl_poll_events     },
+  #endif
+  #if defined(EGL_XCB)
+  { "egl-xcb",         egl_swap,         NULL,               xcb_poll_events    },
+  #endif
+  #if defined(EGL_DRM)
+  { "egl-drm",         egl_swap,         drm_present,        drm_poll_events    },
+  #endif
+  #if defined(EGL_RPI)
+  { "egl-rpi",         egl_swap,         NULL,               rpi_poll_events    },
+  #endif
+  #if defined(EGL_SURFACELESS)
+  { "egl-surfaceless", surfaceless_swap, NULL,               NULL               },
+  #endif
+  #if defined(PGL_FBDEV)
+  { "pgl-fbdev",       pgl_fbdev_swap,   NULL,               fb_poll_events     },
+  #endif
+  #if defined(PGL_DRM)
+  { "pgl-drm",         pgl_drm_swap,     NULL,               drm_poll_events    },
+  #endif
+  #if defined(PGL_X11)
+  { "pgl-x11",         pgl_x11_swap,     NULL,               pgl_x11_poll_events },
+  #endif
+  #if defined(PGL_WAYLAND)
+  { "pgl-wayland",     pgl_wl_swap,      NULL,               pgl_wl_poll_events },
+  #endif
+  #if defined(PGL_XCB)
+  { "pgl-xcb",         pgl_xcb_swap,     NULL,               pgl_xcb_poll_events },
+  #endif
+  #if defined(WAFFLE)
+  { "waffle",          waffle_swap,      NULL,               waffle_poll_events },
+  #endif
+  { NULL }
+};
+
+/******************************************************************************/
+
 int main(int argc, char *argv[])
 {
   int err = 0, ret = EXIT_FAILURE;
   const char *backend_arg = NULL, *engine_arg = NULL;
-  char backends[64], *c;
-  int opt, t_rate = 0, t_rot = 0, t, frames = 0;
-  struct timeval tv;
+  #if defined(GL_DIRECTFB) || defined(GL_FBDEV) || defined(EGL_FBDEV) || defined(EGL_DRM) || defined(PGL_FBDEV) || defined(PGL_DRM)
+  char *c;
+  #endif
+  int opt, frames = 0;
+  uint64_t t_rate = 0, t_rot = 0, t;
+  struct timespec ts;
+  bench_t *bench = NULL;
 
-  #if defined(GL_X11) || defined(EGL_X11)
-  Display *x11_dpy = NULL;
-  Window x11_win = 0;
+  #if defined(GL_X11) || defined(EGL_X11) || defined(PGL_X11)
   int x11_event_mask = NoEventMask;
-  XEvent x11_event;
   #endif
   #if defined(GL_X11)
   XVisualInfo *x11_visual = NULL;
@@ -901,75 +1471,64 @@ int main(int argc, char *argv[])
   #endif
   #if defined(GL_DIRECTFB) || defined(EGL_DIRECTFB)
   IDirectFB *dfb_dpy = NULL;
-  IDirectFBSurface *dfb_win = NULL;
   IDirectFBDisplayLayer *dfb_layer = NULL;
   DFBDisplayLayerConfig dfb_layer_config;
   DFBSurfaceCapabilities dfb_attr = DSCAPS_NONE;
   DFBWindowDescription dfb_desc;
   IDirectFBWindow *dfb_window = NULL;
-  IDirectFBEventBuffer *dfb_event_buffer = NULL;
   DFBWindowEventType dfb_event_mask = DWET_ALL;
-  DFBWindowEvent dfb_event;
   #endif
   #if defined(GL_DIRECTFB)
-  IDirectFBGL *dfb_ctx = NULL;
   DFBGLAttributes directfbgl;
   #endif
-  #if defined(GL_FBDEV) || defined(EGL_FBDEV)
-  int fb_dpy = -1;
+  #if defined(GL_FBDEV) || defined(EGL_FBDEV) || defined(PGL_FBDEV)
   struct fb_window *fb_win = NULL;
   struct fb_fix_screeninfo fb_finfo;
-  struct fb_var_screeninfo fb_vinfo;
-  int fb_keyboard = -1;
   DIR *fb_input_dir = NULL;
   struct dirent *fb_input_dev = NULL;
   unsigned char fb_key_bits[(KEY_CNT - 1) / 8 + 1];
-  struct input_event fb_event;
   #endif
-  #if defined(GL_FBDEV)
+  #if defined(GL_FBDEV) || defined(PGL_FBDEV)
   void *fb_addr = NULL;
+  #endif
+  #if defined(GL_FBDEV)
   GLFBDevVisualPtr fb_visual = NULL;
-  GLFBDevBufferPtr fb_buffer = NULL;
   int fb_attr[4];
   GLFBDevContextPtr fb_ctx = NULL;
   int glfbdev_depth_size = 0;
   #endif
   #if defined(EGL_WAYLAND)
-  struct wl_display *wl_dpy = NULL;
   struct wl_window *wl_win = NULL;
+  #endif
+  #if defined(EGL_WAYLAND) || defined(PGL_WAYLAND)
   struct wl_data wl_data;
-  struct wl_surface *wl_surface = NULL;
   struct wl_shell_surface *wl_shell_surface = NULL;
   #endif
-  #if defined(EGL_XCB)
-  xcb_connection_t *xcb_dpy = NULL;
-  xcb_window_t xcb_win = -1;
+  #if defined(PGL_WAYLAND)
+  int wl_fd = -1;
+  struct wl_shm_pool *wl_pool = NULL;
+  #endif
+  #if defined(EGL_XCB) || defined(PGL_XCB)
   xcb_void_cookie_t xcb_cookie;
   uint32_t xcb_value_list[2];
   xcb_event_mask_t xcb_event_mask = XCB_EVENT_MASK_NO_EVENT;
-  xcb_generic_event_t *xcb_event = NULL;
+  #endif
+  #if defined(PGL_XCB)
+  const xcb_query_extension_reply_t *xcb_shm_extension = NULL;
   #endif
   #if defined(EGL_DRM)
-  struct drm_display *drm_dpy = NULL;
-  struct drm_surface *drm_win = NULL;
-  int drm_fd = -1;
   #ifdef HAVE_DRI
   char drm_driver_path[PATH_MAX];
   struct __DRIcoreExtensionRec **drm_driver_extensions = NULL;
   struct __DRIextensionRec *drm_extensions[] = { &image_loader_extension.base, NULL };
   #endif
+  #endif
+  #if defined(EGL_DRM) || defined(PGL_DRM)
   drmModeResPtr drm_resources = NULL;
-  drmModeConnectorPtr drm_connector = NULL;
   drmModeEncoderPtr drm_encoder = NULL;
-  drmModeCrtcPtr drm_crtc = NULL;
-  struct gbm_bo *drm_bo = NULL;
-  uint32_t drm_fb_id = 0;
-  drmEventContext drm_context = { DRM_EVENT_CONTEXT_VERSION, NULL, NULL };
   int drm_keyboard = -1;
   DIR *drm_input_dir = NULL;
   struct dirent *drm_input_dev = NULL;
-  struct libevdev *drm_evdev = NULL;
-  struct input_event drm_event;
   #endif
   #if defined(EGL_RPI)
   DISPMANX_DISPLAY_HANDLE_T rpi_dpy = DISPMANX_NO_HANDLE;
@@ -981,18 +1540,27 @@ int main(int argc, char *argv[])
   VC_RECT_T rpi_src_rect;
   struct termios *rpi_termios = NULL, rpi_termios_new;
   int rpi_fdflags = -1;
-  char rpi_event[5];
   #endif
-  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM)
+  #if defined(EGL_SURFACELESS)
+  EGLint egl_pbuffer_attr[5];
+  #endif
+  #if defined(PGL_FBDEV)
+  int fb_yoffset = 0;
+  #endif
+  #if defined(PGL_DRM)
+  struct drm_mode_create_dumb drm_create_dumb;
+  struct drm_mode_map_dumb drm_map_dumb;
+  struct drm_mode_destroy_dumb drm_destroy_dumb;
+  uint64_t drm_dumb = 0;
+  #endif
+  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_SURFACELESS)
   #ifdef EGL_EXT_platform_base
   const char *egl_extension_name = NULL, *egl_extensions = NULL;
   PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT = NULL;
   PFNEGLCREATEPLATFORMWINDOWSURFACEEXTPROC eglCreatePlatformWindowSurfaceEXT = NULL;
   #endif
   #endif
-  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI)
-  EGLDisplay egl_dpy = NULL;
-  EGLSurface egl_win = NULL;
+  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI) || defined(EGL_SURFACELESS)
   EGLint egl_config_attr[16];
   EGLint egl_configs_count = 0;
   EGLConfig *egl_configs = NULL, egl_config = NULL;
@@ -1002,53 +1570,17 @@ int main(int argc, char *argv[])
   #endif
   #if defined(WAFFLE)
   struct waffle_display *waffle_dpy = NULL;
-  struct waffle_window *waffle_win = NULL;
   int waffle_init_attr[3];
   int waffle_config_attr[16];
   struct waffle_config *waffle_config = NULL;
   struct waffle_context *waffle_ctx = NULL;
-  struct libinput *waffle_input = NULL;
-  struct libinput_event *waffle_event = NULL;
   #endif
 
-  /* process command line */
+  /* process environment and command line */
 
-  memset(backends, 0, sizeof(backends));
-  #if defined(GL_X11)
-  strcat(backends, "gl-x11 ");
-  #endif
-  #if defined(GL_DIRECTFB)
-  strcat(backends, "gl-directfb ");
-  #endif
-  #if defined(GL_FBDEV)
-  strcat(backends, "gl-fbdev ");
-  #endif
-  #if defined(EGL_X11)
-  strcat(backends, "egl-x11 ");
-  #endif
-  #if defined(EGL_DIRECTFB)
-  strcat(backends, "egl-directfb ");
-  #endif
-  #if defined(EGL_FBDEV)
-  strcat(backends, "egl-fbdev ");
-  #endif
-  #if defined(EGL_WAYLAND)
-  strcat(backends, "egl-wayland ");
-  #endif
-  #if defined(EGL_XCB)
-  strcat(backends, "egl-xcb ");
-  #endif
-  #if defined(EGL_DRM)
-  strcat(backends, "egl-drm ");
-  #endif
-  #if defined(EGL_RPI)
-  strcat(backends, "egl-rpi ");
-  #endif
-  #if defined(WAFFLE)
-  strcat(backends, "waffle ");
-  #endif
+  options_init();
 
-  while ((opt = getopt(argc, argv, "b:e:h")) != -1) {
+  while ((opt = getopt(argc, argv, "b:e:o:h")) != -1) {
     switch (opt) {
       case 'b':
         backend_arg = optarg;
@@ -1056,6 +1588,11 @@ int main(int argc, char *argv[])
       case 'e':
         engine_arg = optarg;
         break;
+      case 'o':
+        if (options_set(optarg) == -1) {
+          return EXIT_FAILURE;
+        }
+        break;
       case 'h':
       default:
         break;
@@ -1073,27 +1610,32 @@ int main(int argc, char *argv[])
   }
   else
   #endif
-  if (argc != 5 || !backend_arg || !engine_arg) {
-    printf("\n\tUsage: %s -b Backend -e Engine\n\n", argv[0]);
-    printf("\t\tBackends: %s\n\n", backends);
+  if (optind != argc || !backend_arg || !engine_arg) {
+    printf("\n\tUsage: %s -b Backend -e Engine [-o Option[=Value]]...\n\n", argv[0]);
+    printf("\t\tBackends: ");
+    for (backend = backend_list; backend->name; backend++) {
+      printf("%s ", backend->name);
+    }
+    printf("\n\n");
     printf("\t\tEngines:  ");
     for (opt = 0; opt < gears_engine_nb(); opt++) {
       printf("%s ", gears_engine_name(opt));
     }
     printf("\n\n");
+    printf("\t\tOptions:  ");
+    for (opt = 0; opt < options_nb(); opt++) {
+      printf("%s ", options_name(opt));
+    }
+    printf("\n\n");
     return EXIT_FAILURE;
   }
 
-  backend = backends;
-  while ((c = strchr(backend, ' '))) {
-    *c = '\0';
-    if (!strcmp(backend, backend_arg))
+  for (backend = backend_list; backend->name; backend++) {
+    if (!strcmp(backend->name, backend_arg))
       break;
-    else
-      backend = c + 1;
   }
 
-  if (!c) {
+  if (!backend->name) {
     printf("%s: Backend unknown\n", backend_arg);
     return EXIT_FAILURE;
   }
@@ -1115,8 +1657,8 @@ int main(int argc, char *argv[])
 
   /* open display */
 
-  #if defined(GL_X11) || defined(EGL_X11)
-  if (!strcmp(backend, "gl-x11") || !strcmp(backend, "egl-x11")) {
+  #if defined(GL_X11) || defined(EGL_X11) || defined(PGL_X11)
+  if (!strcmp(backend->name, "gl-x11") || !strcmp(backend->name, "egl-x11") || !strcmp(backend->name, "pgl-x11")) {
     x11_dpy = XOpenDisplay(NULL);
     if (!x11_dpy) {
       printf("XOpenDisplay failed\n");
@@ -1131,7 +1673,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(GL_DIRECTFB) || defined(EGL_DIRECTFB)
-  if (!strcmp(backend, "gl-directfb") || !strcmp(backend, "egl-directfb")) {
+  if (!strcmp(backend->name, "gl-directfb") || !strcmp(backend->name, "egl-directfb")) {
     err = DirectFBInit(NULL, NULL);
     if (err) {
       printf("DirectFBInit failed: %s\n", DirectFBErrorString(err));
@@ -1161,11 +1703,11 @@ int main(int argc, char *argv[])
     win_height = dfb_layer_config.height;
   }
   #endif
-  #if defined(GL_FBDEV) || defined(EGL_FBDEV)
-  if (!strcmp(backend, "gl-fbdev") || !strcmp(backend, "egl-fbdev")) {
-    fb_dpy = open(getenv("FRAMEBUFFER") ? getenv("FRAMEBUFFER") : "/dev/fb0", O_RDWR);
+  #if defined(GL_FBDEV) || defined(EGL_FBDEV) || defined(PGL_FBDEV)
+  if (!strcmp(backend->name, "gl-fbdev") || !strcmp(backend->name, "egl-fbdev") || !strcmp(backend->name, "pgl-fbdev")) {
+    fb_dpy = open(options.framebuffer, O_RDWR);
     if (fb_dpy == -1) {
-      printf("open %s failed: %m\n", getenv("FRAMEBUFFER") ? getenv("FRAMEBUFFER") : "/dev/fb0");
+      printf("open %s failed: %m\n", options.framebuffer);
       goto out;
     }
 
@@ -1187,8 +1729,8 @@ int main(int argc, char *argv[])
     win_height = fb_vinfo.yres;
   }
   #endif
-  #if defined(EGL_WAYLAND)
-  if (!strcmp(backend, "egl-wayland")) {
+  #if defined(EGL_WAYLAND) || defined(PGL_WAYLAND)
+  if (!strcmp(backend->name, "egl-wayland") || !strcmp(backend->name, "pgl-wayland")) {
     wl_dpy = wl_display_connect(NULL);
     if (!wl_dpy) {
       printf("wl_display_connect failed\n");
@@ -1225,8 +1767,8 @@ int main(int argc, char *argv[])
     win_height = wl_data.height;
   }
   #endif
-  #if defined(EGL_XCB)
-  if (!strcmp(backend, "egl-xcb")) {
+  #if defined(EGL_XCB) || defined(PGL_XCB)
+  if (!strcmp(backend->name, "egl-xcb") || !strcmp(backend->name, "pgl-xcb")) {
     xcb_dpy = xcb_connect(NULL, NULL);
     if (xcb_connection_has_error(xcb_dpy)) {
       printf("xcb_connect failed\n");
@@ -1237,71 +1779,75 @@ int main(int argc, char *argv[])
     win_height = xcb_setup_roots_iterator(xcb_get_setup(xcb_dpy)).data->height_in_pixels;
   }
   #endif
-  #if defined(EGL_DRM)
-  if (!strcmp(backend, "egl-drm")) {
-    drm_fd = open(getenv("DRICARD") ? getenv("DRICARD") : "/dev/dri/card0", O_RDWR);
+  #if defined(EGL_DRM) || defined(PGL_DRM)
+  if (!strcmp(backend->name, "egl-drm") || !strcmp(backend->name, "pgl-drm")) {
+    drm_fd = open(options.dricard, O_RDWR);
     if (drm_fd == -1) {
-      printf("open %s failed: %m\n", getenv("DRICARD") ? getenv("DRICARD") : "/dev/dri/card0");
+      printf("open %s failed: %m\n", options.dricard);
       goto out;
     }
 
-    #ifdef HAVE_DRI
-    if (getenv("NO_GBM")) {
-      drm_dpy = calloc(1, sizeof(struct drm_display));
-      if (!drm_dpy) {
-        printf("drm_display calloc failed: %m\n");
-        goto out;
-      }
+    #if defined(EGL_DRM)
+    if (!strcmp(backend->name, "egl-drm")) {
+      #ifdef HAVE_DRI
+      if (options.no_gbm) {
+        drm_dpy = calloc(1, sizeof(struct drm_display));
+        if (!drm_dpy) {
+          printf("drm_display calloc failed: %m\n");
+          goto out;
+        }
 
-      drm_dpy->fd = drm_fd;
-      drm_dpy->name = "drm";
-      if (getenv("DRI_DRIVER")) {
-        drm_dpy->driver_name = getenv("DRI_DRIVER");
-      }
-      else {
-        #if DRI_MAJOR_VERSION > 10 || (DRI_MAJOR_VERSION == 10 && DRI_MINOR_VERSION >= 3)
-        drm_dpy->driver_name = "kms_swrast";
-        #else
-        printf("DRI_DRIVER is not set\n");
-        goto out;
-        #endif
-      }
+        drm_dpy->fd = drm_fd;
+        drm_dpy->name = "drm";
+        if (options.dri_driver) {
+          drm_dpy->driver_name = options.dri_driver;
+        }
+        else {
+          #if DRI_MAJOR_VERSION > 10 || (DRI_MAJOR_VERSION == 10 && DRI_MINOR_VERSION >= 3)
+          drm_dpy->driver_name = "kms_swrast";
+          #else
+          printf("DRI_DRIVER is not set\n");
+          goto out;
+          #endif
+        }
 
-      sprintf(drm_driver_path, "%s/%s_dri.so", DRI_DRIVERDIR, drm_dpy->driver_name);
-      drm_dpy->driver = dlopen(drm_driver_path, RTLD_LAZY);
-      if (!drm_dpy->driver) {
-        printf("%s DRI driver not found\n", drm_dpy->driver_name);
-        goto out;
-      }
+        sprintf(drm_driver_path, "%s/%s_dri.so", DRI_DRIVERDIR, drm_dpy->driver_name);
+        drm_dpy->driver = dlopen(drm_driver_path, RTLD_LAZY);
+        if (!drm_dpy->driver) {
+          printf("%s DRI driver not found\n", drm_dpy->driver_name);
+          goto out;
+        }
 
-      drm_driver_extensions = dlsym(drm_dpy->driver, "__driDriverExtensions");
-      if (!drm_dpy->driver) {
-        printf("DRI DriverExtensions not found\n");
-        goto out;
-      }
+        drm_driver_extensions = dlsym(drm_dpy->driver, "__driDriverExtensions");
+        if (!drm_dpy->driver) {
+          printf("DRI DriverExtensions not found\n");
+          goto out;
+        }
 
-      drm_dpy->core = drm_driver_extensions[0];
-      drm_dpy->dri2 = (struct __DRIdri2ExtensionRec *)drm_driver_extensions[2];
-      drm_dpy->screen = drm_dpy->dri2->createNewScreen2(0, drm_dpy->fd, drm_extensions, NULL, &drm_dpy->driver_configs, NULL);
-      if (!drm_dpy->screen) {
-        printf("DRI createNewScreen2 failed\n");
-        goto out;
-      }
+        drm_dpy->core = drm_driver_extensions[0];
+        drm_dpy->dri2 = (struct __DRIdri2ExtensionRec *)drm_driver_extensions[2];
+        drm_dpy->screen = drm_dpy->dri2->createNewScreen2(0, drm_dpy->fd, drm_extensions, NULL, &drm_dpy->driver_configs, NULL);
+        if (!drm_dpy->screen) {
+          printf("DRI createNewScreen2 failed\n");
+          goto out;
+        }
 
-      drm_dpy->flush = (struct __DRI2flushExtensionRec *)drm_dpy->core->getExtensions(drm_dpy->screen)[1];
-      drm_dpy->image = (struct __DRIimageExtensionRec *)drm_dpy->core->getExtensions(drm_dpy->screen)[2];
-      drm_dpy->bo_create = drm_bo_create;
-      drm_dpy->bo_destroy = drm_bo_destroy;
-    }
-    else
-    #endif
-    {
-      drm_dpy = gbm_create_device(drm_fd);
-      if (!drm_dpy) {
-        printf("gbm_create_device failed\n");
-        goto out;
+        drm_dpy->flush = (struct __DRI2flushExtensionRec *)drm_dpy->core->getExtensions(drm_dpy->screen)[1];
+        drm_dpy->image = (struct __DRIimageExtensionRec *)drm_dpy->core->getExtensions(drm_dpy->screen)[2];
+        drm_dpy->bo_create = drm_bo_create;
+        drm_dpy->bo_destroy = drm_bo_destroy;
+      }
+      else
+      #endif
+      {
+        drm_dpy = gbm_create_device(drm_fd);
+        if (!drm_dpy) {
+          printf("gbm_create_device failed\n");
+          goto out;
+        }
       }
     }
+    #endif
 
     drm_resources = drmModeGetResources(drm_fd);
     if (!drm_resources) {
@@ -1375,7 +1921,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_RPI)
-  if (!strcmp(backend, "egl-rpi")) {
+  if (!strcmp(backend->name, "egl-rpi")) {
     bcm_host_init();
 
     rpi_dpy = vc_dispmanx_display_open(DISPMANX_ID_MAIN_LCD);
@@ -1395,9 +1941,15 @@ int main(int argc, char *argv[])
     win_height = rpi_info.height;
   }
   #endif
+  #if defined(EGL_SURFACELESS)
+  if (!strcmp(backend->name, "egl-surfaceless")) {
+    win_width = 640;
+    win_height = 480;
+  }
+  #endif
   #if defined(WAFFLE)
-  if (!strcmp(backend, "waffle")) {
-    if (!getenv("PLATFORM")) {
+  if (!strcmp(backend->name, "waffle")) {
+    if (!options.platform) {
       printf("\nPLATFORM is not set:\n"
              "  19 -> GLX\n"
              "  20 -> EGL-Wayland\n"
@@ -1408,7 +1960,7 @@ int main(int argc, char *argv[])
     }
 
     waffle_init_attr[0] = WAFFLE_PLATFORM;
-    waffle_init_attr[1] = atoi(getenv("PLATFORM"));
+    waffle_init_attr[1] = options.platform;
     waffle_init_attr[2] = WAFFLE_NONE;
     err = waffle_init(waffle_init_attr);
     if (!err) {
@@ -1422,65 +1974,74 @@ int main(int argc, char *argv[])
       goto out;
     }
 
-    if (!getenv("WIDTH") || !getenv("HEIGHT")) {
+    if (!options.width || !options.height) {
       printf("WIDTH or HEIGHT is not set\n");
       goto out;
     }
   }
   #endif
 
-  if (getenv("WIDTH")) {
-    win_width = atoi(getenv("WIDTH"));
+  if (options.width) {
+    win_width = options.width;
+  }
+
+  if (options.height) {
+    win_height = options.height;
   }
 
-  if (getenv("HEIGHT")) {
-    win_height = atoi(getenv("HEIGHT"));
+  if (options.posx) {
+    win_posx = options.posx;
   }
 
-  if (getenv("POSX")) {
-    win_posx = atoi(getenv("POSX"));
+  if (options.posy) {
+    win_posy = options.posy;
   }
 
-  if (getenv("POSY")) {
-    win_posy = atoi(getenv("POSY"));
+  if (options.gears) {
+    nb_gears = options.gears;
   }
 
-  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM)
+  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_SURFACELESS)
   #ifdef EGL_EXT_platform_base
   #if defined(EGL_X11)
-  if (!strcmp(backend, "egl-x11")) {
+  if (!strcmp(backend->name, "egl-x11")) {
     egl_extension_name = "EGL_EXT_platform_x11";
   }
   #endif
   #if defined(EGL_DIRECTFB)
-  if (!strcmp(backend, "egl-directfb")) {
+  if (!strcmp(backend->name, "egl-directfb")) {
     egl_extension_name = "EGL_EXT_platform_directfb";
   }
   #endif
   #if defined(EGL_FBDEV)
-  if (!strcmp(backend, "egl-fbdev")) {
+  if (!strcmp(backend->name, "egl-fbdev")) {
     egl_extension_name = "EGL_EXT_platform_fbdev";
   }
   #endif
   #if defined(EGL_WAYLAND)
-  if (!strcmp(backend, "egl-wayland")) {
+  if (!strcmp(backend->name, "egl-wayland")) {
     egl_extension_name = "EGL_EXT_platform_wayland";
   }
   #endif
   #if defined(EGL_XCB)
-  if (!strcmp(backend, "egl-xcb")) {
+  if (!strcmp(backend->name, "egl-xcb")) {
     egl_extension_name = "EGL_EXT_platform_xcb";
   }
   #endif
   #if defined(EGL_DRM)
-  if (!strcmp(backend, "egl-drm")) {
+  if (!strcmp(backend->name, "egl-drm")) {
     egl_extension_name = "EGL_KHR_platform_gbm";
   }
   #endif
+  #if defined(EGL_SURFACELESS)
+  if (!strcmp(backend->name, "egl-surfaceless")) {
+    egl_extension_name = "EGL_MESA_platform_surfaceless";
+  }
+  #endif
 
-  if (!strcmp(backend, "egl-x11") || !strcmp(backend, "egl-directfb") || !strcmp(backend, "egl-fbdev") || !strcmp(backend, "egl-wayland") || !strcmp(backend, "egl-xcb") || !strcmp(backend, "egl-drm")) {
+  if (!strcmp(backend->name, "egl-x11") || !strcmp(backend->name, "egl-directfb") || !strcmp(backend->name, "egl-fbdev") || !strcmp(backend->name, "egl-wayland") || !strcmp(backend->name, "egl-xcb") || !strcmp(backend->name, "egl-drm") || !strcmp(backend->name, "egl-surfaceless")) {
     egl_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
-    if (!getenv("NO_EGL_EXT_PLATFORM") && egl_extensions && strstr(egl_extensions, egl_extension_name)) {
+    if (!options.no_egl_ext_platform && egl_extensions && strstr(egl_extensions, egl_extension_name)) {
       eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
       eglCreatePlatformWindowSurfaceEXT = (PFNEGLCREATEPLATFORMWINDOWSURFACEEXTPROC)eglGetProcAddress("eglCreatePlatformWindowSurfaceEXT");
     }
@@ -1489,7 +2050,7 @@ int main(int argc, char *argv[])
   #endif
 
   #if defined(EGL_X11)
-  if (!strcmp(backend, "egl-x11")) {
+  if (!strcmp(backend->name, "egl-x11")) {
     #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_X11_EXT)
     if (eglGetPlatformDisplayEXT) {
       egl_dpy = eglGetPlatformDisplayEXT(EGL_PLATFORM_X11_EXT, x11_dpy, NULL);
@@ -1503,7 +2064,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_DIRECTFB)
-  if (!strcmp(backend, "egl-directfb")) {
+  if (!strcmp(backend->name, "egl-directfb")) {
     #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_DIRECTFB_EXT)
     if (eglGetPlatformDisplayEXT) {
       egl_dpy = eglGetPlatformDisplayEXT(EGL_PLATFORM_DIRECTFB_EXT, dfb_dpy, NULL);
@@ -1517,7 +2078,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_FBDEV)
-  if (!strcmp(backend, "egl-fbdev")) {
+  if (!strcmp(backend->name, "egl-fbdev")) {
     #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_FBDEV_EXT)
     if (eglGetPlatformDisplayEXT) {
       egl_dpy = eglGetPlatformDisplayEXT(EGL_PLATFORM_FBDEV_EXT, &fb_dpy, NULL);
@@ -1531,7 +2092,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_WAYLAND)
-  if (!strcmp(backend, "egl-wayland")) {
+  if (!strcmp(backend->name, "egl-wayland")) {
     #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_WAYLAND_EXT)
     if (eglGetPlatformDisplayEXT) {
       egl_dpy = eglGetPlatformDisplayEXT(EGL_PLATFORM_WAYLAND_EXT, wl_dpy, NULL);
@@ -1545,7 +2106,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_XCB)
-  if (!strcmp(backend, "egl-xcb")) {
+  if (!strcmp(backend->name, "egl-xcb")) {
     #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_XCB_EXT)
     if (eglGetPlatformDisplayEXT) {
       egl_dpy = eglGetPlatformDisplayEXT(EGL_PLATFORM_XCB_EXT, xcb_dpy, NULL);
@@ -1559,7 +2120,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_DRM)
-  if (!strcmp(backend, "egl-drm")) {
+  if (!strcmp(backend->name, "egl-drm")) {
     #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_GBM_KHR)
     if (eglGetPlatformDisplayEXT) {
       egl_dpy = eglGetPlatformDisplayEXT(EGL_PLATFORM_GBM_KHR, drm_dpy, NULL);
@@ -1573,12 +2134,26 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_RPI)
-  if (!strcmp(backend, "egl-rpi")) {
+  if (!strcmp(backend->name, "egl-rpi")) {
     egl_dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
   }
   #endif
-  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI)
-  if (!strcmp(backend, "egl-x11") || !strcmp(backend, "egl-directfb") || !strcmp(backend, "egl-fbdev") || !strcmp(backend, "egl-wayland") || !strcmp(backend, "egl-xcb") || !strcmp(backend, "egl-drm") || !strcmp(backend, "egl-rpi")) {
+  #if defined(EGL_SURFACELESS)
+  if (!strcmp(backend->name, "egl-surfaceless")) {
+    #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_SURFACELESS_MESA)
+    if (eglGetPlatformDisplayEXT) {
+      egl_dpy = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    else
+    #endif
+    {
+      setenv("EGL_PLATFORM", "surfaceless", 1);
+      egl_dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+  }
+  #endif
+  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI) || defined(EGL_SURFACELESS)
+  if (!strcmp(backend->name, "egl-x11") || !strcmp(backend->name, "egl-directfb") || !strcmp(backend->name, "egl-fbdev") || !strcmp(backend->name, "egl-wayland") || !strcmp(backend->name, "egl-xcb") || !strcmp(backend->name, "egl-drm") || !strcmp(backend->name, "egl-rpi") || !strcmp(backend->name, "egl-surfaceless")) {
     if (!egl_dpy) {
       printf("eglGetDisplay failed: 0x%x\n", eglGetError());
       goto out;
@@ -1589,7 +2164,7 @@ int main(int argc, char *argv[])
   /* set attributes */
 
   #if defined(GL_X11)
-  if (!strcmp(backend, "gl-x11")) {
+  if (!strcmp(backend->name, "gl-x11")) {
     x11_attr[0] = GLX_RGBA;
     x11_attr[1] = GLX_DOUBLEBUFFER;
     x11_attr[2] = GLX_DEPTH_SIZE;
@@ -1603,12 +2178,12 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(GL_DIRECTFB)
-  if (!strcmp(backend, "gl-directfb")) {
+  if (!strcmp(backend->name, "gl-directfb")) {
     dfb_attr = DSCAPS_DOUBLE | DSCAPS_DEPTH;
   }
   #endif
   #if defined(GL_FBDEV)
-  if (!strcmp(backend, "gl-fbdev")) {
+  if (!strcmp(backend->name, "gl-fbdev")) {
     fb_attr[0] = GLFBDEV_DOUBLE_BUFFER;
     fb_attr[1] = GLFBDEV_DEPTH_SIZE;
     fb_attr[2] = 1;
@@ -1633,8 +2208,8 @@ int main(int argc, char *argv[])
   }
   #endif
 
-  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI)
-  if (!strcmp(backend, "egl-x11") || !strcmp(backend, "egl-directfb") || !strcmp(backend, "egl-fbdev") || !strcmp(backend, "egl-wayland") || !strcmp(backend, "egl-xcb") || !strcmp(backend, "egl-drm") || !strcmp(backend, "egl-rpi")) {
+  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI) || defined(EGL_SURFACELESS)
+  if (!strcmp(backend->name, "egl-x11") || !strcmp(backend->name, "egl-directfb") || !strcmp(backend->name, "egl-fbdev") || !strcmp(backend->name, "egl-wayland") || !strcmp(backend->name, "egl-xcb") || !strcmp(backend->name, "egl-drm") || !strcmp(backend->name, "egl-rpi") || !strcmp(backend->name, "egl-surfaceless")) {
     err = eglInitialize(egl_dpy, &egl_major_version, &egl_minor_version);
     if (!err) {
       printf("eglInitialize failed: 0x%x\n", eglGetError());
@@ -1660,6 +2235,12 @@ int main(int argc, char *argv[])
     egl_config_attr[opt++] = 1;
     egl_config_attr[opt++] = EGL_RENDERABLE_TYPE;
     egl_config_attr[opt++] = !gears_engine_version(gears_engine) ? EGL_OPENGL_BIT : gears_engine_version(gears_engine) == 1 ? EGL_OPENGL_ES_BIT : EGL_OPENGL_ES2_BIT;
+    #if defined(EGL_SURFACELESS)
+    if (!strcmp(backend->name, "egl-surfaceless")) {
+      egl_config_attr[opt++] = EGL_SURFACE_TYPE;
+      egl_config_attr[opt++] = EGL_PBUFFER_BIT;
+    }
+    #endif
     egl_config_attr[opt] = EGL_NONE;
     err = eglChooseConfig(egl_dpy, egl_config_attr, NULL, 0, &egl_configs_count);
     if (!err || !egl_configs_count) {
@@ -1680,11 +2261,27 @@ int main(int argc, char *argv[])
     }
 
     egl_config = egl_configs[0];
+
+    #if defined(EGL_SURFACELESS)
+    if (!strcmp(backend->name, "egl-surfaceless")) {
+      /* no native visual narrows the choice, the first configurations may have 10-bit colors or a 16-bit depth: pick the windowed backends one */
+      for (opt = 0; opt < egl_configs_count; opt++) {
+        eglGetConfigAttrib(egl_dpy, egl_configs[opt], EGL_DEPTH_SIZE, &egl_depth_size);
+        eglGetConfigAttrib(egl_dpy, egl_configs[opt], EGL_RED_SIZE, &egl_red_size);
+        eglGetConfigAttrib(egl_dpy, egl_configs[opt], EGL_GREEN_SIZE, &egl_green_size);
+        eglGetConfigAttrib(egl_dpy, egl_configs[opt], EGL_BLUE_SIZE, &egl_blue_size);
+        if (egl_depth_size == 24 && egl_red_size == 8 && egl_green_size == 8 && egl_blue_size == 8) {
+          egl_config = egl_configs[opt];
+          break;
+        }
+      }
+    }
+    #endif
   }
   #endif
 
   #if defined(WAFFLE)
-  if (!strcmp(backend, "waffle")) {
+  if (!strcmp(backend->name, "waffle")) {
     opt = 0;
     waffle_config_attr[opt++] = WAFFLE_RED_SIZE;
     waffle_config_attr[opt++] = 1;
@@ -1709,8 +2306,8 @@ int main(int argc, char *argv[])
 
   /* create window associated to the display */
 
-  #if defined(GL_X11) || defined(EGL_X11)
-  if (!strcmp(backend, "gl-x11") || !strcmp(backend, "egl-x11")) {
+  #if defined(GL_X11) || defined(EGL_X11) || defined(PGL_X11)
+  if (!strcmp(backend->name, "gl-x11") || !strcmp(backend->name, "egl-x11") || !strcmp(backend->name, "pgl-x11")) {
     x11_win = XCreateSimpleWindow(x11_dpy, DefaultRootWindow(x11_dpy), win_posx, win_posy, win_width, win_height, 0, 0, 0);
     if (!x11_win) {
       printf("XCreateSimpleWindow failed\n");
@@ -1725,12 +2322,74 @@ int main(int argc, char *argv[])
     XSelectInput(x11_dpy, x11_win, x11_event_mask);
   }
   #endif
+  #if defined(PGL_X11)
+  if (!strcmp(backend->name, "pgl-x11")) {
+    if (!XShmQueryExtension(x11_dpy)) {
+      printf("MIT-SHM extension not supported\n");
+      goto out;
+    }
+
+    if (DefaultVisual(x11_dpy, DefaultScreen(x11_dpy))->red_mask != 0xff0000 || DefaultVisual(x11_dpy, DefaultScreen(x11_dpy))->green_mask != 0xff00 || DefaultVisual(x11_dpy, DefaultScreen(x11_dpy))->blue_mask != 0xff) {
+      printf("X11 visual not supported\n");
+      goto out;
+    }
+
+    x11_shm_completion = XShmGetEventBase(x11_dpy) + ShmCompletion;
+
+    pgl_nb_buffers = 2;
+    for (opt = 0; opt < pgl_nb_buffers; opt++) {
+      pgl_buffer[opt].x11_image = XShmCreateImage(x11_dpy, DefaultVisual(x11_dpy, DefaultScreen(x11_dpy)), DefaultDepth(x11_dpy, DefaultScreen(x11_dpy)), ZPixmap, NULL, &pgl_buffer[opt].x11_shm, win_width, win_height);
+      if (!pgl_buffer[opt].x11_image) {
+        printf("XShmCreateImage failed\n");
+        goto out;
+      }
+
+      if (pgl_buffer[opt].x11_image->bits_per_pixel != 32) {
+        printf("XShmCreateImage %d bits per pixel not supported\n", pgl_buffer[opt].x11_image->bits_per_pixel);
+        goto out;
+      }
+
+      pgl_buffer[opt].x11_shm.shmid = shmget(IPC_PRIVATE, pgl_buffer[opt].x11_image->bytes_per_line * win_height, IPC_CREAT | 0600);
+      if (pgl_buffer[opt].x11_shm.shmid == -1) {
+        printf("shmget failed: %m\n");
+        goto out;
+      }
+
+      pgl_buffer[opt].x11_shm.shmaddr = shmat(pgl_buffer[opt].x11_shm.shmid, NULL, 0);
+      if (pgl_buffer[opt].x11_shm.shmaddr == (char *)-1) {
+        pgl_buffer[opt].x11_shm.shmaddr = NULL;
+        printf("shmat failed: %m\n");
+        shmctl(pgl_buffer[opt].x11_shm.shmid, IPC_RMID, NULL);
+        goto out;
+      }
+
+      pgl_buffer[opt].x11_shm.readOnly = True;
+      if (!XShmAttach(x11_dpy, &pgl_buffer[opt].x11_shm)) {
+        printf("XShmAttach failed\n");
+        shmctl(pgl_buffer[opt].x11_shm.shmid, IPC_RMID, NULL);
+        goto out;
+      }
+
+      XSync(x11_dpy, False);
+
+      /* the segment is freed once detached by both the server and the client */
+      shmctl(pgl_buffer[opt].x11_shm.shmid, IPC_RMID, NULL);
+
+      pgl_buffer[opt].x11_image->data = pgl_buffer[opt].x11_shm.shmaddr;
+      pgl_buffer[opt].addr = pgl_buffer[opt].x11_shm.shmaddr;
+      pgl_buffer[opt].pitch = pgl_buffer[opt].x11_image->bytes_per_line;
+      memset(pgl_buffer[opt].addr, 0, pgl_buffer[opt].pitch * win_height);
+    }
+
+    pgl_back = 0;
+  }
+  #endif
   #if defined(GL_DIRECTFB) || defined(EGL_DIRECTFB)
-  if (!strcmp(backend, "gl-directfb") || !strcmp(backend, "egl-directfb")) {
+  if (!strcmp(backend->name, "gl-directfb") || !strcmp(backend->name, "egl-directfb")) {
     memset(&dfb_desc, 0, sizeof(DFBWindowDescription));
     dfb_desc.flags = DWDESC_SURFACE_CAPS | DWDESC_WIDTH | DWDESC_HEIGHT | DWDESC_POSX | DWDESC_POSY;
     dfb_desc.surface_caps = dfb_attr;
-    if (getenv("DSCAPS_GL")) {
+    if (options.dscaps_gl) {
       dfb_desc.surface_caps |= DSCAPS_GL;
     }
     dfb_desc.width = win_width;
@@ -1775,8 +2434,8 @@ int main(int argc, char *argv[])
     }
   }
   #endif
-  #if defined(GL_FBDEV) || defined(EGL_FBDEV)
-  if (!strcmp(backend, "gl-fbdev") || !strcmp(backend, "egl-fbdev")) {
+  #if defined(GL_FBDEV) || defined(EGL_FBDEV) || defined(PGL_FBDEV)
+  if (!strcmp(backend->name, "gl-fbdev") || !strcmp(backend->name, "egl-fbdev") || !strcmp(backend->name, "pgl-fbdev")) {
     fb_win = calloc(1, sizeof(struct fb_window));
     if (!fb_win) {
       printf("fb_window calloc failed: %m\n");
@@ -1788,8 +2447,8 @@ int main(int argc, char *argv[])
     fb_win->posx = win_posx;
     fb_win->posy = win_posy;
 
-    if (getenv("KEYBOARD")) {
-      fb_keyboard = open(getenv("KEYBOARD"), O_RDONLY | O_NONBLOCK);
+    if (options.keyboard) {
+      fb_keyboard = open(options.keyboard, O_RDONLY | O_NONBLOCK);
     }
     else {
       fb_input_dir = opendir("/dev/input");
@@ -1826,54 +2485,167 @@ int main(int argc, char *argv[])
     }
   }
   #endif
-  #if defined(EGL_WAYLAND)
-  if (!strcmp(backend, "egl-wayland")) {
-    wl_surface = wl_compositor_create_surface(wl_data.wl_compositor);
-    if (!wl_surface) {
-      printf("wl_compositor_create_surface failed\n");
+  #if defined(PGL_FBDEV)
+  if (!strcmp(backend->name, "pgl-fbdev")) {
+    if (fb_vinfo.bits_per_pixel != 32 || fb_vinfo.red.offset != 16 || fb_vinfo.green.offset != 8 || fb_vinfo.blue.offset != 0) {
+      printf("%s format is not XRGB8888\n", options.framebuffer);
+      goto out;
+    }
+
+    if (win_posx + win_width > fb_vinfo.xres || win_posy + win_height > fb_vinfo.yres) {
+      printf("window does not fit in %s\n", options.framebuffer);
+      goto out;
+    }
+
+    fb_addr = mmap(NULL, fb_finfo.smem_len, PROT_READ | PROT_WRITE, MAP_SHARED, fb_dpy, 0);
+    if (fb_addr == MAP_FAILED) {
+      printf("mmap failed: %m\n");
+      goto out;
+    }
+
+    /* the gears are drawn in the framebuffer memory, in a second buffer panned
+       to the screen when the virtual resolution is large enough */
+
+    fb_yoffset = fb_vinfo.yoffset;
+    if (fb_vinfo.yres_virtual >= 2 * fb_vinfo.yres && fb_finfo.smem_len >= 2 * fb_vinfo.yres * fb_finfo.line_length) {
+      pgl_nb_buffers = 2;
+      pgl_buffer[0].offset = 0;
+      pgl_buffer[1].offset = fb_vinfo.yres;
+      pgl_back = 1;
+    }
+    else {
+      pgl_nb_buffers = 1;
+      pgl_buffer[0].offset = fb_vinfo.yoffset;
+      pgl_back = 0;
+    }
+
+    for (opt = 0; opt < pgl_nb_buffers; opt++) {
+      pgl_buffer[opt].pitch = fb_finfo.line_length;
+      pgl_buffer[opt].addr = (char *)fb_addr + (pgl_buffer[opt].offset + win_posy) * fb_finfo.line_length + (fb_vinfo.xoffset + win_posx) * 4;
+    }
+
+    if (pgl_nb_buffers == 2) {
+      fb_vinfo.yoffset = pgl_buffer[0].offset;
+      err = ioctl(fb_dpy, FBIOPAN_DISPLAY, &fb_vinfo);
+      if (err == -1) {
+        printf("ioctl FBIOPAN_DISPLAY failed: %m\n");
+        goto out;
+      }
+    }
+  }
+  #endif
+  #if defined(EGL_WAYLAND) || defined(PGL_WAYLAND)
+  if (!strcmp(backend->name, "egl-wayland") || !strcmp(backend->name, "pgl-wayland")) {
+    wl_surface = wl_compositor_create_surface(wl_data.wl_compositor);
+    if (!wl_surface) {
+      printf("wl_compositor_create_surface failed\n");
+      goto out;
+    }
+
+    wl_shell_surface = wl_shell_get_shell_surface(wl_data.wl_shell, wl_surface);
+    if (!wl_shell_surface) {
+      printf("wl_shell_get_shell_surface failed\n");
+      goto out;
+    }
+
+    wl_shell_surface_set_toplevel(wl_shell_surface);
+
+    #ifdef HAVE_WL_SHELL_SURFACE_SET_POSITION
+    wl_shell_surface_set_position(wl_shell_surface, win_posx, win_posy);
+    #endif
+
+    #if defined(EGL_WAYLAND)
+    if (!strcmp(backend->name, "egl-wayland")) {
+      if (options.no_wl_egl_window) {
+        wl_win = calloc(1, sizeof(struct wl_window));
+        if (!wl_win) {
+          printf("wl_window calloc failed: %m\n");
+          goto out;
+        }
+
+        wl_win->surface = wl_surface;
+        wl_win->width = win_width;
+        wl_win->height = win_height;
+      }
+      else {
+        wl_win = wl_egl_window_create(wl_surface, win_width, win_height);
+        if (!wl_win) {
+          printf("wl_egl_window_create failed\n");
+          goto out;
+        }
+      }
+    }
+    #endif
+
+    wl_data.xkb_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    if (!wl_data.xkb_context) {
+      printf("xkb_context_new failed\n");
+      goto out;
+    }
+  }
+  #endif
+  #if defined(PGL_WAYLAND)
+  if (!strcmp(backend->name, "pgl-wayland")) {
+    if (!wl_data.wl_shm) {
+      printf("wl_shm not supported\n");
       goto out;
     }
 
-    wl_shell_surface = wl_shell_get_shell_surface(wl_data.wl_shell, wl_surface);
-    if (!wl_shell_surface) {
-      printf("wl_shell_get_shell_surface failed\n");
+    wl_fd = memfd_create("yagears", MFD_CLOEXEC);
+    if (wl_fd == -1) {
+      printf("memfd_create failed: %m\n");
       goto out;
     }
 
-    wl_shell_surface_set_toplevel(wl_shell_surface);
+    /* each buffer starts on a page boundary so that it can be mapped on its own */
+    pgl_nb_buffers = 2;
+    pgl_buffer[0].size = (win_width * 4 * win_height + getpagesize() - 1) & ~(getpagesize() - 1);
+    err = ftruncate(wl_fd, pgl_nb_buffers * pgl_buffer[0].size);
+    if (err == -1) {
+      printf("ftruncate failed: %m\n");
+      goto out;
+    }
 
-    #ifdef HAVE_WL_SHELL_SURFACE_SET_POSITION
-    wl_shell_surface_set_position(wl_shell_surface, win_posx, win_posy);
-    #endif
+    wl_pool = wl_shm_create_pool(wl_data.wl_shm, wl_fd, pgl_nb_buffers * pgl_buffer[0].size);
+    if (!wl_pool) {
+      printf("wl_shm_create_pool failed\n");
+      goto out;
+    }
 
-    if (getenv("NO_WL_EGL_WINDOW")) {
-      wl_win = calloc(1, sizeof(struct wl_window));
-      if (!wl_win) {
-        printf("wl_window calloc failed: %m\n");
+    for (opt = 0; opt < pgl_nb_buffers; opt++) {
+      pgl_buffer[opt].offset = opt * pgl_buffer[0].size;
+      pgl_buffer[opt].size = pgl_buffer[0].size;
+      pgl_buffer[opt].map = mmap(NULL, pgl_buffer[opt].size, PROT_READ | PROT_WRITE, MAP_SHARED, wl_fd, pgl_buffer[opt].offset);
+      if (pgl_buffer[opt].map == MAP_FAILED) {
+        pgl_buffer[opt].map = NULL;
+        printf("mmap failed: %m\n");
         goto out;
       }
 
-      wl_win->surface = wl_surface;
-      wl_win->width = win_width;
-      wl_win->height = win_height;
-    }
-    else {
-      wl_win = wl_egl_window_create(wl_surface, win_width, win_height);
-      if (!wl_win) {
-        printf("wl_egl_window_create failed\n");
+      pgl_buffer[opt].wl_buffer = wl_shm_pool_create_buffer(wl_pool, pgl_buffer[opt].offset, win_width, win_height, win_width * 4, WL_SHM_FORMAT_XRGB8888);
+      if (!pgl_buffer[opt].wl_buffer) {
+        printf("wl_shm_pool_create_buffer failed\n");
         goto out;
       }
-    }
 
-    wl_data.xkb_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-    if (!wl_data.xkb_context) {
-      printf("xkb_context_new failed\n");
-      goto out;
+      wl_buffer_add_listener(pgl_buffer[opt].wl_buffer, &pgl_wl_buffer_listener, &pgl_buffer[opt]);
+
+      pgl_buffer[opt].addr = pgl_buffer[opt].map;
+      pgl_buffer[opt].pitch = win_width * 4;
+      memset(pgl_buffer[opt].addr, 0, pgl_buffer[opt].size);
     }
+
+    /* the buffers keep the pool memory alive */
+    wl_shm_pool_destroy(wl_pool);
+    wl_pool = NULL;
+    close(wl_fd);
+    wl_fd = -1;
+
+    pgl_back = 0;
   }
   #endif
-  #if defined(EGL_XCB)
-  if (!strcmp(backend, "egl-xcb")) {
+  #if defined(EGL_XCB) || defined(PGL_XCB)
+  if (!strcmp(backend->name, "egl-xcb") || !strcmp(backend->name, "pgl-xcb")) {
     xcb_win = xcb_generate_id(xcb_dpy);
     xcb_event_mask = XCB_EVENT_MASK_KEY_PRESS;
     xcb_value_list[0] = 0;
@@ -1894,32 +2666,90 @@ int main(int argc, char *argv[])
     xcb_flush(xcb_dpy);
   }
   #endif
-  #if defined(EGL_DRM)
-  if (!strcmp(backend, "egl-drm")) {
-    #ifdef HAVE_DRI
-    if (getenv("NO_GBM")) {
-      drm_win = calloc(1, sizeof(struct drm_surface));
-      if (!drm_win) {
-        printf("drm_surface calloc failed: %m\n");
+  #if defined(PGL_XCB)
+  if (!strcmp(backend->name, "pgl-xcb")) {
+    xcb_shm_extension = xcb_get_extension_data(xcb_dpy, &xcb_shm_id);
+    if (!xcb_shm_extension || !xcb_shm_extension->present) {
+      printf("MIT-SHM extension not supported\n");
+      goto out;
+    }
+
+    if (xcb_setup_roots_iterator(xcb_get_setup(xcb_dpy)).data->root_depth != 24) {
+      printf("XCB depth %d not supported\n", xcb_setup_roots_iterator(xcb_get_setup(xcb_dpy)).data->root_depth);
+      goto out;
+    }
+
+    xcb_shm_completion = xcb_shm_extension->first_event + XCB_SHM_COMPLETION;
+
+    xcb_gc = xcb_generate_id(xcb_dpy);
+    xcb_create_gc(xcb_dpy, xcb_gc, xcb_win, 0, NULL);
+
+    pgl_nb_buffers = 2;
+    for (opt = 0; opt < pgl_nb_buffers; opt++) {
+      pgl_buffer[opt].pitch = win_width * 4;
+      pgl_buffer[opt].xcb_shmid = shmget(IPC_PRIVATE, pgl_buffer[opt].pitch * win_height, IPC_CREAT | 0600);
+      if (pgl_buffer[opt].xcb_shmid == -1) {
+        printf("shmget failed: %m\n");
         goto out;
       }
 
-      drm_win->display = drm_dpy;
-      drm_win->width = drm_connector->modes[0].hdisplay;
-      drm_win->height = drm_connector->modes[0].vdisplay;
-    }
-    else
-    #endif
-    {
-      drm_win = gbm_surface_create(drm_dpy, drm_connector->modes[0].hdisplay, drm_connector->modes[0].vdisplay, GBM_FORMAT_XRGB8888, GBM_BO_USE_SCANOUT);
-      if (!drm_win) {
-        printf("gbm_surface_create failed\n");
+      pgl_buffer[opt].map = shmat(pgl_buffer[opt].xcb_shmid, NULL, 0);
+      if (pgl_buffer[opt].map == (void *)-1) {
+        pgl_buffer[opt].map = NULL;
+        printf("shmat failed: %m\n");
+        shmctl(pgl_buffer[opt].xcb_shmid, IPC_RMID, NULL);
+        goto out;
+      }
+
+      pgl_buffer[opt].xcb_shm = xcb_generate_id(xcb_dpy);
+      xcb_cookie = xcb_shm_attach_checked(xcb_dpy, pgl_buffer[opt].xcb_shm, pgl_buffer[opt].xcb_shmid, 1);
+      if (xcb_request_check(xcb_dpy, xcb_cookie)) {
+        pgl_buffer[opt].xcb_shm = 0;
+        printf("xcb_shm_attach failed\n");
+        shmctl(pgl_buffer[opt].xcb_shmid, IPC_RMID, NULL);
         goto out;
       }
+
+      /* the segment is freed once detached by both the server and the client */
+      shmctl(pgl_buffer[opt].xcb_shmid, IPC_RMID, NULL);
+
+      pgl_buffer[opt].addr = pgl_buffer[opt].map;
+      memset(pgl_buffer[opt].addr, 0, pgl_buffer[opt].pitch * win_height);
+    }
+
+    pgl_back = 0;
+  }
+  #endif
+  #if defined(EGL_DRM) || defined(PGL_DRM)
+  if (!strcmp(backend->name, "egl-drm") || !strcmp(backend->name, "pgl-drm")) {
+    #if defined(EGL_DRM)
+    if (!strcmp(backend->name, "egl-drm")) {
+      #ifdef HAVE_DRI
+      if (options.no_gbm) {
+        drm_win = calloc(1, sizeof(struct drm_surface));
+        if (!drm_win) {
+          printf("drm_surface calloc failed: %m\n");
+          goto out;
+        }
+
+        drm_win->display = drm_dpy;
+        drm_win->width = drm_connector->modes[0].hdisplay;
+        drm_win->height = drm_connector->modes[0].vdisplay;
+      }
+      else
+      #endif
+      {
+        drm_win = gbm_surface_create(drm_dpy, drm_connector->modes[0].hdisplay, drm_connector->modes[0].vdisplay, GBM_FORMAT_XRGB8888, GBM_BO_USE_SCANOUT);
+        if (!drm_win) {
+          printf("gbm_surface_create failed\n");
+          goto out;
+        }
+      }
     }
+    #endif
 
-    if (getenv("KEYBOARD")) {
-      drm_keyboard = open(getenv("KEYBOARD"), O_RDONLY | O_NONBLOCK);
+    if (options.keyboard) {
+      drm_keyboard = open(options.keyboard, O_RDONLY | O_NONBLOCK);
     }
     else {
       drm_input_dir = opendir("/dev/input");
@@ -1957,8 +2787,73 @@ int main(int argc, char *argv[])
     }
   }
   #endif
+  #if defined(PGL_DRM)
+  if (!strcmp(backend->name, "pgl-drm")) {
+    err = drmGetCap(drm_fd, DRM_CAP_DUMB_BUFFER, &drm_dumb);
+    if (err || !drm_dumb) {
+      printf("%s does not support dumb buffers\n", options.dricard);
+      goto out;
+    }
+
+    if (win_posx + win_width > drm_connector->modes[0].hdisplay || win_posy + win_height > drm_connector->modes[0].vdisplay) {
+      printf("window does not fit in %s mode\n", options.dricard);
+      goto out;
+    }
+
+    /* the gears are drawn in two dumb buffers, scanned out in turn */
+
+    pgl_nb_buffers = 2;
+    for (opt = 0; opt < pgl_nb_buffers; opt++) {
+      memset(&drm_create_dumb, 0, sizeof(struct drm_mode_create_dumb));
+      drm_create_dumb.width = drm_connector->modes[0].hdisplay;
+      drm_create_dumb.height = drm_connector->modes[0].vdisplay;
+      drm_create_dumb.bpp = 32;
+      err = drmIoctl(drm_fd, DRM_IOCTL_MODE_CREATE_DUMB, &drm_create_dumb);
+      if (err == -1) {
+        printf("ioctl DRM_IOCTL_MODE_CREATE_DUMB failed: %m\n");
+        goto out;
+      }
+
+      pgl_buffer[opt].handle = drm_create_dumb.handle;
+      pgl_buffer[opt].pitch = drm_create_dumb.pitch;
+      pgl_buffer[opt].size = drm_create_dumb.size;
+
+      err = drmModeAddFB(drm_fd, drm_create_dumb.width, drm_create_dumb.height, 24, 32, drm_create_dumb.pitch, drm_create_dumb.handle, &pgl_buffer[opt].fb_id);
+      if (err) {
+        printf("drmModeAddFB failed: %m\n");
+        goto out;
+      }
+
+      memset(&drm_map_dumb, 0, sizeof(struct drm_mode_map_dumb));
+      drm_map_dumb.handle = drm_create_dumb.handle;
+      err = drmIoctl(drm_fd, DRM_IOCTL_MODE_MAP_DUMB, &drm_map_dumb);
+      if (err == -1) {
+        printf("ioctl DRM_IOCTL_MODE_MAP_DUMB failed: %m\n");
+        goto out;
+      }
+
+      pgl_buffer[opt].map = mmap(NULL, pgl_buffer[opt].size, PROT_READ | PROT_WRITE, MAP_SHARED, drm_fd, drm_map_dumb.offset);
+      if (pgl_buffer[opt].map == MAP_FAILED) {
+        pgl_buffer[opt].map = NULL;
+        printf("mmap failed: %m\n");
+        goto out;
+      }
+
+      memset(pgl_buffer[opt].map, 0, pgl_buffer[opt].size);
+      pgl_buffer[opt].addr = (char *)pgl_buffer[opt].map + win_posy * pgl_buffer[opt].pitch + win_posx * 4;
+    }
+
+    err = drmModeSetCrtc(drm_fd, drm_crtc->crtc_id, pgl_buffer[0].fb_id, 0, 0, &drm_connector->connector_id, 1, &drm_connector->modes[0]);
+    if (err) {
+      printf("drmModeSetCrtc failed: %m\n");
+      goto out;
+    }
+
+    pgl_back = 1;
+  }
+  #endif
   #if defined(EGL_RPI)
-  if (!strcmp(backend, "egl-rpi")) {
+  if (!strcmp(backend->name, "egl-rpi")) {
     rpi_update = vc_dispmanx_update_start(0);
     if (rpi_update == DISPMANX_NO_HANDLE) {
       printf("vc_dispmanx_update_start failed\n");
@@ -2033,7 +2928,7 @@ int main(int argc, char *argv[])
   #endif
 
   #if defined(EGL_X11)
-  if (!strcmp(backend, "egl-x11")) {
+  if (!strcmp(backend->name, "egl-x11")) {
     #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_X11_EXT)
     if (eglCreatePlatformWindowSurfaceEXT) {
       egl_win = eglCreatePlatformWindowSurfaceEXT(egl_dpy, egl_config, &x11_win, NULL);
@@ -2046,7 +2941,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_DIRECTFB)
-  if (!strcmp(backend, "egl-directfb")) {
+  if (!strcmp(backend->name, "egl-directfb")) {
     #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_DIRECTFB_EXT)
     if (eglCreatePlatformWindowSurfaceEXT) {
       egl_win = eglCreatePlatformWindowSurfaceEXT(egl_dpy, egl_config, dfb_win, NULL);
@@ -2059,7 +2954,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_FBDEV)
-  if (!strcmp(backend, "egl-fbdev")) {
+  if (!strcmp(backend->name, "egl-fbdev")) {
     #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_FBDEV_EXT)
     if (eglCreatePlatformWindowSurfaceEXT) {
       egl_win = eglCreatePlatformWindowSurfaceEXT(egl_dpy, egl_config, fb_win, NULL);
@@ -2072,7 +2967,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_WAYLAND)
-  if (!strcmp(backend, "egl-wayland")) {
+  if (!strcmp(backend->name, "egl-wayland")) {
     #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_WAYLAND_EXT)
     if (eglCreatePlatformWindowSurfaceEXT) {
       egl_win = eglCreatePlatformWindowSurfaceEXT(egl_dpy, egl_config, wl_win, NULL);
@@ -2085,7 +2980,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_XCB)
-  if (!strcmp(backend, "egl-xcb")) {
+  if (!strcmp(backend->name, "egl-xcb")) {
     #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_XCB_EXT)
     if (eglCreatePlatformWindowSurfaceEXT) {
       egl_win = eglCreatePlatformWindowSurfaceEXT(egl_dpy, egl_config, &xcb_win, NULL);
@@ -2098,7 +2993,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_DRM)
-  if (!strcmp(backend, "egl-drm")) {
+  if (!strcmp(backend->name, "egl-drm")) {
     #if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_GBM_KHR)
     if (eglCreatePlatformWindowSurfaceEXT) {
       egl_win = eglCreatePlatformWindowSurfaceEXT(egl_dpy, egl_config, drm_win, NULL);
@@ -2111,21 +3006,35 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(EGL_RPI)
-  if (!strcmp(backend, "egl-rpi")) {
+  if (!strcmp(backend->name, "egl-rpi")) {
     egl_win = eglCreateWindowSurface(egl_dpy, egl_config, (EGLNativeWindowType)rpi_win, NULL);
   }
   #endif
   #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI)
-  if (!strcmp(backend, "egl-x11") || !strcmp(backend, "egl-directfb") || !strcmp(backend, "egl-fbdev") || !strcmp(backend, "egl-wayland") || !strcmp(backend, "egl-xcb") || !strcmp(backend, "egl-drm") || !strcmp(backend, "egl-rpi")) {
+  if (!strcmp(backend->name, "egl-x11") || !strcmp(backend->name, "egl-directfb") || !strcmp(backend->name, "egl-fbdev") || !strcmp(backend->name, "egl-wayland") || !strcmp(backend->name, "egl-xcb") || !strcmp(backend->name, "egl-drm") || !strcmp(backend->name, "egl-rpi")) {
     if (!egl_win) {
       printf("eglCreateWindowSurface failed: 0x%x\n", eglGetError());
       goto out;
     }
   }
   #endif
+  #if defined(EGL_SURFACELESS)
+  if (!strcmp(backend->name, "egl-surfaceless")) {
+    egl_pbuffer_attr[0] = EGL_WIDTH;
+    egl_pbuffer_attr[1] = win_width;
+    egl_pbuffer_attr[2] = EGL_HEIGHT;
+    egl_pbuffer_attr[3] = win_height;
+    egl_pbuffer_attr[4] = EGL_NONE;
+    egl_win = eglCreatePbufferSurface(egl_dpy, egl_config, egl_pbuffer_attr);
+    if (!egl_win) {
+      printf("eglCreatePbufferSurface failed: 0x%x\n", eglGetError());
+      goto out;
+    }
+  }
+  #endif
 
   #if defined(WAFFLE)
-  if (!strcmp(backend, "waffle")) {
+  if (!strcmp(backend->name, "waffle")) {
     waffle_win = waffle_window_create(waffle_config, win_width, win_height);
     if (!waffle_win) {
       printf("waffle_window_create failed: 0x%x\n", waffle_error_get_code());
@@ -2140,8 +3049,8 @@ int main(int argc, char *argv[])
       goto out;
     }
 
-    if (!libinput_path_add_device(waffle_input, getenv("KEYBOARD") ? getenv("KEYBOARD") : "/dev/input/event0")) {
-      printf("libinput_path_add_device %s failed\n", getenv("KEYBOARD") ? getenv("KEYBOARD") : "/dev/input/event0");
+    if (!libinput_path_add_device(waffle_input, options.keyboard ? options.keyboard : "/dev/input/event0")) {
+      printf("libinput_path_add_device %s failed\n", options.keyboard ? options.keyboard : "/dev/input/event0");
       goto out;
     }
   }
@@ -2150,7 +3059,7 @@ int main(int argc, char *argv[])
   /* create context and attach it to the window */
 
   #if defined(GL_X11)
-  if (!strcmp(backend, "gl-x11")) {
+  if (!strcmp(backend->name, "gl-x11")) {
     x11_ctx = glXCreateContext(x11_dpy, x11_visual, NULL, True);
     if (!x11_ctx) {
       printf("glXCreateContext failed\n");
@@ -2165,7 +3074,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(GL_DIRECTFB)
-  if (!strcmp(backend, "gl-directfb")) {
+  if (!strcmp(backend->name, "gl-directfb")) {
     c = alloca(2);
     sprintf(c, "%d", gears_engine_version(gears_engine));
     DirectFBSetOption("gles", c);
@@ -2184,7 +3093,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(GL_FBDEV)
-  if (!strcmp(backend, "gl-fbdev")) {
+  if (!strcmp(backend->name, "gl-fbdev")) {
     fb_ctx = glFBDevCreateContext(fb_visual, NULL);
     if (!fb_ctx) {
       printf("glFBDevCreateContext failed\n");
@@ -2200,8 +3109,8 @@ int main(int argc, char *argv[])
   }
   #endif
 
-  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI)
-  if (!strcmp(backend, "egl-x11") || !strcmp(backend, "egl-directfb") || !strcmp(backend, "egl-fbdev") || !strcmp(backend, "egl-wayland") || !strcmp(backend, "egl-xcb") || !strcmp(backend, "egl-drm") || !strcmp(backend, "egl-rpi")) {
+  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI) || defined(EGL_SURFACELESS)
+  if (!strcmp(backend->name, "egl-x11") || !strcmp(backend->name, "egl-directfb") || !strcmp(backend->name, "egl-fbdev") || !strcmp(backend->name, "egl-wayland") || !strcmp(backend->name, "egl-xcb") || !strcmp(backend->name, "egl-drm") || !strcmp(backend->name, "egl-rpi") || !strcmp(backend->name, "egl-surfaceless")) {
     opt = 0;
     memset(egl_ctx_attr, 0, sizeof(egl_ctx_attr));
     if (gears_engine_version(gears_engine) == 2) {
@@ -2226,7 +3135,7 @@ int main(int argc, char *argv[])
   #endif
 
   #if defined(WAFFLE)
-  if (!strcmp(backend, "waffle")) {
+  if (!strcmp(backend->name, "waffle")) {
     waffle_ctx = waffle_context_create(waffle_config, NULL);
     if (!waffle_ctx) {
       printf("waffle_context_create failed: 0x%x\n", waffle_error_get_code());
@@ -2243,12 +3152,33 @@ int main(int argc, char *argv[])
 
   /* drawing (main event loop) */
 
-  err = gears_engine_init(gears_engine, win_width, win_height);
+  scene = scene_new(nb_gears);
+  if (!scene) {
+    goto out;
+  }
+
+  err = gears_engine_init(gears_engine, win_width, win_height, scene);
   if (err == -1) {
     goto out;
   }
 
-  if (getenv("NO_ANIM")) {
+  #if defined(PGL_FBDEV) || defined(PGL_DRM) || defined(PGL_X11) || defined(PGL_WAYLAND) || defined(PGL_XCB)
+  if (!strcmp(backend->name, "pgl-fbdev") || !strcmp(backend->name, "pgl-drm") || !strcmp(backend->name, "pgl-x11") || !strcmp(backend->name, "pgl-wayland") || !strcmp(backend->name, "pgl-xcb")) {
+    err = gears_engine_target(gears_engine, pgl_buffer[pgl_back].addr, pgl_buffer[pgl_back].pitch);
+    if (err == -1) {
+      printf("gears_engine_target failed\n");
+      goto out;
+    }
+  }
+  #endif
+
+  if (bench_enabled()) {
+    bench = bench_new("yagears2", engine_arg, backend->name, win_width, win_height, scene->nb, gears_engine_driver(gears_engine));
+    if (!bench) {
+      goto out;
+    }
+  }
+  else if (options.no_anim) {
     animate = 0;
   }
 
@@ -2256,27 +3186,31 @@ int main(int argc, char *argv[])
 
   while (loop) {
     if (animate && redisplay) {
-      err = gettimeofday(&tv, NULL);
+      err = clock_gettime(CLOCK_MONOTONIC, &ts);
       if (err == -1) {
-        printf("gettimeofday failed: %m\n");
+        printf("clock_gettime failed: %m\n");
       }
 
-      t = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+      t = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 
       if (!frames) {
         t_rate = t_rot = t;
       }
       else {
-        if (t - t_rate >= 2000) {
+        if (t - t_rate >= 2000000000) {
           loop++;
-          fps += frames * 1000.0 / (t - t_rate);
+          fps += frames * 1000000000.0 / (t - t_rate);
           t_rate = t;
           frames = 0;
         }
 
-        model_rz += 15 * (t - t_rot) / 1000.0;
+        model_rz += 15 * (t - t_rot) / 1000000000.0;
         model_rz = fmod(model_rz, 360);
         t_rot = t;
+
+        if (bench && bench_frame(bench, t)) {
+          loop = 0;
+        }
       }
     }
     else {
@@ -2292,203 +3226,27 @@ int main(int argc, char *argv[])
         frames++;
       }
 
-      #if defined(GL_X11)
-      if (!strcmp(backend, "gl-x11")) {
-        glXSwapBuffers(x11_dpy, x11_win);
-      }
-      #endif
-      #if defined(GL_DIRECTFB)
-      if (!strcmp(backend, "gl-directfb")) {
-        if (getenv("DSCAPS_GL")) {
-          dfb_ctx->SwapBuffers(dfb_ctx);
-        }
-        else {
-          dfb_win->Flip(dfb_win, NULL, DSFLIP_WAITFORSYNC);
-        }
-      }
-      #endif
-      #if defined(GL_FBDEV)
-      if (!strcmp(backend, "gl-fbdev")) {
-        glFBDevSwapBuffers(fb_buffer);
-      }
-      #endif
-
-      #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI)
-      if (!strcmp(backend, "egl-x11") || !strcmp(backend, "egl-directfb") || !strcmp(backend, "egl-fbdev") || !strcmp(backend, "egl-wayland") || !strcmp(backend, "egl-xcb") || !strcmp(backend, "egl-drm") || !strcmp(backend, "egl-rpi")) {
-        eglSwapBuffers(egl_dpy, egl_win);
-      }
-      #endif
-
-      #if defined(WAFFLE)
-      if (!strcmp(backend, "waffle")) {
-        waffle_window_swap_buffers(waffle_win);
-      }
-      #endif
-    }
-
-    #if defined(GL_X11) || defined(EGL_X11)
-    if (!strcmp(backend, "gl-x11") || !strcmp(backend, "egl-x11")) {
-      if (!animate && redisplay) {
-        redisplay = 0;
-      }
-
-      memset(&x11_event, 0, sizeof(XEvent));
-      if (XPending(x11_dpy)) {
-        XNextEvent(x11_dpy, &x11_event);
-        if (x11_event.type == Expose && !redisplay) {
-          redisplay = 1;
-        }
-        else if (x11_event.type == KeyPress) {
-          x11_keyboard_handle_key(&x11_event);
-        }
-      }
-    }
-    #endif
-    #if defined(GL_DIRECTFB) || defined(EGL_DIRECTFB)
-    if (!strcmp(backend, "gl-directfb") || !strcmp(backend, "egl-directfb")) {
-      if (redisplay) {
-        if (getenv("DSCAPS_GL")) {
-          dfb_win->Flip(dfb_win, NULL, DSFLIP_WAITFORSYNC);
-        }
-        if (!animate) {
-          redisplay = 0;
-        }
-      }
-
-      memset(&dfb_event, 0, sizeof(DFBWindowEvent));
-      if (!dfb_event_buffer->GetEvent(dfb_event_buffer, (DFBEvent *)&dfb_event)) {
-        if (dfb_event.type == DWET_KEYDOWN) {
-          dfb_keyboard_handle_key(&dfb_event);
-        }
-      }
-    }
-    #endif
-    #if defined(GL_FBDEV) || defined(EGL_FBDEV)
-    if (!strcmp(backend, "gl-fbdev") || !strcmp(backend, "egl-fbdev")) {
-      if (!animate && redisplay) {
-        redisplay = 0;
-      }
-
-      memset(&fb_event, 0, sizeof(struct input_event));
-      if (read(fb_keyboard, &fb_event, sizeof(struct input_event)) > 0 && fb_event.type == EV_KEY) {
-        if (fb_event.value) {
-          fb_keyboard_handle_key(&fb_event);
-        }
-      }
-    }
-    #endif
-    #if defined(EGL_WAYLAND)
-    if (!strcmp(backend, "egl-wayland")) {
-      if (!animate && redisplay) {
-        redisplay = 0;
-      }
-
-      wl_display_dispatch(wl_dpy);
+      backend->swap();
     }
-    #endif
-    #if defined(EGL_XCB)
-    if (!strcmp(backend, "egl-xcb")) {
-      if (!animate && redisplay) {
-        redisplay = 0;
-      }
 
-      xcb_event = xcb_poll_for_event(xcb_dpy);
-      if (xcb_event) {
-        if ((xcb_event->response_type & 0x7f) == XCB_KEY_PRESS) {
-          xcb_keyboard_handle_key(xcb_event);
-        }
-        free(xcb_event);
-      }
-    }
-    #endif
-    #if defined(EGL_DRM)
-    if (!strcmp(backend, "egl-drm")) {
-      if (redisplay) {
-        #ifdef HAVE_DRI
-        if (getenv("NO_GBM")) {
-          drm_bo = drm_dpy->surface_lock_front_buffer(drm_win);
-        }
-        else
-        #endif
-        {
-          drm_bo = gbm_surface_lock_front_buffer(drm_win);
-        }
-        if (drm_bo) {
-          #ifdef HAVE_DRI
-          if (getenv("NO_GBM")) {
-            drm_fb_id = (uintptr_t)drm_bo->user_data;
-            if (!drm_fb_id) {
-              drmModeAddFB(drm_fd, drm_bo->width, drm_bo->height, 24, 32, drm_bo->stride, drm_bo->handle, &drm_fb_id);
-              drmModeSetCrtc(drm_fd, drm_crtc->crtc_id, drm_fb_id, 0, 0, &drm_connector->connector_id, 1, &drm_connector->modes[0]);
-              drm_bo->user_data = (void *)(uintptr_t)drm_fb_id;
-              drm_bo->destroy_user_data = drm_destroy_user_data;
-            }
-          }
-          else
-          #endif
-          {
-            drm_fb_id = (uintptr_t)gbm_bo_get_user_data(drm_bo);
-            if (!drm_fb_id) {
-              drmModeAddFB(drm_fd, gbm_bo_get_width(drm_bo), gbm_bo_get_height(drm_bo), 24, 32, gbm_bo_get_stride(drm_bo), gbm_bo_get_handle(drm_bo).u32, &drm_fb_id);
-              drmModeSetCrtc(drm_fd, drm_crtc->crtc_id, drm_fb_id, 0, 0, &drm_connector->connector_id, 1, &drm_connector->modes[0]);
-              gbm_bo_set_user_data(drm_bo, (void *)(uintptr_t)drm_fb_id, gbm_destroy_user_data);
-            }
-          }
-          drmModePageFlip(drm_fd, drm_crtc->crtc_id, drm_fb_id, DRM_MODE_PAGE_FLIP_EVENT, NULL);
-          drmHandleEvent(drm_fd, &drm_context);
-          #ifdef HAVE_DRI
-          if (getenv("NO_GBM")) {
-            drm_dpy->surface_release_buffer(drm_win, drm_bo);
-          }
-          else
-          #endif
-          {
-            gbm_surface_release_buffer(drm_win, drm_bo);
-          }
-        }
-        if (!animate) {
-          redisplay = 0;
-        }
+    if (redisplay) {
+      if (backend->present) {
+        backend->present();
       }
 
-      memset(&drm_event, 0, sizeof(struct input_event));
-      if (!libevdev_next_event(drm_evdev, LIBEVDEV_READ_FLAG_NORMAL, &drm_event) && drm_event.type == EV_KEY) {
-        if (drm_event.value) {
-          drm_keyboard_handle_key(&drm_event);
-        }
-      }
-    }
-    #endif
-    #if defined(EGL_RPI)
-    if (!strcmp(backend, "egl-rpi")) {
-      if (!animate && redisplay) {
+      if (!animate) {
         redisplay = 0;
-      }
 
-      memset(rpi_event, 0, sizeof(rpi_event));
-      if (read(STDIN_FILENO, rpi_event, 4) > 0) {
-        if (rpi_event[0]) {
-          rpi_keyboard_handle_key(rpi_event);
+        /* without events, nothing can trigger another frame */
+        if (!backend->poll_events) {
+          loop = 0;
         }
       }
     }
-    #endif
-    #if defined(WAFFLE)
-    if (!strcmp(backend, "waffle")) {
-      if (!animate && redisplay) {
-        redisplay = 0;
-      }
 
-      libinput_dispatch(waffle_input);
-      waffle_event = libinput_get_event(waffle_input);
-      if (waffle_event && libinput_event_get_type(waffle_event) == LIBINPUT_EVENT_KEYBOARD_KEY) {
-        if (libinput_event_keyboard_get_key_state((struct libinput_event_keyboard *)waffle_event)) {
-          waffle_keyboard_handle_key((struct libinput_event_keyboard *)waffle_event);
-        }
-        libinput_event_destroy(waffle_event);
-      }
+    if (backend->poll_events) {
+      backend->poll_events();
     }
-    #endif
   }
 
   gears_engine_term(gears_engine);
@@ -2496,7 +3254,7 @@ int main(int argc, char *argv[])
   /* print info */
 
   #if defined(GL_X11)
-  if (!strcmp(backend, "gl-x11")) {
+  if (!strcmp(backend->name, "gl-x11")) {
     glXQueryVersion(x11_dpy, &glx_major_version, &glx_minor_version);
     glXGetConfig(x11_dpy, x11_visual, GLX_DEPTH_SIZE, &glx_depth_size);
     glXGetConfig(x11_dpy, x11_visual, GLX_RED_SIZE, &glx_red_size);
@@ -2507,21 +3265,46 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(GL_DIRECTFB)
-  if (!strcmp(backend, "gl-directfb")) {
+  if (!strcmp(backend->name, "gl-directfb")) {
     memset(&directfbgl, 0, sizeof(DFBGLAttributes));
     dfb_ctx->GetAttributes(dfb_ctx, &directfbgl);
     printf("DirectFBGL %d (depth %d, red %d, green %d, blue %d, alpha %d)\n", DIRECTFBGL_INTERFACE_VERSION, directfbgl.depth_size, directfbgl.red_size, directfbgl.green_size, directfbgl.blue_size, directfbgl.alpha_size);
   }
   #endif
   #if defined(GL_FBDEV)
-  if (!strcmp(backend, "gl-fbdev")) {
+  if (!strcmp(backend->name, "gl-fbdev")) {
     glfbdev_depth_size = glFBDevGetVisualAttrib(fb_visual, GLFBDEV_DEPTH_SIZE);
     printf("GLFBDev %s (depth %d, red %d, green %d, blue %d, alpha %d)\n", glFBDevGetString(GLFBDEV_VERSION), glfbdev_depth_size, fb_vinfo.red.length, fb_vinfo.green.length, fb_vinfo.blue.length, fb_vinfo.transp.length);
   }
   #endif
+  #if defined(PGL_FBDEV)
+  if (!strcmp(backend->name, "pgl-fbdev")) {
+    printf("FBDev %s (buffers %d, pitch %d)\n", fb_finfo.id, pgl_nb_buffers, pgl_buffer[0].pitch);
+  }
+  #endif
+  #if defined(PGL_DRM)
+  if (!strcmp(backend->name, "pgl-drm")) {
+    printf("DRM dumb buffers (buffers %d, pitch %d)\n", pgl_nb_buffers, pgl_buffer[0].pitch);
+  }
+  #endif
+  #if defined(PGL_X11)
+  if (!strcmp(backend->name, "pgl-x11")) {
+    printf("X11 MIT-SHM (buffers %d, pitch %d)\n", pgl_nb_buffers, pgl_buffer[0].pitch);
+  }
+  #endif
+  #if defined(PGL_WAYLAND)
+  if (!strcmp(backend->name, "pgl-wayland")) {
+    printf("Wayland wl_shm (buffers %d, pitch %d)\n", pgl_nb_buffers, pgl_buffer[0].pitch);
+  }
+  #endif
+  #if defined(PGL_XCB)
+  if (!strcmp(backend->name, "pgl-xcb")) {
+    printf("XCB MIT-SHM (buffers %d, pitch %d)\n", pgl_nb_buffers, pgl_buffer[0].pitch);
+  }
+  #endif
 
-  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI)
-  if (!strcmp(backend, "egl-x11") || !strcmp(backend, "egl-directfb") || !strcmp(backend, "egl-fbdev") || !strcmp(backend, "egl-wayland") || !strcmp(backend, "egl-xcb") || !strcmp(backend, "egl-drm") || !strcmp(backend, "egl-rpi")) {
+  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI) || defined(EGL_SURFACELESS)
+  if (!strcmp(backend->name, "egl-x11") || !strcmp(backend->name, "egl-directfb") || !strcmp(backend->name, "egl-fbdev") || !strcmp(backend->name, "egl-wayland") || !strcmp(backend->name, "egl-xcb") || !strcmp(backend->name, "egl-drm") || !strcmp(backend->name, "egl-rpi") || !strcmp(backend->name, "egl-surfaceless")) {
     eglGetConfigAttrib(egl_dpy, egl_config, EGL_DEPTH_SIZE, &egl_depth_size);
     eglGetConfigAttrib(egl_dpy, egl_config, EGL_RED_SIZE, &egl_red_size);
     eglGetConfigAttrib(egl_dpy, egl_config, EGL_GREEN_SIZE, &egl_green_size);
@@ -2531,6 +3314,13 @@ int main(int argc, char *argv[])
   }
   #endif
 
+  if (bench) {
+    err = bench_report(bench);
+    if (err == -1) {
+      goto out;
+    }
+  }
+
   ret = EXIT_SUCCESS;
 
 out:
@@ -2538,7 +3328,7 @@ out:
   /* destroy context */
 
   #if defined(WAFFLE)
-  if (!strcmp(backend, "waffle")) {
+  if (!strcmp(backend->name, "waffle")) {
     if (waffle_ctx) {
       waffle_make_current(waffle_dpy, NULL, NULL);
       waffle_context_destroy(waffle_ctx);
@@ -2546,8 +3336,8 @@ out:
   }
   #endif
 
-  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI)
-  if (!strcmp(backend, "egl-x11") || !strcmp(backend, "egl-directfb") || !strcmp(backend, "egl-fbdev") || !strcmp(backend, "egl-wayland") || !strcmp(backend, "egl-xcb") || !strcmp(backend, "egl-drm") || !strcmp(backend, "egl-rpi")) {
+  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI) || defined(EGL_SURFACELESS)
+  if (!strcmp(backend->name, "egl-x11") || !strcmp(backend->name, "egl-directfb") || !strcmp(backend->name, "egl-fbdev") || !strcmp(backend->name, "egl-wayland") || !strcmp(backend->name, "egl-xcb") || !strcmp(backend->name, "egl-drm") || !strcmp(backend->name, "egl-rpi") || !strcmp(backend->name, "egl-surfaceless")) {
     if (egl_ctx) {
       eglMakeCurrent(egl_dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
       eglDestroyContext(egl_dpy, egl_ctx);
@@ -2556,7 +3346,7 @@ out:
   #endif
 
   #if defined(GL_X11)
-  if (!strcmp(backend, "gl-x11")) {
+  if (!strcmp(backend->name, "gl-x11")) {
     if (x11_ctx) {
       glXMakeCurrent(x11_dpy, None, NULL);
       glXDestroyContext(x11_dpy, x11_ctx);
@@ -2564,7 +3354,7 @@ out:
   }
   #endif
   #if defined(GL_DIRECTFB)
-  if (!strcmp(backend, "gl-directfb")) {
+  if (!strcmp(backend->name, "gl-directfb")) {
     if (dfb_ctx) {
       dfb_ctx->Unlock(dfb_ctx);
       dfb_ctx->Release(dfb_ctx);
@@ -2572,7 +3362,7 @@ out:
   }
   #endif
   #if defined(GL_FBDEV)
-  if (!strcmp(backend, "gl-fbdev")) {
+  if (!strcmp(backend->name, "gl-fbdev")) {
     if (fb_ctx) {
       glFBDevMakeCurrent(NULL, NULL, NULL);
       glFBDevDestroyContext(fb_ctx);
@@ -2583,7 +3373,7 @@ out:
   /* destroy window and close display */
 
   #if defined(WAFFLE)
-  if (!strcmp(backend, "waffle")) {
+  if (!strcmp(backend->name, "waffle")) {
     if (waffle_input) {
       libinput_unref(waffle_input);
     }
@@ -2602,8 +3392,8 @@ out:
   }
   #endif
 
-  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI)
-  if (!strcmp(backend, "egl-x11") || !strcmp(backend, "egl-directfb") || !strcmp(backend, "egl-fbdev") || !strcmp(backend, "egl-wayland") || !strcmp(backend, "egl-xcb") || !strcmp(backend, "egl-drm") || !strcmp(backend, "egl-rpi")) {
+  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_RPI) || defined(EGL_SURFACELESS)
+  if (!strcmp(backend->name, "egl-x11") || !strcmp(backend->name, "egl-directfb") || !strcmp(backend->name, "egl-fbdev") || !strcmp(backend->name, "egl-wayland") || !strcmp(backend->name, "egl-xcb") || !strcmp(backend->name, "egl-drm") || !strcmp(backend->name, "egl-rpi") || !strcmp(backend->name, "egl-surfaceless")) {
     if (egl_win) {
       eglDestroySurface(egl_dpy, egl_win);
     }
@@ -2618,8 +3408,8 @@ out:
   }
   #endif
 
-  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM)
-  if (!strcmp(backend, "egl-x11") || !strcmp(backend, "egl-directfb") || !strcmp(backend, "egl-fbdev") || !strcmp(backend, "egl-wayland") || !strcmp(backend, "egl-xcb") || !strcmp(backend, "egl-drm")) {
+  #if defined(EGL_X11) || defined(EGL_DIRECTFB) || defined(EGL_FBDEV) || defined(EGL_WAYLAND) || defined(EGL_XCB) || defined(EGL_DRM) || defined(EGL_SURFACELESS)
+  if (!strcmp(backend->name, "egl-x11") || !strcmp(backend->name, "egl-directfb") || !strcmp(backend->name, "egl-fbdev") || !strcmp(backend->name, "egl-wayland") || !strcmp(backend->name, "egl-xcb") || !strcmp(backend->name, "egl-drm") || !strcmp(backend->name, "egl-surfaceless")) {
     #ifdef EGL_EXT_platform_base
     if (eglGetPlatformDisplayEXT) {
       eglGetPlatformDisplayEXT = NULL;
@@ -2633,14 +3423,32 @@ out:
   #endif
 
   #if defined(GL_X11)
-  if (!strcmp(backend, "gl-x11")) {
+  if (!strcmp(backend->name, "gl-x11")) {
     if (x11_visual) {
       XFree(x11_visual);
     }
   }
   #endif
-  #if defined(GL_X11) || defined(EGL_X11)
-  if (!strcmp(backend, "gl-x11") || !strcmp(backend, "egl-x11")) {
+  #if defined(PGL_X11)
+  if (!strcmp(backend->name, "pgl-x11")) {
+    for (opt = 0; opt < pgl_nb_buffers; opt++) {
+      if (pgl_buffer[opt].x11_shm.shmseg) {
+        XShmDetach(x11_dpy, &pgl_buffer[opt].x11_shm);
+        XSync(x11_dpy, False);
+      }
+
+      if (pgl_buffer[opt].x11_shm.shmaddr) {
+        shmdt(pgl_buffer[opt].x11_shm.shmaddr);
+      }
+
+      if (pgl_buffer[opt].x11_image) {
+        XDestroyImage(pgl_buffer[opt].x11_image);
+      }
+    }
+  }
+  #endif
+  #if defined(GL_X11) || defined(EGL_X11) || defined(PGL_X11)
+  if (!strcmp(backend->name, "gl-x11") || !strcmp(backend->name, "egl-x11") || !strcmp(backend->name, "pgl-x11")) {
     if (x11_event_mask) {
       XSelectInput(x11_dpy, x11_win, NoEventMask);
     }
@@ -2655,12 +3463,12 @@ out:
   }
   #endif
   #if defined(GL_DIRECTFB)
-  if (!strcmp(backend, "gl-directfb")) {
+  if (!strcmp(backend->name, "gl-directfb")) {
       dfb_attr = DSCAPS_NONE;
   }
   #endif
   #if defined(GL_DIRECTFB) || defined(EGL_DIRECTFB)
-  if (!strcmp(backend, "gl-directfb") || !strcmp(backend, "egl-directfb")) {
+  if (!strcmp(backend->name, "gl-directfb") || !strcmp(backend->name, "egl-directfb")) {
     if (dfb_event_buffer) {
       dfb_event_buffer->Release(dfb_event_buffer);
     }
@@ -2683,7 +3491,7 @@ out:
   }
   #endif
   #if defined(GL_FBDEV)
-  if (!strcmp(backend, "gl-fbdev")) {
+  if (!strcmp(backend->name, "gl-fbdev")) {
     if (fb_buffer) {
       glFBDevDestroyBuffer(fb_buffer);
     }
@@ -2697,8 +3505,20 @@ out:
     }
   }
   #endif
-  #if defined(GL_FBDEV) || defined(EGL_FBDEV)
-  if (!strcmp(backend, "gl-fbdev") || !strcmp(backend, "egl-fbdev")) {
+  #if defined(PGL_FBDEV)
+  if (!strcmp(backend->name, "pgl-fbdev")) {
+    if (pgl_nb_buffers == 2) {
+      fb_vinfo.yoffset = fb_yoffset;
+      ioctl(fb_dpy, FBIOPAN_DISPLAY, &fb_vinfo);
+    }
+
+    if (fb_addr) {
+      munmap(fb_addr, fb_finfo.smem_len);
+    }
+  }
+  #endif
+  #if defined(GL_FBDEV) || defined(EGL_FBDEV) || defined(PGL_FBDEV)
+  if (!strcmp(backend->name, "gl-fbdev") || !strcmp(backend->name, "egl-fbdev") || !strcmp(backend->name, "pgl-fbdev")) {
     if (fb_keyboard != -1) {
       close(fb_keyboard);
     }
@@ -2716,8 +3536,29 @@ out:
     }
   }
   #endif
-  #if defined(EGL_WAYLAND)
-  if (!strcmp(backend, "egl-wayland")) {
+  #if defined(PGL_WAYLAND)
+  if (!strcmp(backend->name, "pgl-wayland")) {
+    for (opt = 0; opt < pgl_nb_buffers; opt++) {
+      if (pgl_buffer[opt].wl_buffer) {
+        wl_buffer_destroy(pgl_buffer[opt].wl_buffer);
+      }
+
+      if (pgl_buffer[opt].map) {
+        munmap(pgl_buffer[opt].map, pgl_buffer[opt].size);
+      }
+    }
+
+    if (wl_pool) {
+      wl_shm_pool_destroy(wl_pool);
+    }
+
+    if (wl_fd != -1) {
+      close(wl_fd);
+    }
+  }
+  #endif
+  #if defined(EGL_WAYLAND) || defined(PGL_WAYLAND)
+  if (!strcmp(backend->name, "egl-wayland") || !strcmp(backend->name, "pgl-wayland")) {
     if (wl_data.xkb_state) {
       xkb_state_unref(wl_data.xkb_state);
     }
@@ -2730,14 +3571,16 @@ out:
       xkb_context_unref(wl_data.xkb_context);
     }
 
+    #if defined(EGL_WAYLAND)
     if (wl_win) {
-      if (getenv("NO_WL_EGL_WINDOW")) {
+      if (options.no_wl_egl_window) {
         free(wl_win);
       }
       else {
         wl_egl_window_destroy(wl_win);
       }
     }
+    #endif
 
     if (wl_shell_surface) {
       wl_shell_surface_destroy(wl_shell_surface);
@@ -2755,6 +3598,10 @@ out:
       wl_seat_destroy(wl_data.wl_seat);
     }
 
+    if (wl_data.wl_shm) {
+      wl_shm_destroy(wl_data.wl_shm);
+    }
+
     if (wl_data.wl_shell) {
       wl_shell_destroy(wl_data.wl_shell);
     }
@@ -2776,8 +3623,25 @@ out:
     }
   }
   #endif
-  #if defined(EGL_XCB)
-  if (!strcmp(backend, "egl-xcb")) {
+  #if defined(PGL_XCB)
+  if (!strcmp(backend->name, "pgl-xcb")) {
+    for (opt = 0; opt < pgl_nb_buffers; opt++) {
+      if (pgl_buffer[opt].xcb_shm) {
+        xcb_shm_detach(xcb_dpy, pgl_buffer[opt].xcb_shm);
+      }
+
+      if (pgl_buffer[opt].map) {
+        shmdt(pgl_buffer[opt].map);
+      }
+    }
+
+    if (xcb_gc) {
+      xcb_free_gc(xcb_dpy, xcb_gc);
+    }
+  }
+  #endif
+  #if defined(EGL_XCB) || defined(PGL_XCB)
+  if (!strcmp(backend->name, "egl-xcb") || !strcmp(backend->name, "pgl-xcb")) {
     if (xcb_event_mask) {
       xcb_event_mask = XCB_EVENT_MASK_NO_EVENT;
       xcb_change_window_attributes(xcb_dpy, xcb_win, XCB_CW_EVENT_MASK, &xcb_event_mask);
@@ -2792,8 +3656,8 @@ out:
     }
   }
   #endif
-  #if defined(EGL_DRM)
-  if (!strcmp(backend, "egl-drm")) {
+  #if defined(EGL_DRM) || defined(PGL_DRM)
+  if (!strcmp(backend->name, "egl-drm") || !strcmp(backend->name, "pgl-drm")) {
     if (drm_evdev) {
       libevdev_free(drm_evdev);
     }
@@ -2806,9 +3670,10 @@ out:
       closedir(drm_input_dir);
     }
 
+    #if defined(EGL_DRM)
     if (drm_win) {
       #ifdef HAVE_DRI
-      if (getenv("NO_GBM")) {
+      if (options.no_gbm) {
         free(drm_win);
       }
       else
@@ -2817,12 +3682,31 @@ out:
         gbm_surface_destroy(drm_win);
       }
     }
+    #endif
 
     if (drm_crtc) {
       drmModeSetCrtc(drm_fd, drm_crtc->crtc_id, drm_crtc->buffer_id, drm_crtc->x, drm_crtc->y, &drm_connector->connector_id, 1, &drm_crtc->mode);
       drmModeFreeCrtc(drm_crtc);
     }
 
+    #if defined(PGL_DRM)
+    for (opt = 0; opt < pgl_nb_buffers; opt++) {
+      if (pgl_buffer[opt].map) {
+        munmap(pgl_buffer[opt].map, pgl_buffer[opt].size);
+      }
+
+      if (pgl_buffer[opt].fb_id) {
+        drmModeRmFB(drm_fd, pgl_buffer[opt].fb_id);
+      }
+
+      if (pgl_buffer[opt].handle) {
+        memset(&drm_destroy_dumb, 0, sizeof(struct drm_mode_destroy_dumb));
+        drm_destroy_dumb.handle = pgl_buffer[opt].handle;
+        drmIoctl(drm_fd, DRM_IOCTL_MODE_DESTROY_DUMB, &drm_destroy_dumb);
+      }
+    }
+    #endif
+
     if (drm_encoder) {
       drmModeFreeEncoder(drm_encoder);
     }
@@ -2835,9 +3719,10 @@ out:
       drmModeFreeResources(drm_resources);
     }
 
+    #if defined(EGL_DRM)
     if (drm_dpy) {
       #ifdef HAVE_DRI
-      if (getenv("NO_GBM")) {
+      if (options.no_gbm) {
         if (drm_dpy->screen) {
           for (opt = 0; drm_dpy->driver_configs[opt]; opt++)
             free(drm_dpy->driver_configs[opt]);
@@ -2858,6 +3743,7 @@ out:
         gbm_device_destroy(drm_dpy);
       }
     }
+    #endif
 
     if (drm_fd != -1) {
       close(drm_fd);
@@ -2865,7 +3751,7 @@ out:
   }
   #endif
   #if defined(EGL_RPI)
-  if (!strcmp(backend, "egl-rpi")) {
+  if (!strcmp(backend->name, "egl-rpi")) {
     if (rpi_fdflags != -1) {
       fcntl(STDIN_FILENO, F_SETFL, rpi_fdflags);
     }
@@ -2894,6 +3780,10 @@ out:
   }
   #endif
 
+  bench_free(bench);
+
+  scene_free(scene);
+
   gears_engine_free(gears_engine);
 
   return ret;
@@ -0,0 +1,207 @@
+/*
+  yagears                  Yet Another Gears OpenGL / Vulkan demo
+  Copyright (C) 2013-2024  Nicolas Caramelli
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "mat4.h"
+
+/* per gear transforms computed by the engines: with the previous matrix code,
+   kept here as the reference, and with the mat4 module */
+
+static void multiply(float *a, const float *b)
+{
+  float m[16];
+  int i, j;
+  div_t d;
+
+  for (i = 0; i < 16; i++) {
+    m[i] = 0;
+    d = div(i, 4);
+    for (j = 0; j < 4; j++)
+      m[i] += (a + d.rem)[j * 4] * (b + d.quot * 4)[j];
+  }
+
+  memcpy(a, m, sizeof(m));
+}
+
+static void translate(float *a, float tx, float ty, float tz)
+{
+  float m[16] = {
+     1,  0,  0, 0,
+     0,  1,  0, 0,
+     0,  0,  1, 0,
+    tx, ty, tz, 1
+  };
+
+  multiply(a, m);
+}
+
+static void rotate(float *a, float r, float ux, float uy, float uz)
+{
+  float s, c;
+
+  sincosf(r * M_PI / 180, &s, &c);
+
+  float m[16] = {
+         ux * ux * (1 - c) + c, uy * ux * (1 - c) + uz * s, ux * uz * (1 - c) - uy * s, 0,
+    ux * uy * (1 - c) - uz * s,      uy * uy * (1 - c) + c, uy * uz * (1 - c) + ux * s, 0,
+    ux * uz * (1 - c) + uy * s, uy * uz * (1 - c) - ux * s,      uz * uz * (1 - c) + c, 0,
+                             0,                          0,                          0, 1
+  };
+
+  multiply(a, m);
+}
+
+static void transpose(float *a)
+{
+  float m[16] = {
+    a[0], a[4], a[8],  a[12],
+    a[1], a[5], a[9],  a[13],
+    a[2], a[6], a[10], a[14],
+    a[3], a[7], a[11], a[15]
+  };
+
+  memcpy(a, m, sizeof(m));
+}
+
+static void invert(float *a)
+{
+  float m[16] = {
+         1,      0,      0, 0,
+         0,      1,      0, 0,
+         0,      0,      1, 0,
+    -a[12], -a[13], -a[14], 1,
+  };
+
+  a[12] = a[13] = a[14] = 0;
+  transpose(a);
+
+  multiply(a, m);
+}
+
+/******************************************************************************/
+
+static float Projection[16], View[16];
+
+static void reference_transform(float tx, float ty, float rz, float *ModelViewProjection, float *Normal)
+{
+  memcpy(Normal, View, sizeof(View));
+  translate(Normal, tx, ty, 0);
+  rotate(Normal, rz, 0, 0, 1);
+  memcpy(ModelViewProjection, Projection, sizeof(Projection));
+  multiply(ModelViewProjection, Normal);
+  invert(Normal);
+  transpose(Normal);
+}
+
+static void mat4_transform(float tx, float ty, float rz, float *ModelViewProjection, float *Normal)
+{
+  memcpy(Normal, View, sizeof(View));
+  mat4_translate(Normal, tx, ty, 0);
+  mat4_rotate_z(Normal, rz);
+  memcpy(ModelViewProjection, Projection, sizeof(Projection));
+  mat4_multiply(ModelViewProjection, Normal);
+  mat4_rigid_invert(Normal);
+  mat4_transpose(Normal);
+}
+
+static double run(void (*transform)(float, float, float, float *, float *), int nb, int frames, float *out)
+{
+  struct timeval tv0, tv1;
+  int i, frame;
+
+  gettimeofday(&tv0, NULL);
+
+  for (frame = 0; frame < frames; frame++) {
+    for (i = 0; i < nb; i++) {
+      transform(i % 100, i / 100, i + frame, out + i * 32, out + i * 32 + 16);
+    }
+  }
+
+  gettimeofday(&tv1, NULL);
+
+  return ((tv1.tv_sec - tv0.tv_sec) * 1e9 + (tv1.tv_usec - tv0.tv_usec) * 1e3) / ((double)nb * frames);
+}
+
+int main(int argc, char *argv[])
+{
+  int ret = EXIT_FAILURE, nb = 10000, frames = 100, i;
+  float *reference = NULL, *out = NULL, err = 0;
+  double reference_ns, mat4_ns;
+
+  if (getenv("GEARS")) {
+    nb = atoi(getenv("GEARS"));
+  }
+
+  if (getenv("FRAMES")) {
+    frames = atoi(getenv("FRAMES"));
+  }
+
+  if (nb <= 0 || frames <= 0) {
+    printf("invalid GEARS or FRAMES\n");
+    return ret;
+  }
+
+  reference = malloc(nb * 32 * sizeof(float));
+  out = malloc(nb * 32 * sizeof(float));
+  if (!reference || !out) {
+    printf("malloc failed\n");
+    goto out;
+  }
+
+  memset(Projection, 0, sizeof(Projection));
+  Projection[0] = 5;
+  Projection[5] = 5;
+  Projection[10] = -65.0 / 55;
+  Projection[11] = -1;
+  Projection[14] = -600.0 / 55;
+
+  mat4_identity(View);
+  mat4_translate(View, 0, 0, -40);
+  mat4_rotate(View, 20, 1, 0, 0);
+  mat4_rotate(View, 30, 0, 1, 0);
+
+  reference_ns = run(reference_transform, nb, frames, reference);
+  mat4_ns = run(mat4_transform, nb, frames, out);
+
+  for (i = 0; i < nb * 32; i++) {
+    err = fmaxf(err, fabsf(reference[i] - out[i]) / fmaxf(1, fabsf(reference[i])));
+  }
+
+  printf("%d gears, %d frames\n", nb, frames);
+  printf("reference: %.1f ns per gear\n", reference_ns);
+  printf("mat4:      %.1f ns per gear (%.1fx), max relative error %g\n", mat4_ns, reference_ns / mat4_ns, err);
+
+  if (err < 1e-4) {
+    ret = EXIT_SUCCESS;
+  }
+
+out:
+  free(out);
+  free(reference);
+
+  return ret;
+}
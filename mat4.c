@@ -0,0 +1,191 @@
+/*
+  yagears                  Yet Another Gears OpenGL / Vulkan demo
+  Copyright (C) 2013-2024  Nicolas Caramelli
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "mat4.h"
+
+/******************************************************************************/
+
+/* columns are handled as 4 floats vectors */
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+typedef __m128 vec4;
+
+#define vec4_load(p)     _mm_loadu_ps(p)
+#define vec4_store(p, v) _mm_storeu_ps(p, v)
+#define vec4_set1(f)     _mm_set1_ps(f)
+#define vec4_add(a, b)   _mm_add_ps(a, b)
+#define vec4_sub(a, b)   _mm_sub_ps(a, b)
+#define vec4_mul(a, b)   _mm_mul_ps(a, b)
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+
+typedef float32x4_t vec4;
+
+#define vec4_load(p)     vld1q_f32(p)
+#define vec4_store(p, v) vst1q_f32(p, v)
+#define vec4_set1(f)     vdupq_n_f32(f)
+#define vec4_add(a, b)   vaddq_f32(a, b)
+#define vec4_sub(a, b)   vsubq_f32(a, b)
+#define vec4_mul(a, b)   vmulq_f32(a, b)
+#else
+typedef struct {
+  float v[4];
+} vec4;
+
+static inline vec4 vec4_load(const float *p)
+{
+  vec4 r = { { p[0], p[1], p[2], p[3] } };
+  return r;
+}
+
+static inline void vec4_store(float *p, vec4 a)
+{
+  p[0] = a.v[0];
+  p[1] = a.v[1];
+  p[2] = a.v[2];
+  p[3] = a.v[3];
+}
+
+static inline vec4 vec4_set1(float f)
+{
+  vec4 r = { { f, f, f, f } };
+  return r;
+}
+
+static inline vec4 vec4_add(vec4 a, vec4 b)
+{
+  vec4 r = { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+  return r;
+}
+
+static inline vec4 vec4_sub(vec4 a, vec4 b)
+{
+  vec4 r = { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } };
+  return r;
+}
+
+static inline vec4 vec4_mul(vec4 a, vec4 b)
+{
+  vec4 r = { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } };
+  return r;
+}
+#endif
+
+/******************************************************************************/
+
+void mat4_identity(float *a)
+{
+  float m[16] = {
+    1, 0, 0, 0,
+    0, 1, 0, 0,
+    0, 0, 1, 0,
+    0, 0, 0, 1,
+  };
+
+  memcpy(a, m, sizeof(m));
+}
+
+void mat4_multiply(float *a, const float *b)
+{
+  vec4 c0 = vec4_load(a), c1 = vec4_load(a + 4), c2 = vec4_load(a + 8), c3 = vec4_load(a + 12);
+  int j;
+
+  /* column j of the product is the combination of the columns of a weighted by column j of b */
+
+  for (j = 0; j < 4; j++) {
+    vec4_store(a + j * 4, vec4_add(vec4_add(vec4_mul(c0, vec4_set1(b[j * 4])), vec4_mul(c1, vec4_set1(b[j * 4 + 1]))),
+                                   vec4_add(vec4_mul(c2, vec4_set1(b[j * 4 + 2])), vec4_mul(c3, vec4_set1(b[j * 4 + 3])))));
+  }
+}
+
+void mat4_translate(float *a, float tx, float ty, float tz)
+{
+  vec4 c0 = vec4_load(a), c1 = vec4_load(a + 4), c2 = vec4_load(a + 8), c3 = vec4_load(a + 12);
+
+  /* only the last column is modified */
+
+  vec4_store(a + 12, vec4_add(vec4_add(vec4_mul(c0, vec4_set1(tx)), vec4_mul(c1, vec4_set1(ty))), vec4_add(vec4_mul(c2, vec4_set1(tz)), c3)));
+}
+
+void mat4_rotate(float *a, float r, float ux, float uy, float uz)
+{
+  float s, c;
+
+  sincosf(r * M_PI / 180, &s, &c);
+
+  float m[16] = {
+         ux * ux * (1 - c) + c, uy * ux * (1 - c) + uz * s, ux * uz * (1 - c) - uy * s, 0,
+    ux * uy * (1 - c) - uz * s,      uy * uy * (1 - c) + c, uy * uz * (1 - c) + ux * s, 0,
+    ux * uz * (1 - c) + uy * s, uy * uz * (1 - c) - ux * s,      uz * uz * (1 - c) + c, 0,
+                             0,                          0,                          0, 1
+  };
+
+  mat4_multiply(a, m);
+}
+
+void mat4_rotate_z(float *a, float r)
+{
+  vec4 c0 = vec4_load(a), c1 = vec4_load(a + 4), vs, vc;
+  float s, c;
+
+  sincosf(r * M_PI / 180, &s, &c);
+
+  /* only the first two columns are modified */
+
+  vs = vec4_set1(s);
+  vc = vec4_set1(c);
+  vec4_store(a, vec4_add(vec4_mul(c0, vc), vec4_mul(c1, vs)));
+  vec4_store(a + 4, vec4_sub(vec4_mul(c1, vc), vec4_mul(c0, vs)));
+}
+
+void mat4_transpose(float *a)
+{
+  float m[16] = {
+    a[0], a[4], a[8],  a[12],
+    a[1], a[5], a[9],  a[13],
+    a[2], a[6], a[10], a[14],
+    a[3], a[7], a[11], a[15]
+  };
+
+  memcpy(a, m, sizeof(m));
+}
+
+void mat4_rigid_invert(float *a)
+{
+  float tx = a[12], ty = a[13], tz = a[14];
+
+  /* the inverse of [R t] is [transpose(R) -transpose(R)t] */
+
+  float m[16] = {
+    a[0], a[4], a[8],  0,
+    a[1], a[5], a[9],  0,
+    a[2], a[6], a[10], 0,
+    -(a[0] * tx + a[1] * ty + a[2] * tz), -(a[4] * tx + a[5] * ty + a[6] * tz), -(a[8] * tx + a[9] * ty + a[10] * tz), 1
+  };
+
+  memcpy(a, m, sizeof(m));
+}
@@ -0,0 +1,46 @@
+/*
+  yagears                  Yet Another Gears OpenGL / Vulkan demo
+  Copyright (C) 2013-2024  Nicolas Caramelli
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef MAT4_H
+#define MAT4_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 4x4 matrices are arrays of 16 floats stored in column-major order,
+   operations multiply the matrix on the right (a = a * m) */
+
+void mat4_identity(float *a);
+void mat4_multiply(float *a, const float *b);
+void mat4_translate(float *a, float tx, float ty, float tz);
+void mat4_rotate(float *a, float r, float ux, float uy, float uz);
+void mat4_rotate_z(float *a, float r);
+void mat4_transpose(float *a);
+void mat4_rigid_invert(float *a); /* rotation and translation only */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,404 @@
+/*
+  yagears                  Yet Another Gears OpenGL / Vulkan demo
+  Copyright (C) 2013-2024  Nicolas Caramelli
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "list.h"
+#include "mesh.h"
+
+/******************************************************************************/
+
+struct mesh_entry {
+  mesh_t mesh;
+  float inner;
+  float outer;
+  float width;
+  int teeth;
+  float tooth_depth;
+  struct list entry;
+};
+
+static struct list mesh_list = LIST_INIT(mesh_list);
+
+static unsigned short half(float f)
+{
+  union { float f; unsigned int u; } v;
+  unsigned int sign, mantissa;
+  int exponent;
+
+  v.f = f;
+  sign = (v.u >> 16) & 0x8000;
+  exponent = (int)((v.u >> 23) & 0xff) - 127 + 15;
+  mantissa = (v.u & 0x7fffff) + 0x1000;
+
+  if (mantissa & 0x800000) {
+    mantissa = 0;
+    exponent++;
+  }
+
+  if (exponent <= 0) {
+    return sign;
+  }
+
+  if (exponent >= 31) {
+    return sign | 0x7c00;
+  }
+
+  return sign | exponent << 10 | mantissa >> 13;
+}
+
+static unsigned int pack(float nx, float ny, float nz)
+{
+  float l = sqrtf(nx * nx + ny * ny + nz * nz);
+
+  if (!l) {
+    l = 1;
+  }
+
+  return lrintf((nx / l * 0.5 + 0.5) * 1023) | lrintf((ny / l * 0.5 + 0.5) * 1023) << 10 | lrintf((nz / l * 0.5 + 0.5) * 1023) << 20;
+}
+
+static void emit(mesh_t *mesh, float x, float y, float z, const float *n, const float *t)
+{
+  float flip = mesh->layout & MESH_FLIP_Y ? -1 : 1;
+  float *v;
+  unsigned short *h;
+
+  if (mesh->layout & MESH_COMPACT) {
+    h = (unsigned short *)((char *)mesh->vertices + mesh->nvertices * mesh->stride);
+    *h++ = half(x);
+    *h++ = half(flip * y);
+    *h++ = half(z);
+    *h++ = half(t[2]);
+
+    if (mesh->layout & MESH_NORMAL) {
+      *(unsigned int *)h = pack(n[0], flip * n[1], n[2]);
+    }
+
+    mesh->nvertices++;
+    return;
+  }
+
+  v = (float *)((char *)mesh->vertices + mesh->nvertices * mesh->stride);
+
+  *v++ = x;
+  *v++ = flip * y;
+  *v++ = z;
+
+  if (mesh->layout & MESH_NORMAL) {
+    *v++ = n[0];
+    *v++ = flip * n[1];
+    *v++ = n[2];
+  }
+
+  if (mesh->layout & MESH_TEXCOORD) {
+    *v++ = t[0];
+    *v++ = t[1];
+  }
+
+  mesh->nvertices++;
+}
+
+/******************************************************************************/
+
+int mesh_stride(int layout)
+{
+  int stride = 3 * sizeof(float);
+
+  if (layout & MESH_COMPACT) {
+    stride = 4 * sizeof(unsigned short);
+
+    if (layout & MESH_NORMAL) {
+      stride += sizeof(unsigned int);
+    }
+
+    return stride;
+  }
+
+  if (layout & MESH_NORMAL) {
+    stride += 3 * sizeof(float);
+  }
+
+  if (layout & MESH_TEXCOORD) {
+    stride += 2 * sizeof(float);
+  }
+
+  return stride;
+}
+
+void mesh_tessellate(mesh_t *mesh, float inner, float outer, float width, int teeth, float tooth_depth)
+{
+  float r0, r1, r2, da, a1, ai, s[5], c[5];
+  int i, j;
+  float n[3], t[3] = { 0, 0, 0 };
+  int k = 0;
+
+  mesh->stride = mesh_stride(mesh->layout);
+  mesh->nvertices = 0;
+  mesh->ninstances = MESH_NINSTANCES(teeth, mesh->layout);
+  mesh->nstrips = MESH_NSTRIPS(teeth / mesh->ninstances);
+  mesh->nindices = 0;
+
+  r0 = inner;
+  r1 = outer - tooth_depth / 2;
+  r2 = outer + tooth_depth / 2;
+  a1 = 2 * M_PI / teeth;
+  da = a1 / 4;
+
+  #define normal(nx, ny, nz) \
+    n[0] = nx; \
+    n[1] = ny; \
+    n[2] = nz;
+
+  /* t[2] is the scale giving texture coordinates from the position (compact layout) */
+
+  #define texcoord(tx, ty) \
+    t[0] = tx; \
+    t[1] = ty; \
+    t[2] = tx || ty ? 0.36 / r1 : 0;
+
+  #define vertex(x, y, z) \
+    emit(mesh, x, y, z, n, t);
+
+  /* instances are rotated copies of the first tooth */
+
+  for (i = 0; i < mesh->ninstances; i++) {
+    sincosf(i * a1, &mesh->instances[2 * i + 1], &mesh->instances[2 * i]);
+    if (mesh->layout & MESH_FLIP_Y) {
+      mesh->instances[2 * i + 1] = -mesh->instances[2 * i + 1];
+    }
+  }
+
+  for (i = 0; i < teeth / mesh->ninstances; i++) {
+    ai = i * a1;
+    for (j = 0; j < 5; j++) {
+      sincosf(ai + j * da, &s[j], &c[j]);
+    }
+
+    /* front face begin */
+    mesh->strips[k].begin = mesh->nvertices;
+    /* front face normal */
+    normal(0, 0, 1);
+    /* front face vertices */
+    texcoord(0.36 * r2 * s[1] / r1 + 0.5, 0.36 * r2 * c[1] / r1 + 0.5);
+    vertex(r2 * c[1], r2 * s[1], width / 2);
+    texcoord(0.36 * r2 * s[2] / r1 + 0.5, 0.36 * r2 * c[2] / r1 + 0.5);
+    vertex(r2 * c[2], r2 * s[2], width / 2);
+    texcoord(0.36 * r1 * s[0] / r1 + 0.5, 0.36 * r1 * c[0] / r1 + 0.5);
+    vertex(r1 * c[0], r1 * s[0], width / 2);
+    texcoord(0.36 * r1 * s[3] / r1 + 0.5, 0.36 * r1 * c[3] / r1 + 0.5);
+    vertex(r1 * c[3], r1 * s[3], width / 2);
+    texcoord(0.36 * r0 * s[0] / r1 + 0.5, 0.36 * r0 * c[0] / r1 + 0.5);
+    vertex(r0 * c[0], r0 * s[0], width / 2);
+    texcoord(0.36 * r1 * s[4] / r1 + 0.5, 0.36 * r1 * c[4] / r1 + 0.5);
+    vertex(r1 * c[4], r1 * s[4], width / 2);
+    texcoord(0.36 * r0 * s[4] / r1 + 0.5, 0.36 * r0 * c[4] / r1 + 0.5);
+    vertex(r0 * c[4], r0 * s[4], width / 2);
+    texcoord(0, 0);
+    /* front face end */
+    mesh->strips[k].count = 7;
+    k++;
+
+    /* back face begin */
+    mesh->strips[k].begin = mesh->nvertices;
+    /* back face normal */
+    normal(0, 0, -1);
+    /* back face vertices */
+    vertex(r2 * c[1], r2 * s[1], -width / 2);
+    vertex(r2 * c[2], r2 * s[2], -width / 2);
+    vertex(r1 * c[0], r1 * s[0], -width / 2);
+    vertex(r1 * c[3], r1 * s[3], -width / 2);
+    vertex(r0 * c[0], r0 * s[0], -width / 2);
+    vertex(r1 * c[4], r1 * s[4], -width / 2);
+    vertex(r0 * c[4], r0 * s[4], -width / 2);
+    /* back face end */
+    mesh->strips[k].count = 7;
+    k++;
+
+    /* first outward face begin */
+    mesh->strips[k].begin = mesh->nvertices;
+    /* first outward face normal */
+    normal(r2 * s[1] - r1 * s[0], r1 * c[0] - r2 * c[1], 0);
+    /* first outward face vertices */
+    vertex(r1 * c[0], r1 * s[0],  width / 2);
+    vertex(r1 * c[0], r1 * s[0], -width / 2);
+    vertex(r2 * c[1], r2 * s[1],  width / 2);
+    vertex(r2 * c[1], r2 * s[1], -width / 2);
+    /* first outward face end */
+    mesh->strips[k].count = 4;
+    k++;
+
+    /* second outward face begin */
+    mesh->strips[k].begin = mesh->nvertices;
+    /* second outward face normal */
+    normal(s[2] - s[1], c[1] - c[2], 0);
+    /* second outward face vertices */
+    vertex(r2 * c[1], r2 * s[1],  width / 2);
+    vertex(r2 * c[1], r2 * s[1], -width / 2);
+    vertex(r2 * c[2], r2 * s[2],  width / 2);
+    vertex(r2 * c[2], r2 * s[2], -width / 2);
+    /* second outward face end */
+    mesh->strips[k].count = 4;
+    k++;
+
+    /* third outward face begin */
+    mesh->strips[k].begin = mesh->nvertices;
+    /* third outward face normal */
+    normal(r1 * s[3] - r2 * s[2], r2 * c[2] - r1 * c[3], 0);
+    /* third outward face vertices */
+    vertex(r2 * c[2], r2 * s[2],  width / 2);
+    vertex(r2 * c[2], r2 * s[2], -width / 2);
+    vertex(r1 * c[3], r1 * s[3],  width / 2);
+    vertex(r1 * c[3], r1 * s[3], -width / 2);
+    /* third outward face end */
+    mesh->strips[k].count = 4;
+    k++;
+
+    /* fourth outward face begin */
+    mesh->strips[k].begin = mesh->nvertices;
+    /* fourth outward face normal */
+    normal(s[4] - s[3], c[3] - c[4], 0);
+    /* fourth outward face vertices */
+    vertex(r1 * c[3], r1 * s[3],  width / 2);
+    vertex(r1 * c[3], r1 * s[3], -width / 2);
+    vertex(r1 * c[4], r1 * s[4],  width / 2);
+    vertex(r1 * c[4], r1 * s[4], -width / 2);
+    /* fourth outward face end */
+    mesh->strips[k].count = 4;
+    k++;
+
+    /* inside face begin */
+    mesh->strips[k].begin = mesh->nvertices;
+    /* inside face normal */
+    normal(s[0] - s[4], c[4] - c[0], 0);
+    /* inside face vertices */
+    vertex(r0 * c[0], r0 * s[0],  width / 2);
+    vertex(r0 * c[0], r0 * s[0], -width / 2);
+    vertex(r0 * c[4], r0 * s[4],  width / 2);
+    vertex(r0 * c[4], r0 * s[4], -width / 2);
+    /* inside face end */
+    mesh->strips[k].count = 4;
+    k++;
+  }
+
+  /* stitch strips into a triangle list drawn with a single call */
+
+  if (mesh->layout & MESH_INDEXED) {
+    for (k = 0; k < mesh->nstrips; k++) {
+      for (j = 0; j < mesh->strips[k].count - 2; j++) {
+        /* odd triangles of a strip have their first two vertices swapped to keep the winding */
+        mesh->indices[mesh->nindices++] = mesh->strips[k].begin + j + (j & 1);
+        mesh->indices[mesh->nindices++] = mesh->strips[k].begin + j + 1 - (j & 1);
+        mesh->indices[mesh->nindices++] = mesh->strips[k].begin + j + 2;
+      }
+    }
+  }
+}
+
+const mesh_t *mesh_get(float inner, float outer, float width, int teeth, float tooth_depth, int layout)
+{
+  struct mesh_entry *mesh_entry = NULL;
+  struct list *entry = NULL;
+
+  LIST_FOR_EACH(entry, &mesh_list) {
+    mesh_entry = LIST_ENTRY(entry, struct mesh_entry, entry);
+    if (mesh_entry->inner == inner && mesh_entry->outer == outer && mesh_entry->width == width && mesh_entry->teeth == teeth && mesh_entry->tooth_depth == tooth_depth && mesh_entry->mesh.layout == layout) {
+      return &mesh_entry->mesh;
+    }
+  }
+
+  if (layout & MESH_INDEXED && MESH_NVERTICES(teeth / MESH_NINSTANCES(teeth, layout)) > 65536) {
+    printf("too many vertices for indexed geometry\n");
+    return NULL;
+  }
+
+  mesh_entry = calloc(1, sizeof(struct mesh_entry));
+  if (!mesh_entry) {
+    printf("calloc mesh_entry failed\n");
+    return NULL;
+  }
+
+  mesh_entry->mesh.layout = layout;
+
+  mesh_entry->mesh.vertices = calloc(MESH_NVERTICES(teeth / MESH_NINSTANCES(teeth, layout)), mesh_stride(layout));
+  if (!mesh_entry->mesh.vertices) {
+    printf("calloc vertices failed\n");
+    goto out;
+  }
+
+  mesh_entry->mesh.strips = calloc(MESH_NSTRIPS(teeth / MESH_NINSTANCES(teeth, layout)), sizeof(Strip));
+  if (!mesh_entry->mesh.strips) {
+    printf("calloc strips failed\n");
+    goto out;
+  }
+
+  if (layout & MESH_INDEXED) {
+    mesh_entry->mesh.indices = calloc(MESH_NINDICES(teeth / MESH_NINSTANCES(teeth, layout)), sizeof(unsigned short));
+    if (!mesh_entry->mesh.indices) {
+      printf("calloc indices failed\n");
+      goto out;
+    }
+  }
+
+  mesh_entry->mesh.instances = calloc(MESH_NINSTANCES(teeth, layout), 2 * sizeof(float));
+  if (!mesh_entry->mesh.instances) {
+    printf("calloc instances failed\n");
+    goto out;
+  }
+
+  mesh_tessellate(&mesh_entry->mesh, inner, outer, width, teeth, tooth_depth);
+
+  mesh_entry->inner = inner;
+  mesh_entry->outer = outer;
+  mesh_entry->width = width;
+  mesh_entry->teeth = teeth;
+  mesh_entry->tooth_depth = tooth_depth;
+  list_add(&mesh_entry->entry, &mesh_list);
+
+  return &mesh_entry->mesh;
+
+out:
+  free(mesh_entry->mesh.instances);
+  free(mesh_entry->mesh.indices);
+  free(mesh_entry->mesh.strips);
+  free(mesh_entry->mesh.vertices);
+  free(mesh_entry);
+  return NULL;
+}
+
+static void __attribute__((destructor)) mesh_cache_free(void)
+{
+  struct mesh_entry *mesh_entry = NULL;
+  struct list *entry = mesh_list.next;
+
+  while (entry != &mesh_list) {
+    mesh_entry = LIST_ENTRY(entry, struct mesh_entry, entry);
+    entry = entry->next;
+    free(mesh_entry->mesh.instances);
+    free(mesh_entry->mesh.indices);
+    free(mesh_entry->mesh.strips);
+    free(mesh_entry->mesh.vertices);
+    free(mesh_entry);
+  }
+}
@@ -0,0 +1,77 @@
+/*
+  yagears                  Yet Another Gears OpenGL / Vulkan demo
+  Copyright (C) 2013-2024  Nicolas Caramelli
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef MESH_H
+#define MESH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* vertex layout: position (3 floats), followed by optional attributes */
+
+#define MESH_NORMAL   0x1 /* normal (3 floats) */
+#define MESH_TEXCOORD 0x2 /* texture coordinates (2 floats) */
+#define MESH_FLIP_Y   0x4 /* y axis pointing down (Vulkan) */
+#define MESH_INDEXED  0x8 /* strips stitched into a triangle list */
+#define MESH_COMPACT  0x10 /* half float position with texture scale in w (4 half floats),
+                             normal packed in 2_10_10_10 unsigned normalized (1 int),
+                             texture coordinates computed from the position */
+#define MESH_INSTANCED 0x20 /* a single tooth, drawn once per instance rotation */
+
+#define MESH_NVERTICES(teeth) (34 * (teeth))
+#define MESH_NSTRIPS(teeth)   (7 * (teeth))
+#define MESH_NINDICES(teeth)  (60 * (teeth))
+
+#define MESH_NINSTANCES(teeth, layout) ((layout) & MESH_INSTANCED ? (teeth) : 1)
+
+typedef struct {
+  int begin;
+  int count;
+} Strip;
+
+typedef struct {
+  int layout;
+  int stride;
+  int nvertices;
+  void *vertices;
+  int nstrips;
+  Strip *strips;
+  int nindices;
+  unsigned short *indices;
+  int ninstances;
+  float *instances; /* rotation of each instance (cos, sin) */
+} mesh_t;
+
+/* mesh_tessellate() fills the vertices, strips, indices and instances buffers
+   provided by the caller, mesh_get() returns a mesh shared through a cache */
+
+int mesh_stride(int layout);
+void mesh_tessellate(mesh_t *mesh, float inner, float outer, float width, int teeth, float tooth_depth);
+const mesh_t *mesh_get(float inner, float outer, float width, int teeth, float tooth_depth, int layout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -33,12 +33,16 @@ void *glutGetWindowData();
 void glutLeaveMainLoop();
 void glutExit();
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "bench.h"
 #include "gears_engine.h"
+#include "options.h"
 
 #if !defined(ENGINE_CTOR) && defined(YAGEARS_ENGINE)
 #define stringify_engine_ctor(name)       name##_engine_ctor()
@@ -60,40 +64,45 @@ engine_ctor_proto(YAGEARS_ENGINE);
 /******************************************************************************/
 
 static gears_engine_t *gears_engine[COLS * ROWS];
+static scene_t *scene = NULL;
+static bench_t *bench = NULL;
 
-static int loop = 0, animate = 1, t_rate = 0, t_rot = 0, frames = 0, win_width = 0, win_height = 0, win_posx = 0, win_posy = 0;
+static int loop = 0, animate = 1, frames = 0, win_width = 0, win_height = 0, win_posx = 0, win_posy = 0, nb_gears = 3;
+static uint64_t t_rate = 0, t_rot = 0;
 static float fps = 0, view_tz[COLS * ROWS], view_rx[COLS * ROWS], view_ry[COLS * ROWS], model_rz[COLS * ROWS];
 
 /******************************************************************************/
 
-static int current_time()
+static uint64_t current_time()
 {
-  struct timeval tv;
+  struct timespec ts;
 
-  gettimeofday(&tv, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &ts);
 
-  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
 /******************************************************************************/
 
 static void rotate(int n)
 {
-  int t;
+  uint64_t t;
 
   t = current_time();
 
-  if (t - t_rate >= 2000) {
+  if (t - t_rate >= 2000000000) {
     loop++;
-    fps += frames * 1000.0 / (t - t_rate);
+    fps += frames * 1000000000.0 / (t - t_rate);
     t_rate = t;
     frames = 0;
   }
 
-  model_rz[n] += 15 * (t - t_rot) / 1000.0;
+  model_rz[n] += 15 * (t - t_rot) / 1000000000.0;
   model_rz[n] = fmod(model_rz[n], 360);
 
   t_rot = t;
+
+  if (bench) bench_frame(bench, t);
 }
 
 /******************************************************************************/
@@ -110,6 +119,12 @@ static void glutDisplay()
 
 static void glutIdle()
 {
+  if (bench_done(bench)) {
+    glutIdleFunc(NULL);
+    glutLeaveMainLoop();
+    return;
+  }
+
   if (animate) {
     if (!frames) return;
     glutPostRedisplay();
@@ -178,9 +193,26 @@ static void glutPassiveMotion(int x, int y)
 int main(int argc, char *argv[])
 {
   const char *engine_arg = NULL;
-  int opt, i, j;
+  int err, opt, i, j;
   int glut_win[COLS * ROWS];
 
+  /* process environment and command line */
+
+  options_init();
+
+  while ((opt = getopt(argc, argv, "o:h")) != -1) {
+    switch (opt) {
+      case 'o':
+        if (options_set(optarg) == -1) {
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'h':
+      default:
+        break;
+    }
+  }
+
   #if !defined(ENGINE_CTOR) && defined(YAGEARS_ENGINE)
   engine_ctor(YAGEARS_ENGINE);
   #endif
@@ -191,17 +223,22 @@ int main(int argc, char *argv[])
   }
   else
   #endif
-  if (argc != 2 || !strcmp(argv[1], "-h")) {
-    printf("\n\tUsage: %s Engine\n\n", argv[0]);
+  if (optind != argc - 1) {
+    printf("\n\tUsage: %s [-o Option[=Value]]... Engine\n\n", argv[0]);
     printf("\t\tEngines: ");
     for (opt = 0; opt < gears_engine_nb(); opt++) {
       printf("%s ", gears_engine_name(opt));
     }
     printf("\n\n");
+    printf("\t\tOptions: ");
+    for (opt = 0; opt < options_nb(); opt++) {
+      printf("%s ", options_name(opt));
+    }
+    printf("\n\n");
     return EXIT_FAILURE;
   }
   else
-    engine_arg = argv[1];
+    engine_arg = argv[optind];
 
   for (opt = 0; opt < gears_engine_nb(); opt++) {
     if (!strcmp(gears_engine_name(opt), engine_arg))
@@ -209,7 +246,18 @@ int main(int argc, char *argv[])
   }
 
   if (opt == gears_engine_nb()) {
-    printf("%s: Engine unknown\n", argv[1]);
+    printf("%s: Engine unknown\n", engine_arg);
+    return EXIT_FAILURE;
+  }
+
+  /* scene */
+
+  if (options.gears) {
+    nb_gears = options.gears;
+  }
+
+  scene = scene_new(nb_gears);
+  if (!scene) {
     return EXIT_FAILURE;
   }
 
@@ -240,7 +288,7 @@ int main(int argc, char *argv[])
       view_rx[i * COLS + j] = 20.0;
       view_ry[i * COLS + j] = 30.0;
       model_rz[i * COLS + j] = 210.0;
-      gears_engine_init(gears_engine[i * COLS + j], win_width / COLS, win_height / ROWS);
+      gears_engine_init(gears_engine[i * COLS + j], win_width / COLS, win_height / ROWS, scene);
       win_posx += win_width / COLS;
     }
     win_posx = 0;
@@ -249,7 +297,13 @@ int main(int argc, char *argv[])
 
   /* drawing (main event loop) */
 
-  if (getenv("NO_ANIM")) {
+  if (bench_enabled()) {
+    bench = bench_new("yagears2-mosaic", engine_arg, "glut", win_width / COLS, win_height / ROWS, scene->nb, gears_engine_driver(gears_engine[0]));
+    if (!bench) {
+      return EXIT_FAILURE;
+    }
+  }
+  else if (options.no_anim) {
     animate = 0;
   }
 
@@ -274,5 +328,15 @@ int main(int argc, char *argv[])
 
   glutExit();
 
+  scene_free(scene);
+
+  if (bench) {
+    err = bench_report(bench);
+    bench_free(bench);
+    if (err == -1) {
+      return EXIT_FAILURE;
+    }
+  }
+
   return EXIT_SUCCESS;
 }
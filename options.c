@@ -0,0 +1,160 @@
+/*
+  yagears                  Yet Another Gears OpenGL / Vulkan demo
+  Copyright (C) 2013-2024  Nicolas Caramelli
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "options.h"
+
+options_t options = {
+  .framebuffer = "/dev/fb0",
+  .dricard = "/dev/dri/card0",
+  .frames_in_flight = 2
+};
+
+/******************************************************************************/
+
+enum {
+  OPTION_FLAG,
+  OPTION_INT,
+  OPTION_STRING
+};
+
+static const struct {
+  char *name;
+  int type;
+  size_t offset;
+} option_desc[] = {
+  { "WIDTH",               OPTION_INT,    offsetof(options_t, width)               },
+  { "HEIGHT",              OPTION_INT,    offsetof(options_t, height)              },
+  { "POSX",                OPTION_INT,    offsetof(options_t, posx)                },
+  { "POSY",                OPTION_INT,    offsetof(options_t, posy)                },
+  { "GEARS",               OPTION_INT,    offsetof(options_t, gears)               },
+  { "NO_ANIM",             OPTION_FLAG,   offsetof(options_t, no_anim)             },
+  { "NO_TEXTURE",          OPTION_FLAG,   offsetof(options_t, no_texture)          },
+  { "TEXTURE",             OPTION_STRING, offsetof(options_t, texture)             },
+  { "INDEXED",             OPTION_FLAG,   offsetof(options_t, indexed)             },
+  { "COMPACT",             OPTION_FLAG,   offsetof(options_t, compact)             },
+  { "INSTANCED",           OPTION_FLAG,   offsetof(options_t, instanced)           },
+  { "DSCAPS_GL",           OPTION_FLAG,   offsetof(options_t, dscaps_gl)           },
+  { "NO_GBM",              OPTION_FLAG,   offsetof(options_t, no_gbm)              },
+  { "NO_WL_EGL_WINDOW",    OPTION_FLAG,   offsetof(options_t, no_wl_egl_window)    },
+  { "NO_EGL_EXT_PLATFORM", OPTION_FLAG,   offsetof(options_t, no_egl_ext_platform) },
+  { "PLATFORM",            OPTION_INT,    offsetof(options_t, platform)            },
+  { "KEYBOARD",            OPTION_STRING, offsetof(options_t, keyboard)            },
+  { "FRAMEBUFFER",         OPTION_STRING, offsetof(options_t, framebuffer)         },
+  { "DRICARD",             OPTION_STRING, offsetof(options_t, dricard)             },
+  { "DRI_DRIVER",          OPTION_STRING, offsetof(options_t, dri_driver)          },
+  { "BENCH_WARMUP",        OPTION_INT,    offsetof(options_t, bench_warmup)        },
+  { "BENCH_FRAMES",        OPTION_INT,    offsetof(options_t, bench_frames)        },
+  { "BENCH_DURATION",      OPTION_INT,    offsetof(options_t, bench_duration)      },
+  { "BENCH_OUTPUT",        OPTION_STRING, offsetof(options_t, bench_output)        },
+  { "BENCH_FORMAT",        OPTION_STRING, offsetof(options_t, bench_format)        },
+  { "READBACK",            OPTION_STRING, offsetof(options_t, readback)            },
+  { "FRAMES_IN_FLIGHT",    OPTION_INT,    offsetof(options_t, frames_in_flight)    },
+  { "PIPELINE_CACHE",      OPTION_STRING, offsetof(options_t, pipeline_cache)      },
+  { "PROGRAM_CACHE",       OPTION_STRING, offsetof(options_t, program_cache)       },
+  { "RECORD_THREADS",      OPTION_INT,    offsetof(options_t, record_threads)      },
+  { "GPU_TIMESTAMPS",      OPTION_FLAG,   offsetof(options_t, gpu_timestamps)      },
+  { "PIPELINE_STATISTICS", OPTION_FLAG,   offsetof(options_t, pipeline_statistics) },
+  { "PGL_THREADS",         OPTION_INT,    offsetof(options_t, pgl_threads)         },
+  { NULL }
+};
+
+static void option_store(int opt, char *value)
+{
+  void *field = (char *)&options + option_desc[opt].offset;
+
+  if (option_desc[opt].type == OPTION_STRING) {
+    *(char **)field = value;
+  }
+  else {
+    *(int *)field = atoi(value);
+  }
+}
+
+/******************************************************************************/
+
+void options_init()
+{
+  int opt;
+  char *value = NULL;
+
+  for (opt = 0; option_desc[opt].name; opt++) {
+    value = getenv(option_desc[opt].name);
+    if (value) {
+      /* a flag is set as soon as the variable is defined, whatever its value */
+      option_store(opt, option_desc[opt].type == OPTION_FLAG ? "1" : value);
+    }
+  }
+}
+
+int options_set(const char *arg)
+{
+  int opt;
+  size_t len;
+  char *value = NULL;
+
+  value = strchr(arg, '=');
+  len = value ? (size_t)(value - arg) : strlen(arg);
+
+  for (opt = 0; option_desc[opt].name; opt++) {
+    if (strlen(option_desc[opt].name) == len && !strncmp(option_desc[opt].name, arg, len))
+      break;
+  }
+
+  if (!option_desc[opt].name) {
+    printf("%.*s: Option unknown\n", (int)len, arg);
+    return -1;
+  }
+
+  if (value) {
+    value++;
+  }
+  else if (option_desc[opt].type == OPTION_FLAG) {
+    value = "1";
+  }
+  else {
+    printf("%s: Option value missing\n", option_desc[opt].name);
+    return -1;
+  }
+
+  option_store(opt, value);
+
+  return 0;
+}
+
+int options_nb()
+{
+  return sizeof(option_desc) / sizeof(option_desc[0]) - 1;
+}
+
+char *options_name(int opt)
+{
+  if (opt < 0 || opt >= options_nb()) {
+    return NULL;
+  }
+
+  return option_desc[opt].name;
+}
@@ -0,0 +1,83 @@
+/*
+  yagears                  Yet Another Gears OpenGL / Vulkan demo
+  Copyright (C) 2013-2024  Nicolas Caramelli
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* runtime options, named after the environment variables they are read from */
+
+typedef struct {
+  int width;                /* WIDTH */
+  int height;               /* HEIGHT */
+  int posx;                 /* POSX */
+  int posy;                 /* POSY */
+  int gears;                /* GEARS */
+  int no_anim;              /* NO_ANIM */
+  int no_texture;           /* NO_TEXTURE */
+  char *texture;            /* TEXTURE */
+  int indexed;              /* INDEXED */
+  int compact;              /* COMPACT */
+  int instanced;            /* INSTANCED */
+  int dscaps_gl;            /* DSCAPS_GL */
+  int no_gbm;               /* NO_GBM */
+  int no_wl_egl_window;     /* NO_WL_EGL_WINDOW */
+  int no_egl_ext_platform;  /* NO_EGL_EXT_PLATFORM */
+  int platform;             /* PLATFORM */
+  char *keyboard;           /* KEYBOARD */
+  char *framebuffer;        /* FRAMEBUFFER */
+  char *dricard;            /* DRICARD */
+  char *dri_driver;         /* DRI_DRIVER */
+  int bench_warmup;         /* BENCH_WARMUP */
+  int bench_frames;         /* BENCH_FRAMES */
+  int bench_duration;       /* BENCH_DURATION */
+  char *bench_output;       /* BENCH_OUTPUT */
+  char *bench_format;       /* BENCH_FORMAT */
+  char *readback;           /* READBACK */
+  int frames_in_flight;     /* FRAMES_IN_FLIGHT */
+  char *pipeline_cache;     /* PIPELINE_CACHE */
+  char *program_cache;      /* PROGRAM_CACHE */
+  int record_threads;       /* RECORD_THREADS */
+  int gpu_timestamps;       /* GPU_TIMESTAMPS */
+  int pipeline_statistics;  /* PIPELINE_STATISTICS */
+  int pgl_threads;          /* PGL_THREADS */
+} options_t;
+
+extern options_t options;
+
+/* options_init() reads the environment once at startup, options_set() then
+   overrides an option from the command line with a NAME[=VALUE] argument */
+
+void options_init(void);
+int options_set(const char *arg);
+int options_nb(void);
+char *options_name(int opt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -22,119 +22,297 @@
 */
 
 #include PGL_H
+#include <math.h>
+#include <pthread.h>
 #include "engine.h"
+#include "image_loader.h"
+#include "mat4.h"
+#include "mesh.h"
+#include "options.h"
 
 extern struct list engine_list;
 
-static void identity(float *a)
+/******************************************************************************/
+
+/* the texture is stored in blocks of 4x4 texels of 64 bytes, aligned on a
+   cache line, so that the 2x2 texels of a bilinear fetch are most of the time
+   read from a single cache line */
+
+#define TEXEL_BLOCK_SHIFT 2
+#define TEXEL_BLOCK       (1 << TEXEL_BLOCK_SHIFT)
+
+struct texture {
+  u32 *texels; /* RGBA bytes */
+  int width;
+  int height;
+  int blocks_x;
+};
+
+typedef struct {
+  vec4 LightPos;
+  mat4 ModelViewProjectionMatrix;
+  mat4 NormalMatrix;
+  vec4 Color;
+  const struct texture *Texture; /* NULL when texturing is disabled */
+} Uniforms;
+
+/* with PGL_THREADS set, the gears are drawn in tiled mode: the vertices are
+   shaded and the triangles are binned per screen tile by the drawing thread,
+   then the tiles are cleared, rasterized and shaded in parallel by a pool of
+   threads, straight into the color buffer and depth buffer of the context */
+
+#define TILE_SIZE   64
+#define MAX_THREADS 16
+#define NB_OUTPUTS  6
+
+#define COLOR_ROW(gears, y)  ((u32 *)((gears)->color_lastrow - (y) * (gears)->color_pitch))
+#define PGL_DEPTH_ROW(y)     ((float *)c->zbuf.lastrow - (y) * (int)c->zbuf.w)
+#define PGL_PACK(r, g, b, a) ((u32)(a) << c->Ashift | (u32)(r) << c->Rshift | (u32)(g) << c->Gshift | (u32)(b) << c->Bshift)
+
+#define COLOR_BYTE(f) ((f) <= 0 ? 0 : (f) >= 1 ? 255 : (u32)((f) * 255 + 0.5))
+
+/* the vertices are shaded 4 at a time in tiled mode, from attributes stored
+   as structure of arrays: positions x, y, z, normals x, y, z then texture
+   coordinates s, t */
+
+#define NB_ATTRIBS 8
+
+#define NB_LANES 4
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+typedef __m128 simd4;
+
+#define simd4_load(p)     _mm_loadu_ps(p)
+#define simd4_store(p, v) _mm_storeu_ps(p, v)
+#define simd4_set1(f)     _mm_set1_ps(f)
+#define simd4_add(a, b)   _mm_add_ps(a, b)
+#define simd4_mul(a, b)   _mm_mul_ps(a, b)
+#define simd4_div(a, b)   _mm_div_ps(a, b)
+#define simd4_max(a, b)   _mm_max_ps(a, b)
+#define simd4_sqrt(a)     _mm_sqrt_ps(a)
+
+/* the 4 bytes of a texel widened to 4 floats */
+static inline simd4 simd4_texel(u32 t)
 {
-  float m[16] = {
-    1, 0, 0, 0,
-    0, 1, 0, 0,
-    0, 0, 1, 0,
-    0, 0, 0, 1,
-  };
+  __m128i zero = _mm_setzero_si128();
 
-  memcpy(a, m, sizeof(m));
+  return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(t), zero), zero));
 }
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+
+typedef float32x4_t simd4;
+
+#define simd4_load(p)     vld1q_f32(p)
+#define simd4_store(p, v) vst1q_f32(p, v)
+#define simd4_set1(f)     vdupq_n_f32(f)
+#define simd4_add(a, b)   vaddq_f32(a, b)
+#define simd4_mul(a, b)   vmulq_f32(a, b)
+#define simd4_max(a, b)   vmaxq_f32(a, b)
+#define simd4_texel(t)    vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vcreate_u8(t)))))
+#if defined(__aarch64__)
+#define simd4_div(a, b)   vdivq_f32(a, b)
+#define simd4_sqrt(a)     vsqrtq_f32(a)
+#else
+/* no division nor square root on 32-bit NEON: estimates refined by Newton-Raphson steps */
+static inline simd4 simd4_div(simd4 a, simd4 b)
+{
+  simd4 r = vrecpeq_f32(b);
 
-static void multiply(float *a, const float *b)
+  r = vmulq_f32(r, vrecpsq_f32(b, r));
+  r = vmulq_f32(r, vrecpsq_f32(b, r));
+  return vmulq_f32(a, r);
+}
+
+static inline simd4 simd4_sqrt(simd4 a)
 {
-  float m[16];
-  int i, j;
-  div_t d;
+  simd4 r = vrsqrteq_f32(a);
 
-  for (i = 0; i < 16; i++) {
-    m[i] = 0;
-    d = div(i, 4);
-    for (j = 0; j < 4; j++)
-      m[i] += (a + d.rem)[j * 4] * (b + d.quot * 4)[j];
-  }
+  r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+  r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+  return vmulq_f32(a, r);
+}
+#endif
+#else
+typedef struct {
+  float v[4];
+} simd4;
+
+static inline simd4 simd4_load(const float *p)
+{
+  simd4 r = { { p[0], p[1], p[2], p[3] } };
+  return r;
+}
 
-  memcpy(a, m, sizeof(m));
+static inline void simd4_store(float *p, simd4 a)
+{
+  memcpy(p, a.v, sizeof(a.v));
+}
+
+static inline simd4 simd4_set1(float f)
+{
+  simd4 r = { { f, f, f, f } };
+  return r;
 }
 
-static void translate(float *a, float tx, float ty, float tz)
+static inline simd4 simd4_add(simd4 a, simd4 b)
 {
-  float m[16] = {
-     1,  0,  0, 0,
-     0,  1,  0, 0,
-     0,  0,  1, 0,
-    tx, ty, tz, 1
-  };
+  simd4 r = { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+  return r;
+}
 
-  multiply(a, m);
+static inline simd4 simd4_mul(simd4 a, simd4 b)
+{
+  simd4 r = { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } };
+  return r;
 }
 
-static void rotate(float *a, float r, float ux, float uy, float uz)
+static inline simd4 simd4_div(simd4 a, simd4 b)
 {
-  float s, c;
+  simd4 r = { { a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3] } };
+  return r;
+}
 
-  sincosf(r * M_PI / 180, &s, &c);
+static inline simd4 simd4_max(simd4 a, simd4 b)
+{
+  simd4 r = { { MAX(a.v[0], b.v[0]), MAX(a.v[1], b.v[1]), MAX(a.v[2], b.v[2]), MAX(a.v[3], b.v[3]) } };
+  return r;
+}
 
-  float m[16] = {
-         ux * ux * (1 - c) + c, uy * ux * (1 - c) + uz * s, ux * uz * (1 - c) - uy * s, 0,
-    ux * uy * (1 - c) - uz * s,      uy * uy * (1 - c) + c, uy * uz * (1 - c) + ux * s, 0,
-    ux * uz * (1 - c) + uy * s, uy * uz * (1 - c) - ux * s,      uz * uz * (1 - c) + c, 0,
-                             0,                          0,                          0, 1
-  };
+static inline simd4 simd4_sqrt(simd4 a)
+{
+  simd4 r = { { sqrtf(a.v[0]), sqrtf(a.v[1]), sqrtf(a.v[2]), sqrtf(a.v[3]) } };
+  return r;
+}
 
-  multiply(a, m);
+static inline simd4 simd4_texel(u32 t)
+{
+  const u8 *b = (const u8 *)&t;
+  simd4 r = { { b[0], b[1], b[2], b[3] } };
+  return r;
 }
+#endif
 
-static void transpose(float *a)
+/* m * (x, y, z, 1) for the row r of the column-major matrix m */
+static inline simd4 simd4_transform(const float *m, int r, simd4 x, simd4 y, simd4 z)
 {
-  float m[16] = {
-    a[0], a[4], a[8],  a[12],
-    a[1], a[5], a[9],  a[13],
-    a[2], a[6], a[10], a[14],
-    a[3], a[7], a[11], a[15]
-  };
+  return simd4_add(simd4_add(simd4_mul(simd4_set1(m[r]), x), simd4_mul(simd4_set1(m[4 + r]), y)), simd4_add(simd4_mul(simd4_set1(m[8 + r]), z), simd4_set1(m[12 + r])));
+}
 
-  memcpy(a, m, sizeof(m));
+static inline int texel_index(const struct texture *texture, int x, int y)
+{
+  return ((y >> TEXEL_BLOCK_SHIFT) * texture->blocks_x + (x >> TEXEL_BLOCK_SHIFT)) << (2 * TEXEL_BLOCK_SHIFT) | (y & (TEXEL_BLOCK - 1)) << TEXEL_BLOCK_SHIFT | (x & (TEXEL_BLOCK - 1));
 }
 
-static void invert(float *a)
+#define texel_fetch(texture, x, y) ((texture)->texels[texel_index(texture, x, y)])
+
+/* bilinear filtering with repeat wrapping (GL_LINEAR and GL_REPEAT): the 4
+   texels are widened to floats and weighted with one RGBA operation each */
+static inline vec4 texture_sample(const struct texture *texture, float s, float t)
 {
-  float m[16] = {
-         1,      0,      0, 0,
-         0,      1,      0, 0,
-         0,      0,      1, 0,
-    -a[12], -a[13], -a[14], 1,
-  };
+  float x = s * texture->width - 0.5, y = t * texture->height - 0.5, fx, fy;
+  int x0, y0, x1, y1;
+  simd4 r;
+  vec4 color;
+
+  x0 = floorf(x);
+  y0 = floorf(y);
+  fx = x - x0;
+  fy = y - y0;
+
+  /* the texture coordinates are almost always in [0, 1], wrapping is rare */
+  if ((unsigned int)x0 >= (unsigned int)texture->width) {
+    x0 %= texture->width;
+    if (x0 < 0) {
+      x0 += texture->width;
+    }
+  }
+  if ((unsigned int)y0 >= (unsigned int)texture->height) {
+    y0 %= texture->height;
+    if (y0 < 0) {
+      y0 += texture->height;
+    }
+  }
+  x1 = x0 + 1 < texture->width ? x0 + 1 : 0;
+  y1 = y0 + 1 < texture->height ? y0 + 1 : 0;
 
-  a[12] = a[13] = a[14] = 0;
-  transpose(a);
+  r = simd4_add(simd4_add(simd4_mul(simd4_texel(texel_fetch(texture, x0, y0)), simd4_set1((1 - fx) * (1 - fy))), simd4_mul(simd4_texel(texel_fetch(texture, x1, y0)), simd4_set1(fx * (1 - fy)))),
+                simd4_add(simd4_mul(simd4_texel(texel_fetch(texture, x0, y1)), simd4_set1((1 - fx) * fy)), simd4_mul(simd4_texel(texel_fetch(texture, x1, y1)), simd4_set1(fx * fy))));
+  simd4_store((float *)&color, simd4_mul(r, simd4_set1(1.0 / 255)));
 
-  multiply(a, m);
+  return color;
 }
 
-/******************************************************************************/
+struct vertex {
+  vec4 position;    /* clip coordinates */
+  float x, y, z, w; /* window coordinates, w is 1 / clip w */
+  float v[NB_OUTPUTS];
+};
 
-#define GEAR0 0
-#define GEAR1 1
-#define GEAR2 2
+struct triangle {
+  int gear;
+  int v[3];
+  int xmin, ymin, xmax, ymax;
+};
 
-typedef float Vertex[6];
+struct tile {
+  int *triangle;
+  int nb_triangles;
+  int size;
+};
 
-typedef struct {
-  int begin;
-  int count;
-} Strip;
+struct worker {
+  gears_t *gears;
+  pthread_t thread;
+  int started;
+  int frame;
+};
 
 struct gear {
-  int nvertices;
-  Vertex *vertices;
-  int nstrips;
-  Strip *strips;
+  const mesh_t *mesh;
   GLuint vbo;
+  GLuint ibo;
+  float *attribs;
+  int nb_attribs;
 };
 
 struct gears {
+  glContext context;
+  int own_context;
+  u8 *back_buffer;
+  u8 *back_lastrow;
   GLuint program;
-  struct gear *gear[3];
+  const scene_t *scene;
+  struct gear **gear;
   float Projection[16];
   float View[16];
+  int width;
+  int height;
+  int nb_threads;
+  struct worker *worker;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  pthread_cond_t done_cond;
+  int frame;
+  int pending;
+  int quit;
+  int next_tile;
+  int tiles_x;
+  int tiles_y;
+  struct tile *tile;
+  Uniforms *uniforms;
+  struct vertex *vertex;
+  int nb_vertices;
+  int size_vertices;
+  struct triangle *triangle;
+  int nb_triangles;
+  int size_triangles;
+  u32 clear_color;
+  u8 *color_lastrow;
+  int color_pitch;
+  struct texture texture;
 };
 
 static void delete_gear(gears_t *gears, int id)
@@ -145,14 +323,14 @@ static void delete_gear(gears_t *gears, int id)
     return;
   }
 
+  if (gear->ibo) {
+    glDeleteBuffers(1, &gear->ibo);
+  }
   if (gear->vbo) {
     glDeleteBuffers(1, &gear->vbo);
   }
-  if (gear->strips) {
-    free(gear->strips);
-  }
-  if (gear->vertices) {
-    free(gear->vertices);
+  if (gear->attribs) {
+    free(gear->attribs);
   }
 
   free(gear);
@@ -163,11 +341,9 @@ static void delete_gear(gears_t *gears, int id)
 static int create_gear(gears_t *gears, int id, float inner, float outer, float width, int teeth, float tooth_depth)
 {
   struct gear *gear;
-  float r0, r1, r2, da, a1, ai, s[5], c[5];
-  int i, j;
-  float n[3];
-  int k = 0;
   GLenum err = GL_NO_ERROR;
+  const float *attrib;
+  int i, k;
 
   gear = calloc(1, sizeof(struct gear));
   if (!gear) {
@@ -177,142 +353,27 @@ static int create_gear(gears_t *gears, int id, float inner, float outer, float w
 
   gears->gear[id] = gear;
 
-  gear->nvertices = 0;
-  gear->vertices = calloc(34 * teeth, sizeof(Vertex));
-  if (!gear->vertices) {
-    printf("calloc vertices failed\n");
+  gear->mesh = mesh_get(inner, outer, width, teeth, tooth_depth, MESH_NORMAL | MESH_TEXCOORD | (options.indexed ? MESH_INDEXED : 0));
+  if (!gear->mesh) {
     goto out;
   }
 
-  gear->nstrips = 7 * teeth;
-  gear->strips = calloc(gear->nstrips, sizeof(Strip));
-  if (!gear->strips) {
-    printf("calloc strips failed\n");
-    goto out;
-  }
+  /* attributes as structure of arrays for the tiled mode, padded to a multiple of the lanes */
+
+  if (options.pgl_threads > 0) {
+    gear->nb_attribs = (gear->mesh->nvertices + NB_LANES - 1) / NB_LANES * NB_LANES;
+    gear->attribs = calloc(NB_ATTRIBS * gear->nb_attribs, sizeof(float));
+    if (!gear->attribs) {
+      printf("calloc attribs failed\n");
+      goto out;
+    }
 
-  r0 = inner;
-  r1 = outer - tooth_depth / 2;
-  r2 = outer + tooth_depth / 2;
-  a1 = 2 * M_PI / teeth;
-  da = a1 / 4;
-
-  #define normal(nx, ny, nz) \
-    n[0] = nx; \
-    n[1] = ny; \
-    n[2] = nz;
-
-  #define vertex(x, y, z) \
-    gear->vertices[gear->nvertices][0] = x; \
-    gear->vertices[gear->nvertices][1] = y; \
-    gear->vertices[gear->nvertices][2] = z; \
-    gear->vertices[gear->nvertices][3] = n[0]; \
-    gear->vertices[gear->nvertices][4] = n[1]; \
-    gear->vertices[gear->nvertices][5] = n[2]; \
-    gear->nvertices++;
-
-  for (i = 0; i < teeth; i++) {
-    ai = i * a1;
-    for (j = 0; j < 5; j++) {
-      sincosf(ai + j * da, &s[j], &c[j]);
-    }
-
-    /* front face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* front face normal */
-    normal(0, 0, 1);
-    /* front face vertices */
-    vertex(r2 * c[1], r2 * s[1], width / 2);
-    vertex(r2 * c[2], r2 * s[2], width / 2);
-    vertex(r1 * c[0], r1 * s[0], width / 2);
-    vertex(r1 * c[3], r1 * s[3], width / 2);
-    vertex(r0 * c[0], r0 * s[0], width / 2);
-    vertex(r1 * c[4], r1 * s[4], width / 2);
-    vertex(r0 * c[4], r0 * s[4], width / 2);
-    /* front face end */
-    gear->strips[k].count = 7;
-    k++;
-
-    /* back face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* back face normal */
-    normal(0, 0, -1);
-    /* back face vertices */
-    vertex(r2 * c[1], r2 * s[1], -width / 2);
-    vertex(r2 * c[2], r2 * s[2], -width / 2);
-    vertex(r1 * c[0], r1 * s[0], -width / 2);
-    vertex(r1 * c[3], r1 * s[3], -width / 2);
-    vertex(r0 * c[0], r0 * s[0], -width / 2);
-    vertex(r1 * c[4], r1 * s[4], -width / 2);
-    vertex(r0 * c[4], r0 * s[4], -width / 2);
-    /* back face end */
-    gear->strips[k].count = 7;
-    k++;
-
-    /* first outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* first outward face normal */
-    normal(r2 * s[1] - r1 * s[0], r1 * c[0] - r2 * c[1], 0);
-    /* first outward face vertices */
-    vertex(r1 * c[0], r1 * s[0],  width / 2);
-    vertex(r1 * c[0], r1 * s[0], -width / 2);
-    vertex(r2 * c[1], r2 * s[1],  width / 2);
-    vertex(r2 * c[1], r2 * s[1], -width / 2);
-    /* first outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* second outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* second outward face normal */
-    normal(s[2] - s[1], c[1] - c[2], 0);
-    /* second outward face vertices */
-    vertex(r2 * c[1], r2 * s[1],  width / 2);
-    vertex(r2 * c[1], r2 * s[1], -width / 2);
-    vertex(r2 * c[2], r2 * s[2],  width / 2);
-    vertex(r2 * c[2], r2 * s[2], -width / 2);
-    /* second outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* third outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* third outward face normal */
-    normal(r1 * s[3] - r2 * s[2], r2 * c[2] - r1 * c[3], 0);
-    /* third outward face vertices */
-    vertex(r2 * c[2], r2 * s[2],  width / 2);
-    vertex(r2 * c[2], r2 * s[2], -width / 2);
-    vertex(r1 * c[3], r1 * s[3],  width / 2);
-    vertex(r1 * c[3], r1 * s[3], -width / 2);
-    /* third outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* fourth outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* fourth outward face normal */
-    normal(s[4] - s[3], c[3] - c[4], 0);
-    /* fourth outward face vertices */
-    vertex(r1 * c[3], r1 * s[3],  width / 2);
-    vertex(r1 * c[3], r1 * s[3], -width / 2);
-    vertex(r1 * c[4], r1 * s[4],  width / 2);
-    vertex(r1 * c[4], r1 * s[4], -width / 2);
-    /* fourth outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* inside face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* inside face normal */
-    normal(s[0] - s[4], c[4] - c[0], 0);
-    /* inside face vertices */
-    vertex(r0 * c[0], r0 * s[0],  width / 2);
-    vertex(r0 * c[0], r0 * s[0], -width / 2);
-    vertex(r0 * c[4], r0 * s[4],  width / 2);
-    vertex(r0 * c[4], r0 * s[4], -width / 2);
-    /* inside face end */
-    gear->strips[k].count = 4;
-    k++;
+    for (i = 0; i < gear->mesh->nvertices; i++) {
+      attrib = (const float *)((const char *)gear->mesh->vertices + i * gear->mesh->stride);
+      for (k = 0; k < NB_ATTRIBS; k++) {
+        gear->attribs[k * gear->nb_attribs + i] = attrib[k];
+      }
+    }
   }
 
   /* vertex buffer object */
@@ -330,13 +391,37 @@ static int create_gear(gears_t *gears, int id, float inner, float outer, float w
     goto out;
   }
 
-  glBufferData(GL_ARRAY_BUFFER, gear->nvertices * sizeof(Vertex), gear->vertices, GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, gear->mesh->nvertices * gear->mesh->stride, gear->mesh->vertices, GL_STATIC_DRAW);
   err = glGetError();
   if (err) {
     printf("glBufferData failed: 0x%x\n", (unsigned int)err);
     goto out;
   }
 
+  /* index buffer object */
+
+  if (gear->mesh->nindices) {
+    glGenBuffers(1, &gear->ibo);
+    if (!gear->ibo) {
+      printf("glGenBuffers failed\n");
+      goto out;
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gear->ibo);
+    err = glGetError();
+    if (err) {
+      printf("glBindBuffer failed: 0x%x\n", (unsigned int)err);
+      goto out;
+    }
+
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, gear->mesh->nindices * sizeof(GLushort), gear->mesh->indices, GL_STATIC_DRAW);
+    err = glGetError();
+    if (err) {
+      printf("glBufferData failed: 0x%x\n", (unsigned int)err);
+      goto out;
+    }
+  }
+
   return 0;
 
 out:
@@ -344,89 +429,186 @@ out:
   return -1;
 }
 
-typedef struct {
-  vec4 LightPos;
-  mat4 ModelViewProjectionMatrix;
-  mat4 NormalMatrix;
-  vec4 Color;
-} Uniforms;
-
-static void draw_gear(gears_t *gears, int id, float model_tx, float model_ty, float model_rz, const float *color)
+static void set_uniforms(gears_t *gears, Uniforms *uniforms, float model_tx, float model_ty, float model_rz, const float *color)
 {
-  struct gear *gear = gears->gear[id];
   const float pos[4] = { 5.0, 5.0, 10.0, 0.0 };
   float ModelView[16], ModelViewProjection[16];
-  Uniforms uniforms;
-  int k;
+  float l;
 
-  if (!gear) {
-    return;
-  }
+  /* the light direction is normalized once per draw instead of once per vertex */
 
-  memcpy(&uniforms.LightPos, pos, sizeof(vec4));
+  l = sqrtf(pos[0] * pos[0] + pos[1] * pos[1] + pos[2] * pos[2]);
+  uniforms->LightPos.x = pos[0] / l;
+  uniforms->LightPos.y = pos[1] / l;
+  uniforms->LightPos.z = pos[2] / l;
+  uniforms->LightPos.w = pos[3];
 
   memcpy(ModelView, gears->View, sizeof(ModelView));
 
-  translate(ModelView, model_tx, model_ty, 0);
-  rotate(ModelView, model_rz, 0, 0, 1);
+  mat4_translate(ModelView, model_tx, model_ty, 0);
+  mat4_rotate_z(ModelView, model_rz);
 
   memcpy(ModelViewProjection, gears->Projection, sizeof(ModelViewProjection));
-  multiply(ModelViewProjection, ModelView);
-  memcpy(&uniforms.ModelViewProjectionMatrix, ModelViewProjection, sizeof(mat4));
+  mat4_multiply(ModelViewProjection, ModelView);
+  memcpy(&uniforms->ModelViewProjectionMatrix, ModelViewProjection, sizeof(mat4));
 
-  invert(ModelView);
-  transpose(ModelView);
-  memcpy(&uniforms.NormalMatrix, ModelView, sizeof(mat4));
+  mat4_rigid_invert(ModelView);
+  mat4_transpose(ModelView);
+  memcpy(&uniforms->NormalMatrix, ModelView, sizeof(mat4));
 
-  memcpy(&uniforms.Color, color, sizeof(vec4));
+  memcpy(&uniforms->Color, color, sizeof(vec4));
+
+  uniforms->Texture = options.no_texture ? NULL : &gears->texture;
+}
+
+static void draw_gear(gears_t *gears, int id, float model_tx, float model_ty, float model_rz, const float *color)
+{
+  struct gear *gear = gears->gear[id];
+  Uniforms uniforms;
+  int k;
+
+  if (!gear) {
+    return;
+  }
+
+  set_uniforms(gears, &uniforms, model_tx, model_ty, model_rz, color);
 
   pglSetUniform(&uniforms);
 
   glBindBuffer(GL_ARRAY_BUFFER, gear->vbo);
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), NULL);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const float *)NULL + 3);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, gear->mesh->stride, NULL);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, gear->mesh->stride, (const float *)NULL + 3);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, gear->mesh->stride, (const float *)NULL + 6);
 
   glEnableVertexAttribArray(0);
   glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
 
-  for (k = 0; k < gear->nstrips; k++) {
-    glDrawArrays(GL_TRIANGLE_STRIP, gear->strips[k].begin, gear->strips[k].count);
+  if (gear->ibo) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gear->ibo);
+    glDrawElements(GL_TRIANGLES, gear->mesh->nindices, GL_UNSIGNED_SHORT, NULL);
+  }
+  else {
+    for (k = 0; k < gear->mesh->nstrips; k++) {
+      glDrawArrays(GL_TRIANGLE_STRIP, gear->mesh->strips[k].begin, gear->mesh->strips[k].count);
+    }
   }
 
+  glDisableVertexAttribArray(2);
   glDisableVertexAttribArray(1);
   glDisableVertexAttribArray(0);
 }
 
+/* copy of the RGBA image in blocks of 4x4 texels, padded to whole blocks */
+static int create_texture(gears_t *gears, const unsigned char *data, int width, int height)
+{
+  struct texture *texture = &gears->texture;
+  int blocks_y, x, y;
+
+  texture->blocks_x = (width + TEXEL_BLOCK - 1) / TEXEL_BLOCK;
+  blocks_y = (height + TEXEL_BLOCK - 1) / TEXEL_BLOCK;
+  if (posix_memalign((void **)&texture->texels, 64, texture->blocks_x * blocks_y * TEXEL_BLOCK * TEXEL_BLOCK * sizeof(u32))) {
+    texture->texels = NULL;
+    printf("posix_memalign texels failed\n");
+    return -1;
+  }
+
+  texture->width = width;
+  texture->height = height;
+
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      memcpy(&texture->texels[texel_index(texture, x, y)], data + (y * width + x) * 4, sizeof(u32));
+    }
+  }
+
+  return 0;
+}
+
 /******************************************************************************/
 
 static void pgl_gears_term(gears_t *gears)
 {
+  int i;
+
   if (!gears) {
     return;
   }
 
-  if (gears->gear[GEAR2]) {
-    delete_gear(gears, GEAR2);
+  if (gears->worker) {
+    pthread_mutex_lock(&gears->mutex);
+    gears->quit = 1;
+    pthread_cond_broadcast(&gears->cond);
+    pthread_mutex_unlock(&gears->mutex);
+    for (i = gears->nb_threads - 2; i >= 0; i--) {
+      if (gears->worker[i].started) {
+        pthread_join(gears->worker[i].thread, NULL);
+      }
+    }
+    free(gears->worker);
+  }
+  if (gears->triangle) {
+    free(gears->triangle);
+  }
+  if (gears->vertex) {
+    free(gears->vertex);
+  }
+  if (gears->uniforms) {
+    free(gears->uniforms);
+  }
+  if (gears->tile) {
+    for (i = gears->tiles_x * gears->tiles_y - 1; i >= 0; i--) {
+      if (gears->tile[i].triangle) {
+        free(gears->tile[i].triangle);
+      }
+    }
+    free(gears->tile);
   }
-  if (gears->gear[GEAR1]) {
-    delete_gear(gears, GEAR1);
+  if (gears->nb_threads) {
+    pthread_cond_destroy(&gears->done_cond);
+    pthread_cond_destroy(&gears->cond);
+    pthread_mutex_destroy(&gears->mutex);
   }
-  if (gears->gear[GEAR0]) {
-    delete_gear(gears, GEAR0);
+
+  if (gears->gear) {
+    for (i = gears->scene->nb - 1; i >= 0; i--) {
+      if (gears->gear[i]) {
+        delete_gear(gears, i);
+      }
+    }
+    free(gears->gear);
   }
   if (gears->program) {
     glDeleteProgram(gears->program);
   }
+  if (gears->texture.texels) {
+    free(gears->texture.texels);
+  }
 
   printf("%s\n", glGetString(GL_VERSION));
 
+  if (gears->back_buffer) {
+    c->back_buffer.buf = gears->back_buffer;
+    c->back_buffer.lastrow = gears->back_lastrow;
+  }
+  if (gears->own_context) {
+    free_glContext(&gears->context);
+    set_glContext(NULL);
+  }
+
   free(gears);
 }
 
+/* vertex attributes */
 #define POSITION 0
 #define NORMAL   1
-#define COLOR    0
+#define TEXCOORD 2
+
+/* vertex shader outputs, as vec4 color then vec2 texture coordinates */
+#define COLOR      0
+#define TEXCOORD_S 4
+#define TEXCOORD_T 5
 
 void vertex_shader(float *vs_output, void *vertex_attribs, Shader_Builtins *builtins, void *uniforms)
 {
@@ -439,21 +621,469 @@ void vertex_shader(float *vs_output, void *vertex_attribs, Shader_Builtins *buil
   vec3 L = { u->LightPos.x, u->LightPos.y, u->LightPos.z };
   vec4 n = mult_mat4_vec4(u->NormalMatrix, a[NORMAL]);
   vec3 N = { n.x, n.y, n.z };
-  float dot = dot_vec3s(norm_vec3(L), norm_vec3(N));
+  float dot = dot_vec3s(L, norm_vec3(N));
   v[COLOR] = add_vec4s(mult_vec4s(u->Color, l), scale_vec4(u->Color, MAX(dot, 0.0)));
+  vs_output[TEXCOORD_S] = a[TEXCOORD].x;
+  vs_output[TEXCOORD_T] = a[TEXCOORD].y;
 }
 
+/* as in the GLES2 engine, the texel replaces the color unless it is transparent */
 void fragment_shader(float *fs_input, Shader_Builtins *builtins, void *uniforms)
 {
   vec4 *v = (vec4 *)fs_input;
+  Uniforms *u = uniforms;
+  vec4 t;
 
   builtins->gl_FragColor = v[COLOR];
+
+  if (u->Texture) {
+    t = texture_sample(u->Texture, fs_input[TEXCOORD_S], fs_input[TEXCOORD_T]);
+    if (t.w != 0) {
+      builtins->gl_FragColor = t;
+    }
+  }
+}
+
+/* tiled mode */
+
+static int vertex_alloc(gears_t *gears)
+{
+  struct vertex *vertex;
+
+  if (gears->nb_vertices == gears->size_vertices) {
+    vertex = realloc(gears->vertex, 2 * gears->size_vertices * sizeof(struct vertex));
+    if (!vertex) {
+      printf("realloc vertex failed\n");
+      return -1;
+    }
+    gears->vertex = vertex;
+    gears->size_vertices *= 2;
+  }
+
+  return gears->nb_vertices++;
+}
+
+static void vertex_project(gears_t *gears, struct vertex *vertex)
+{
+  vertex->w = 1 / vertex->position.w;
+  vertex->x = (vertex->position.x * vertex->w + 1) * 0.5 * gears->width;
+  vertex->y = (vertex->position.y * vertex->w + 1) * 0.5 * gears->height;
+  vertex->z = (vertex->position.z * vertex->w + 1) * 0.5;
 }
 
-static gears_t *pgl_gears_init(int win_width, int win_height)
+/* vertex stage of a gear, returns the index of its first shaded vertex: this
+   is vertex_shader() and the viewport transform computed for NB_LANES vertices
+   at once, with the light direction of the uniforms already normalized */
+static int shade_vertices(gears_t *gears, int id)
+{
+  struct gear *gear = gears->gear[id];
+  const Uniforms *u = &gears->uniforms[id];
+  const float *mvp = (const float *)u->ModelViewProjectionMatrix, *nm = (const float *)u->NormalMatrix;
+  const float *px = gear->attribs, *py = px + gear->nb_attribs, *pz = py + gear->nb_attribs;
+  const float *nx = pz + gear->nb_attribs, *ny = nx + gear->nb_attribs, *nz = ny + gear->nb_attribs;
+  const float *ts = nz + gear->nb_attribs, *tt = ts + gear->nb_attribs;
+  struct vertex *vertex;
+  simd4 x, y, z, cx, cy, cz, cw, tx, ty, tz, iw, dot;
+  float out[9][NB_LANES];
+  int base, i, k;
+
+  while (gears->nb_vertices + gear->nb_attribs > gears->size_vertices) {
+    vertex = realloc(gears->vertex, 2 * gears->size_vertices * sizeof(struct vertex));
+    if (!vertex) {
+      printf("realloc vertex failed\n");
+      return -1;
+    }
+    gears->vertex = vertex;
+    gears->size_vertices *= 2;
+  }
+
+  base = gears->nb_vertices;
+
+  for (i = 0; i < gear->nb_attribs; i += NB_LANES) {
+    x = simd4_load(px + i);
+    y = simd4_load(py + i);
+    z = simd4_load(pz + i);
+    cx = simd4_transform(mvp, 0, x, y, z);
+    cy = simd4_transform(mvp, 1, x, y, z);
+    cz = simd4_transform(mvp, 2, x, y, z);
+    cw = simd4_transform(mvp, 3, x, y, z);
+
+    x = simd4_load(nx + i);
+    y = simd4_load(ny + i);
+    z = simd4_load(nz + i);
+    tx = simd4_transform(nm, 0, x, y, z);
+    ty = simd4_transform(nm, 1, x, y, z);
+    tz = simd4_transform(nm, 2, x, y, z);
+    dot = simd4_add(simd4_add(simd4_mul(simd4_set1(u->LightPos.x), tx), simd4_mul(simd4_set1(u->LightPos.y), ty)), simd4_mul(simd4_set1(u->LightPos.z), tz));
+    dot = simd4_div(dot, simd4_sqrt(simd4_add(simd4_add(simd4_mul(tx, tx), simd4_mul(ty, ty)), simd4_mul(tz, tz))));
+    dot = simd4_max(dot, simd4_set1(0));
+
+    /* window coordinates, only used for the vertices in front of the near plane */
+
+    iw = simd4_div(simd4_set1(1), cw);
+    simd4_store(out[0], cx);
+    simd4_store(out[1], cy);
+    simd4_store(out[2], cz);
+    simd4_store(out[3], cw);
+    simd4_store(out[4], simd4_mul(simd4_add(simd4_mul(cx, iw), simd4_set1(1)), simd4_set1(0.5 * gears->width)));
+    simd4_store(out[5], simd4_mul(simd4_add(simd4_mul(cy, iw), simd4_set1(1)), simd4_set1(0.5 * gears->height)));
+    simd4_store(out[6], simd4_mul(simd4_add(simd4_mul(cz, iw), simd4_set1(1)), simd4_set1(0.5)));
+    simd4_store(out[7], iw);
+    simd4_store(out[8], dot);
+
+    for (k = 0; k < NB_LANES; k++) {
+      vertex = &gears->vertex[base + i + k];
+      vertex->position.x = out[0][k];
+      vertex->position.y = out[1][k];
+      vertex->position.z = out[2][k];
+      vertex->position.w = out[3][k];
+      vertex->x = out[4][k];
+      vertex->y = out[5][k];
+      vertex->z = out[6][k];
+      vertex->w = out[7][k];
+      vertex->v[0] = u->Color.x * (0.2 + out[8][k]);
+      vertex->v[1] = u->Color.y * (0.2 + out[8][k]);
+      vertex->v[2] = u->Color.z * (0.2 + out[8][k]);
+      vertex->v[3] = u->Color.w * (1 + out[8][k]);
+      vertex->v[TEXCOORD_S] = ts[i + k];
+      vertex->v[TEXCOORD_T] = tt[i + k];
+    }
+  }
+
+  gears->nb_vertices += gear->nb_attribs;
+
+  return base;
+}
+
+static void bin_triangle(gears_t *gears, int id, int v0, int v1, int v2)
+{
+  const struct vertex *a = &gears->vertex[v0], *b = &gears->vertex[v1], *d = &gears->vertex[v2];
+  struct triangle *triangle;
+  struct tile *tile;
+  int xmin, ymin, xmax, ymax, tx, ty, *tile_triangle;
+
+  if ((b->x - a->x) * (d->y - a->y) - (b->y - a->y) * (d->x - a->x) == 0) {
+    return;
+  }
+
+  /* pixels whose center is in the bounding box, clamped to the viewport */
+
+  xmin = ceil(fmin(a->x, fmin(b->x, d->x)) - 0.5);
+  ymin = ceil(fmin(a->y, fmin(b->y, d->y)) - 0.5);
+  xmax = floor(fmax(a->x, fmax(b->x, d->x)) - 0.5);
+  ymax = floor(fmax(a->y, fmax(b->y, d->y)) - 0.5);
+  if (xmin < 0) {
+    xmin = 0;
+  }
+  if (ymin < 0) {
+    ymin = 0;
+  }
+  if (xmax > gears->width - 1) {
+    xmax = gears->width - 1;
+  }
+  if (ymax > gears->height - 1) {
+    ymax = gears->height - 1;
+  }
+  if (xmin > xmax || ymin > ymax) {
+    return;
+  }
+
+  if (gears->nb_triangles == gears->size_triangles) {
+    triangle = realloc(gears->triangle, 2 * gears->size_triangles * sizeof(struct triangle));
+    if (!triangle) {
+      printf("realloc triangle failed\n");
+      return;
+    }
+    gears->triangle = triangle;
+    gears->size_triangles *= 2;
+  }
+
+  triangle = &gears->triangle[gears->nb_triangles];
+  triangle->gear = id;
+  triangle->v[0] = v0;
+  triangle->v[1] = v1;
+  triangle->v[2] = v2;
+  triangle->xmin = xmin;
+  triangle->ymin = ymin;
+  triangle->xmax = xmax;
+  triangle->ymax = ymax;
+
+  for (ty = ymin / TILE_SIZE; ty <= ymax / TILE_SIZE; ty++) {
+    for (tx = xmin / TILE_SIZE; tx <= xmax / TILE_SIZE; tx++) {
+      tile = &gears->tile[ty * gears->tiles_x + tx];
+      if (tile->nb_triangles == tile->size) {
+        tile_triangle = realloc(tile->triangle, (tile->size ? 2 * tile->size : 256) * sizeof(int));
+        if (!tile_triangle) {
+          printf("realloc tile failed\n");
+          continue;
+        }
+        tile->triangle = tile_triangle;
+        tile->size = tile->size ? 2 * tile->size : 256;
+      }
+      tile->triangle[tile->nb_triangles++] = gears->nb_triangles;
+    }
+  }
+
+  gears->nb_triangles++;
+}
+
+/* clipping against the near plane (z >= -w), the other planes are handled by
+   the viewport bounds and by the depth range test of the fragments */
+static void add_triangle(gears_t *gears, int id, int v0, int v1, int v2)
+{
+  int v[3], clipped[4], nb_clipped = 0, i, j, k, n;
+  struct vertex *a, *b, *vertex;
+  float d[3], t;
+
+  v[0] = v0;
+  v[1] = v1;
+  v[2] = v2;
+
+  for (i = 0; i < 3; i++) {
+    d[i] = gears->vertex[v[i]].position.z + gears->vertex[v[i]].position.w;
+  }
+
+  if (d[0] >= 0 && d[1] >= 0 && d[2] >= 0) {
+    bin_triangle(gears, id, v0, v1, v2);
+    return;
+  }
+
+  if (d[0] < 0 && d[1] < 0 && d[2] < 0) {
+    return;
+  }
+
+  for (i = 0; i < 3; i++) {
+    j = (i + 1) % 3;
+    if (d[i] >= 0) {
+      clipped[nb_clipped++] = v[i];
+    }
+    if ((d[i] >= 0) != (d[j] >= 0)) {
+      k = vertex_alloc(gears);
+      if (k == -1) {
+        return;
+      }
+      a = &gears->vertex[v[i]];
+      b = &gears->vertex[v[j]];
+      vertex = &gears->vertex[k];
+      t = d[i] / (d[i] - d[j]);
+      vertex->position.x = a->position.x + t * (b->position.x - a->position.x);
+      vertex->position.y = a->position.y + t * (b->position.y - a->position.y);
+      vertex->position.z = a->position.z + t * (b->position.z - a->position.z);
+      vertex->position.w = a->position.w + t * (b->position.w - a->position.w);
+      for (n = 0; n < NB_OUTPUTS; n++) {
+        vertex->v[n] = a->v[n] + t * (b->v[n] - a->v[n]);
+      }
+      vertex_project(gears, vertex);
+      clipped[nb_clipped++] = k;
+    }
+  }
+
+  for (i = 2; i < nb_clipped; i++) {
+    bin_triangle(gears, id, clipped[0], clipped[i - 1], clipped[i]);
+  }
+}
+
+static void draw_triangle(gears_t *gears, const struct triangle *triangle, int x0, int y0, int x1, int y1)
+{
+  const struct vertex *v0 = &gears->vertex[triangle->v[0]], *v1 = &gears->vertex[triangle->v[1]], *v2 = &gears->vertex[triangle->v[2]];
+  float area, A0, B0, C0, A1, B1, C1, A2, B2, C2, w0, w1, w2, z, iw, p0, p1, p2;
+  float fs_input[NB_OUTPUTS];
+  Shader_Builtins builtins;
+  u32 *color;
+  float *depth;
+  int xmin, ymin, xmax, ymax, x, y, k;
+
+  xmin = triangle->xmin > x0 ? triangle->xmin : x0;
+  ymin = triangle->ymin > y0 ? triangle->ymin : y0;
+  xmax = triangle->xmax < x1 ? triangle->xmax : x1;
+  ymax = triangle->ymax < y1 ? triangle->ymax : y1;
+
+  /* edge functions divided by the signed area: they are the barycentric
+     coordinates of the pixel centers, positive inside whatever the winding */
+
+  area = (v1->x - v0->x) * (v2->y - v0->y) - (v1->y - v0->y) * (v2->x - v0->x);
+  A0 = (v1->y - v2->y) / area;
+  B0 = (v2->x - v1->x) / area;
+  C0 = (v1->x * v2->y - v2->x * v1->y) / area;
+  A1 = (v2->y - v0->y) / area;
+  B1 = (v0->x - v2->x) / area;
+  C1 = (v2->x * v0->y - v0->x * v2->y) / area;
+  A2 = (v0->y - v1->y) / area;
+  B2 = (v1->x - v0->x) / area;
+  C2 = (v0->x * v1->y - v1->x * v0->y) / area;
+
+  for (y = ymin; y <= ymax; y++) {
+    color = COLOR_ROW(gears, y);
+    depth = PGL_DEPTH_ROW(y);
+    w0 = A0 * (xmin + 0.5) + B0 * (y + 0.5) + C0;
+    w1 = A1 * (xmin + 0.5) + B1 * (y + 0.5) + C1;
+    w2 = A2 * (xmin + 0.5) + B2 * (y + 0.5) + C2;
+
+    for (x = xmin; x <= xmax; x++, w0 += A0, w1 += A1, w2 += A2) {
+      if (w0 < 0 || w1 < 0 || w2 < 0) {
+        continue;
+      }
+
+      z = w0 * v0->z + w1 * v1->z + w2 * v2->z;
+      if (z < 0 || z > 1 || z >= depth[x]) {
+        continue;
+      }
+
+      /* perspective-correct interpolation of the vertex shader outputs */
+
+      iw = w0 * v0->w + w1 * v1->w + w2 * v2->w;
+      p0 = w0 * v0->w / iw;
+      p1 = w1 * v1->w / iw;
+      p2 = w2 * v2->w / iw;
+      for (k = 0; k < NB_OUTPUTS; k++) {
+        fs_input[k] = p0 * v0->v[k] + p1 * v1->v[k] + p2 * v2->v[k];
+      }
+
+      builtins.gl_FragCoord.x = x + 0.5;
+      builtins.gl_FragCoord.y = y + 0.5;
+      builtins.gl_FragCoord.z = z;
+      builtins.gl_FragCoord.w = iw;
+      fragment_shader(fs_input, &builtins, &gears->uniforms[triangle->gear]);
+
+      depth[x] = z;
+      color[x] = PGL_PACK(COLOR_BYTE(builtins.gl_FragColor.x), COLOR_BYTE(builtins.gl_FragColor.y), COLOR_BYTE(builtins.gl_FragColor.z), COLOR_BYTE(builtins.gl_FragColor.w));
+    }
+  }
+}
+
+static void draw_tile(gears_t *gears, int id)
+{
+  struct tile *tile = &gears->tile[id];
+  int x0, y0, x1, y1, x, y, i;
+  u32 *color;
+  float *depth;
+
+  x0 = id % gears->tiles_x * TILE_SIZE;
+  y0 = id / gears->tiles_x * TILE_SIZE;
+  x1 = x0 + TILE_SIZE < gears->width ? x0 + TILE_SIZE - 1 : gears->width - 1;
+  y1 = y0 + TILE_SIZE < gears->height ? y0 + TILE_SIZE - 1 : gears->height - 1;
+
+  for (y = y0; y <= y1; y++) {
+    color = COLOR_ROW(gears, y);
+    depth = PGL_DEPTH_ROW(y);
+    for (x = x0; x <= x1; x++) {
+      color[x] = gears->clear_color;
+      depth[x] = 1;
+    }
+  }
+
+  for (i = 0; i < tile->nb_triangles; i++) {
+    draw_triangle(gears, &gears->triangle[tile->triangle[i]], x0, y0, x1, y1);
+  }
+}
+
+/* tiles are taken one at a time by the threads until none is left */
+static void draw_tiles(gears_t *gears)
+{
+  int id;
+
+  while ((id = __sync_fetch_and_add(&gears->next_tile, 1)) < gears->tiles_x * gears->tiles_y) {
+    draw_tile(gears, id);
+  }
+}
+
+/* worker thread: draws tiles each time the frame counter is incremented */
+static void *worker_thread(void *arg)
+{
+  struct worker *worker = arg;
+  gears_t *gears = worker->gears;
+  int quit;
+
+  while (1) {
+    pthread_mutex_lock(&gears->mutex);
+    while (worker->frame == gears->frame && !gears->quit) {
+      pthread_cond_wait(&gears->cond, &gears->mutex);
+    }
+    worker->frame = gears->frame;
+    quit = gears->quit;
+    pthread_mutex_unlock(&gears->mutex);
+
+    if (quit) {
+      break;
+    }
+
+    draw_tiles(gears);
+
+    pthread_mutex_lock(&gears->mutex);
+    if (--gears->pending == 0) {
+      pthread_cond_signal(&gears->done_cond);
+    }
+    pthread_mutex_unlock(&gears->mutex);
+  }
+
+  return NULL;
+}
+
+static void draw_tiled(gears_t *gears, float model_rz)
+{
+  const gear_desc_t *gear_desc;
+  const mesh_t *mesh;
+  int base, i, k, n;
+
+  gears->nb_vertices = 0;
+  gears->nb_triangles = 0;
+  for (i = 0; i < gears->tiles_x * gears->tiles_y; i++) {
+    gears->tile[i].nb_triangles = 0;
+  }
+
+  /* vertex stage and binning */
+
+  for (i = 0; i < gears->scene->nb; i++) {
+    gear_desc = &gears->scene->gear[i];
+    set_uniforms(gears, &gears->uniforms[i], gear_desc->tx, gear_desc->ty, gear_desc->ratio * model_rz + gear_desc->phase, gear_desc->color);
+
+    base = shade_vertices(gears, i);
+    if (base == -1) {
+      return;
+    }
+
+    mesh = gears->gear[i]->mesh;
+    if (mesh->nindices) {
+      for (k = 0; k < mesh->nindices; k += 3) {
+        add_triangle(gears, i, base + mesh->indices[k], base + mesh->indices[k + 1], base + mesh->indices[k + 2]);
+      }
+    }
+    else {
+      for (k = 0; k < mesh->nstrips; k++) {
+        for (n = mesh->strips[k].begin; n < mesh->strips[k].begin + mesh->strips[k].count - 2; n++) {
+          add_triangle(gears, i, base + n, base + n + 1, base + n + 2);
+        }
+      }
+    }
+  }
+
+  /* rasterization and fragment stage, the drawing thread takes tiles too */
+
+  gears->next_tile = 0;
+
+  pthread_mutex_lock(&gears->mutex);
+  gears->pending = gears->nb_threads - 1;
+  gears->frame++;
+  pthread_cond_broadcast(&gears->cond);
+  pthread_mutex_unlock(&gears->mutex);
+
+  draw_tiles(gears);
+
+  pthread_mutex_lock(&gears->mutex);
+  while (gears->pending) {
+    pthread_cond_wait(&gears->done_cond, &gears->mutex);
+  }
+  pthread_mutex_unlock(&gears->mutex);
+}
+
+static gears_t *pgl_gears_init(int win_width, int win_height, const scene_t *scene)
 {
   gears_t *gears = NULL;
-  GLenum interpolation[3] = { SMOOTH, SMOOTH, SMOOTH };
+  int i;
+  GLenum interpolation[NB_OUTPUTS] = { SMOOTH, SMOOTH, SMOOTH, SMOOTH, SMOOTH, SMOOTH };
+  u32 *back_buffer = NULL;
+  int texture_width, texture_height;
+  unsigned char *texture_data = NULL;
   const float zNear = 5, zFar = 60;
 
   gears = calloc(1, sizeof(gears_t));
@@ -462,9 +1092,30 @@ static gears_t *pgl_gears_init(int win_width, int win_height)
     return NULL;
   }
 
+  gears->scene = scene;
+
+  gears->gear = calloc(scene->nb, sizeof(struct gear *));
+  if (!gears->gear) {
+    printf("calloc gear failed\n");
+    goto out;
+  }
+
+  /* without a context made current by the backend, the gears are drawn in a
+     context of their own, in XRGB8888 format, retargeted with target() */
+
+  if (!c) {
+    if (!init_glContext(&gears->context, &back_buffer, win_width, win_height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000)) {
+      printf("init_glContext failed\n");
+      goto out;
+    }
+
+    set_glContext(&gears->context);
+    gears->own_context = 1;
+  }
+
   glEnable(GL_DEPTH_TEST);
 
-  gears->program = pglCreateProgram(vertex_shader, fragment_shader, 3, interpolation, GL_FALSE);
+  gears->program = pglCreateProgram(vertex_shader, fragment_shader, NB_OUTPUTS, interpolation, GL_FALSE);
   if (!gears->program) {
     printf("glCreateProgram failed\n");
     goto out;
@@ -478,18 +1129,94 @@ static gears_t *pgl_gears_init(int win_width, int win_height)
 
   glViewport(0, 0, win_width, win_height);
 
-  /* create gears */
+  /* load texture */
 
-  if (create_gear(gears, GEAR0, 1.0, 4.0, 1.0, 20, 0.7)) {
+  image_load(options.texture, NULL, &texture_width, &texture_height);
+
+  texture_data = malloc(texture_width * texture_height * 4);
+  if (!texture_data) {
+    printf("malloc texture_data failed\n");
     goto out;
   }
 
-  if (create_gear(gears, GEAR1, 0.5, 2.0, 2.0, 10, 0.7)) {
+  image_load(options.texture, texture_data, &texture_width, &texture_height);
+
+  if (create_texture(gears, texture_data, texture_width, texture_height)) {
+    free(texture_data);
     goto out;
   }
 
-  if (create_gear(gears, GEAR2, 1.3, 2.0, 0.5, 10, 0.7)) {
-    goto out;
+  free(texture_data);
+
+  /* create gears */
+
+  for (i = 0; i < scene->nb; i++) {
+    if (create_gear(gears, i, scene->gear[i].inner, scene->gear[i].outer, scene->gear[i].width, scene->gear[i].teeth, scene->gear[i].tooth_depth)) {
+      goto out;
+    }
+  }
+
+  /* tiled mode: screen tiles, buffers of the shaded vertices and of the binned triangles, pool of threads */
+
+  if (options.pgl_threads > 0) {
+    gears->nb_threads = options.pgl_threads < MAX_THREADS ? options.pgl_threads : MAX_THREADS;
+    gears->width = win_width;
+    gears->height = win_height;
+    gears->tiles_x = (win_width + TILE_SIZE - 1) / TILE_SIZE;
+    gears->tiles_y = (win_height + TILE_SIZE - 1) / TILE_SIZE;
+    gears->clear_color = PGL_PACK(0, 0, 0, 255);
+    gears->color_lastrow = c->back_buffer.lastrow;
+    gears->color_pitch = c->back_buffer.w * sizeof(u32);
+
+    pthread_mutex_init(&gears->mutex, NULL);
+    pthread_cond_init(&gears->cond, NULL);
+    pthread_cond_init(&gears->done_cond, NULL);
+
+    gears->tile = calloc(gears->tiles_x * gears->tiles_y, sizeof(struct tile));
+    if (!gears->tile) {
+      printf("calloc tile failed\n");
+      goto out;
+    }
+
+    gears->uniforms = calloc(scene->nb, sizeof(Uniforms));
+    if (!gears->uniforms) {
+      printf("calloc uniforms failed\n");
+      goto out;
+    }
+
+    for (i = 0; i < scene->nb; i++) {
+      gears->size_vertices += gears->gear[i]->nb_attribs;
+    }
+    gears->size_vertices *= 2;
+    gears->vertex = calloc(gears->size_vertices, sizeof(struct vertex));
+    if (!gears->vertex) {
+      printf("calloc vertex failed\n");
+      goto out;
+    }
+
+    gears->size_triangles = gears->size_vertices;
+    gears->triangle = calloc(gears->size_triangles, sizeof(struct triangle));
+    if (!gears->triangle) {
+      printf("calloc triangle failed\n");
+      goto out;
+    }
+
+    if (gears->nb_threads > 1) {
+      gears->worker = calloc(gears->nb_threads - 1, sizeof(struct worker));
+      if (!gears->worker) {
+        printf("calloc worker failed\n");
+        goto out;
+      }
+
+      for (i = 0; i < gears->nb_threads - 1; i++) {
+        gears->worker[i].gears = gears;
+        if (pthread_create(&gears->worker[i].thread, NULL, worker_thread, &gears->worker[i])) {
+          printf("pthread_create failed\n");
+          goto out;
+        }
+        gears->worker[i].started = 1;
+      }
+    }
   }
 
   memset(gears->Projection, 0, sizeof(gears->Projection));
@@ -508,24 +1235,63 @@ out:
 
 static void pgl_gears_draw(gears_t *gears, float view_tz, float view_rx, float view_ry, float model_rz)
 {
-  const float red[4] = { 0.8, 0.1, 0.0, 1.0 };
-  const float green[4] = { 0.0, 0.8, 0.2, 1.0 };
-  const float blue[4] = { 0.2, 0.2, 1.0, 1.0 };
+  const gear_desc_t *gear_desc;
+  int i;
 
   if (!gears) {
     return;
   }
 
+  mat4_identity(gears->View);
+  mat4_translate(gears->View, 0, 0, view_tz);
+  mat4_rotate(gears->View, view_rx, 1, 0, 0);
+  mat4_rotate(gears->View, view_ry, 0, 1, 0);
+
+  if (gears->nb_threads) {
+    draw_tiled(gears, model_rz);
+    return;
+  }
+
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  identity(gears->View);
-  translate(gears->View, 0, 0, view_tz);
-  rotate(gears->View, view_rx, 1, 0, 0);
-  rotate(gears->View, view_ry, 0, 1, 0);
+  for (i = 0; i < gears->scene->nb; i++) {
+    gear_desc = &gears->scene->gear[i];
+    draw_gear(gears, i, gear_desc->tx, gear_desc->ty, gear_desc->ratio * model_rz + gear_desc->phase, gear_desc->color);
+  }
+}
+
+static const char *pgl_gears_driver(gears_t *gears)
+{
+  return (const char *)glGetString(GL_VERSION);
+}
+
+/* render into memory with the given pitch in bytes, such as a scanout buffer */
+static int pgl_gears_target(gears_t *gears, void *buffer, int pitch)
+{
+  if (!gears) {
+    return -1;
+  }
+
+  if (gears->nb_threads) {
+    gears->color_lastrow = (u8 *)buffer + (gears->height - 1) * pitch;
+    gears->color_pitch = pitch;
+    return 0;
+  }
+
+  if (pitch != (int)(c->back_buffer.w * sizeof(u32))) {
+    printf("pitch %d not supported without PGL_THREADS\n", pitch);
+    return -1;
+  }
 
-  draw_gear(gears, GEAR0, -3.0, -2.0,      model_rz     , red);
-  draw_gear(gears, GEAR1,  3.1, -2.0, -2 * model_rz - 9 , green);
-  draw_gear(gears, GEAR2, -3.1,  4.2, -2 * model_rz - 25, blue);
+  if (!gears->back_buffer) {
+    gears->back_buffer = c->back_buffer.buf;
+    gears->back_lastrow = c->back_buffer.lastrow;
+  }
+
+  c->back_buffer.buf = buffer;
+  c->back_buffer.lastrow = (u8 *)buffer + (c->back_buffer.h - 1) * pitch;
+
+  return 0;
 }
 
 /******************************************************************************/
@@ -535,7 +1301,9 @@ static engine_t pgl_engine = {
   3,
   pgl_gears_init,
   pgl_gears_draw,
-  pgl_gears_term
+  pgl_gears_term,
+  pgl_gears_driver,
+  pgl_gears_target
 };
 
 void
@@ -0,0 +1,96 @@
+/*
+  yagears                  Yet Another Gears OpenGL / Vulkan demo
+  Copyright (C) 2013-2024  Nicolas Caramelli
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "scene.h"
+
+/******************************************************************************/
+
+static const gear_desc_t gear_desc[3] = {
+  { 1.0, 4.0, 1.0, 20, 0.7, -3.0, -2.0,  1,   0, { 0.8, 0.1, 0.0, 1.0 } },
+  { 0.5, 2.0, 2.0, 10, 0.7,  3.1, -2.0, -2,  -9, { 0.0, 0.8, 0.2, 1.0 } },
+  { 1.3, 2.0, 0.5, 10, 0.7, -3.1,  4.2, -2, -25, { 0.2, 0.2, 1.0, 1.0 } }
+};
+
+/* size of the cell containing the 3 gears above */
+#define CELL 13.0
+
+/******************************************************************************/
+
+scene_t *scene_new(int nb)
+{
+  scene_t *scene = NULL;
+  int cells, cols, i;
+  float scale, cx, cy;
+
+  if (nb <= 0) {
+    nb = 3;
+  }
+
+  scene = calloc(1, sizeof(scene_t));
+  if (!scene) {
+    printf("calloc scene failed\n");
+    return NULL;
+  }
+
+  scene->gear = calloc(nb, sizeof(gear_desc_t));
+  if (!scene->gear) {
+    printf("calloc gear failed\n");
+    free(scene);
+    return NULL;
+  }
+
+  scene->nb = nb;
+
+  /* the 3 gears are replicated on a square grid of cells, scaled down to fit in one cell */
+
+  cells = (nb + 2) / 3;
+  cols = ceil(sqrt(cells));
+  scale = 1.0 / cols;
+
+  for (i = 0; i < nb; i++) {
+    scene->gear[i] = gear_desc[i % 3];
+    cx = ((i / 3) % cols - (cols - 1) / 2.0) * CELL;
+    cy = ((cols - 1) / 2.0 - (i / 3) / cols) * CELL;
+    scene->gear[i].inner *= scale;
+    scene->gear[i].outer *= scale;
+    scene->gear[i].width *= scale;
+    scene->gear[i].tooth_depth *= scale;
+    scene->gear[i].tx = (scene->gear[i].tx + cx) * scale;
+    scene->gear[i].ty = (scene->gear[i].ty + cy) * scale;
+  }
+
+  return scene;
+}
+
+void scene_free(scene_t *scene)
+{
+  if (!scene) {
+    return;
+  }
+
+  free(scene->gear);
+  free(scene);
+}
@@ -0,0 +1,58 @@
+/*
+  yagears                  Yet Another Gears OpenGL / Vulkan demo
+  Copyright (C) 2013-2024  Nicolas Caramelli
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  float inner;
+  float outer;
+  float width;
+  int teeth;
+  float tooth_depth;
+  float tx;
+  float ty;
+  float ratio;
+  float phase;
+  float color[4];
+} gear_desc_t;
+
+typedef struct {
+  int nb;
+  gear_desc_t *gear;
+} scene_t;
+
+/* gear rotation angle is ratio * model_rz + phase (in degrees) */
+
+scene_t *scene_new(int nb);
+void scene_free(scene_t *scene);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -24,11 +24,12 @@
 #include "config.h"
 
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/time.h>
+#include <time.h>
 
 #include <vulkan/vulkan.h>
 
@@ -45,6 +46,7 @@
 #include <SFML/Graphics.hpp>
 #endif
 
+#include "options.h"
 #include "vulkan_gears.h"
 
 /******************************************************************************/
@@ -53,37 +55,39 @@ static char *toolkit = NULL;
 static VkSwapchainKHR vk_swapchain = VK_NULL_HANDLE;
 static VkQueue vk_queue = VK_NULL_HANDLE;
 static gears_t *gears = NULL;
+static scene_t *scene = NULL;
 
-static int loop = 0, animate = 1, t_rate = 0, t_rot = 0, frames = 0, win_width = 0, win_height = 0, win_posx = 0, win_posy = 0;
+static int loop = 0, animate = 1, frames = 0, win_width = 0, win_height = 0, win_posx = 0, win_posy = 0, nb_gears = 3;
+static uint64_t t_rate = 0, t_rot = 0;
 static float fps = 0, view_tz = -40.0, view_rx = 20.0, view_ry = 30.0, model_rz = 210.0;
 
 /******************************************************************************/
 
-static int current_time()
+static uint64_t current_time()
 {
-  struct timeval tv;
+  struct timespec ts;
 
-  gettimeofday(&tv, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &ts);
 
-  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
 /******************************************************************************/
 
 static void rotate()
 {
-  int t;
+  uint64_t t;
 
   t = current_time();
 
-  if (t - t_rate >= 2000) {
+  if (t - t_rate >= 2000000000) {
     loop++;
-    fps += frames * 1000.0 / (t - t_rate);
+    fps += frames * 1000000000.0 / (t - t_rate);
     t_rate = t;
     frames = 0;
   }
 
-  model_rz += 15 * (t - t_rot) / 1000.0;
+  model_rz += 15 * (t - t_rot) / 1000000000.0;
   model_rz = fmod(model_rz, 360);
 
   t_rot = t;
@@ -97,14 +101,6 @@ static void glfwDisplay(GLFWwindow *window)
   if (animate) { if (frames) rotate(); else t_rate = t_rot = current_time(); }
   vk_gears_draw(gears, view_tz, view_rx, view_ry, model_rz, vk_queue);
   if (animate) frames++;
-
-  uint32_t vk_index = 0;
-  VkPresentInfoKHR vk_present_info;
-  memset(&vk_present_info, 0, sizeof(VkPresentInfoKHR));
-  vk_present_info.swapchainCount = 1;
-  vk_present_info.pSwapchains = &vk_swapchain;
-  vk_present_info.pImageIndices = &vk_index;
-  vkQueuePresentKHR(vk_queue, &vk_present_info);
 }
 
 static void glfwIdle(GLFWwindow *window)
@@ -152,12 +148,7 @@ static void glfwKeyCallback(GLFWwindow *window, int key, int scancode, int actio
       view_ry += 5.0;
       break;
     case GLFW_KEY_T:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -176,14 +167,6 @@ static void SDL_Display(SDL_Window *window)
   if (animate) { if (frames) rotate(); else t_rate = t_rot = current_time(); }
   vk_gears_draw(gears, view_tz, view_rx, view_ry, model_rz, vk_queue);
   if (animate) frames++;
-
-  uint32_t vk_index = 0;
-  VkPresentInfoKHR vk_present_info;
-  memset(&vk_present_info, 0, sizeof(VkPresentInfoKHR));
-  vk_present_info.swapchainCount = 1;
-  vk_present_info.pSwapchains = &vk_swapchain;
-  vk_present_info.pImageIndices = &vk_index;
-  vkQueuePresentKHR(vk_queue, &vk_present_info);
 }
 
 static void SDL_Idle(SDL_Window *window)
@@ -234,12 +217,7 @@ static void SDL_KeyDownEvent(SDL_Window *window, SDL_Event *event, void *data)
       view_ry += 5.0;
       break;
     case SDLK_t:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -266,14 +244,6 @@ void draw()
   if (animate) { if (frames) rotate(); else t_rate = t_rot = current_time(); }
   vk_gears_draw(gears, view_tz, view_rx, view_ry, model_rz, vk_queue);
   if (animate) frames++;
-
-  uint32_t vk_index = 0;
-  VkPresentInfoKHR vk_present_info;
-  memset(&vk_present_info, 0, sizeof(VkPresentInfoKHR));
-  vk_present_info.swapchainCount = 1;
-  vk_present_info.pSwapchains = &vk_swapchain;
-  vk_present_info.pImageIndices = &vk_index;
-  vkQueuePresentKHR(vk_queue, &vk_present_info);
 }
 
 void idle()
@@ -322,12 +292,7 @@ void keyPressedEvent(sf::Event &event)
       view_ry += 5.0;
       break;
     case sf::Keyboard::T:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -368,10 +333,13 @@ int main(int argc, char *argv[])
   VkSurfaceKHR vk_surface = VK_NULL_HANDLE;
   VkDeviceCreateInfo vk_device_create_info;
   VkDeviceQueueCreateInfo vk_device_queue_create_info;
+  VkPhysicalDeviceFeatures vk_physical_device_features, vk_enabled_features;
   VkDevice vk_device = VK_NULL_HANDLE;
   VkSwapchainCreateInfoKHR vk_swapchain_create_info;
 
-  /* process command line */
+  /* process environment and command line */
+
+  options_init();
 
   memset(toolkits, 0, sizeof(toolkits));
   #if defined(GLFW)
@@ -384,20 +352,30 @@ int main(int argc, char *argv[])
   strcat(toolkits, "sfml ");
   #endif
 
-  while ((opt = getopt(argc, argv, "t:h")) != -1) {
+  while ((opt = getopt(argc, argv, "t:o:h")) != -1) {
     switch (opt) {
       case 't':
         toolkit_arg = optarg;
         break;
+      case 'o':
+        if (options_set(optarg) == -1) {
+          return EXIT_FAILURE;
+        }
+        break;
       case 'h':
       default:
         break;
     }
   }
 
-  if (argc != 3 || !toolkit_arg) {
-    printf("\n\tUsage: %s -t Toolkit\n\n", argv[0]);
+  if (optind != argc || !toolkit_arg) {
+    printf("\n\tUsage: %s -t Toolkit [-o Option[=Value]]...\n\n", argv[0]);
     printf("\t\tToolkits: %s\n\n", toolkits);
+    printf("\t\tOptions:  ");
+    for (opt = 0; opt < options_nb(); opt++) {
+      printf("%s ", options_name(opt));
+    }
+    printf("\n\n");
     return EXIT_FAILURE;
   }
 
@@ -447,20 +425,24 @@ int main(int argc, char *argv[])
   }
   #endif
 
-  if (getenv("WIDTH")) {
-    win_width = atoi(getenv("WIDTH"));
+  if (options.width) {
+    win_width = options.width;
   }
 
-  if (getenv("HEIGHT")) {
-    win_height = atoi(getenv("HEIGHT"));
+  if (options.height) {
+    win_height = options.height;
   }
 
-  if (getenv("POSX")) {
-    win_posx = atoi(getenv("POSX"));
+  if (options.posx) {
+    win_posx = options.posx;
   }
 
-  if (getenv("POSY")) {
-    win_posy = atoi(getenv("POSY"));
+  if (options.posy) {
+    win_posy = options.posy;
+  }
+
+  if (options.gears) {
+    nb_gears = options.gears;
   }
 
   /* Toolkit window */
@@ -568,6 +550,13 @@ int main(int argc, char *argv[])
   vk_device_create_info.enabledExtensionCount = 1;
   vk_extension_names[0] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
   vk_device_create_info.ppEnabledExtensionNames = vk_extension_names;
+  if (options.pipeline_statistics) {
+    vkGetPhysicalDeviceFeatures(vk_physical_device, &vk_physical_device_features);
+    memset(&vk_enabled_features, 0, sizeof(VkPhysicalDeviceFeatures));
+    vk_enabled_features.pipelineStatisticsQuery = vk_physical_device_features.pipelineStatisticsQuery;
+    vk_enabled_features.inheritedQueries = vk_physical_device_features.inheritedQueries;
+    vk_device_create_info.pEnabledFeatures = &vk_enabled_features;
+  }
   err = vkCreateDevice(vk_physical_device, &vk_device_create_info, NULL, &vk_device);
   if (err) {
     printf("vkCreateDevice failed: %d\n", err);
@@ -582,7 +571,7 @@ int main(int argc, char *argv[])
 
   memset(&vk_swapchain_create_info, 0, sizeof(VkSwapchainCreateInfoKHR));
   vk_swapchain_create_info.surface = vk_surface;
-  vk_swapchain_create_info.minImageCount = 1;
+  vk_swapchain_create_info.minImageCount = options.frames_in_flight > 1 ? options.frames_in_flight : 1;
   vk_swapchain_create_info.imageFormat = VK_FORMAT_B8G8R8A8_UNORM;
   vk_swapchain_create_info.imageExtent.width = win_width;
   vk_swapchain_create_info.imageExtent.height = win_height;
@@ -595,12 +584,17 @@ int main(int argc, char *argv[])
 
   /* drawing (main event loop) */
 
-  gears = vk_gears_init(win_width, win_height, vk_device, vk_swapchain);
+  scene = scene_new(nb_gears);
+  if (!scene) {
+    goto out;
+  }
+
+  gears = vk_gears_init(win_width, win_height, scene, vk_physical_device, vk_device, vk_swapchain);
   if (!gears) {
     goto out;
   }
 
-  if (getenv("NO_ANIM")) {
+  if (options.no_anim) {
     animate = 0;
   }
 
@@ -683,6 +677,8 @@ out:
     vkDestroyInstance(vk_instance, NULL);
   }
 
+  scene_free(scene);
+
   /* Toolkit term */
 
   #if defined(GLFW)
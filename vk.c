@@ -25,10 +25,11 @@
 
 #include <math.h>
 #include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 #if defined(VK_X11)
@@ -63,14 +64,22 @@
 #endif
 #include <vulkan/vulkan.h>
 
+#include "bench.h"
+#include "options.h"
 #include "vulkan_gears.h"
 
 /******************************************************************************/
 
-static char *wsi = NULL;
+typedef struct {
+  const char *name;
+  void (*poll_events)(void);
+} wsi_t;
+
+static wsi_t *wsi = NULL;
 static gears_t *gears = NULL;
+static scene_t *scene = NULL;
 
-static int loop = 1, animate = 1, redisplay = 1, win_width = 0, win_height = 0, win_posx = 0, win_posy = 0;
+static int loop = 1, animate = 1, redisplay = 1, win_width = 0, win_height = 0, win_posx = 0, win_posy = 0, nb_gears = 3;
 static float fps = 0, view_tz = -40.0, view_rx = 20.0, view_ry = 30.0, model_rz = 210.0;
 
 /******************************************************************************/
@@ -124,12 +133,7 @@ static void x11_keyboard_handle_key(XEvent *event)
       view_ry += 5.0;
       break;
     case XK_t:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -176,12 +180,7 @@ static void dfb_keyboard_handle_key(DFBWindowEvent *event)
       view_ry += 5.0;
       break;
     case DIKS_SMALL_T:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -235,12 +234,7 @@ static void fb_keyboard_handle_key(struct input_event *event)
       view_ry += 5.0;
       break;
     case KEY_T:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -352,12 +346,7 @@ static void wl_keyboard_handle_key(void *data, struct wl_keyboard *keyboard, uns
       view_ry += 5.0;
       break;
     case XKB_KEY_t:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -450,12 +439,7 @@ static void xcb_keyboard_handle_key(xcb_generic_event_t *event)
       view_ry += 5.0;
       break;
     case 0x1c:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -502,12 +486,7 @@ static void d2d_keyboard_handle_key(struct input_event *event)
       view_ry += 5.0;
       break;
     case KEY_T:
-      if (getenv("NO_TEXTURE")) {
-        unsetenv("NO_TEXTURE");
-      }
-      else {
-        setenv("NO_TEXTURE", "1", 1);
-      }
+      options.no_texture = !options.no_texture;
       break;
     default:
       return;
@@ -521,19 +500,180 @@ static void d2d_keyboard_handle_key(struct input_event *event)
 
 /******************************************************************************/
 
+#if defined(VK_X11)
+static Display *x11_dpy = NULL;
+#endif
+#if defined(VK_DIRECTFB)
+static IDirectFBEventBuffer *dfb_event_buffer = NULL;
+#endif
+#if defined(VK_FBDEV)
+static int fb_keyboard = -1;
+#endif
+#if defined(VK_WAYLAND)
+static struct wl_display *wl_dpy = NULL;
+#endif
+#if defined(VK_XCB)
+static xcb_connection_t *xcb_dpy = NULL;
+#endif
+#if defined(VK_D2D)
+static struct libevdev *d2d_evdev = NULL;
+#endif
+
+#if defined(VK_X11)
+static void x11_poll_events(void)
+{
+  XEvent x11_event;
+
+  memset(&x11_event, 0, sizeof(XEvent));
+  if (XPending(x11_dpy)) {
+    XNextEvent(x11_dpy, &x11_event);
+    if (x11_event.type == Expose && !redisplay) {
+      redisplay = 1;
+    }
+    else if (x11_event.type == KeyPress) {
+      x11_keyboard_handle_key(&x11_event);
+    }
+  }
+}
+#endif
+
+#if defined(VK_DIRECTFB)
+static void dfb_poll_events(void)
+{
+  DFBWindowEvent dfb_event;
+
+  memset(&dfb_event, 0, sizeof(DFBWindowEvent));
+  if (!dfb_event_buffer->GetEvent(dfb_event_buffer, (DFBEvent *)&dfb_event)) {
+    if (dfb_event.type == DWET_KEYDOWN) {
+      dfb_keyboard_handle_key(&dfb_event);
+    }
+  }
+}
+#endif
+
+#if defined(VK_FBDEV)
+static void fb_poll_events(void)
+{
+  struct input_event fb_event;
+
+  memset(&fb_event, 0, sizeof(struct input_event));
+  if (read(fb_keyboard, &fb_event, sizeof(struct input_event)) > 0 && fb_event.type == EV_KEY) {
+    if (fb_event.value) {
+      fb_keyboard_handle_key(&fb_event);
+    }
+  }
+}
+#endif
+
+#if defined(VK_WAYLAND)
+static void wl_poll_events(void)
+{
+  wl_display_dispatch(wl_dpy);
+}
+#endif
+
+#if defined(VK_XCB)
+static void xcb_poll_events(void)
+{
+  xcb_generic_event_t *xcb_event = NULL;
+
+  xcb_event = xcb_poll_for_event(xcb_dpy);
+  if (xcb_event) {
+    if ((xcb_event->response_type & 0x7f) == XCB_KEY_PRESS) {
+      xcb_keyboard_handle_key(xcb_event);
+    }
+    free(xcb_event);
+  }
+}
+#endif
+
+#if defined(VK_D2D)
+static void d2d_poll_events(void)
+{
+  struct input_event d2d_event;
+
+  memset(&d2d_event, 0, sizeof(struct input_event));
+  if (!libevdev_next_event(d2d_evdev, LIBEVDEV_READ_FLAG_NORMAL, &d2d_event) && d2d_event.type == EV_KEY) {
+    if (d2d_event.value) {
+      d2d_keyboard_handle_key(&d2d_event);
+    }
+  }
+}
+#endif
+
+#if defined(VK_OFFSCREEN)
+static int offscreen_write(const char *filename, const unsigned char *pixels)
+{
+  FILE *file = NULL;
+  int i;
+
+  file = fopen(filename, "w");
+  if (!file) {
+    printf("fopen %s failed: %m\n", filename);
+    return -1;
+  }
+
+  /* binary PPM, BGRA pixels of the color image converted to RGB */
+
+  fprintf(file, "P6\n%d %d\n255\n", win_width, win_height);
+  for (i = 0; i < win_width * win_height; i++, pixels += 4) {
+    fputc(pixels[2], file);
+    fputc(pixels[1], file);
+    fputc(pixels[0], file);
+  }
+
+  fclose(file);
+
+  return 0;
+}
+#endif
+
+/******************************************************************************/
+
+static wsi_t wsi_list[] = {
+  #if defined(VK_X11)
+  { "vk-x11",       x11_poll_events },
+  #endif
+  #if defined(VK_DIRECTFB)
+  { "vk-directfb",  dfb_poll_events },
+  #endif
+  #if defined(VK_FBDEV)
+  { "vk-fbdev",     fb_poll_events  },
+  #endif
+  #if defined(VK_WAYLAND)
+  { "vk-wayland",   wl_poll_events  },
+  #endif
+  #if defined(VK_XCB)
+  { "vk-xcb",       xcb_poll_events },
+  #endif
+  #if defined(VK_D2D)
+  { "vk-d2d",       d2d_poll_events },
+  #endif
+  #if defined(VK_OFFSCREEN)
+  { "vk-offscreen", NULL            },
+  #endif
+  { NULL }
+};
+
+/******************************************************************************/
+
 int main(int argc, char *argv[])
 {
   int err = 0, ret = EXIT_FAILURE;
   const char *wsi_arg = NULL;
-  char wsis[64], *c;
-  int opt, t_rate = 0, t_rot = 0, t, frames = 0;
-  struct timeval tv;
+  #if defined(VK_FBDEV) || defined(VK_D2D)
+  char *c;
+  #endif
+  int opt, frames = 0, record_threads, rotate = 1;
+  uint64_t t_rate = 0, t_rot = 0, t, record_time, gpu_time, gpu_statistics[2];
+  struct timespec ts;
+  bench_t *bench = NULL;
+  VkPhysicalDeviceProperties vk_physical_device_properties;
+  char vk_driver[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE + 64];
 
   #if defined(VK_X11)
-  Display *x11_dpy = NULL;
   Window x11_win = 0;
   int x11_event_mask = NoEventMask;
-  XEvent x11_event;
   VkXlibSurfaceCreateInfoKHR x11_surface_create_info;
   #endif
   #if defined(VK_DIRECTFB)
@@ -543,9 +683,7 @@ int main(int argc, char *argv[])
   DFBDisplayLayerConfig dfb_layer_config;
   DFBWindowDescription dfb_desc;
   IDirectFBWindow *dfb_window = NULL;
-  IDirectFBEventBuffer *dfb_event_buffer = NULL;
   DFBWindowEventType dfb_event_mask = DWET_ALL;
-  DFBWindowEvent dfb_event;
   VkDirectFBSurfaceCreateInfoEXT dfb_surface_create_info;
   #endif
   #if defined(VK_FBDEV)
@@ -553,27 +691,22 @@ int main(int argc, char *argv[])
   struct fb_window *fb_win = NULL;
   struct fb_fix_screeninfo fb_finfo;
   struct fb_var_screeninfo fb_vinfo;
-  int fb_keyboard = -1;
   DIR *fb_input_dir = NULL;
   struct dirent *fb_input_dev = NULL;
   unsigned char fb_key_bits[(KEY_CNT - 1) / 8 + 1];
-  struct input_event fb_event;
   VkFBDevSurfaceCreateInfoEXT fb_surface_create_info;
   #endif
   #if defined(VK_WAYLAND)
-  struct wl_display *wl_dpy = NULL;
   struct wl_surface *wl_win = NULL;
   struct wl_data wl_data;
   struct wl_shell_surface *wl_shell_surface = NULL;
   VkWaylandSurfaceCreateInfoKHR wl_surface_create_info;
   #endif
   #if defined(VK_XCB)
-  xcb_connection_t *xcb_dpy = NULL;
   xcb_window_t xcb_win = -1;
   xcb_void_cookie_t xcb_cookie;
   uint32_t xcb_value_list[2];
   xcb_event_mask_t xcb_event_mask = XCB_EVENT_MASK_NO_EVENT;
-  xcb_generic_event_t *xcb_event = NULL;
   VkXcbSurfaceCreateInfoKHR xcb_surface_create_info;
   #endif
   #if defined(VK_D2D)
@@ -585,8 +718,6 @@ int main(int argc, char *argv[])
   int d2d_keyboard = -1;
   DIR *d2d_input_dir = NULL;
   struct dirent *d2d_input_dev = NULL;
-  struct libevdev *d2d_evdev = NULL;
-  struct input_event d2d_event;
   VkDisplaySurfaceCreateInfoKHR d2d_surface_create_info;
   #endif
   const char *vk_extension_name = NULL;
@@ -597,62 +728,53 @@ int main(int argc, char *argv[])
   VkSurfaceKHR vk_surface = VK_NULL_HANDLE;
   VkDeviceCreateInfo vk_device_create_info;
   VkDeviceQueueCreateInfo vk_device_queue_create_info;
+  VkPhysicalDeviceFeatures vk_physical_device_features, vk_enabled_features;
   VkDevice vk_device = VK_NULL_HANDLE;
   VkQueue vk_queue = VK_NULL_HANDLE;
   VkSwapchainCreateInfoKHR vk_swapchain_create_info;
   VkSwapchainKHR vk_swapchain = VK_NULL_HANDLE;
-  VkPresentInfoKHR vk_present_info;
-  uint32_t vk_index = 0;
 
-  /* process command line */
+  /* process environment and command line */
 
-  memset(wsis, 0, sizeof(wsis));
-  #if defined(VK_X11)
-  strcat(wsis, "vk-x11 ");
-  #endif
-  #if defined(VK_DIRECTFB)
-  strcat(wsis, "vk-directfb ");
-  #endif
-  #if defined(VK_FBDEV)
-  strcat(wsis, "vk-fbdev ");
-  #endif
-  #if defined(VK_WAYLAND)
-  strcat(wsis, "vk-wayland ");
-  #endif
-  #if defined(VK_XCB)
-  strcat(wsis, "vk-xcb ");
-  #endif
-  #if defined(VK_D2D)
-  strcat(wsis, "vk-d2d ");
-  #endif
+  options_init();
 
-  while ((opt = getopt(argc, argv, "w:h")) != -1) {
+  while ((opt = getopt(argc, argv, "w:o:h")) != -1) {
     switch (opt) {
       case 'w':
         wsi_arg = optarg;
         break;
+      case 'o':
+        if (options_set(optarg) == -1) {
+          return EXIT_FAILURE;
+        }
+        break;
       case 'h':
       default:
         break;
     }
   }
 
-  if (argc != 3 || !wsi_arg) {
-    printf("\n\tUsage: %s -w WSI\n\n", argv[0]);
-    printf("\t\tWSIs: %s\n\n", wsis);
+  if (optind != argc || !wsi_arg) {
+    printf("\n\tUsage: %s -w WSI [-o Option[=Value]]...\n\n", argv[0]);
+    printf("\t\tWSIs:    ");
+    for (wsi = wsi_list; wsi->name; wsi++) {
+      printf("%s ", wsi->name);
+    }
+    printf("\n\n");
+    printf("\t\tOptions: ");
+    for (opt = 0; opt < options_nb(); opt++) {
+      printf("%s ", options_name(opt));
+    }
+    printf("\n\n");
     return EXIT_FAILURE;
   }
 
-  wsi = wsis;
-  while ((c = strchr(wsi, ' '))) {
-    *c = '\0';
-    if (!strcmp(wsi, wsi_arg))
+  for (wsi = wsi_list; wsi->name; wsi++) {
+    if (!strcmp(wsi->name, wsi_arg))
       break;
-    else
-      wsi = c + 1;
   }
 
-  if (!c) {
+  if (!wsi->name) {
     printf("%s: WSI unknown\n", wsi_arg);
     return EXIT_FAILURE;
   }
@@ -660,38 +782,38 @@ int main(int argc, char *argv[])
   /* create instance and set physical device */
 
   #if defined(VK_X11)
-  if (!strcmp(wsi, "vk-x11")) {
+  if (!strcmp(wsi->name, "vk-x11")) {
     vk_extension_name = VK_KHR_XLIB_SURFACE_EXTENSION_NAME;
   }
   #endif
   #if defined(VK_DIRECTFB)
-  if (!strcmp(wsi, "vk-directfb")) {
+  if (!strcmp(wsi->name, "vk-directfb")) {
     vk_extension_name = VK_EXT_DIRECTFB_SURFACE_EXTENSION_NAME;
   }
   #endif
   #if defined(VK_FBDEV)
-  if (!strcmp(wsi, "vk-fbdev")) {
+  if (!strcmp(wsi->name, "vk-fbdev")) {
     vk_extension_name = VK_EXT_FBDEV_SURFACE_EXTENSION_NAME;
   }
   #endif
   #if defined(VK_WAYLAND)
-  if (!strcmp(wsi, "vk-wayland")) {
+  if (!strcmp(wsi->name, "vk-wayland")) {
     vk_extension_name = VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME;
   }
   #endif
   #if defined(VK_XCB)
-  if (!strcmp(wsi, "vk-xcb")) {
+  if (!strcmp(wsi->name, "vk-xcb")) {
     vk_extension_name = VK_KHR_XCB_SURFACE_EXTENSION_NAME;
   }
   #endif
   #if defined(VK_D2D)
-  if (!strcmp(wsi, "vk-d2d")) {
+  if (!strcmp(wsi->name, "vk-d2d")) {
     vk_extension_name = VK_KHR_DISPLAY_EXTENSION_NAME;
   }
   #endif
 
   memset(&vk_instance_create_info, 0, sizeof(VkInstanceCreateInfo));
-  vk_instance_create_info.enabledExtensionCount = 1;
+  vk_instance_create_info.enabledExtensionCount = vk_extension_name ? 1 : 0;
   vk_instance_create_info.ppEnabledExtensionNames = &vk_extension_name;
   err = vkCreateInstance(&vk_instance_create_info, NULL, &vk_instance);
   if (err) {
@@ -722,7 +844,7 @@ int main(int argc, char *argv[])
   /* open display */
 
   #if defined(VK_X11)
-  if (!strcmp(wsi, "vk-x11")) {
+  if (!strcmp(wsi->name, "vk-x11")) {
     x11_dpy = XOpenDisplay(NULL);
     if (!x11_dpy) {
       printf("XOpenDisplay failed\n");
@@ -737,7 +859,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_DIRECTFB)
-  if (!strcmp(wsi, "vk-directfb")) {
+  if (!strcmp(wsi->name, "vk-directfb")) {
     err = DirectFBInit(NULL, NULL);
     if (err) {
       printf("DirectFBInit failed: %s\n", DirectFBErrorString(err));
@@ -768,10 +890,10 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_FBDEV)
-  if (!strcmp(wsi, "vk-fbdev")) {
-    fb_dpy = open(getenv("FRAMEBUFFER") ? getenv("FRAMEBUFFER") : "/dev/fb0", O_RDWR);
+  if (!strcmp(wsi->name, "vk-fbdev")) {
+    fb_dpy = open(options.framebuffer, O_RDWR);
     if (fb_dpy == -1) {
-      printf("open %s failed: %m\n", getenv("FRAMEBUFFER") ? getenv("FRAMEBUFFER") : "/dev/fb0");
+      printf("open %s failed: %m\n", options.framebuffer);
       goto out;
     }
 
@@ -794,7 +916,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_WAYLAND)
-  if (!strcmp(wsi, "vk-wayland")) {
+  if (!strcmp(wsi->name, "vk-wayland")) {
     wl_dpy = wl_display_connect(NULL);
     if (!wl_dpy) {
       printf("wl_display_connect failed\n");
@@ -832,7 +954,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_XCB)
-  if (!strcmp(wsi, "vk-xcb")) {
+  if (!strcmp(wsi->name, "vk-xcb")) {
     xcb_dpy = xcb_connect(NULL, NULL);
     if (xcb_connection_has_error(xcb_dpy)) {
       printf("xcb_connect failed\n");
@@ -844,7 +966,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_D2D)
-  if (!strcmp(wsi, "vk-d2d")) {
+  if (!strcmp(wsi->name, "vk-d2d")) {
     err = vkGetPhysicalDeviceDisplayPropertiesKHR(vk_physical_device, &d2d_properties_count, NULL);
     if (err || !d2d_properties_count) {
       printf("vkGetPhysicalDeviceDisplayPropertiesKHR failed: %d, %d\n", err, vk_physical_devices_count);
@@ -887,27 +1009,37 @@ int main(int argc, char *argv[])
     win_height = d2d_mode_properties[0].parameters.visibleRegion.height;
   }
   #endif
+  #if defined(VK_OFFSCREEN)
+  if (!strcmp(wsi->name, "vk-offscreen")) {
+    win_width = 640;
+    win_height = 480;
+  }
+  #endif
+
+  if (options.width) {
+    win_width = options.width;
+  }
 
-  if (getenv("WIDTH")) {
-    win_width = atoi(getenv("WIDTH"));
+  if (options.height) {
+    win_height = options.height;
   }
 
-  if (getenv("HEIGHT")) {
-    win_height = atoi(getenv("HEIGHT"));
+  if (options.posx) {
+    win_posx = options.posx;
   }
 
-  if (getenv("POSX")) {
-    win_posx = atoi(getenv("POSX"));
+  if (options.posy) {
+    win_posy = options.posy;
   }
 
-  if (getenv("POSY")) {
-    win_posy = atoi(getenv("POSY"));
+  if (options.gears) {
+    nb_gears = options.gears;
   }
 
   /* create window associated to the display */
 
   #if defined(VK_X11)
-  if (!strcmp(wsi, "vk-x11")) {
+  if (!strcmp(wsi->name, "vk-x11")) {
     x11_win = XCreateSimpleWindow(x11_dpy, DefaultRootWindow(x11_dpy), win_posx, win_posy, win_width, win_height, 0, 0, 0);
     if (!x11_win) {
       printf("XCreateSimpleWindow failed\n");
@@ -923,7 +1055,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_DIRECTFB)
-  if (!strcmp(wsi, "vk-directfb")) {
+  if (!strcmp(wsi->name, "vk-directfb")) {
     memset(&dfb_desc, 0, sizeof(DFBWindowDescription));
     dfb_desc.flags = DWDESC_WIDTH | DWDESC_HEIGHT | DWDESC_POSX | DWDESC_POSY;
     dfb_desc.width = win_width;
@@ -969,7 +1101,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_FBDEV)
-  if (!strcmp(wsi, "vk-fbdev")) {
+  if (!strcmp(wsi->name, "vk-fbdev")) {
     fb_win = calloc(1, sizeof(struct fb_window));
     if (!fb_win) {
       printf("fb_window calloc failed: %m\n");
@@ -981,8 +1113,8 @@ int main(int argc, char *argv[])
     fb_win->posx = win_posx;
     fb_win->posy = win_posy;
 
-    if (getenv("KEYBOARD")) {
-      fb_keyboard = open(getenv("KEYBOARD"), O_RDONLY | O_NONBLOCK);
+    if (options.keyboard) {
+      fb_keyboard = open(options.keyboard, O_RDONLY | O_NONBLOCK);
     }
     else {
       fb_input_dir = opendir("/dev/input");
@@ -1020,7 +1152,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_WAYLAND)
-  if (!strcmp(wsi, "vk-wayland")) {
+  if (!strcmp(wsi->name, "vk-wayland")) {
     wl_win = wl_compositor_create_surface(wl_data.wl_compositor);
     if (!wl_win) {
       printf("wl_compositor_create_surface failed\n");
@@ -1047,7 +1179,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_XCB)
-  if (!strcmp(wsi, "vk-xcb")) {
+  if (!strcmp(wsi->name, "vk-xcb")) {
     xcb_win = xcb_generate_id(xcb_dpy);
     xcb_event_mask = XCB_EVENT_MASK_KEY_PRESS;
     xcb_value_list[0] = 0;
@@ -1069,11 +1201,11 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_D2D)
-  if (!strcmp(wsi, "vk-d2d")) {
+  if (!strcmp(wsi->name, "vk-d2d")) {
     d2d_win = d2d_mode_properties[0].parameters.visibleRegion;
 
-    if (getenv("KEYBOARD")) {
-      d2d_keyboard = open(getenv("KEYBOARD"), O_RDONLY | O_NONBLOCK);
+    if (options.keyboard) {
+      d2d_keyboard = open(options.keyboard, O_RDONLY | O_NONBLOCK);
     }
     else {
       d2d_input_dir = opendir("/dev/input");
@@ -1115,7 +1247,7 @@ int main(int argc, char *argv[])
   /* create surface */
 
   #if defined(VK_X11)
-  if (!strcmp(wsi, "vk-x11")) {
+  if (!strcmp(wsi->name, "vk-x11")) {
     memset(&x11_surface_create_info, 0, sizeof(VkXlibSurfaceCreateInfoKHR));
     x11_surface_create_info.dpy = x11_dpy;
     x11_surface_create_info.window = x11_win;
@@ -1127,7 +1259,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_DIRECTFB)
-  if (!strcmp(wsi, "vk-directfb")) {
+  if (!strcmp(wsi->name, "vk-directfb")) {
     memset(&dfb_surface_create_info, 0, sizeof(VkDirectFBSurfaceCreateInfoEXT));
     dfb_surface_create_info.dfb = dfb_dpy;
     dfb_surface_create_info.surface = dfb_win;
@@ -1139,7 +1271,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_FBDEV)
-  if (!strcmp(wsi, "vk-fbdev")) {
+  if (!strcmp(wsi->name, "vk-fbdev")) {
     memset(&fb_surface_create_info, 0, sizeof(VkFBDevSurfaceCreateInfoEXT));
     fb_surface_create_info.fd = fb_dpy;
     fb_surface_create_info.window = fb_win;
@@ -1151,7 +1283,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_WAYLAND)
-  if (!strcmp(wsi, "vk-wayland")) {
+  if (!strcmp(wsi->name, "vk-wayland")) {
     memset(&wl_surface_create_info, 0, sizeof(VkWaylandSurfaceCreateInfoKHR));
     wl_surface_create_info.display = wl_dpy;
     wl_surface_create_info.surface = wl_win;
@@ -1163,7 +1295,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_XCB)
-  if (!strcmp(wsi, "vk-xcb")) {
+  if (!strcmp(wsi->name, "vk-xcb")) {
     memset(&xcb_surface_create_info, 0, sizeof(VkXcbSurfaceCreateInfoKHR));
     xcb_surface_create_info.connection = xcb_dpy;
     xcb_surface_create_info.window = xcb_win;
@@ -1175,7 +1307,7 @@ int main(int argc, char *argv[])
   }
   #endif
   #if defined(VK_D2D)
-  if (!strcmp(wsi, "vk-d2d")) {
+  if (!strcmp(wsi->name, "vk-d2d")) {
     memset(&d2d_surface_create_info, 0, sizeof(VkDisplaySurfaceCreateInfoKHR));
     d2d_surface_create_info.displayMode = d2d_dpy;
     d2d_surface_create_info.imageExtent = d2d_win;
@@ -1194,9 +1326,18 @@ int main(int argc, char *argv[])
   memset(&vk_device_queue_create_info, 0, sizeof(VkDeviceQueueCreateInfo));
   vk_device_queue_create_info.queueCount = 1;
   vk_device_create_info.pQueueCreateInfos = &vk_device_queue_create_info;
-  vk_device_create_info.enabledExtensionCount = 1;
-  vk_extension_name = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
-  vk_device_create_info.ppEnabledExtensionNames = &vk_extension_name;
+  if (vk_surface) {
+    vk_device_create_info.enabledExtensionCount = 1;
+    vk_extension_name = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    vk_device_create_info.ppEnabledExtensionNames = &vk_extension_name;
+  }
+  if (options.pipeline_statistics) {
+    vkGetPhysicalDeviceFeatures(vk_physical_device, &vk_physical_device_features);
+    memset(&vk_enabled_features, 0, sizeof(VkPhysicalDeviceFeatures));
+    vk_enabled_features.pipelineStatisticsQuery = vk_physical_device_features.pipelineStatisticsQuery;
+    vk_enabled_features.inheritedQueries = vk_physical_device_features.inheritedQueries;
+    vk_device_create_info.pEnabledFeatures = &vk_enabled_features;
+  }
   err = vkCreateDevice(vk_physical_device, &vk_device_create_info, NULL, &vk_device);
   if (err) {
     printf("vkCreateDevice failed: %d\n", err);
@@ -1207,57 +1348,86 @@ int main(int argc, char *argv[])
 
   vkGetDeviceQueue(vk_device, 0, 0, &vk_queue);
 
-  /* create swapchain */
+  /* create swapchain (none for offscreen rendering) */
 
-  memset(&vk_swapchain_create_info, 0, sizeof(VkSwapchainCreateInfoKHR));
-  vk_swapchain_create_info.surface = vk_surface;
-  vk_swapchain_create_info.minImageCount = 1;
-  vk_swapchain_create_info.imageFormat = VK_FORMAT_B8G8R8A8_UNORM;
-  vk_swapchain_create_info.imageExtent.width = win_width;
-  vk_swapchain_create_info.imageExtent.height = win_height;
-  vk_swapchain_create_info.imageArrayLayers = 1;
-  err = vkCreateSwapchainKHR(vk_device, &vk_swapchain_create_info, NULL, &vk_swapchain);
-  if (err) {
-    printf("vkCreateSwapchainKHR failed: %d\n", err);
-    goto out;
+  if (vk_surface) {
+    memset(&vk_swapchain_create_info, 0, sizeof(VkSwapchainCreateInfoKHR));
+    vk_swapchain_create_info.surface = vk_surface;
+    vk_swapchain_create_info.minImageCount = options.frames_in_flight > 1 ? options.frames_in_flight : 1;
+    vk_swapchain_create_info.imageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    vk_swapchain_create_info.imageExtent.width = win_width;
+    vk_swapchain_create_info.imageExtent.height = win_height;
+    vk_swapchain_create_info.imageArrayLayers = 1;
+    err = vkCreateSwapchainKHR(vk_device, &vk_swapchain_create_info, NULL, &vk_swapchain);
+    if (err) {
+      printf("vkCreateSwapchainKHR failed: %d\n", err);
+      goto out;
+    }
   }
 
   /* drawing (main event loop) */
 
-  gears = vk_gears_init(win_width, win_height, vk_device, vk_swapchain);
+  scene = scene_new(nb_gears);
+  if (!scene) {
+    goto out;
+  }
+
+  gears = vk_gears_init(win_width, win_height, scene, vk_physical_device, vk_device, vk_swapchain);
   if (!gears) {
     goto out;
   }
 
-  if (getenv("NO_ANIM")) {
+  if (bench_enabled()) {
+    vkGetPhysicalDeviceProperties(vk_physical_device, &vk_physical_device_properties);
+    sprintf(vk_driver, "%s (Vulkan %u.%u.%u, driver 0x%x)", vk_physical_device_properties.deviceName, VK_VERSION_MAJOR(vk_physical_device_properties.apiVersion), VK_VERSION_MINOR(vk_physical_device_properties.apiVersion), VK_VERSION_PATCH(vk_physical_device_properties.apiVersion), vk_physical_device_properties.driverVersion);
+    bench = bench_new("yagears2-vk", "vulkan", wsi->name, win_width, win_height, scene->nb, vk_driver);
+    if (!bench) {
+      goto out;
+    }
+  }
+  else if (options.no_anim) {
     animate = 0;
   }
 
+  #if defined(VK_OFFSCREEN)
+  /* READBACK images are compared between runs: the offscreen gears are
+     drawn at rest, so that the image does not depend on frame timing */
+  if (!strcmp(wsi->name, "vk-offscreen") && options.readback) {
+    rotate = 0;
+  }
+  #endif
+
   signal(SIGINT, sighandler);
 
   while (loop) {
     if (animate && redisplay) {
-      err = gettimeofday(&tv, NULL);
+      err = clock_gettime(CLOCK_MONOTONIC, &ts);
       if (err == -1) {
-        printf("gettimeofday failed: %m\n");
+        printf("clock_gettime failed: %m\n");
       }
 
-      t = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+      t = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 
       if (!frames) {
         t_rate = t_rot = t;
       }
       else {
-        if (t - t_rate >= 2000) {
+        if (t - t_rate >= 2000000000) {
           loop++;
-          fps += frames * 1000.0 / (t - t_rate);
+          fps += frames * 1000000000.0 / (t - t_rate);
           t_rate = t;
           frames = 0;
         }
 
-        model_rz += 15 * (t - t_rot) / 1000.0;
-        model_rz = fmod(model_rz, 360);
+        if (rotate) {
+          model_rz += 15 * (t - t_rot) / 1000000000.0;
+          model_rz = fmod(model_rz, 360);
+        }
         t_rot = t;
+
+        if (bench && bench_frame(bench, t)) {
+          loop = 0;
+        }
       }
     }
     else {
@@ -1267,115 +1437,60 @@ int main(int argc, char *argv[])
     }
 
     if (redisplay) {
-      vk_gears_draw(gears, view_tz, view_rx, view_ry, model_rz, vk_queue);
-
-      if (animate) {
-        frames++;
-      }
-
-      memset(&vk_present_info, 0, sizeof(VkPresentInfoKHR));
-      vk_present_info.swapchainCount = 1;
-      vk_present_info.pSwapchains = &vk_swapchain;
-      vk_present_info.pImageIndices = &vk_index;
-      err = vkQueuePresentKHR(vk_queue, &vk_present_info);
-      if (err) {
-        printf("vkQueuePresentKHR failed: %d\n", err);
+      err = vk_gears_draw(gears, view_tz, view_rx, view_ry, model_rz, vk_queue);
+      if (err == -1) {
         goto out;
       }
-    }
-
-    #if defined(VK_X11)
-    if (!strcmp(wsi, "vk-x11")) {
-      if (!animate && redisplay) {
-        redisplay = 0;
-      }
 
-      memset(&x11_event, 0, sizeof(XEvent));
-      if (XPending(x11_dpy)) {
-        XNextEvent(x11_dpy, &x11_event);
-        if (x11_event.type == Expose && !redisplay) {
-          redisplay = 1;
-        }
-        else if (x11_event.type == KeyPress) {
-          x11_keyboard_handle_key(&x11_event);
+      if (bench) {
+        record_time = vk_gears_record_time(gears, &record_threads);
+        bench_record(bench, record_threads, record_time);
+        if (vk_gears_gpu_time(gears, &gpu_time, gpu_statistics)) {
+          bench_gpu(bench, gpu_time, gpu_statistics);
         }
       }
-    }
-    #endif
-    #if defined(VK_DIRECTFB)
-    if (!strcmp(wsi, "vk-directfb")) {
-      if (!animate && redisplay) {
-        redisplay = 0;
-      }
 
-      memset(&dfb_event, 0, sizeof(DFBWindowEvent));
-      if (!dfb_event_buffer->GetEvent(dfb_event_buffer, (DFBEvent *)&dfb_event)) {
-        if (dfb_event.type == DWET_KEYDOWN) {
-          dfb_keyboard_handle_key(&dfb_event);
-        }
+      if (animate) {
+        frames++;
       }
     }
-    #endif
-    #if defined(VK_FBDEV)
-    if (!strcmp(wsi, "vk-fbdev")) {
-      if (!animate && redisplay) {
-        redisplay = 0;
-      }
 
-      memset(&fb_event, 0, sizeof(struct input_event));
-      if (read(fb_keyboard, &fb_event, sizeof(struct input_event)) > 0 && fb_event.type == EV_KEY) {
-        if (fb_event.value) {
-          fb_keyboard_handle_key(&fb_event);
-        }
+    if (!animate && redisplay) {
+      redisplay = 0;
+
+      /* without events, nothing can trigger another frame */
+      if (!wsi->poll_events) {
+        loop = 0;
       }
     }
-    #endif
-    #if defined(VK_WAYLAND)
-    if (!strcmp(wsi, "vk-wayland")) {
-      if (!animate && redisplay) {
-        redisplay = 0;
-      }
 
-      wl_display_dispatch(wl_dpy);
+    if (wsi->poll_events) {
+      wsi->poll_events();
     }
-    #endif
-    #if defined(VK_XCB)
-    if (!strcmp(wsi, "vk-xcb")) {
-      if (!animate && redisplay) {
-        redisplay = 0;
-      }
+  }
 
-      xcb_event = xcb_poll_for_event(xcb_dpy);
-      if (xcb_event) {
-        if ((xcb_event->response_type & 0x7f) == XCB_KEY_PRESS) {
-          xcb_keyboard_handle_key(xcb_event);
-        }
-        free(xcb_event);
-      }
+  #if defined(VK_OFFSCREEN)
+  if (options.readback && vk_gears_readback(gears)) {
+    err = offscreen_write(options.readback, vk_gears_readback(gears));
+    if (err == -1) {
+      goto out;
     }
-    #endif
-    #if defined(VK_D2D)
-    if (!strcmp(wsi, "vk-d2d")) {
-      if (!animate && redisplay) {
-        redisplay = 0;
-      }
+  }
+  #endif
 
-      memset(&d2d_event, 0, sizeof(struct input_event));
-      if (!libevdev_next_event(d2d_evdev, LIBEVDEV_READ_FLAG_NORMAL, &d2d_event) && d2d_event.type == EV_KEY) {
-        if (d2d_event.value) {
-          d2d_keyboard_handle_key(&d2d_event);
-        }
-      }
+  if (bench) {
+    err = bench_report(bench);
+    if (err == -1) {
+      goto out;
     }
-    #endif
   }
 
-  vk_gears_term(gears);
-
   ret = EXIT_SUCCESS;
 
 out:
 
+  vk_gears_term(gears);
+
   /* destroy swapchain, device, surface and instance */
 
   if (vk_swapchain) {
@@ -1398,10 +1513,14 @@ out:
     vkDestroyInstance(vk_instance, NULL);
   }
 
+  bench_free(bench);
+
+  scene_free(scene);
+
   /* destroy window and close display */
 
   #if defined(VK_X11)
-  if (!strcmp(wsi, "vk-x11")) {
+  if (!strcmp(wsi->name, "vk-x11")) {
     if (x11_event_mask) {
       XSelectInput(x11_dpy, x11_win, NoEventMask);
     }
@@ -1416,7 +1535,7 @@ out:
   }
   #endif
   #if defined(VK_DIRECTFB)
-  if (!strcmp(wsi, "vk-directfb")) {
+  if (!strcmp(wsi->name, "vk-directfb")) {
     if (dfb_event_buffer) {
       dfb_event_buffer->Release(dfb_event_buffer);
     }
@@ -1439,7 +1558,7 @@ out:
   }
   #endif
   #if defined(VK_FBDEV)
-  if (!strcmp(wsi, "vk-fbdev")) {
+  if (!strcmp(wsi->name, "vk-fbdev")) {
     if (fb_keyboard != -1) {
       close(fb_keyboard);
     }
@@ -1458,7 +1577,7 @@ out:
   }
   #endif
   #if defined(VK_WAYLAND)
-  if (!strcmp(wsi, "vk-wayland")) {
+  if (!strcmp(wsi->name, "vk-wayland")) {
     if (wl_data.xkb_state) {
       xkb_state_unref(wl_data.xkb_state);
     }
@@ -1509,7 +1628,7 @@ out:
   }
   #endif
   #if defined(VK_XCB)
-  if (!strcmp(wsi, "vk-xcb")) {
+  if (!strcmp(wsi->name, "vk-xcb")) {
     if (xcb_event_mask) {
       xcb_event_mask = XCB_EVENT_MASK_NO_EVENT;
       xcb_change_window_attributes(xcb_dpy, xcb_win, XCB_CW_EVENT_MASK, &xcb_event_mask);
@@ -1525,7 +1644,7 @@ out:
   }
   #endif
   #if defined(VK_D2D)
-  if (!strcmp(wsi, "vk-d2d")) {
+  if (!strcmp(wsi->name, "vk-d2d")) {
     if (d2d_evdev) {
       libevdev_free(d2d_evdev);
     }
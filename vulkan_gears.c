@@ -23,460 +23,585 @@
 
 #include <vulkan/vulkan.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include "vulkan_gears.h"
+#include "mat4.h"
+#include "mesh.h"
+#include "options.h"
 
 #include "image_loader.h"
 
-static void identity(float *a)
-{
-  float m[16] = {
-    1, 0, 0, 0,
-    0, 1, 0, 0,
-    0, 0, 1, 0,
-    0, 0, 0, 1,
-  };
-
-  memcpy(a, m, sizeof(m));
-}
-
-static void multiply(float *a, const float *b)
-{
-  float m[16];
-  int i, j;
-  div_t d;
-
-  for (i = 0; i < 16; i++) {
-    m[i] = 0;
-    d = div(i, 4);
-    for (j = 0; j < 4; j++)
-      m[i] += (a + d.rem)[j * 4] * (b + d.quot * 4)[j];
-  }
-
-  memcpy(a, m, sizeof(m));
-}
+/******************************************************************************/
 
-static void translate(float *a, float tx, float ty, float tz)
-{
-  float m[16] = {
-     1,  0,  0, 0,
-     0,  1,  0, 0,
-     0,  0,  1, 0,
-    tx, ty, tz, 1
-  };
+/* per-draw data recorded in the command buffer, within the 128 bytes of push
+   constants always available: the light direction is given in object space,
+   so that the normals don't need to be transformed by a normal matrix */
 
-  multiply(a, m);
-}
+struct PushConstants {
+  float ModelViewProjection[16];
+  float LightDir[4];
+  float Color[4];
+  int TextureEnable;
+};
 
-static void rotate(float *a, float r, float ux, float uy, float uz)
-{
-  float s, c;
+/* frames in flight: each one has its own command buffer and synchronization
+   objects */
 
-  sincosf(r * M_PI / 180, &s, &c);
+#define MAX_FRAMES 3
 
-  float m[16] = {
-         ux * ux * (1 - c) + c, uy * ux * (1 - c) - uz * s, ux * uz * (1 - c) - uy * s, 0,
-    ux * uy * (1 - c) + uz * s,      uy * uy * (1 - c) + c, uy * uz * (1 - c) - ux * s, 0,
-    ux * uz * (1 - c) + uy * s, uy * uz * (1 - c) + ux * s,      uz * uz * (1 - c) + c, 0,
-                             0,                          0,                          0, 1
-  };
+/* device memory is sub-allocated linearly from blocks of at least
+   MEMORY_BLOCK_SIZE bytes, with separate pools of blocks for optimal images and
+   for buffers so that bufferImageGranularity never applies; host-visible
+   blocks are mapped once, staging blocks are freed when the upload is
+   complete and the others when the gears are released */
 
-  multiply(a, m);
-}
+#define MEMORY_BLOCK_SIZE (16 << 20)
 
-static void transpose(float *a)
-{
-  float m[16] = {
-    a[0], a[4], a[8],  a[12],
-    a[1], a[5], a[9],  a[13],
-    a[2], a[6], a[10], a[14],
-    a[3], a[7], a[11], a[15]
-  };
+#define MEMORY_ALL     -1
+#define MEMORY_OPTIMAL  0
+#define MEMORY_LINEAR   1
+#define MEMORY_STAGING  2
 
-  memcpy(a, m, sizeof(m));
-}
+struct memory_block {
+  VkDeviceMemory memory;
+  uint32_t type;
+  int pool;
+  VkDeviceSize size;
+  VkDeviceSize offset;
+  void *data;
+  struct memory_block *next;
+};
 
-static void invert(float *a)
-{
-  float m[16] = {
-         1,      0,      0, 0,
-         0,      1,      0, 0,
-         0,      0,      1, 0,
-    -a[12], -a[13], -a[14], 1,
-  };
+/* the semaphore waited by the presentation of a swapchain image belongs to
+   the image: it is only signaled again once the image is acquired again, the
+   fence of a frame in flight does not tell when the presentation waited it */
 
-  a[12] = a[13] = a[14] = 0;
-  transpose(a);
+struct image {
+  VkImage image;
+  VkImageView view;
+  VkFramebuffer framebuffer;
+  VkSemaphore renderSemaphore;
+};
 
-  multiply(a, m);
-}
+struct frame {
+  VkCommandBuffer commandBuffer;
+  VkFence fence;
+  VkSemaphore acquireSemaphore;
+  VkQueryPool timestampPool;
+  VkQueryPool statisticsPool;
+  int queries;
+};
 
-/******************************************************************************/
+/* with GPU_TIMESTAMPS, a timestamp is written before the render pass, after
+   each gear and after the render pass, with PIPELINE_STATISTICS the vertex and
+   fragment shader invocations are counted over the render pass: the results
+   of a frame are read back when its fence is waited, nb_frames frames later */
 
-#define GEAR0 0
-#define GEAR1 1
-#define GEAR2 2
+#define PIPELINE_STATISTICS (VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT)
 
-typedef float Vertex[8];
+/* with RECORD_THREADS > 1, the gears are split across worker threads which
+   record secondary command buffers from their own command pool, then executed
+   in the render pass of the frame command buffer */
 
-typedef struct {
-  int begin;
-  int count;
-} Strip;
+#define MAX_THREADS 16
 
-struct Uniform {
-  float LightPos[4];
-  float ModelViewProjection[16];
-  float NormalMatrix[16];
-  float Color[4];
-  int TextureEnable;
+struct thread {
+  gears_t *gears;
+  pthread_t thread;
+  int started;
+  VkCommandPool commandPool;
+  VkCommandBuffer commandBuffer[MAX_FRAMES];
+  int first;
+  int last;
+  int record;
+  VkResult res;
 };
 
 struct gear {
-  int nvertices;
-  Vertex *vertices;
-  int nstrips;
-  Strip *strips;
+  const mesh_t *mesh;
   VkBuffer vbo;
-  VkDeviceMemory vboMemory;
-  void *vbo_data;
-  VkBuffer ubo;
-  VkDeviceMemory uboMemory;
-  void *ubo_data;
-  VkDescriptorSet descriptorSet;
 };
 
 struct gears {
   VkDevice device;
-  VkImage colorImage;
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  struct memory_block *memory;
+  VkSwapchainKHR swapchain;
+  struct image *image;
+  uint32_t nb_images;
   VkImage depthImage;
   VkImage textureImage;
-  VkDeviceMemory depthMemory;
-  VkDeviceMemory textureMemory;
-  VkImageView imageView[2];
+  VkImageView depthView;
   VkImageView texture;
   VkSampler sampler;
-  VkFramebuffer framebuffer;
   VkRenderPass renderPass;
   VkDescriptorSetLayout descriptorSetLayout;
   VkPipelineLayout pipelineLayout;
   VkPipeline pipeline;
   VkCommandPool commandPool;
-  VkCommandBuffer commandBuffer;
+  VkCommandBuffer uploadCommandBuffer;
+  VkBuffer *staging;
+  int nb_staging;
+  struct frame frame[MAX_FRAMES];
+  int nb_frames;
+  int current;
+  struct thread *thread;
+  int nb_threads;
+  pthread_mutex_t record_mutex;
+  pthread_cond_t record_cond;
+  pthread_cond_t record_done_cond;
+  int record;
+  int record_pending;
+  int record_quit;
+  VkFramebuffer record_framebuffer;
+  float record_model_rz;
+  uint64_t record_time;
+  int nb_timestamps;
+  double timestampPeriod;
+  uint64_t timestampMask;
+  uint64_t *timestamps;
+  int statistics;
+  int queries_ready;
+  uint64_t gpu_time;
+  uint64_t gpu_statistics[2];
+  int nb_queries;
+  double gpu_time_sum;
+  double *gear_time_sum;
   VkDescriptorPool descriptorPool;
-  struct gear *gear[3];
+  VkDescriptorSet descriptorSet;
+  VkBuffer readbackBuffer;
+  void *readback_data;
+  int width;
+  int height;
+  int layout;
+  const scene_t *scene;
+  struct gear **gear;
   float Projection[16];
   float View[16];
 };
 
-static void delete_gear(gears_t *gears, int id)
+/* first memory type with the required properties, preferably with the preferred ones too */
+static int memory_type(gears_t *gears, uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
 {
-  struct gear *gear = gears->gear[id];
+  VkMemoryPropertyFlags flags;
+  int type = -1, i;
 
-  if (!gear) {
-    return;
+  for (i = 0; i < gears->memoryProperties.memoryTypeCount; i++) {
+    flags = gears->memoryProperties.memoryTypes[i].propertyFlags;
+    if (!(typeBits & (1 << i)) || (flags & required) != required) {
+      continue;
+    }
+    if ((flags & preferred) == preferred) {
+      return i;
+    }
+    if (type == -1) {
+      type = i;
+    }
   }
 
-  if (gear->descriptorSet) {
-   vkFreeDescriptorSets(gears->device, gears->descriptorPool, 1, &gear->descriptorSet);
+  return type;
+}
+
+static int memory_alloc(gears_t *gears, const VkMemoryRequirements *memoryRequirements, int pool, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkDeviceMemory *memory, VkDeviceSize *offset, void **data)
+{
+  struct memory_block *block;
+  VkDeviceSize start = 0;
+  VkMemoryAllocateInfo memoryAllocateInfo;
+  VkResult res;
+  int type;
+
+  type = memory_type(gears, memoryRequirements->memoryTypeBits, required, preferred);
+  if (type == -1) {
+    printf("memory_type failed: 0x%x, 0x%x\n", memoryRequirements->memoryTypeBits, required);
+    return -1;
   }
-  if (gear->ubo_data) {
-    vkUnmapMemory(gears->device, gear->uboMemory);
+
+  for (block = gears->memory; block; block = block->next) {
+    if (block->type != type || block->pool != pool) {
+      continue;
+    }
+    start = (block->offset + memoryRequirements->alignment - 1) / memoryRequirements->alignment * memoryRequirements->alignment;
+    if (start + memoryRequirements->size <= block->size) {
+      break;
+    }
   }
-  if (gear->uboMemory) {
-    vkFreeMemory(gears->device, gear->uboMemory, NULL);
+
+  if (!block) {
+    block = calloc(1, sizeof(struct memory_block));
+    if (!block) {
+      printf("calloc memory_block failed\n");
+      return -1;
+    }
+
+    block->type = type;
+    block->pool = pool;
+    block->size = memoryRequirements->size > MEMORY_BLOCK_SIZE ? memoryRequirements->size : MEMORY_BLOCK_SIZE;
+
+    memset(&memoryAllocateInfo, 0, sizeof(VkMemoryAllocateInfo));
+    memoryAllocateInfo.allocationSize = block->size;
+    memoryAllocateInfo.memoryTypeIndex = type;
+    res = vkAllocateMemory(gears->device, &memoryAllocateInfo, NULL, &block->memory);
+    if (res) {
+      printf("vkAllocateMemory failed: %d\n", res);
+      free(block);
+      return -1;
+    }
+
+    if (gears->memoryProperties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+      res = vkMapMemory(gears->device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->data);
+      if (res) {
+        printf("vkMapMemory failed: %d\n", res);
+        vkFreeMemory(gears->device, block->memory, NULL);
+        free(block);
+        return -1;
+      }
+    }
+
+    block->next = gears->memory;
+    gears->memory = block;
+    start = 0;
   }
-  if (gear->ubo) {
-    vkDestroyBuffer(gears->device, gear->ubo, NULL);
+
+  block->offset = start + memoryRequirements->size;
+
+  *memory = block->memory;
+  *offset = start;
+  if (data) {
+    *data = block->data ? (char *)block->data + start : NULL;
   }
-  if (gear->vbo_data) {
-    vkUnmapMemory(gears->device, gear->vboMemory);
+
+  return 0;
+}
+
+static void memory_free(gears_t *gears, int pool)
+{
+  struct memory_block **prev = &gears->memory, *block;
+
+  while (*prev) {
+    block = *prev;
+    if (pool != MEMORY_ALL && block->pool != pool) {
+      prev = &block->next;
+      continue;
+    }
+    *prev = block->next;
+    if (block->data) {
+      vkUnmapMemory(gears->device, block->memory);
+    }
+    vkFreeMemory(gears->device, block->memory, NULL);
+    free(block);
   }
-  if (gear->vboMemory) {
-    vkFreeMemory(gears->device, gear->vboMemory, NULL);
+}
+
+/* host-visible buffer read by the upload command buffer, returns its mapped data */
+static void *staging_alloc(gears_t *gears, VkDeviceSize size, VkBuffer *buffer)
+{
+  VkResult res = VK_SUCCESS;
+  VkBuffer *staging;
+  VkBufferCreateInfo bufferCreateInfo;
+  VkMemoryRequirements memoryRequirements;
+  VkDeviceMemory memory;
+  VkDeviceSize offset;
+  void *data = NULL;
+
+  staging = realloc(gears->staging, (gears->nb_staging + 1) * sizeof(VkBuffer));
+  if (!staging) {
+    printf("realloc staging failed\n");
+    return NULL;
   }
-  if (gear->vbo) {
-    vkDestroyBuffer(gears->device, gear->vbo, NULL);
+
+  gears->staging = staging;
+
+  memset(&bufferCreateInfo, 0, sizeof(VkBufferCreateInfo));
+  bufferCreateInfo.size = size;
+  bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  res = vkCreateBuffer(gears->device, &bufferCreateInfo, NULL, &gears->staging[gears->nb_staging]);
+  if (res) {
+    printf("vkCreateBuffer failed: %d\n", res);
+    return NULL;
   }
-  if (gear->strips) {
-    free(gear->strips);
+
+  *buffer = gears->staging[gears->nb_staging++];
+
+  memset(&memoryRequirements, 0, sizeof(VkMemoryRequirements));
+  vkGetBufferMemoryRequirements(gears->device, *buffer, &memoryRequirements);
+
+  if (memory_alloc(gears, &memoryRequirements, MEMORY_STAGING, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, &memory, &offset, &data)) {
+    return NULL;
   }
-  if (gear->vertices) {
-    free(gear->vertices);
+  res = vkBindBufferMemory(gears->device, *buffer, memory, offset);
+  if (res) {
+    printf("vkBindBufferMemory failed: %d\n", res);
+    return NULL;
   }
 
-  free(gear);
-
-  gears->gear[id] = NULL;
+  return data;
 }
 
-static int create_gear(gears_t *gears, int id, float inner, float outer, float width, int teeth, float tooth_depth)
+/* submit the copies recorded in the upload command buffer, then release the staging buffers */
+static int staging_submit(gears_t *gears)
 {
-  struct gear *gear;
-  float r0, r1, r2, da, a1, ai, s[5], c[5];
-  int i, j;
-  float n[3], t[2];
-  int k = 0;
   VkResult res = VK_SUCCESS;
-  VkBufferCreateInfo bufferCreateInfo;
-  VkMemoryAllocateInfo memoryAllocateInfo;
-  VkDeviceSize offset = 0;
-  VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
-  VkWriteDescriptorSet writeDescriptorSet[2];
-  VkDescriptorBufferInfo descriptorBufferInfo;
-  VkDescriptorImageInfo descriptorImageInfo;
+  VkQueue queue;
+  VkMemoryBarrier memoryBarrier;
+  VkSubmitInfo submitInfo;
+  int i;
 
-  gear = calloc(1, sizeof(struct gear));
-  if (!gear) {
-    printf("calloc gear failed\n");
+  /* vertex buffers written by the copies are read by the next frames */
+
+  memset(&memoryBarrier, 0, sizeof(VkMemoryBarrier));
+  memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+  vkCmdPipelineBarrier(gears->uploadCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+
+  res = vkEndCommandBuffer(gears->uploadCommandBuffer);
+  if (res) {
+    printf("vkEndCommandBuffer failed: %d\n", res);
     return -1;
   }
 
-  gears->gear[id] = gear;
+  vkGetDeviceQueue(gears->device, 0, 0, &queue);
 
-  gear->nvertices = 0;
-  gear->vertices = calloc(34 * teeth, sizeof(Vertex));
-  if (!gear->vertices) {
-    printf("calloc vertices failed\n");
+  memset(&submitInfo, 0, sizeof(VkSubmitInfo));
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &gears->uploadCommandBuffer;
+  res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+  if (res) {
+    printf("vkQueueSubmit failed: %d\n", res);
+    return -1;
+  }
+
+  res = vkQueueWaitIdle(queue);
+  if (res) {
+    printf("vkQueueWaitIdle failed: %d\n", res);
+    return -1;
+  }
+
+  vkFreeCommandBuffers(gears->device, gears->commandPool, 1, &gears->uploadCommandBuffer);
+  gears->uploadCommandBuffer = VK_NULL_HANDLE;
+
+  for (i = gears->nb_staging - 1; i >= 0; i--) {
+    vkDestroyBuffer(gears->device, gears->staging[i], NULL);
+  }
+  free(gears->staging);
+  gears->staging = NULL;
+  gears->nb_staging = 0;
+
+  memory_free(gears, MEMORY_STAGING);
+
+  return 0;
+}
+
+/* pipeline cache saved in PIPELINE_CACHE directory, one file per device,
+   the data is only reused if its header matches the device */
+
+static char *pipeline_cache_filename(const VkPhysicalDeviceProperties *physicalDeviceProperties)
+{
+  char *filename = NULL;
+
+  if (!options.pipeline_cache) {
+    return NULL;
+  }
+
+  if (asprintf(&filename, "%s/yagears2-vk-%04x-%04x.cache", options.pipeline_cache, physicalDeviceProperties->vendorID, physicalDeviceProperties->deviceID) == -1) {
+    printf("asprintf failed\n");
+    return NULL;
+  }
+
+  return filename;
+}
+
+static void *pipeline_cache_load(const char *filename, const VkPhysicalDeviceProperties *physicalDeviceProperties, size_t *size)
+{
+  FILE *file;
+  long file_size;
+  uint32_t header[4];
+  void *data = NULL;
+
+  *size = 0;
+
+  file = fopen(filename, "rb");
+  if (!file) {
+    return NULL;
+  }
+
+  fseek(file, 0, SEEK_END);
+  file_size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if (file_size < (long)(sizeof(header) + VK_UUID_SIZE)) {
     goto out;
   }
 
-  gear->nstrips = 7 * teeth;
-  gear->strips = calloc(gear->nstrips, sizeof(Strip));
-  if (!gear->strips) {
-    printf("calloc strips failed\n");
+  data = malloc(file_size);
+  if (!data) {
+    printf("malloc pipeline cache failed\n");
     goto out;
   }
 
-  r0 = inner;
-  r1 = outer - tooth_depth / 2;
-  r2 = outer + tooth_depth / 2;
-  a1 = 2 * M_PI / teeth;
-  da = a1 / 4;
-
-  #define normal(nx, ny, nz) \
-    n[0] = nx; \
-    n[1] = ny; \
-    n[2] = nz;
-
-  #define texcoord(tx, ty) \
-    t[0] = tx; \
-    t[1] = ty;
-
-  #define vertex(x, y, z) \
-    gear->vertices[gear->nvertices][0] = x; \
-    gear->vertices[gear->nvertices][1] = y; \
-    gear->vertices[gear->nvertices][2] = z; \
-    gear->vertices[gear->nvertices][3] = n[0]; \
-    gear->vertices[gear->nvertices][4] = n[1]; \
-    gear->vertices[gear->nvertices][5] = n[2]; \
-    gear->vertices[gear->nvertices][6] = t[0]; \
-    gear->vertices[gear->nvertices][7] = t[1]; \
-    gear->nvertices++;
-
-  for (i = 0; i < teeth; i++) {
-    ai = i * a1;
-    for (j = 0; j < 5; j++) {
-      sincosf(ai + j * da, &s[j], &c[j]);
-    }
+  if (fread(data, 1, file_size, file) != file_size) {
+    printf("fread %s failed\n", filename);
+    goto out;
+  }
+
+  /* header size, header version, vendor ID, device ID, then pipeline cache UUID */
 
-    /* front face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* front face normal */
-    normal(0, 0, 1);
-    /* front face vertices */
-    texcoord(0.36 * r2 * s[1] / r1 + 0.5, 0.36 * r2 * c[1] / r1 + 0.5);
-    vertex(r2 * c[1], -r2 * s[1], width / 2);
-    texcoord(0.36 * r2 * s[2] / r1 + 0.5, 0.36 * r2 * c[2] / r1 + 0.5);
-    vertex(r2 * c[2], -r2 * s[2], width / 2);
-    texcoord(0.36 * r1 * s[0] / r1 + 0.5, 0.36 * r1 * c[0] / r1 + 0.5);
-    vertex(r1 * c[0], -r1 * s[0], width / 2);
-    texcoord(0.36 * r1 * s[3] / r1 + 0.5, 0.36 * r1 * c[3] / r1 + 0.5);
-    vertex(r1 * c[3], -r1 * s[3], width / 2);
-    texcoord(0.36 * r0 * s[0] / r1 + 0.5, 0.36 * r0 * c[0] / r1 + 0.5);
-    vertex(r0 * c[0], -r0 * s[0], width / 2);
-    texcoord(0.36 * r1 * s[4] / r1 + 0.5, 0.36 * r1 * c[4] / r1 + 0.5);
-    vertex(r1 * c[4], -r1 * s[4], width / 2);
-    texcoord(0.36 * r0 * s[4] / r1 + 0.5, 0.36 * r0 * c[4] / r1 + 0.5);
-    vertex(r0 * c[4], -r0 * s[4], width / 2);
-    texcoord(0, 0);
-    /* front face end */
-    gear->strips[k].count = 7;
-    k++;
-
-    /* back face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* back face normal */
-    normal(0, 0, -1);
-    /* back face vertices */
-    vertex(r2 * c[1], -r2 * s[1], -width / 2);
-    vertex(r2 * c[2], -r2 * s[2], -width / 2);
-    vertex(r1 * c[0], -r1 * s[0], -width / 2);
-    vertex(r1 * c[3], -r1 * s[3], -width / 2);
-    vertex(r0 * c[0], -r0 * s[0], -width / 2);
-    vertex(r1 * c[4], -r1 * s[4], -width / 2);
-    vertex(r0 * c[4], -r0 * s[4], -width / 2);
-    /* back face end */
-    gear->strips[k].count = 7;
-    k++;
-
-    /* first outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* first outward face normal */
-    normal(r2 * s[1] - r1 * s[0], r2 * c[1] - r1 * c[0], 0);
-    /* first outward face vertices */
-    vertex(r1 * c[0], -r1 * s[0],  width / 2);
-    vertex(r1 * c[0], -r1 * s[0], -width / 2);
-    vertex(r2 * c[1], -r2 * s[1],  width / 2);
-    vertex(r2 * c[1], -r2 * s[1], -width / 2);
-    /* first outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* second outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* second outward face normal */
-    normal(s[2] - s[1], c[2] - c[1], 0);
-    /* second outward face vertices */
-    vertex(r2 * c[1], -r2 * s[1],  width / 2);
-    vertex(r2 * c[1], -r2 * s[1], -width / 2);
-    vertex(r2 * c[2], -r2 * s[2],  width / 2);
-    vertex(r2 * c[2], -r2 * s[2], -width / 2);
-    /* second outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* third outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* third outward face normal */
-    normal(r1 * s[3] - r2 * s[2], r1 * c[3] - r2 * c[2], 0);
-    /* third outward face vertices */
-    vertex(r2 * c[2], -r2 * s[2],  width / 2);
-    vertex(r2 * c[2], -r2 * s[2], -width / 2);
-    vertex(r1 * c[3], -r1 * s[3],  width / 2);
-    vertex(r1 * c[3], -r1 * s[3], -width / 2);
-    /* third outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* fourth outward face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* fourth outward face normal */
-    normal(s[4] - s[3], c[4] - c[3], 0);
-    /* fourth outward face vertices */
-    vertex(r1 * c[3], -r1 * s[3],  width / 2);
-    vertex(r1 * c[3], -r1 * s[3], -width / 2);
-    vertex(r1 * c[4], -r1 * s[4],  width / 2);
-    vertex(r1 * c[4], -r1 * s[4], -width / 2);
-    /* fourth outward face end */
-    gear->strips[k].count = 4;
-    k++;
-
-    /* inside face begin */
-    gear->strips[k].begin = gear->nvertices;
-    /* inside face normal */
-    normal(s[0] - s[4], c[0] - c[4], 0);
-    /* inside face vertices */
-    vertex(r0 * c[0], -r0 * s[0],  width / 2);
-    vertex(r0 * c[0], -r0 * s[0], -width / 2);
-    vertex(r0 * c[4], -r0 * s[4],  width / 2);
-    vertex(r0 * c[4], -r0 * s[4], -width / 2);
-    /* inside face end */
-    gear->strips[k].count = 4;
-    k++;
+  memcpy(header, data, sizeof(header));
+  if (header[0] < sizeof(header) + VK_UUID_SIZE || header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || header[2] != physicalDeviceProperties->vendorID || header[3] != physicalDeviceProperties->deviceID || memcmp((char *)data + sizeof(header), physicalDeviceProperties->pipelineCacheUUID, VK_UUID_SIZE)) {
+    printf("%s: Pipeline cache not valid for this device\n", filename);
+    goto out;
   }
 
-  /* vertex buffer object */
+  fclose(file);
+  *size = file_size;
+  return data;
 
-  memset(&bufferCreateInfo, 0, sizeof(VkBufferCreateInfo));
-  res = vkCreateBuffer(gears->device, &bufferCreateInfo, NULL, &gear->vbo);
+out:
+  free(data);
+  fclose(file);
+  return NULL;
+}
+
+static void pipeline_cache_save(gears_t *gears, VkPipelineCache pipelineCache, const char *filename)
+{
+  VkResult res = VK_SUCCESS;
+  size_t size = 0;
+  void *data = NULL;
+  char *tmp_filename = NULL;
+  FILE *file;
+
+  res = vkGetPipelineCacheData(gears->device, pipelineCache, &size, NULL);
+  if (res || !size) {
+    printf("vkGetPipelineCacheData failed: %d, %zu\n", res, size);
+    return;
+  }
+
+  data = malloc(size);
+  if (!data) {
+    printf("malloc pipeline cache failed\n");
+    return;
+  }
+
+  res = vkGetPipelineCacheData(gears->device, pipelineCache, &size, data);
   if (res) {
-    printf("vkCreateBuffer failed: %d\n", res);
+    printf("vkGetPipelineCacheData failed: %d\n", res);
     goto out;
   }
-  memset(&memoryAllocateInfo, 0, sizeof(VkMemoryAllocateInfo));
-  memoryAllocateInfo.allocationSize = gear->nvertices * sizeof(Vertex);
-  res = vkAllocateMemory(gears->device, &memoryAllocateInfo, NULL, &gear->vboMemory);
-  if (res) {
-    printf("vkAllocateMemory failed: %d\n", res);
+
+  /* written next to the cache file then renamed, so that a concurrent launch never reads a partial file */
+
+  if (asprintf(&tmp_filename, "%s.%d", filename, getpid()) == -1) {
+    printf("asprintf failed\n");
+    tmp_filename = NULL;
     goto out;
   }
-  res = vkMapMemory(gears->device, gear->vboMemory, 0, gear->nvertices * sizeof(Vertex), 0, &gear->vbo_data);
-  if (res) {
-    printf("vkMapMemory failed: %d\n", res);
+
+  file = fopen(tmp_filename, "wb");
+  if (!file) {
+    printf("fopen %s failed: %m\n", tmp_filename);
     goto out;
   }
-  res = vkBindBufferMemory(gears->device, gear->vbo, gear->vboMemory, 0);
-  if (res) {
-    printf("vkBindBufferMemory failed: %d\n", res);
+
+  if (fwrite(data, 1, size, file) != size) {
+    printf("fwrite %s failed\n", tmp_filename);
+    fclose(file);
+    unlink(tmp_filename);
     goto out;
   }
 
-  vkCmdBindVertexBuffers(gears->commandBuffer, 0, 1, &gear->vbo, &offset);
+  fclose(file);
 
-  memcpy(gear->vbo_data, gear->vertices, gear->nvertices * sizeof(Vertex));
+  if (rename(tmp_filename, filename)) {
+    printf("rename %s failed: %m\n", tmp_filename);
+    unlink(tmp_filename);
+  }
 
-  /* uniform buffer object */
+out:
+  free(tmp_filename);
+  free(data);
+}
 
-  memset(&bufferCreateInfo, 0, sizeof(VkBufferCreateInfo));
-  res = vkCreateBuffer(gears->device, &bufferCreateInfo, NULL, &gear->ubo);
-  if (res) {
-    printf("vkCreateBuffer failed: %d\n", res);
+static void delete_gear(gears_t *gears, int id)
+{
+  struct gear *gear = gears->gear[id];
+
+  if (!gear) {
+    return;
+  }
+
+  if (gear->vbo) {
+    vkDestroyBuffer(gears->device, gear->vbo, NULL);
+  }
+
+  free(gear);
+
+  gears->gear[id] = NULL;
+}
+
+static int create_gear(gears_t *gears, int id, float inner, float outer, float width, int teeth, float tooth_depth)
+{
+  struct gear *gear;
+  VkResult res = VK_SUCCESS;
+  VkBufferCreateInfo bufferCreateInfo;
+  VkMemoryRequirements memoryRequirements;
+  VkDeviceMemory memory;
+  VkDeviceSize offset;
+  VkBuffer stagingBuffer;
+  VkBufferCopy bufferCopy;
+  void *vbo_data;
+
+  gear = calloc(1, sizeof(struct gear));
+  if (!gear) {
+    printf("calloc gear failed\n");
+    return -1;
+  }
+
+  gears->gear[id] = gear;
+
+  gear->mesh = mesh_get(inner, outer, width, teeth, tooth_depth, gears->layout);
+  if (!gear->mesh) {
     goto out;
   }
-  memset(&memoryAllocateInfo, 0, sizeof(VkMemoryAllocateInfo));
-  memoryAllocateInfo.allocationSize = sizeof(struct Uniform);
-  res = vkAllocateMemory(gears->device, &memoryAllocateInfo, NULL, &gear->uboMemory);
+
+  /* vertex buffer object */
+
+  memset(&bufferCreateInfo, 0, sizeof(VkBufferCreateInfo));
+  bufferCreateInfo.size = gear->mesh->nvertices * gear->mesh->stride + gear->mesh->ninstances * 2 * sizeof(float);
+  bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  res = vkCreateBuffer(gears->device, &bufferCreateInfo, NULL, &gear->vbo);
   if (res) {
-    printf("vkAllocateMemory failed: %d\n", res);
+    printf("vkCreateBuffer failed: %d\n", res);
     goto out;
   }
-  res = vkMapMemory(gears->device, gear->uboMemory, 0, sizeof(struct Uniform), 0, &gear->ubo_data);
-  if (res) {
-    printf("vkMapMemory failed: %d\n", res);
+
+  memset(&memoryRequirements, 0, sizeof(VkMemoryRequirements));
+  vkGetBufferMemoryRequirements(gears->device, gear->vbo, &memoryRequirements);
+
+  if (memory_alloc(gears, &memoryRequirements, MEMORY_LINEAR, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory, &offset, NULL)) {
     goto out;
   }
-  res = vkBindBufferMemory(gears->device, gear->ubo, gear->uboMemory, 0);
+  res = vkBindBufferMemory(gears->device, gear->vbo, memory, offset);
   if (res) {
     printf("vkBindBufferMemory failed: %d\n", res);
     goto out;
   }
 
-  memset(&descriptorSetAllocateInfo, 0, sizeof(VkDescriptorSetAllocateInfo));
-  descriptorSetAllocateInfo.descriptorPool = gears->descriptorPool;
-  descriptorSetAllocateInfo.descriptorSetCount = 1;
-  descriptorSetAllocateInfo.pSetLayouts = &gears->descriptorSetLayout;
-  res = vkAllocateDescriptorSets(gears->device, &descriptorSetAllocateInfo, &gear->descriptorSet);
-  if (res) {
-    printf("vkAllocateDescriptorSets failed: %d\n", res);
+  /* per-vertex data followed by per-instance data, copied from a staging buffer */
+
+  vbo_data = staging_alloc(gears, bufferCreateInfo.size, &stagingBuffer);
+  if (!vbo_data) {
     goto out;
   }
 
-  memset(&writeDescriptorSet[0], 0, sizeof(VkWriteDescriptorSet));
-  writeDescriptorSet[0].dstSet = gear->descriptorSet;
-  writeDescriptorSet[1].dstBinding = 0;
-  writeDescriptorSet[0].descriptorCount = 1;
-  writeDescriptorSet[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  memset(&descriptorBufferInfo, 0, sizeof(VkDescriptorBufferInfo));
-  descriptorBufferInfo.buffer = gear->ubo;
-  writeDescriptorSet[0].pBufferInfo = &descriptorBufferInfo;
-  memset(&writeDescriptorSet[1], 0, sizeof(VkWriteDescriptorSet));
-  writeDescriptorSet[1].dstSet = gear->descriptorSet;
-  writeDescriptorSet[1].dstBinding = 1;
-  writeDescriptorSet[1].descriptorCount = 1;
-  writeDescriptorSet[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  memset(&descriptorImageInfo, 0, sizeof(VkDescriptorImageInfo));
-  descriptorImageInfo.sampler = gears->sampler;
-  descriptorImageInfo.imageView = gears->texture;
-  writeDescriptorSet[1].pImageInfo = &descriptorImageInfo;
-  vkUpdateDescriptorSets(gears->device, 2, writeDescriptorSet, 0, NULL);
-
-  vkCmdBindDescriptorSets(gears->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gears->pipelineLayout, 0, 1, &gear->descriptorSet, 0, NULL);
+  memcpy(vbo_data, gear->mesh->vertices, gear->mesh->nvertices * gear->mesh->stride);
+  memcpy((char *)vbo_data + gear->mesh->nvertices * gear->mesh->stride, gear->mesh->instances, gear->mesh->ninstances * 2 * sizeof(float));
 
-  for (k = 0; k < gear->nstrips; k++)
-    vkCmdDraw(gears->commandBuffer, gear->strips[k].count, 1, gear->strips[k].begin, 0);
+  memset(&bufferCopy, 0, sizeof(VkBufferCopy));
+  bufferCopy.size = bufferCreateInfo.size;
+  vkCmdCopyBuffer(gears->uploadCommandBuffer, stagingBuffer, gear->vbo, 1, &bufferCopy);
 
   return 0;
 
@@ -485,64 +610,298 @@ out:
   return -1;
 }
 
-static void draw_gear(gears_t *gears, int id, float model_tx, float model_ty, float model_rz, const float *color)
+static void draw_gear(gears_t *gears, VkCommandBuffer commandBuffer, int id, float model_tx, float model_ty, float model_rz, const float *color)
 {
   struct gear *gear = gears->gear[id];
   const float pos[4] = { 5.0, -5.0, 10.0, 0.0 };
   float ModelView[16], ModelViewProjection[16];
-  struct Uniform u;
+  struct PushConstants u;
+  VkDeviceSize offset[2];
+  VkBuffer buffer[2];
+  int k;
 
   if (!gear) {
     return;
   }
 
-  memcpy(u.LightPos, pos, sizeof(pos));
-
   memcpy(ModelView, gears->View, sizeof(ModelView));
 
-  translate(ModelView, model_tx, model_ty, 0);
-  rotate(ModelView, model_rz, 0, 0, 1);
+  /* y axis pointing down: rotations around x and z are reversed */
+
+  mat4_translate(ModelView, model_tx, model_ty, 0);
+  mat4_rotate_z(ModelView, -model_rz);
 
   memcpy(ModelViewProjection, gears->Projection, sizeof(ModelViewProjection));
-  multiply(ModelViewProjection, ModelView);
+  mat4_multiply(ModelViewProjection, ModelView);
   memcpy(u.ModelViewProjection, ModelViewProjection, sizeof(ModelViewProjection));
 
-  invert(ModelView);
-  transpose(ModelView);
-  memcpy(u.NormalMatrix, ModelView, sizeof(ModelView));
+  /* the inverse rotation brings the light direction into object space */
+
+  mat4_rigid_invert(ModelView);
+  for (k = 0; k < 3; k++)
+    u.LightDir[k] = ModelView[k] * pos[0] + ModelView[4 + k] * pos[1] + ModelView[8 + k] * pos[2];
+  u.LightDir[3] = 0;
 
   memcpy(u.Color, color, sizeof(u.Color));
 
-  if (getenv("NO_TEXTURE"))
+  if (options.no_texture)
     u.TextureEnable = 0;
   else
     u.TextureEnable = 1;
 
-  memcpy(gear->ubo_data, &u, sizeof(struct Uniform));
+  vkCmdPushConstants(commandBuffer, gears->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(struct PushConstants), &u);
+
+  /* per-vertex data followed by per-instance data */
+
+  buffer[0] = buffer[1] = gear->vbo;
+  offset[0] = 0;
+  offset[1] = gear->mesh->nvertices * gear->mesh->stride;
+  vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffer, offset);
+
+  for (k = 0; k < gear->mesh->nstrips; k++)
+    vkCmdDraw(commandBuffer, gear->mesh->strips[k].count, gear->mesh->ninstances, gear->mesh->strips[k].begin, 0);
+}
+
+/* state and draws of the gears from first to last - 1 */
+static void record_gears(gears_t *gears, VkCommandBuffer commandBuffer, int first, int last, float model_rz)
+{
+  const gear_desc_t *gear_desc;
+  VkRect2D scissor;
+  VkViewport viewport;
+  int i;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gears->pipeline);
+
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gears->pipelineLayout, 0, 1, &gears->descriptorSet, 0, NULL);
+
+  memset(&scissor, 0, sizeof(VkRect2D));
+  scissor.extent.width = gears->width;
+  scissor.extent.height = gears->height;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  memset(&viewport, 0, sizeof(VkViewport));
+  viewport.width = gears->width;
+  viewport.height = gears->height;
+  viewport.maxDepth = 1;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  for (i = first; i < last; i++) {
+    gear_desc = &gears->scene->gear[i];
+    draw_gear(gears, commandBuffer, i, gear_desc->tx, -gear_desc->ty, gear_desc->ratio * model_rz + gear_desc->phase, gear_desc->color);
+    if (gears->nb_timestamps) {
+      vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, gears->frame[gears->current].timestampPool, 1 + i);
+    }
+  }
+}
+
+static VkResult record_secondary(struct thread *thread)
+{
+  gears_t *gears = thread->gears;
+  VkCommandBuffer commandBuffer = thread->commandBuffer[gears->current];
+  VkResult res = VK_SUCCESS;
+  VkCommandBufferInheritanceInfo commandBufferInheritanceInfo;
+  VkCommandBufferBeginInfo commandBufferBeginInfo;
+
+  res = vkResetCommandBuffer(commandBuffer, 0);
+  if (res) {
+    printf("vkResetCommandBuffer failed: %d\n", res);
+    return res;
+  }
+
+  memset(&commandBufferInheritanceInfo, 0, sizeof(VkCommandBufferInheritanceInfo));
+  commandBufferInheritanceInfo.renderPass = gears->renderPass;
+  commandBufferInheritanceInfo.framebuffer = gears->record_framebuffer;
+  if (gears->statistics) {
+    commandBufferInheritanceInfo.pipelineStatistics = PIPELINE_STATISTICS;
+  }
+  memset(&commandBufferBeginInfo, 0, sizeof(VkCommandBufferBeginInfo));
+  commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  commandBufferBeginInfo.pInheritanceInfo = &commandBufferInheritanceInfo;
+  res = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+  if (res) {
+    printf("vkBeginCommandBuffer failed: %d\n", res);
+    return res;
+  }
+
+  record_gears(gears, commandBuffer, thread->first, thread->last, gears->record_model_rz);
+
+  res = vkEndCommandBuffer(commandBuffer);
+  if (res) {
+    printf("vkEndCommandBuffer failed: %d\n", res);
+  }
+
+  return res;
+}
+
+/* worker thread: records its gears each time the record counter is incremented */
+static void *record_thread(void *arg)
+{
+  struct thread *thread = arg;
+  gears_t *gears = thread->gears;
+  int quit;
+
+  while (1) {
+    pthread_mutex_lock(&gears->record_mutex);
+    while (thread->record == gears->record && !gears->record_quit) {
+      pthread_cond_wait(&gears->record_cond, &gears->record_mutex);
+    }
+    thread->record = gears->record;
+    quit = gears->record_quit;
+    pthread_mutex_unlock(&gears->record_mutex);
+
+    if (quit) {
+      break;
+    }
+
+    thread->res = record_secondary(thread);
+
+    pthread_mutex_lock(&gears->record_mutex);
+    if (--gears->record_pending == 0) {
+      pthread_cond_signal(&gears->record_done_cond);
+    }
+    pthread_mutex_unlock(&gears->record_mutex);
+  }
+
+  return NULL;
+}
+
+/* results of the queries of a frame whose fence has been waited, so available without stalling */
+static void read_queries(gears_t *gears, struct frame *frame)
+{
+  VkResult res = VK_SUCCESS;
+  int i;
+
+  gears->queries_ready = 0;
+
+  if (gears->nb_timestamps) {
+    res = vkGetQueryPoolResults(gears->device, frame->timestampPool, 0, gears->nb_timestamps, gears->nb_timestamps * sizeof(uint64_t), gears->timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (res) {
+      return;
+    }
+
+    gears->gpu_time = ((gears->timestamps[gears->nb_timestamps - 1] - gears->timestamps[0]) & gears->timestampMask) * gears->timestampPeriod;
+    gears->gpu_time_sum += gears->gpu_time;
+    for (i = 0; i < gears->scene->nb; i++) {
+      gears->gear_time_sum[i] += ((gears->timestamps[1 + i] - gears->timestamps[i]) & gears->timestampMask) * gears->timestampPeriod;
+    }
+  }
+
+  if (gears->statistics) {
+    res = vkGetQueryPoolResults(gears->device, frame->statisticsPool, 0, 1, sizeof(gears->gpu_statistics), gears->gpu_statistics, sizeof(gears->gpu_statistics), VK_QUERY_RESULT_64_BIT);
+    if (res) {
+      return;
+    }
+  }
+
+  gears->nb_queries++;
+  gears->queries_ready = 1;
 }
 
 /******************************************************************************/
 
 void vk_gears_term(gears_t *gears)
 {
+  int i, min, max;
+  double sum;
+
   if (!gears) {
     return;
   }
 
-  if (gears->gear[GEAR2]) {
-    delete_gear(gears, GEAR2);
+  if (gears->thread) {
+    pthread_mutex_lock(&gears->record_mutex);
+    gears->record_quit = 1;
+    pthread_cond_broadcast(&gears->record_cond);
+    pthread_mutex_unlock(&gears->record_mutex);
+    for (i = gears->nb_threads - 1; i >= 0; i--) {
+      if (gears->thread[i].started) {
+        pthread_join(gears->thread[i].thread, NULL);
+      }
+    }
   }
-  if (gears->gear[GEAR1]) {
-    delete_gear(gears, GEAR1);
+
+  if (gears->device) {
+    vkDeviceWaitIdle(gears->device);
+  }
+
+  /* per gear, an aggregate is printed whatever the size of the scene: gear 0
+     is apart as it is measured from the first timestamp, before the render
+     pass begin and clear */
+
+  if (gears->nb_timestamps && gears->nb_queries) {
+    printf("GPU time: %.3f ms per frame\n", gears->gpu_time_sum / gears->nb_queries / 1000000);
+    printf("  gear 0: %.3f ms (including render pass begin and clear)\n", gears->gear_time_sum[0] / gears->nb_queries / 1000000);
+    if (gears->scene->nb > 1) {
+      min = max = 1;
+      sum = 0;
+      for (i = 1; i < gears->scene->nb; i++) {
+        if (gears->gear_time_sum[i] < gears->gear_time_sum[min]) {
+          min = i;
+        }
+        if (gears->gear_time_sum[i] > gears->gear_time_sum[max]) {
+          max = i;
+        }
+        sum += gears->gear_time_sum[i];
+      }
+      printf("  gears 1-%d: min %.3f ms (gear %d), avg %.3f ms, max %.3f ms (gear %d)\n", gears->scene->nb - 1, gears->gear_time_sum[min] / gears->nb_queries / 1000000, min, sum / (gears->scene->nb - 1) / gears->nb_queries / 1000000, gears->gear_time_sum[max] / gears->nb_queries / 1000000, max);
+    }
   }
-  if (gears->gear[GEAR0]) {
-    delete_gear(gears, GEAR0);
+
+  if (gears->gear) {
+    for (i = gears->scene->nb - 1; i >= 0; i--) {
+      if (gears->gear[i]) {
+        delete_gear(gears, i);
+      }
+    }
+    free(gears->gear);
   }
   if (gears->descriptorPool) {
     vkDestroyDescriptorPool(gears->device, gears->descriptorPool, NULL);
   }
-  if (gears->commandBuffer) {
-    vkFreeCommandBuffers(gears->device, gears->commandPool, 1, &gears->commandBuffer);
+  for (i = gears->nb_frames - 1; i >= 0; i--) {
+    if (gears->frame[i].acquireSemaphore) {
+      vkDestroySemaphore(gears->device, gears->frame[i].acquireSemaphore, NULL);
+    }
+    if (gears->frame[i].fence) {
+      vkDestroyFence(gears->device, gears->frame[i].fence, NULL);
+    }
+    if (gears->frame[i].commandBuffer) {
+      vkFreeCommandBuffers(gears->device, gears->commandPool, 1, &gears->frame[i].commandBuffer);
+    }
+    if (gears->frame[i].statisticsPool) {
+      vkDestroyQueryPool(gears->device, gears->frame[i].statisticsPool, NULL);
+    }
+    if (gears->frame[i].timestampPool) {
+      vkDestroyQueryPool(gears->device, gears->frame[i].timestampPool, NULL);
+    }
+  }
+  if (gears->gear_time_sum) {
+    free(gears->gear_time_sum);
+  }
+  if (gears->timestamps) {
+    free(gears->timestamps);
+  }
+  if (gears->thread) {
+    for (i = gears->nb_threads - 1; i >= 0; i--) {
+      if (gears->thread[i].commandPool) {
+        vkDestroyCommandPool(gears->device, gears->thread[i].commandPool, NULL);
+      }
+    }
+    free(gears->thread);
+  }
+  if (gears->nb_threads) {
+    pthread_cond_destroy(&gears->record_done_cond);
+    pthread_cond_destroy(&gears->record_cond);
+    pthread_mutex_destroy(&gears->record_mutex);
+  }
+  if (gears->staging) {
+    for (i = gears->nb_staging - 1; i >= 0; i--) {
+      vkDestroyBuffer(gears->device, gears->staging[i], NULL);
+    }
+    free(gears->staging);
+  }
+  if (gears->uploadCommandBuffer) {
+    vkFreeCommandBuffers(gears->device, gears->commandPool, 1, &gears->uploadCommandBuffer);
   }
   if (gears->commandPool) {
     vkDestroyCommandPool(gears->device, gears->commandPool, NULL);
@@ -553,10 +912,6 @@ void vk_gears_term(gears_t *gears)
   if (gears->texture) {
     vkDestroyImageView(gears->device, gears->texture, NULL);
   }
-  if (gears->textureMemory) {
-    vkUnmapMemory(gears->device, gears->textureMemory);
-    vkFreeMemory(gears->device, gears->textureMemory, NULL);
-  }
   if (gears->textureImage) {
     vkDestroyImage(gears->device, gears->textureImage, NULL);
   }
@@ -572,56 +927,88 @@ void vk_gears_term(gears_t *gears)
   if (gears->renderPass) {
     vkDestroyRenderPass(gears->device, gears->renderPass, NULL);
   }
-  if (gears->framebuffer) {
-    vkDestroyFramebuffer(gears->device, gears->framebuffer, NULL);
-  }
-  if (gears->imageView[1]) {
-    vkDestroyImageView(gears->device, gears->imageView[1], NULL);
-  }
-  if (gears->imageView[0]) {
-    vkDestroyImageView(gears->device, gears->imageView[0], NULL);
+  if (gears->image) {
+    for (i = gears->nb_images - 1; i >= 0; i--) {
+      if (gears->image[i].renderSemaphore) {
+        vkDestroySemaphore(gears->device, gears->image[i].renderSemaphore, NULL);
+      }
+      if (gears->image[i].framebuffer) {
+        vkDestroyFramebuffer(gears->device, gears->image[i].framebuffer, NULL);
+      }
+      if (gears->image[i].view) {
+        vkDestroyImageView(gears->device, gears->image[i].view, NULL);
+      }
+    }
   }
-  if (gears->depthMemory) {
-    vkFreeMemory(gears->device, gears->depthMemory, NULL);
+  if (gears->depthView) {
+    vkDestroyImageView(gears->device, gears->depthView, NULL);
   }
   if (gears->depthImage) {
     vkDestroyImage(gears->device, gears->depthImage, NULL);
   }
+  if (gears->readbackBuffer) {
+    vkDestroyBuffer(gears->device, gears->readbackBuffer, NULL);
+  }
+  if (gears->image) {
+    for (i = gears->nb_images - 1; i >= 0; i--) {
+      if (!gears->swapchain && gears->image[i].image) {
+        vkDestroyImage(gears->device, gears->image[i].image, NULL);
+      }
+    }
+    free(gears->image);
+  }
+
+  memory_free(gears, MEMORY_ALL);
 
   free(gears);
 }
 
-gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapchain)
+gears_t *vk_gears_init(int win_width, int win_height, const scene_t *scene, void *physical_device, void *device, void *swapchain)
 {
   gears_t *gears = NULL;
+  int i;
   const uint32_t vertShaderSource[] = {
     #include "vert.spv"
   };
   const uint32_t fragShaderSource[] = {
     #include "frag.spv"
   };
-  uint32_t count = 1;
+  VkImage *swapchainImages = NULL;
   VkResult res = VK_SUCCESS;
   VkImageCreateInfo imageCreateInfo;
+  VkBufferCreateInfo bufferCreateInfo;
   VkMemoryRequirements memoryRequirements;
-  VkMemoryAllocateInfo memoryAllocateInfo;
+  VkDeviceMemory memory;
+  VkDeviceSize offset;
   VkImageViewCreateInfo imageViewCreateInfo;
   VkFramebufferCreateInfo framebufferCreateInfo;
   VkRenderPassCreateInfo renderPassCreateInfo;
   VkAttachmentDescription attachmentDescription[2];
   VkSubpassDescription subpassDescription;
   VkAttachmentReference attachmentReference[2];
+  VkSubpassDependency subpassDependency[2];
+  VkImageView attachments[2];
   VkShaderModuleCreateInfo shaderModuleCreateInfo;
   VkShaderModule vertShaderModule = VK_NULL_HANDLE;
   VkShaderModule fragShaderModule = VK_NULL_HANDLE;
   VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
-  VkDescriptorSetLayoutBinding descriptorSetLayoutBinding[2];
+  VkDescriptorSetLayoutBinding descriptorSetLayoutBinding;
+  VkPushConstantRange pushConstantRange;
   VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+  VkPhysicalDeviceProperties physicalDeviceProperties;
+  VkPipelineCacheCreateInfo pipelineCacheCreateInfo;
+  VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+  char *pipeline_cache_file = NULL;
+  void *pipeline_cache_data = NULL;
+  struct timespec ts_start, ts_end;
   VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo;
   VkPipelineShaderStageCreateInfo pipelineShaderStageCreateInfo[2];
+  VkSpecializationInfo specializationInfo;
+  VkSpecializationMapEntry specializationMapEntry;
+  VkBool32 compact;
   VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo;
-  VkVertexInputBindingDescription vertexInputBindingDescription;
-  VkVertexInputAttributeDescription vertexInputAttributeDescription[3];
+  VkVertexInputBindingDescription vertexInputBindingDescription[2];
+  VkVertexInputAttributeDescription vertexInputAttributeDescription[4];
   VkPipelineInputAssemblyStateCreateInfo pipelineInputAssemblyStateCreateInfo;
   VkPipelineViewportStateCreateInfo pipelineViewportStateCreateInfo;
   VkPipelineRasterizationStateCreateInfo pipelineRasterizationStateCreateInfo;
@@ -630,34 +1017,158 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   VkPipelineColorBlendStateCreateInfo pipelineColorBlendStateCreateInfo;
   VkPipelineDynamicStateCreateInfo pipelineDynamicStateCreateInfo;
   VkDynamicState dynamicState[2];
-  int texture_width, texture_height;
+  int texture_width, texture_height, texture_levels;
   void *texture_data = NULL;
+  VkBuffer stagingBuffer;
+  VkImageMemoryBarrier imageMemoryBarrier;
+  VkBufferImageCopy bufferImageCopy;
+  VkImageBlit imageBlit;
   VkSamplerCreateInfo samplerCreateInfo;
   VkCommandPoolCreateInfo commandPoolCreateInfo;
   VkCommandBufferAllocateInfo commandBufferAllocateInfo;
   VkCommandBufferBeginInfo commandBufferBeginInfo;
-  VkRenderPassBeginInfo renderPassBeginInfo;
-  VkClearValue clearValue[2];
-  VkRect2D scissor;
-  VkViewport viewport;
+  VkFenceCreateInfo fenceCreateInfo;
+  VkSemaphoreCreateInfo semaphoreCreateInfo;
+  VkQueueFamilyProperties *queueFamilyProperties = NULL;
+  uint32_t queueFamilyCount = 0;
+  VkPhysicalDeviceFeatures physicalDeviceFeatures;
+  VkQueryPoolCreateInfo queryPoolCreateInfo;
   VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
-  VkDescriptorPoolSize descriptorPoolSize[2];
+  VkDescriptorPoolSize descriptorPoolSize;
+  VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
+  VkWriteDescriptorSet writeDescriptorSet;
+  VkDescriptorImageInfo descriptorImageInfo;
   const float zNear = 5, zFar = 60;
 
-  gears = calloc(1, sizeof(gears_t));
-  if (!gears) {
-    printf("calloc gears failed\n");
-    return NULL;
+  gears = calloc(1, sizeof(gears_t));
+  if (!gears) {
+    printf("calloc gears failed\n");
+    return NULL;
+  }
+
+  gears->scene = scene;
+
+  gears->gear = calloc(scene->nb, sizeof(struct gear *));
+  if (!gears->gear) {
+    printf("calloc gear failed\n");
+    goto out;
+  }
+
+  gears->device = device;
+  gears->swapchain = swapchain;
+  vkGetPhysicalDeviceMemoryProperties(physical_device, &gears->memoryProperties);
+  gears->width = win_width;
+  gears->height = win_height;
+
+  gears->nb_frames = options.frames_in_flight;
+  if (gears->nb_frames < 1) {
+    gears->nb_frames = 1;
+  }
+  else if (gears->nb_frames > MAX_FRAMES) {
+    gears->nb_frames = MAX_FRAMES;
+  }
+
+  gears->layout = MESH_NORMAL | MESH_TEXCOORD | MESH_FLIP_Y;
+
+  if (options.compact) {
+    gears->layout |= MESH_COMPACT;
+  }
+
+  if (options.instanced) {
+    gears->layout |= MESH_INSTANCED;
+  }
+
+  /* color attachments */
+
+  if (swapchain) {
+    res = vkGetSwapchainImagesKHR(gears->device, swapchain, &gears->nb_images, NULL);
+    if (res || !gears->nb_images) {
+      printf("vkGetSwapchainImagesKHR failed: %d, %d\n", res, gears->nb_images);
+      goto out;
+    }
+
+    swapchainImages = calloc(gears->nb_images, sizeof(VkImage));
+    if (!swapchainImages) {
+      printf("calloc swapchainImages failed\n");
+      goto out;
+    }
+
+    res = vkGetSwapchainImagesKHR(gears->device, swapchain, &gears->nb_images, swapchainImages);
+    if (res) {
+      printf("vkGetSwapchainImagesKHR failed: %d\n", res);
+      goto out;
+    }
+  }
+  else {
+    /* offscreen rendering: no swapchain, one color image per frame in flight owned by the device */
+    gears->nb_images = gears->nb_frames;
+  }
+
+  gears->image = calloc(gears->nb_images, sizeof(struct image));
+  if (!gears->image) {
+    printf("calloc image failed\n");
+    goto out;
+  }
+
+  for (i = 0; i < gears->nb_images; i++) {
+    if (swapchain) {
+      gears->image[i].image = swapchainImages[i];
+      continue;
+    }
+
+    memset(&imageCreateInfo, 0, sizeof(VkImageCreateInfo));
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = VK_FORMAT_B8G8R8A8_UNORM;
+    imageCreateInfo.extent.width = win_width;
+    imageCreateInfo.extent.height = win_height;
+    imageCreateInfo.extent.depth = 1;
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    res = vkCreateImage(gears->device, &imageCreateInfo, NULL, &gears->image[i].image);
+    if (res) {
+      printf("vkCreateImage failed: %d\n", res);
+      goto out;
+    }
+
+    memset(&memoryRequirements, 0, sizeof(VkMemoryRequirements));
+    vkGetImageMemoryRequirements(gears->device, gears->image[i].image, &memoryRequirements);
+
+    if (memory_alloc(gears, &memoryRequirements, MEMORY_OPTIMAL, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory, &offset, NULL)) {
+      goto out;
+    }
+    res = vkBindImageMemory(gears->device, gears->image[i].image, memory, offset);
+    if (res) {
+      printf("vkBindImageMemory failed: %d\n", res);
+      goto out;
+    }
   }
 
-  gears->device = device;
+  /* each offscreen frame is copied back to its slice of a mapped buffer at the end of its command buffer */
 
-  /* color attachment */
+  if (!swapchain && options.readback) {
+    memset(&bufferCreateInfo, 0, sizeof(VkBufferCreateInfo));
+    bufferCreateInfo.size = gears->nb_frames * win_width * win_height * 4;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    res = vkCreateBuffer(gears->device, &bufferCreateInfo, NULL, &gears->readbackBuffer);
+    if (res) {
+      printf("vkCreateBuffer failed: %d\n", res);
+      goto out;
+    }
 
-  res = vkGetSwapchainImagesKHR(gears->device, swapchain, &count, &gears->colorImage);
-  if (res) {
-    printf("vkGetSwapchainImagesKHR failed: %d\n", res);
-    goto out;
+    memset(&memoryRequirements, 0, sizeof(VkMemoryRequirements));
+    vkGetBufferMemoryRequirements(gears->device, gears->readbackBuffer, &memoryRequirements);
+
+    /* read by the CPU: cached memory if possible */
+    if (memory_alloc(gears, &memoryRequirements, MEMORY_LINEAR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &memory, &offset, &gears->readback_data)) {
+      goto out;
+    }
+    res = vkBindBufferMemory(gears->device, gears->readbackBuffer, memory, offset);
+    if (res) {
+      printf("vkBindBufferMemory failed: %d\n", res);
+      goto out;
+    }
   }
 
   /* depth attachment */
@@ -679,34 +1190,15 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   memset(&memoryRequirements, 0, sizeof(VkMemoryRequirements));
   vkGetImageMemoryRequirements(gears->device, gears->depthImage, &memoryRequirements);
 
-  memset(&memoryAllocateInfo, 0, sizeof(VkMemoryAllocateInfo));
-  memoryAllocateInfo.allocationSize = memoryRequirements.size;
-  res = vkAllocateMemory(gears->device, &memoryAllocateInfo, NULL, &gears->depthMemory);
-  if (res) {
-    printf("vkAllocateMemory failed: %d\n", res);
+  if (memory_alloc(gears, &memoryRequirements, MEMORY_OPTIMAL, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory, &offset, NULL)) {
     goto out;
   }
-  res = vkBindImageMemory(gears->device, gears->depthImage, gears->depthMemory, 0);
+  res = vkBindImageMemory(gears->device, gears->depthImage, memory, offset);
   if (res) {
     printf("vkBindImageMemory failed: %d\n", res);
     goto out;
   }
 
-  /* create framebuffer */
-
-  memset(&imageViewCreateInfo, 0, sizeof(VkImageViewCreateInfo));
-  imageViewCreateInfo.image = gears->colorImage;
-  imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-  imageViewCreateInfo.format = VK_FORMAT_B8G8R8A8_UNORM;
-  imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  imageViewCreateInfo.subresourceRange.levelCount = 1;
-  imageViewCreateInfo.subresourceRange.layerCount = 1;
-  res = vkCreateImageView(gears->device, &imageViewCreateInfo, NULL, &gears->imageView[0]);
-  if (res) {
-    printf("vkCreateImageView failed: %d\n", res);
-    goto out;
-  }
-
   memset(&imageViewCreateInfo, 0, sizeof(VkImageViewCreateInfo));
   imageViewCreateInfo.image = gears->depthImage;
   imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -714,23 +1206,12 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
   imageViewCreateInfo.subresourceRange.levelCount = 1;
   imageViewCreateInfo.subresourceRange.layerCount = 1;
-  res = vkCreateImageView(gears->device, &imageViewCreateInfo, 0, &gears->imageView[1]);
+  res = vkCreateImageView(gears->device, &imageViewCreateInfo, 0, &gears->depthView);
   if (res) {
     printf("vkCreateImageView failed: %d\n", res);
     goto out;
   }
 
-  memset(&framebufferCreateInfo, 0, sizeof(VkFramebufferCreateInfo));
-  framebufferCreateInfo.attachmentCount = 2;
-  framebufferCreateInfo.pAttachments = gears->imageView;
-  framebufferCreateInfo.width = win_width;
-  framebufferCreateInfo.height = win_height;
-  res = vkCreateFramebuffer(gears->device, &framebufferCreateInfo, NULL, &gears->framebuffer);
-  if (res) {
-    printf("vkCreateFramebuffer failed: %d\n", res);
-    goto out;
-  }
-
   /* create render pass */
 
   memset(&renderPassCreateInfo, 0, sizeof(VkRenderPassCreateInfo));
@@ -738,6 +1219,7 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   memset(&attachmentDescription[0], 0, sizeof(VkAttachmentDescription));
   attachmentDescription[0].format = VK_FORMAT_B8G8R8A8_UNORM;
   attachmentDescription[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachmentDescription[0].finalLayout = swapchain ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
   memset(&attachmentDescription[1], 0, sizeof(VkAttachmentDescription));
   attachmentDescription[1].format = VK_FORMAT_D32_SFLOAT_S8_UINT;
   attachmentDescription[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
@@ -752,12 +1234,66 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   attachmentReference[1].attachment = 1;
   subpassDescription.pDepthStencilAttachment = &attachmentReference[1];
   renderPassCreateInfo.pSubpasses = &subpassDescription;
+  /* the attachments may still be used by the previous frame in flight */
+  renderPassCreateInfo.dependencyCount = 1;
+  memset(&subpassDependency[0], 0, sizeof(VkSubpassDependency));
+  subpassDependency[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  subpassDependency[0].dstSubpass = 0;
+  subpassDependency[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  subpassDependency[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  subpassDependency[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  subpassDependency[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  /* offscreen, the color attachment is then copied back: the copy waits for the color writes and the final layout transition */
+  if (!swapchain) {
+    renderPassCreateInfo.dependencyCount = 2;
+    memset(&subpassDependency[1], 0, sizeof(VkSubpassDependency));
+    subpassDependency[1].srcSubpass = 0;
+    subpassDependency[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    subpassDependency[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependency[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    subpassDependency[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    subpassDependency[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  }
+  renderPassCreateInfo.pDependencies = subpassDependency;
   res = vkCreateRenderPass(gears->device, &renderPassCreateInfo, NULL, &gears->renderPass);
   if (res) {
     printf("vkCreateRenderPass failed: %d\n", res);
     goto out;
   }
 
+  /* create framebuffers */
+
+  for (i = 0; i < gears->nb_images; i++) {
+    memset(&imageViewCreateInfo, 0, sizeof(VkImageViewCreateInfo));
+    imageViewCreateInfo.image = gears->image[i].image;
+    imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageViewCreateInfo.format = VK_FORMAT_B8G8R8A8_UNORM;
+    imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageViewCreateInfo.subresourceRange.levelCount = 1;
+    imageViewCreateInfo.subresourceRange.layerCount = 1;
+    res = vkCreateImageView(gears->device, &imageViewCreateInfo, NULL, &gears->image[i].view);
+    if (res) {
+      printf("vkCreateImageView failed: %d\n", res);
+      goto out;
+    }
+
+    attachments[0] = gears->image[i].view;
+    attachments[1] = gears->depthView;
+
+    memset(&framebufferCreateInfo, 0, sizeof(VkFramebufferCreateInfo));
+    framebufferCreateInfo.renderPass = gears->renderPass;
+    framebufferCreateInfo.attachmentCount = 2;
+    framebufferCreateInfo.pAttachments = attachments;
+    framebufferCreateInfo.width = win_width;
+    framebufferCreateInfo.height = win_height;
+    framebufferCreateInfo.layers = 1;
+    res = vkCreateFramebuffer(gears->device, &framebufferCreateInfo, NULL, &gears->image[i].framebuffer);
+    if (res) {
+      printf("vkCreateFramebuffer failed: %d\n", res);
+      goto out;
+    }
+  }
+
   /* vertex shader */
 
   memset(&shaderModuleCreateInfo, 0, sizeof(VkShaderModuleCreateInfo));
@@ -783,15 +1319,12 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   /* create pipeline */
 
   memset(&descriptorSetLayoutCreateInfo, 0, sizeof(VkDescriptorSetLayoutCreateInfo));
-  descriptorSetLayoutCreateInfo.bindingCount = 2;
-  memset(&descriptorSetLayoutBinding[0], 0, sizeof(VkDescriptorSetLayoutBinding));
-  descriptorSetLayoutBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  descriptorSetLayoutBinding[0].descriptorCount = 1;
-  memset(&descriptorSetLayoutBinding[1], 0, sizeof(VkDescriptorSetLayoutBinding));
-  descriptorSetLayoutBinding[1].binding = 1;
-  descriptorSetLayoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  descriptorSetLayoutBinding[1].descriptorCount = 1;
-  descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBinding;
+  descriptorSetLayoutCreateInfo.bindingCount = 1;
+  memset(&descriptorSetLayoutBinding, 0, sizeof(VkDescriptorSetLayoutBinding));
+  descriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorSetLayoutBinding.descriptorCount = 1;
+  descriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  descriptorSetLayoutCreateInfo.pBindings = &descriptorSetLayoutBinding;
   res = vkCreateDescriptorSetLayout(gears->device, &descriptorSetLayoutCreateInfo, NULL, &gears->descriptorSetLayout);
   if (res) {
     printf("vkCreateDescriptorSetLayout failed: %d\n", res);
@@ -801,6 +1334,11 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   memset(&pipelineLayoutCreateInfo, 0, sizeof(VkPipelineLayoutCreateInfo));
   pipelineLayoutCreateInfo.setLayoutCount = 1;
   pipelineLayoutCreateInfo.pSetLayouts = &gears->descriptorSetLayout;
+  pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+  memset(&pushConstantRange, 0, sizeof(VkPushConstantRange));
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  pushConstantRange.size = sizeof(struct PushConstants);
+  pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
   res = vkCreatePipelineLayout(gears->device, &pipelineLayoutCreateInfo, NULL, &gears->pipelineLayout);
   if (res) {
     printf("vkCreatePipelineLayout failed: %d\n", res);
@@ -813,29 +1351,58 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   pipelineShaderStageCreateInfo[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
   pipelineShaderStageCreateInfo[0].module = vertShaderModule;
   pipelineShaderStageCreateInfo[0].pName = "main";
+  memset(&specializationInfo, 0, sizeof(VkSpecializationInfo));
+  specializationInfo.mapEntryCount = 1;
+  memset(&specializationMapEntry, 0, sizeof(VkSpecializationMapEntry));
+  specializationMapEntry.size = sizeof(VkBool32);
+  specializationInfo.pMapEntries = &specializationMapEntry;
+  specializationInfo.dataSize = sizeof(VkBool32);
+  compact = gears->layout & MESH_COMPACT ? VK_TRUE : VK_FALSE;
+  specializationInfo.pData = &compact;
+  pipelineShaderStageCreateInfo[0].pSpecializationInfo = &specializationInfo;
   memset(&pipelineShaderStageCreateInfo[1], 0, sizeof(VkPipelineShaderStageCreateInfo));
   pipelineShaderStageCreateInfo[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   pipelineShaderStageCreateInfo[1].module = fragShaderModule;
   pipelineShaderStageCreateInfo[1].pName = "main";
   graphicsPipelineCreateInfo.pStages = pipelineShaderStageCreateInfo;
   memset(&pipelineVertexInputStateCreateInfo, 0, sizeof(VkPipelineVertexInputStateCreateInfo));
-  pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
-  memset(&vertexInputBindingDescription, 0, sizeof(VkVertexInputBindingDescription));
-  vertexInputBindingDescription.stride = sizeof(Vertex);
-  pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &vertexInputBindingDescription;
-  pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = 3;
+  pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 2;
+  memset(&vertexInputBindingDescription[0], 0, sizeof(VkVertexInputBindingDescription));
+  vertexInputBindingDescription[0].stride = mesh_stride(gears->layout);
+  memset(&vertexInputBindingDescription[1], 0, sizeof(VkVertexInputBindingDescription));
+  vertexInputBindingDescription[1].binding = 1;
+  vertexInputBindingDescription[1].stride = sizeof(float) * 2;
+  vertexInputBindingDescription[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+  pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = vertexInputBindingDescription;
+  pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = 4;
   memset(&vertexInputAttributeDescription[0], 0, sizeof(VkVertexInputAttributeDescription));
   vertexInputAttributeDescription[0].location = 0;
-  vertexInputAttributeDescription[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-  vertexInputAttributeDescription[0].offset = 0;
   memset(&vertexInputAttributeDescription[1], 0, sizeof(VkVertexInputAttributeDescription));
   vertexInputAttributeDescription[1].location = 1;
-  vertexInputAttributeDescription[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-  vertexInputAttributeDescription[1].offset = sizeof(float) * 3;
   memset(&vertexInputAttributeDescription[2], 0, sizeof(VkVertexInputAttributeDescription));
   vertexInputAttributeDescription[2].location = 2;
-  vertexInputAttributeDescription[2].format = VK_FORMAT_R32G32_SFLOAT;
-  vertexInputAttributeDescription[2].offset = sizeof(float) * 6;
+  if (gears->layout & MESH_COMPACT) {
+    vertexInputAttributeDescription[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    vertexInputAttributeDescription[0].offset = 0;
+    vertexInputAttributeDescription[1].format = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+    vertexInputAttributeDescription[1].offset = sizeof(uint16_t) * 4;
+    /* texture coordinates are computed in the vertex shader, the attribute is unused */
+    vertexInputAttributeDescription[2].format = VK_FORMAT_R16G16_SFLOAT;
+    vertexInputAttributeDescription[2].offset = 0;
+  }
+  else {
+    vertexInputAttributeDescription[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    vertexInputAttributeDescription[0].offset = 0;
+    vertexInputAttributeDescription[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    vertexInputAttributeDescription[1].offset = sizeof(float) * 3;
+    vertexInputAttributeDescription[2].format = VK_FORMAT_R32G32_SFLOAT;
+    vertexInputAttributeDescription[2].offset = sizeof(float) * 6;
+  }
+  memset(&vertexInputAttributeDescription[3], 0, sizeof(VkVertexInputAttributeDescription));
+  vertexInputAttributeDescription[3].location = 3;
+  vertexInputAttributeDescription[3].binding = 1;
+  vertexInputAttributeDescription[3].format = VK_FORMAT_R32G32_SFLOAT;
+  vertexInputAttributeDescription[3].offset = 0;
   pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexInputAttributeDescription;
   graphicsPipelineCreateInfo.pVertexInputState = &pipelineVertexInputStateCreateInfo;
   memset(&pipelineInputAssemblyStateCreateInfo, 0, sizeof(VkPipelineInputAssemblyStateCreateInfo));
@@ -871,11 +1438,43 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   graphicsPipelineCreateInfo.pDynamicState = &pipelineDynamicStateCreateInfo;
   graphicsPipelineCreateInfo.layout = gears->pipelineLayout;
   graphicsPipelineCreateInfo.renderPass = gears->renderPass;
-  res = vkCreateGraphicsPipelines(gears->device, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, NULL, &gears->pipeline);
+
+  /* pipeline cache, initialized from the file of the device if any */
+
+  vkGetPhysicalDeviceProperties(physical_device, &physicalDeviceProperties);
+  pipeline_cache_file = pipeline_cache_filename(&physicalDeviceProperties);
+
+  memset(&pipelineCacheCreateInfo, 0, sizeof(VkPipelineCacheCreateInfo));
+  if (pipeline_cache_file) {
+    pipeline_cache_data = pipeline_cache_load(pipeline_cache_file, &physicalDeviceProperties, &pipelineCacheCreateInfo.initialDataSize);
+    pipelineCacheCreateInfo.pInitialData = pipeline_cache_data;
+  }
+  res = vkCreatePipelineCache(gears->device, &pipelineCacheCreateInfo, NULL, &pipelineCache);
+  if (res) {
+    printf("vkCreatePipelineCache failed: %d\n", res);
+    goto out;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_start);
+  res = vkCreateGraphicsPipelines(gears->device, pipelineCache, 1, &graphicsPipelineCreateInfo, NULL, &gears->pipeline);
   if (res) {
     printf("vkCreateGraphicsPipelines failed: %d\n", res);
     goto out;
   }
+  clock_gettime(CLOCK_MONOTONIC, &ts_end);
+
+  printf("Pipeline created in %.3f ms (%s)\n", (ts_end.tv_sec - ts_start.tv_sec) * 1000.0 + (ts_end.tv_nsec - ts_start.tv_nsec) / 1000000.0, pipeline_cache_data ? "pipeline cache loaded" : "no pipeline cache");
+
+  if (pipeline_cache_file) {
+    pipeline_cache_save(gears, pipelineCache, pipeline_cache_file);
+  }
+
+  vkDestroyPipelineCache(gears->device, pipelineCache, NULL);
+  pipelineCache = VK_NULL_HANDLE;
+  free(pipeline_cache_data);
+  pipeline_cache_data = NULL;
+  free(pipeline_cache_file);
+  pipeline_cache_file = NULL;
 
   /* destroy shaders */
 
@@ -883,18 +1482,53 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   vkDestroyShaderModule(gears->device, vertShaderModule, NULL);
   vertShaderModule = fragShaderModule = VK_NULL_HANDLE;
 
+  /* upload command buffer: copies from staging buffers, submitted once all resources are created */
+
+  memset(&commandPoolCreateInfo, 0, sizeof(VkCommandPoolCreateInfo));
+  commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  res = vkCreateCommandPool(gears->device, &commandPoolCreateInfo, NULL, &gears->commandPool);
+  if (res) {
+    printf("vkCreateCommandPool failed: %d\n", res);
+    goto out;
+  }
+
+  memset(&commandBufferAllocateInfo, 0, sizeof(VkCommandBufferAllocateInfo));
+  commandBufferAllocateInfo.commandPool = gears->commandPool;
+  commandBufferAllocateInfo.commandBufferCount = 1;
+  res = vkAllocateCommandBuffers(gears->device, &commandBufferAllocateInfo, &gears->uploadCommandBuffer);
+  if (res) {
+    printf("vkAllocateCommandBuffers failed: %d\n", res);
+    goto out;
+  }
+
+  memset(&commandBufferBeginInfo, 0, sizeof(VkCommandBufferBeginInfo));
+  commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  res = vkBeginCommandBuffer(gears->uploadCommandBuffer, &commandBufferBeginInfo);
+  if (res) {
+    printf("vkBeginCommandBuffer failed: %d\n", res);
+    goto out;
+  }
+
   /* load texture */
 
-  image_load(getenv("TEXTURE"), NULL, &texture_width, &texture_height);
+  image_load(options.texture, NULL, &texture_width, &texture_height);
+
+  texture_levels = 1;
+  while ((texture_width | texture_height) >> texture_levels) {
+    texture_levels++;
+  }
 
   memset(&imageCreateInfo, 0, sizeof(VkImageCreateInfo));
   imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
   imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
   imageCreateInfo.extent.width = texture_width;
   imageCreateInfo.extent.height = texture_height;
-  imageCreateInfo.mipLevels = 1;
+  imageCreateInfo.extent.depth = 1;
+  imageCreateInfo.mipLevels = texture_levels;
   imageCreateInfo.arrayLayers = 1;
   imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
   res = vkCreateImage(gears->device, &imageCreateInfo, NULL, &gears->textureImage);
   if (res) {
     printf("vkCreateImage failed: %d\n", res);
@@ -904,32 +1538,89 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   memset(&memoryRequirements, 0, sizeof(VkMemoryRequirements));
   vkGetImageMemoryRequirements(gears->device, gears->textureImage, &memoryRequirements);
 
-  memset(&memoryAllocateInfo, 0, sizeof(VkMemoryAllocateInfo));
-  memoryAllocateInfo.allocationSize = memoryRequirements.size;
-  res = vkAllocateMemory(gears->device, &memoryAllocateInfo, NULL, &gears->textureMemory);
-  if (res) {
-    printf("vkAllocateMemory failed: %d\n", res);
+  if (memory_alloc(gears, &memoryRequirements, MEMORY_OPTIMAL, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory, &offset, NULL)) {
     goto out;
   }
-  res = vkMapMemory(gears->device, gears->textureMemory, 0, memoryRequirements.size, 0, &texture_data);
+  res = vkBindImageMemory(gears->device, gears->textureImage, memory, offset);
   if (res) {
-    printf("vkMapMemory failed: %d\n", res);
+    printf("vkBindImageMemory failed: %d\n", res);
     goto out;
   }
-  res = vkBindImageMemory(gears->device, gears->textureImage, gears->textureMemory, 0);
-  if (res) {
-    printf("vkBindImageMemory failed: %d\n", res);
+
+  texture_data = staging_alloc(gears, texture_width * texture_height * 4, &stagingBuffer);
+  if (!texture_data) {
     goto out;
   }
 
-  image_load(getenv("TEXTURE"), texture_data, &texture_width, &texture_height);
+  image_load(options.texture, texture_data, &texture_width, &texture_height);
+
+  /* level 0 copied from the staging buffer, then each level blitted from the previous one */
+
+  memset(&imageMemoryBarrier, 0, sizeof(VkImageMemoryBarrier));
+  imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageMemoryBarrier.image = gears->textureImage;
+  imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  imageMemoryBarrier.subresourceRange.levelCount = texture_levels;
+  imageMemoryBarrier.subresourceRange.layerCount = 1;
+  imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(gears->uploadCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &imageMemoryBarrier);
+
+  memset(&bufferImageCopy, 0, sizeof(VkBufferImageCopy));
+  bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  bufferImageCopy.imageSubresource.layerCount = 1;
+  bufferImageCopy.imageExtent.width = texture_width;
+  bufferImageCopy.imageExtent.height = texture_height;
+  bufferImageCopy.imageExtent.depth = 1;
+  vkCmdCopyBufferToImage(gears->uploadCommandBuffer, stagingBuffer, gears->textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferImageCopy);
+
+  imageMemoryBarrier.subresourceRange.levelCount = 1;
+
+  for (i = 1; i < texture_levels; i++) {
+    imageMemoryBarrier.subresourceRange.baseMipLevel = i - 1;
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(gears->uploadCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &imageMemoryBarrier);
+
+    memset(&imageBlit, 0, sizeof(VkImageBlit));
+    imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageBlit.srcSubresource.mipLevel = i - 1;
+    imageBlit.srcSubresource.layerCount = 1;
+    imageBlit.srcOffsets[1].x = texture_width >> (i - 1) > 1 ? texture_width >> (i - 1) : 1;
+    imageBlit.srcOffsets[1].y = texture_height >> (i - 1) > 1 ? texture_height >> (i - 1) : 1;
+    imageBlit.srcOffsets[1].z = 1;
+    imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageBlit.dstSubresource.mipLevel = i;
+    imageBlit.dstSubresource.layerCount = 1;
+    imageBlit.dstOffsets[1].x = texture_width >> i > 1 ? texture_width >> i : 1;
+    imageBlit.dstOffsets[1].y = texture_height >> i > 1 ? texture_height >> i : 1;
+    imageBlit.dstOffsets[1].z = 1;
+    vkCmdBlitImage(gears->uploadCommandBuffer, gears->textureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, gears->textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(gears->uploadCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &imageMemoryBarrier);
+  }
+
+  imageMemoryBarrier.subresourceRange.baseMipLevel = texture_levels - 1;
+  imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(gears->uploadCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &imageMemoryBarrier);
 
   memset(&imageViewCreateInfo, 0, sizeof(VkImageViewCreateInfo));
   imageViewCreateInfo.image = gears->textureImage;
   imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
   imageViewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
   imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  imageViewCreateInfo.subresourceRange.levelCount = 1;
+  imageViewCreateInfo.subresourceRange.levelCount = texture_levels;
   imageViewCreateInfo.subresourceRange.layerCount = 1;
   res = vkCreateImageView(gears->device, &imageViewCreateInfo, 0, &gears->texture);
   if (res) {
@@ -938,98 +1629,223 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   }
 
   memset(&samplerCreateInfo, 0, sizeof(VkSamplerCreateInfo));
+  samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerCreateInfo.maxLod = texture_levels;
   res = vkCreateSampler(gears->device, &samplerCreateInfo, NULL, &gears->sampler);
   if (res) {
     printf("vkCreateSampler failed: %d\n", res);
     goto out;
   }
 
-  /* command buffer submitted to queue, set clear values, set viewport */
+  /* GPU queries, when supported by the device and by the queue */
 
-  memset(&commandPoolCreateInfo, 0, sizeof(VkCommandPoolCreateInfo));
-  res = vkCreateCommandPool(gears->device, &commandPoolCreateInfo, NULL, &gears->commandPool);
-  if (res) {
-    printf("vkCreateCommandPool failed: %d\n", res);
-    goto out;
-  }
+  if (options.gpu_timestamps) {
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queueFamilyCount, NULL);
+    queueFamilyProperties = calloc(queueFamilyCount, sizeof(VkQueueFamilyProperties));
+    if (!queueFamilyProperties) {
+      printf("calloc queueFamilyProperties failed\n");
+      goto out;
+    }
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queueFamilyCount, queueFamilyProperties);
 
-  memset(&commandBufferAllocateInfo, 0, sizeof(VkCommandBufferAllocateInfo));
-  commandBufferAllocateInfo.commandPool = gears->commandPool;
-  commandBufferAllocateInfo.commandBufferCount = 1;
-  res = vkAllocateCommandBuffers(gears->device, &commandBufferAllocateInfo, &gears->commandBuffer);
-  if (res) {
-    printf("vkAllocateCommandBuffers failed: %d\n", res);
-    goto out;
+    if (!queueFamilyCount || !queueFamilyProperties[0].timestampValidBits) {
+      printf("GPU timestamps not supported\n");
+    }
+    else {
+      gears->nb_timestamps = scene->nb + 2;
+      gears->timestampPeriod = physicalDeviceProperties.limits.timestampPeriod;
+      gears->timestampMask = queueFamilyProperties[0].timestampValidBits < 64 ? (1ULL << queueFamilyProperties[0].timestampValidBits) - 1 : ~0ULL;
+
+      gears->timestamps = calloc(gears->nb_timestamps, sizeof(uint64_t));
+      if (!gears->timestamps) {
+        printf("calloc timestamps failed\n");
+        goto out;
+      }
+
+      gears->gear_time_sum = calloc(scene->nb, sizeof(double));
+      if (!gears->gear_time_sum) {
+        printf("calloc gear_time_sum failed\n");
+        goto out;
+      }
+    }
   }
 
-  memset(&commandBufferBeginInfo, 0, sizeof(VkCommandBufferBeginInfo));
-  res = vkBeginCommandBuffer(gears->commandBuffer, &commandBufferBeginInfo);
-  if (res) {
-    printf("vkBeginCommandBuffer failed: %d\n", res);
-    goto out;
+  if (options.pipeline_statistics) {
+    vkGetPhysicalDeviceFeatures(physical_device, &physicalDeviceFeatures);
+    if (!physicalDeviceFeatures.pipelineStatisticsQuery || (options.record_threads > 1 && !physicalDeviceFeatures.inheritedQueries)) {
+      printf("pipeline statistics queries not supported\n");
+    }
+    else {
+      gears->statistics = 1;
+    }
   }
 
-  memset(&renderPassBeginInfo, 0, sizeof(VkRenderPassBeginInfo));
-  renderPassBeginInfo.renderPass = gears->renderPass;
-  renderPassBeginInfo.framebuffer = gears->framebuffer;
-  renderPassBeginInfo.renderArea.extent.width = win_width;
-  renderPassBeginInfo.renderArea.extent.height = win_height;
-  renderPassBeginInfo.clearValueCount = 2;
-  memset(&clearValue[0], 0, sizeof(VkClearValue));
-  memset(&clearValue[1], 0, sizeof(VkClearValue));
-  clearValue[1].depthStencil.depth = 1;
-  renderPassBeginInfo.pClearValues = clearValue;
-  vkCmdBeginRenderPass(gears->commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+  /* command buffers recorded for each frame, fences and acquire semaphores of the frames in flight */
 
-  vkCmdBindPipeline(gears->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gears->pipeline);
+  for (i = 0; i < gears->nb_frames; i++) {
+    memset(&commandBufferAllocateInfo, 0, sizeof(VkCommandBufferAllocateInfo));
+    commandBufferAllocateInfo.commandPool = gears->commandPool;
+    commandBufferAllocateInfo.commandBufferCount = 1;
+    res = vkAllocateCommandBuffers(gears->device, &commandBufferAllocateInfo, &gears->frame[i].commandBuffer);
+    if (res) {
+      printf("vkAllocateCommandBuffers failed: %d\n", res);
+      goto out;
+    }
 
-  memset(&scissor, 0, sizeof(VkRect2D));
-  scissor.extent.width = win_width;
-  scissor.extent.height = win_height;
-  vkCmdSetScissor(gears->commandBuffer, 0, 1, &scissor);
+    memset(&fenceCreateInfo, 0, sizeof(VkFenceCreateInfo));
+    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    res = vkCreateFence(gears->device, &fenceCreateInfo, NULL, &gears->frame[i].fence);
+    if (res) {
+      printf("vkCreateFence failed: %d\n", res);
+      goto out;
+    }
 
-  memset(&viewport, 0, sizeof(VkViewport));
-  viewport.width = win_width;
-  viewport.height = win_height;
-  viewport.maxDepth = 1;
-  vkCmdSetViewport(gears->commandBuffer, 0, 1, &viewport);
+    if (gears->nb_timestamps) {
+      memset(&queryPoolCreateInfo, 0, sizeof(VkQueryPoolCreateInfo));
+      queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+      queryPoolCreateInfo.queryCount = gears->nb_timestamps;
+      res = vkCreateQueryPool(gears->device, &queryPoolCreateInfo, NULL, &gears->frame[i].timestampPool);
+      if (res) {
+        printf("vkCreateQueryPool failed: %d\n", res);
+        goto out;
+      }
+    }
+
+    if (gears->statistics) {
+      memset(&queryPoolCreateInfo, 0, sizeof(VkQueryPoolCreateInfo));
+      queryPoolCreateInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+      queryPoolCreateInfo.queryCount = 1;
+      queryPoolCreateInfo.pipelineStatistics = PIPELINE_STATISTICS;
+      res = vkCreateQueryPool(gears->device, &queryPoolCreateInfo, NULL, &gears->frame[i].statisticsPool);
+      if (res) {
+        printf("vkCreateQueryPool failed: %d\n", res);
+        goto out;
+      }
+    }
+
+    if (!swapchain) {
+      continue;
+    }
+
+    memset(&semaphoreCreateInfo, 0, sizeof(VkSemaphoreCreateInfo));
+    res = vkCreateSemaphore(gears->device, &semaphoreCreateInfo, NULL, &gears->frame[i].acquireSemaphore);
+    if (res) {
+      printf("vkCreateSemaphore failed: %d\n", res);
+      goto out;
+    }
+  }
+
+  /* render semaphores of the swapchain images */
+
+  if (swapchain) {
+    for (i = 0; i < gears->nb_images; i++) {
+      memset(&semaphoreCreateInfo, 0, sizeof(VkSemaphoreCreateInfo));
+      res = vkCreateSemaphore(gears->device, &semaphoreCreateInfo, NULL, &gears->image[i].renderSemaphore);
+      if (res) {
+        printf("vkCreateSemaphore failed: %d\n", res);
+        goto out;
+      }
+    }
+  }
 
   memset(&descriptorPoolCreateInfo, 0, sizeof(VkDescriptorPoolCreateInfo));
-  descriptorPoolCreateInfo.maxSets = 3;
-  descriptorPoolCreateInfo.poolSizeCount = 2;
-  memset(&descriptorPoolSize[0], 0, sizeof(VkDescriptorPoolSize));
-  descriptorPoolSize[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  descriptorPoolSize[0].descriptorCount = 3;
-  memset(&descriptorPoolSize[1], 0, sizeof(VkDescriptorPoolSize));
-  descriptorPoolSize[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  descriptorPoolSize[1].descriptorCount = 3;
-  descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSize;
+  descriptorPoolCreateInfo.maxSets = 1;
+  descriptorPoolCreateInfo.poolSizeCount = 1;
+  memset(&descriptorPoolSize, 0, sizeof(VkDescriptorPoolSize));
+  descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorPoolSize.descriptorCount = 1;
+  descriptorPoolCreateInfo.pPoolSizes = &descriptorPoolSize;
   res = vkCreateDescriptorPool(gears->device, &descriptorPoolCreateInfo, NULL, &gears->descriptorPool);
   if (res) {
     printf("vkCreateDescriptorPool failed: %d\n", res);
     goto out;
   }
 
-  /* create gears */
+  /* the texture is the only descriptor, shared by all gears */
 
-  if (create_gear(gears, GEAR0, 1.0, 4.0, 1.0, 20, 0.7)) {
+  memset(&descriptorSetAllocateInfo, 0, sizeof(VkDescriptorSetAllocateInfo));
+  descriptorSetAllocateInfo.descriptorPool = gears->descriptorPool;
+  descriptorSetAllocateInfo.descriptorSetCount = 1;
+  descriptorSetAllocateInfo.pSetLayouts = &gears->descriptorSetLayout;
+  res = vkAllocateDescriptorSets(gears->device, &descriptorSetAllocateInfo, &gears->descriptorSet);
+  if (res) {
+    printf("vkAllocateDescriptorSets failed: %d\n", res);
     goto out;
   }
 
-  if (create_gear(gears, GEAR1, 0.5, 2.0, 2.0, 10, 0.7)) {
-    goto out;
+  memset(&writeDescriptorSet, 0, sizeof(VkWriteDescriptorSet));
+  writeDescriptorSet.dstSet = gears->descriptorSet;
+  writeDescriptorSet.descriptorCount = 1;
+  writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  memset(&descriptorImageInfo, 0, sizeof(VkDescriptorImageInfo));
+  descriptorImageInfo.sampler = gears->sampler;
+  descriptorImageInfo.imageView = gears->texture;
+  descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  writeDescriptorSet.pImageInfo = &descriptorImageInfo;
+  vkUpdateDescriptorSets(gears->device, 1, &writeDescriptorSet, 0, NULL);
+
+  /* create gears */
+
+  for (i = 0; i < scene->nb; i++) {
+    if (create_gear(gears, i, scene->gear[i].inner, scene->gear[i].outer, scene->gear[i].width, scene->gear[i].teeth, scene->gear[i].tooth_depth)) {
+      goto out;
+    }
   }
 
-  if (create_gear(gears, GEAR2, 1.3, 2.0, 0.5, 10, 0.7)) {
+  if (staging_submit(gears)) {
     goto out;
   }
 
-  vkCmdEndRenderPass(gears->commandBuffer);
+  /* worker threads, each one with its range of gears and its command pool */
 
-  res = vkEndCommandBuffer(gears->commandBuffer);
-  if (res) {
-    printf("vkEndCommandBuffer failed: %d\n", res);
-    goto out;
+  if (options.record_threads > 1) {
+    gears->nb_threads = options.record_threads < MAX_THREADS ? options.record_threads : MAX_THREADS;
+    if (gears->nb_threads > scene->nb) {
+      gears->nb_threads = scene->nb;
+    }
+
+    pthread_mutex_init(&gears->record_mutex, NULL);
+    pthread_cond_init(&gears->record_cond, NULL);
+    pthread_cond_init(&gears->record_done_cond, NULL);
+
+    gears->thread = calloc(gears->nb_threads, sizeof(struct thread));
+    if (!gears->thread) {
+      printf("calloc thread failed\n");
+      goto out;
+    }
+
+    for (i = 0; i < gears->nb_threads; i++) {
+      gears->thread[i].gears = gears;
+      gears->thread[i].first = scene->nb * i / gears->nb_threads;
+      gears->thread[i].last = scene->nb * (i + 1) / gears->nb_threads;
+
+      memset(&commandPoolCreateInfo, 0, sizeof(VkCommandPoolCreateInfo));
+      commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+      res = vkCreateCommandPool(gears->device, &commandPoolCreateInfo, NULL, &gears->thread[i].commandPool);
+      if (res) {
+        printf("vkCreateCommandPool failed: %d\n", res);
+        goto out;
+      }
+
+      memset(&commandBufferAllocateInfo, 0, sizeof(VkCommandBufferAllocateInfo));
+      commandBufferAllocateInfo.commandPool = gears->thread[i].commandPool;
+      commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      commandBufferAllocateInfo.commandBufferCount = gears->nb_frames;
+      res = vkAllocateCommandBuffers(gears->device, &commandBufferAllocateInfo, gears->thread[i].commandBuffer);
+      if (res) {
+        printf("vkAllocateCommandBuffers failed: %d\n", res);
+        goto out;
+      }
+
+      res = pthread_create(&gears->thread[i].thread, NULL, record_thread, &gears->thread[i]);
+      if (res) {
+        printf("pthread_create failed: %d\n", res);
+        goto out;
+      }
+      gears->thread[i].started = 1;
+    }
   }
 
   memset(gears->Projection, 0, sizeof(gears->Projection));
@@ -1039,9 +1855,19 @@ gears_t *vk_gears_init(int win_width, int win_height, void *device, void *swapch
   gears->Projection[11] = -1;
   gears->Projection[14] = -2 * zFar * zNear / (zFar - zNear);
 
+  free(queueFamilyProperties);
+  free(swapchainImages);
+
   return gears;
 
 out:
+  free(queueFamilyProperties);
+  free(swapchainImages);
+  free(pipeline_cache_data);
+  free(pipeline_cache_file);
+  if (pipelineCache) {
+    vkDestroyPipelineCache(gears->device, pipelineCache, NULL);
+  }
   if (fragShaderModule) {
     vkDestroyShaderModule(gears->device, fragShaderModule, NULL);
   }
@@ -1052,32 +1878,259 @@ out:
   return NULL;
 }
 
-void vk_gears_draw(gears_t *gears, float view_tz, float view_rx, float view_ry, float model_rz, void *queue)
+/* time spent recording the draws of the last frame in ns, and number of threads recording them */
+uint64_t vk_gears_record_time(gears_t *gears, int *threads)
+{
+  if (!gears) {
+    return 0;
+  }
+
+  if (threads) {
+    *threads = gears->nb_threads ? gears->nb_threads : 1;
+  }
+
+  return gears->record_time;
+}
+
+/* GPU time of the render pass in ns and vertex and fragment shader invocations
+   (0 without PIPELINE_STATISTICS) of the frame whose queries were read back
+   by the last vk_gears_draw(), returns 0 if no new results are available */
+int vk_gears_gpu_time(gears_t *gears, uint64_t *gpu_time, uint64_t *statistics)
+{
+  if (!gears || !gears->queries_ready) {
+    return 0;
+  }
+
+  if (gpu_time) {
+    *gpu_time = gears->nb_timestamps ? gears->gpu_time : 0;
+  }
+
+  if (statistics) {
+    statistics[0] = gears->statistics ? gears->gpu_statistics[0] : 0;
+    statistics[1] = gears->statistics ? gears->gpu_statistics[1] : 0;
+  }
+
+  return 1;
+}
+
+/* last frame copied back in host memory (BGRA), only with offscreen rendering and READBACK set */
+const void *vk_gears_readback(gears_t *gears)
+{
+  int last;
+
+  if (!gears || !gears->readback_data) {
+    return NULL;
+  }
+
+  last = (gears->current + gears->nb_frames - 1) % gears->nb_frames;
+
+  vkWaitForFences(gears->device, 1, &gears->frame[last].fence, VK_TRUE, UINT64_MAX);
+
+  return (char *)gears->readback_data + last * gears->width * gears->height * 4;
+}
+
+/* record and submit the commands of a frame, then present it if rendering to a swapchain */
+int vk_gears_draw(gears_t *gears, float view_tz, float view_rx, float view_ry, float model_rz, void *queue)
 {
-  const float red[4] = { 0.8, 0.1, 0.0, 1.0 };
-  const float green[4] = { 0.0, 0.8, 0.2, 1.0 };
-  const float blue[4] = { 0.2, 0.2, 1.0, 1.0 };
+  struct frame *frame;
+  int i;
+  uint32_t index;
   VkResult res = VK_SUCCESS;
+  VkCommandBufferBeginInfo commandBufferBeginInfo;
+  VkRenderPassBeginInfo renderPassBeginInfo;
+  VkClearValue clearValue[2];
+  VkCommandBuffer secondaryCommandBuffers[MAX_THREADS];
+  struct timespec ts_start, ts_end;
+  VkBufferImageCopy bufferImageCopy;
+  VkBufferMemoryBarrier bufferMemoryBarrier;
+  VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
   VkSubmitInfo submitInfo;
+  VkPresentInfoKHR presentInfo;
 
   if (!gears) {
-    return;
+    return -1;
+  }
+
+  frame = &gears->frame[gears->current];
+
+  /* wait for the previous use of this frame to be completed, its command buffers are then free */
+
+  res = vkWaitForFences(gears->device, 1, &frame->fence, VK_TRUE, UINT64_MAX);
+  if (res) {
+    printf("vkWaitForFences failed: %d\n", res);
+    return -1;
   }
 
-  identity(gears->View);
-  translate(gears->View, 0, 0, view_tz);
-  rotate(gears->View, view_rx, 1, 0, 0);
-  rotate(gears->View, view_ry, 0, 1, 0);
+  if (frame->queries) {
+    read_queries(gears, frame);
+    frame->queries = 0;
+  }
+  else {
+    gears->queries_ready = 0;
+  }
+
+  if (gears->swapchain) {
+    res = vkAcquireNextImageKHR(gears->device, gears->swapchain, UINT64_MAX, frame->acquireSemaphore, VK_NULL_HANDLE, &index);
+    if (res && res != VK_SUBOPTIMAL_KHR) {
+      printf("vkAcquireNextImageKHR failed: %d\n", res);
+      return -1;
+    }
+  }
+  else {
+    index = gears->current;
+  }
+
+  res = vkResetFences(gears->device, 1, &frame->fence);
+  if (res) {
+    printf("vkResetFences failed: %d\n", res);
+    return -1;
+  }
+
+  res = vkResetCommandBuffer(frame->commandBuffer, 0);
+  if (res) {
+    printf("vkResetCommandBuffer failed: %d\n", res);
+    return -1;
+  }
+
+  memset(&commandBufferBeginInfo, 0, sizeof(VkCommandBufferBeginInfo));
+  commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  res = vkBeginCommandBuffer(frame->commandBuffer, &commandBufferBeginInfo);
+  if (res) {
+    printf("vkBeginCommandBuffer failed: %d\n", res);
+    return -1;
+  }
+
+  if (gears->nb_timestamps) {
+    vkCmdResetQueryPool(frame->commandBuffer, frame->timestampPool, 0, gears->nb_timestamps);
+    vkCmdWriteTimestamp(frame->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame->timestampPool, 0);
+  }
+  if (gears->statistics) {
+    vkCmdResetQueryPool(frame->commandBuffer, frame->statisticsPool, 0, 1);
+    vkCmdBeginQuery(frame->commandBuffer, frame->statisticsPool, 0, 0);
+  }
+
+  mat4_identity(gears->View);
+  mat4_translate(gears->View, 0, 0, view_tz);
+  mat4_rotate(gears->View, -view_rx, 1, 0, 0);
+  mat4_rotate(gears->View, view_ry, 0, 1, 0);
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_start);
+
+  /* secondary command buffers recorded by the worker threads */
+
+  if (gears->nb_threads) {
+    gears->record_framebuffer = gears->image[index].framebuffer;
+    gears->record_model_rz = model_rz;
+
+    pthread_mutex_lock(&gears->record_mutex);
+    gears->record_pending = gears->nb_threads;
+    gears->record++;
+    pthread_cond_broadcast(&gears->record_cond);
+    while (gears->record_pending) {
+      pthread_cond_wait(&gears->record_done_cond, &gears->record_mutex);
+    }
+    pthread_mutex_unlock(&gears->record_mutex);
+
+    for (i = 0; i < gears->nb_threads; i++) {
+      if (gears->thread[i].res) {
+        return -1;
+      }
+      secondaryCommandBuffers[i] = gears->thread[i].commandBuffer[gears->current];
+    }
+  }
 
-  draw_gear(gears, GEAR0, -3.0,  2.0,      model_rz     , red);
-  draw_gear(gears, GEAR1,  3.1,  2.0, -2 * model_rz - 9 , green);
-  draw_gear(gears, GEAR2, -3.1, -4.2, -2 * model_rz - 25, blue);
+  memset(&renderPassBeginInfo, 0, sizeof(VkRenderPassBeginInfo));
+  renderPassBeginInfo.renderPass = gears->renderPass;
+  renderPassBeginInfo.framebuffer = gears->image[index].framebuffer;
+  renderPassBeginInfo.renderArea.extent.width = gears->width;
+  renderPassBeginInfo.renderArea.extent.height = gears->height;
+  renderPassBeginInfo.clearValueCount = 2;
+  memset(&clearValue[0], 0, sizeof(VkClearValue));
+  memset(&clearValue[1], 0, sizeof(VkClearValue));
+  clearValue[1].depthStencil.depth = 1;
+  renderPassBeginInfo.pClearValues = clearValue;
+
+  if (gears->nb_threads) {
+    vkCmdBeginRenderPass(frame->commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(frame->commandBuffer, gears->nb_threads, secondaryCommandBuffers);
+  }
+  else {
+    vkCmdBeginRenderPass(frame->commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    record_gears(gears, frame->commandBuffer, 0, gears->scene->nb, model_rz);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_end);
+  gears->record_time = (ts_end.tv_sec - ts_start.tv_sec) * 1000000000ULL + ts_end.tv_nsec - ts_start.tv_nsec;
+
+  vkCmdEndRenderPass(frame->commandBuffer);
+
+  if (gears->statistics) {
+    vkCmdEndQuery(frame->commandBuffer, frame->statisticsPool, 0);
+  }
+  if (gears->nb_timestamps) {
+    vkCmdWriteTimestamp(frame->commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame->timestampPool, gears->nb_timestamps - 1);
+  }
+  frame->queries = gears->nb_timestamps || gears->statistics;
+
+  if (gears->readbackBuffer) {
+    memset(&bufferImageCopy, 0, sizeof(VkBufferImageCopy));
+    bufferImageCopy.bufferOffset = index * gears->width * gears->height * 4;
+    bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    bufferImageCopy.imageSubresource.layerCount = 1;
+    bufferImageCopy.imageExtent.width = gears->width;
+    bufferImageCopy.imageExtent.height = gears->height;
+    bufferImageCopy.imageExtent.depth = 1;
+    vkCmdCopyImageToBuffer(frame->commandBuffer, gears->image[index].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, gears->readbackBuffer, 1, &bufferImageCopy);
+
+    /* made visible to the host reads of vk_gears_readback() once the fence is signaled */
+    memset(&bufferMemoryBarrier, 0, sizeof(VkBufferMemoryBarrier));
+    bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferMemoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferMemoryBarrier.buffer = gears->readbackBuffer;
+    bufferMemoryBarrier.offset = bufferImageCopy.bufferOffset;
+    bufferMemoryBarrier.size = gears->width * gears->height * 4;
+    vkCmdPipelineBarrier(frame->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &bufferMemoryBarrier, 0, NULL);
+  }
+
+  res = vkEndCommandBuffer(frame->commandBuffer);
+  if (res) {
+    printf("vkEndCommandBuffer failed: %d\n", res);
+    return -1;
+  }
 
   memset(&submitInfo, 0, sizeof(VkSubmitInfo));
+  if (gears->swapchain) {
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &frame->acquireSemaphore;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &gears->image[index].renderSemaphore;
+  }
   submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &gears->commandBuffer;
-  res = vkQueueSubmit(queue, 1, &submitInfo, NULL);
+  submitInfo.pCommandBuffers = &frame->commandBuffer;
+  res = vkQueueSubmit(queue, 1, &submitInfo, frame->fence);
   if (res) {
-    printf("vkEndCommandBuffer failed: %d\n", res);
+    printf("vkQueueSubmit failed: %d\n", res);
+    return -1;
+  }
+
+  gears->current = (gears->current + 1) % gears->nb_frames;
+
+  if (gears->swapchain) {
+    memset(&presentInfo, 0, sizeof(VkPresentInfoKHR));
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &gears->image[index].renderSemaphore;
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &gears->swapchain;
+    presentInfo.pImageIndices = &index;
+    res = vkQueuePresentKHR(queue, &presentInfo);
+    if (res && res != VK_SUBOPTIMAL_KHR) {
+      printf("vkQueuePresentKHR failed: %d\n", res);
+      return -1;
+    }
   }
+
+  return 0;
 }
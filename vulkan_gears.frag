@@ -1,13 +1,12 @@
 #version 420
 
-layout(binding = 0) uniform u {
-  vec4 u_LightPos;
+layout(push_constant) uniform u {
   mat4 u_ModelViewProjectionMatrix;
-  mat4 u_NormalMatrix;
+  vec4 u_LightDir;
   vec4 u_Color;
   int u_TextureEnable;
 };
-layout(binding = 1) uniform sampler2D u_Texture;
+layout(binding = 0) uniform sampler2D u_Texture;
 layout(location = 0) in vec4 v_Color;
 layout(location = 1) in vec2 v_TexCoord;
 layout(location = 0) out vec4 FragColor;
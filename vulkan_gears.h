@@ -21,14 +21,20 @@
   THE SOFTWARE.
 */
 
+#include <stdint.h>
+#include "scene.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef struct gears gears_t;
 
-gears_t *vk_gears_init(int, int, void *, void *);
-void vk_gears_draw(gears_t *, float, float, float, float, void *);
+gears_t *vk_gears_init(int, int, const scene_t *, void *, void *, void *);
+int vk_gears_draw(gears_t *, float, float, float, float, void *);
+uint64_t vk_gears_record_time(gears_t *, int *);
+int vk_gears_gpu_time(gears_t *, uint64_t *, uint64_t *);
+const void *vk_gears_readback(gears_t *);
 void vk_gears_term(gears_t *);
 
 #ifdef __cplusplus
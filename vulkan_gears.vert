@@ -1,12 +1,14 @@
 #version 420
 
-layout(location = 0) in vec3 a_Position;
+layout(constant_id = 0) const bool compact = false;
+
+layout(location = 0) in vec4 a_Position;
 layout(location = 1) in vec3 a_Normal;
 layout(location = 2) in vec2 a_TexCoord;
-layout(binding = 0) uniform u {
-  vec4 u_LightPos;
+layout(location = 3) in vec2 a_Rotation;
+layout(push_constant) uniform u {
   mat4 u_ModelViewProjectionMatrix;
-  mat4 u_NormalMatrix;
+  vec4 u_LightDir;
   vec4 u_Color;
   int u_TextureEnable;
 };
@@ -15,7 +17,16 @@ layout(location = 1) out vec2 v_TexCoord;
 
 void main()
 {
-  gl_Position = u_ModelViewProjectionMatrix * vec4(a_Position, 1);
-  v_Color = u_Color * vec4(0.2, 0.2, 0.2, 1) + u_Color * max(dot(normalize(u_LightPos.xyz), normalize(vec3(u_NormalMatrix * vec4(a_Normal, 1)))), 0.0);
-  v_TexCoord = a_TexCoord;
+  mat2 rotation = mat2(a_Rotation.x, a_Rotation.y, -a_Rotation.y, a_Rotation.x);
+  vec3 position = vec3(rotation * a_Position.xy, a_Position.z);
+  vec3 normal = a_Normal;
+  // texture coordinates are not flipped, so they are rotated the other way
+  v_TexCoord = ((a_TexCoord.yx - 0.5) * rotation + 0.5).yx * sign(dot(a_TexCoord, a_TexCoord));
+  if (compact) {
+    normal = a_Normal * 2.0 - 1.0;
+    v_TexCoord = (vec2(-position.y, position.x) * a_Position.w + 0.5) * sign(a_Position.w);
+  }
+  normal.xy = rotation * normal.xy;
+  gl_Position = u_ModelViewProjectionMatrix * vec4(position, 1);
+  v_Color = u_Color * vec4(0.2, 0.2, 0.2, 1) + u_Color * max(dot(normalize(u_LightDir.xyz), normalize(normal)), 0.0);
 }